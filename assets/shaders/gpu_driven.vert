@@ -0,0 +1,55 @@
+#version 450
+
+// Variant of pbr.vert for GPU driven rendering. Transforms come from the object buffer written
+// at load time, indexed by the firstInstance the culling shader wrote for the draw.
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+// Per-vertex values which will be interpolated on frag shader.
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragTexCoord;
+
+// Set and binding numbers must match the descriptor set layout.
+layout(set = 0, binding = 0) uniform GlobalUbo{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+} ubo;
+
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 boundingSphere;
+    uint firstBatch;
+    uint lodCount;
+    uint slot;
+    uint pad;
+};
+
+layout(set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// Must match the depth pre-pass shader bit for bit, see pbr_depth.vert.
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = objects[gl_InstanceIndex].modelMatrix;
+    mat4 normalMatrix = objects[gl_InstanceIndex].normalMatrix;
+
+    // Transform model's vertex position to world space
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
+
+    // Apply view and then projection.
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+
+    fragNormalWorld = normalize(mat3(normalMatrix) * normal);
+    fragPosWorld = positionWorld.xyz;
+    fragTexCoord = uv;
+    fragColor = color;
+}
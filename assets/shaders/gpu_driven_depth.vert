@@ -0,0 +1,34 @@
+#version 450
+
+// Depth-only variant of gpu_driven.vert for the depth pre-pass, see pbr_depth.vert.
+
+layout(location = 0) in vec3 position;
+
+// Set and binding numbers must match the descriptor set layout.
+layout(set = 0, binding = 0) uniform GlobalUbo{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+} ubo;
+
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 boundingSphere;
+    uint firstBatch;
+    uint lodCount;
+    uint slot;
+    uint pad;
+};
+
+layout(set = 2, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = objects[gl_InstanceIndex].modelMatrix;
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+}
@@ -0,0 +1,10 @@
+#version 450
+
+// Overdraw visualization. Drawn with additive blending, so every shaded fragment adds the same
+// amount and the brightness of a pixel shows how many times it was shaded.
+
+layout (location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(0.1, 0.04, 0.01, 1.0);
+}
@@ -12,11 +12,54 @@ layout (location = 0) out vec4 outColor;
 layout(set = 0, binding = 0) uniform GlobalUbo{
     mat4 projection;
     mat4 view;
-    vec3 lightPosition;
-    vec3 lightColor;
     vec3 viewPos;
+    uvec4 clusterGrid;   // Tiles across, tiles down, depth slices, light count.
+    vec4 clusterParams;  // Slice scale and bias, tiles per pixel across and down.
+    mat4 cascadeMatrices[4];  // World to shadow map clip space, see ShadowCascades.
+    vec4 cascadeSplits;       // View space depth each cascade ends at.
+    vec4 cascadeTexelSizes;   // World space size of a shadow map texel in each cascade.
+    vec4 sunDirection;        // Towards the sun, w is the cascade count.
+    vec4 sunColor;            // Color times intensity.
 } ubo;
 
+// Lights and the clusters they reach, see VeClusteredLighting.
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(set = 0, binding = 1) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+layout(set = 0, binding = 2) readonly buffer Clusters {
+    uvec2 clusters[];  // Offset into lightIndices and light count.
+};
+layout(set = 0, binding = 3) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+layout(set = 0, binding = 4) uniform sampler2DArrayShadow shadowMap;
+
+// Point light cube shadows, six faces each in a tile of the atlas, see PointShadowSystem.
+struct PointShadow {
+    mat4 faceMatrices[6];  // World to face clip space, faces in +x, -x, +y, -y, +z, -z order.
+    vec4 faceRects[6];     // Atlas uv offset and scale of each face, no scale for a lit face.
+};
+
+layout(set = 0, binding = 5) readonly buffer PointShadows {
+    PointShadow pointShadows[32];
+    uint shadowSlots[];  // Per light, its index into pointShadows plus one, 0 for none.
+};
+layout(set = 0, binding = 6) uniform sampler2DShadow pointShadowAtlas;
+
+// Which maps the material has, see MaterialFeatures. Maps that are off aren't sampled, their
+// factor in the material is used as is.
+layout(constant_id = 0) const bool HAS_ALBEDO_MAP = true;
+layout(constant_id = 1) const bool HAS_METALLIC_MAP = true;
+layout(constant_id = 2) const bool HAS_ROUGHNESS_MAP = true;
+layout(constant_id = 3) const bool HAS_AO_MAP = true;
+
 layout(set = 1, binding = 0) uniform sampler2D albedoMap;
 layout(set = 1, binding = 1) uniform sampler2D metallicMap;
 layout(set = 1, binding = 2) uniform sampler2D roughnessMap;
@@ -28,12 +71,6 @@ layout(set = 1, binding = 4) uniform Material {
     float ao;
 } mat;
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
-
-const int numPointLights = 1;
 const float PI = 3.14159265359;
 
 // Approximate the ratio between how much the surface reflects and how much it refracts.
@@ -92,58 +129,178 @@ vec4 srgb_to_linear(vec4 srgb) {
     return vec4(result, srgb.a);
 }
 
+// Cluster holding this fragment: its screen tile, and the depth slice its view space depth falls
+// in. Must match the clusters light_clusters.comp bins lights into.
+uint findCluster(float viewDepth) {
+    uvec2 tile = uvec2(gl_FragCoord.xy * ubo.clusterParams.zw);
+    tile = min(tile, ubo.clusterGrid.xy - uvec2(1));
+    float slice = log(max(viewDepth, 1e-6)) * ubo.clusterParams.x + ubo.clusterParams.y;
+    uint z = uint(clamp(slice, 0.0, float(ubo.clusterGrid.z - 1u)));
+    return (z * ubo.clusterGrid.y + tile.y) * ubo.clusterGrid.x + tile.x;
+}
+
+// Fraction of the sun's light reaching this fragment, looked up in the cascade its view space
+// depth falls in. Nothing beyond the last cascade is shadowed.
+float sunShadow(vec3 N, float viewDepth) {
+    uint cascadeCount = uint(ubo.sunDirection.w);
+    uint cascade = 0u;
+    while (cascade < cascadeCount && viewDepth > ubo.cascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == cascadeCount) {
+        return 1.0;
+    }
+
+    // Look up a point pushed off the surface by a texel or so, so it doesn't shadow itself.
+    vec3 offset = N * ubo.cascadeTexelSizes[cascade] * 1.5;
+    vec4 shadowPos = ubo.cascadeMatrices[cascade] * vec4(fragPosWorld + offset, 1.0);
+    if (shadowPos.z >= 1.0) {
+        return 1.0;
+    }
+    vec2 uv = shadowPos.xy * 0.5 + 0.5;
+
+    // 3x3 percentage closer filtering, each tap already a bilinear blend of four comparisons.
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 tap = uv + vec2(x, y) * texelSize;
+            lit += texture(shadowMap, vec4(tap, float(cascade), shadowPos.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+// Fraction of a point light's light reaching this fragment, looked up in the cube face the
+// direction from the light points through.
+float pointShadow(uint lightIndex, vec3 N, vec3 lightPosition) {
+    uint slot = shadowSlots[lightIndex];
+    if (slot == 0u) {
+        return 1.0;
+    }
+    PointShadow shadow = pointShadows[slot - 1u];
+
+    vec3 fromLight = fragPosWorld - lightPosition;
+    vec3 axis = abs(fromLight);
+    uint face;
+    if (axis.x >= axis.y && axis.x >= axis.z) {
+        face = fromLight.x > 0.0 ? 0u : 1u;
+    } else if (axis.y >= axis.z) {
+        face = fromLight.y > 0.0 ? 2u : 3u;
+    } else {
+        face = fromLight.z > 0.0 ? 4u : 5u;
+    }
+    vec4 rect = shadow.faceRects[face];
+    if (rect.z == 0.0) {
+        return 1.0;
+    }
+
+    // A texel of a 90 degree face is 2 * distance / texels wide. Look up a point pushed off the
+    // surface by a texel or so, so it doesn't shadow itself.
+    float texels = rect.z * float(textureSize(pointShadowAtlas, 0).x);
+    float texelSize = 2.0 * max(axis.x, max(axis.y, axis.z)) / texels;
+    vec4 shadowPos = shadow.faceMatrices[face] * vec4(fragPosWorld + N * texelSize * 1.5, 1.0);
+    shadowPos.xyz /= shadowPos.w;
+    if (shadowPos.z >= 1.0) {
+        return 1.0;
+    }
+
+    // Kept half a texel inside the tile, so filtering never reads the neighbouring tiles.
+    vec2 uv = clamp(shadowPos.xy * 0.5 + 0.5, vec2(0.5 / texels), vec2(1.0 - 0.5 / texels));
+    return texture(pointShadowAtlas, vec3(rect.xy + uv * rect.zw, shadowPos.z));
+}
+
+// Radiance reflected towards V of light arriving from direction L, using the Cook-Torrance BRDF.
+vec3 shade(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness) {
+    // Vector halfway between the view and the light vector.
+    vec3 H = normalize(V + L);
+
+    // Compute the BRDF term using the Cook-Torrance BRDF
+    // Fresnel (F)
+    // Dielectric materials are assumed to have a constant F0 value of 0.04.
+    vec3 F0 = vec3(0.04);
+    // Metal will tint the base reflectivity by the surface's color.
+    F0 = mix(F0, albedo, metallic);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    // Normal distribution function (D)
+    float NDF = distributionGGX(N, H, roughness);
+    // Geometry (G)
+    float G = geometrySmith(N, V, L, roughness);
+
+    // Cook-Torrance BRDF
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // Prevent divide by zero.
+    vec3 specular = numerator / denominator;
+
+    // Specular ratio.
+    vec3 kS = F;
+    // Diffuse ratio.
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic; // Metallic surfaces don't refract light, so we nullify the diffuse term.
+
+    // Calculate the light's contribution to the reflectance equation.
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
 void main() {
-    vec3 albedo = texture(albedoMap, fragTexCoord).rgb * mat.albedo;
-    float metallic = texture(metallicMap, fragTexCoord).r * mat.metallic;
-    float roughness = texture(roughnessMap, fragTexCoord).r * mat.roughness;
-    float ao = texture(aoMap, fragTexCoord).r * mat.ao;
+    vec3 albedo = mat.albedo;
+    float metallic = mat.metallic;
+    float roughness = mat.roughness;
+    float ao = mat.ao;
+    if (HAS_ALBEDO_MAP) {
+        albedo *= texture(albedoMap, fragTexCoord).rgb;
+    }
+    if (HAS_METALLIC_MAP) {
+        metallic *= texture(metallicMap, fragTexCoord).r;
+    }
+    if (HAS_ROUGHNESS_MAP) {
+        roughness *= texture(roughnessMap, fragTexCoord).r;
+    }
+    if (HAS_AO_MAP) {
+        ao *= texture(aoMap, fragTexCoord).r;
+    }
 
     vec3 N = normalize(fragNormalWorld); // Surface normal
     vec3 V = normalize(ubo.viewPos - fragPosWorld); // View direction
+    float viewDepth = (ubo.view * vec4(fragPosWorld, 1.0)).z;
 
     // Total reflected radiance back to the viewer.
     vec3 Lo = vec3(0.0);
 
-    // Sum the contributions of each point light in the scene to the outgoing radiance.
-    for (int i = 0; i < numPointLights; i++) {
+    // The sun, shadowed through the cascaded shadow map.
+    vec3 sunL = ubo.sunDirection.xyz;
+    if (dot(N, sunL) > 0.0) {
+        vec3 radiance = ubo.sunColor.rgb * sunShadow(N, viewDepth);
+        Lo += shade(N, V, sunL, radiance, albedo, metallic, roughness);
+    }
+
+    // Sum the contributions of the point lights reaching this fragment's cluster to the outgoing
+    // radiance.
+    uvec2 cluster = clusters[findCluster(viewDepth)];
+    for (uint i = cluster.x; i < cluster.x + cluster.y; i++) {
+        uint lightIndex = lightIndices[i];
+        PointLight light = pointLights[lightIndex];
+        vec3 toLight = light.position - fragPosWorld;
+        float distance = length(toLight);
+        if (distance >= light.radius) {
+            continue;
+        }
+
         // Light direction.
-        vec3 L = normalize(ubo.lightPosition - fragPosWorld);
-        // Vector halfway between the view and the light vector.
-        vec3 H = normalize(V + L);
-
-        // Attenuate light by the inverse square law.
-        float distance = length(ubo.lightPosition - fragPosWorld);
-        float attenuation = 1.0 / (distance * distance);
-
-        vec3 radiance = ubo.lightColor * attenuation;
-
-        // Compute the BRDF term using the Cook-Torrance BRDF
-        // Fresnel (F)
-        // Dielectric materials are assumed to have a constant F0 value of 0.04.
-        vec3 F0 = vec3(0.04);
-        // Metal will tint the base reflectivity by the surface's color.
-        F0 = mix(F0, albedo, metallic);
-        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-
-        // Normal distribution function (D)
-        float NDF = distributionGGX(N, H, roughness);
-        // Geometry (G)
-        float G = geometrySmith(N, V, L, roughness);
-
-        // Cook-Torrance BRDF
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001; // Prevent divide by zero.
-        vec3 specular = numerator / denominator;
-
-        // Specular ratio.
-        vec3 kS = F;
-        // Diffuse ratio.
-        vec3 kD = vec3(1.0) - kS;
-        kD *= 1.0 - metallic; // Metallic surfaces don't refract light, so we nullify the diffuse term.
-
-        // Calculate the light's contribution to the reflectance equation.
-        float NdotL = max(dot(N, L), 0.0);
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+        vec3 L = toLight / max(distance, 0.0001);
+
+        // Attenuate light by the inverse square law, windowed so it reaches zero at the radius
+        // (Karis 2013).
+        float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+        float attenuation = window * window / max(distance * distance, 0.0001);
+
+        vec3 radiance = light.color * light.intensity * attenuation;
+        if (dot(N, L) > 0.0) {
+            radiance *= pointShadow(lightIndex, N, light.position);
+        }
+        Lo += shade(N, V, L, radiance, albedo, metallic, roughness);
     }
 
     // Improvised ambient term.
@@ -15,26 +15,36 @@ layout(location = 3) out vec2 fragTexCoord;
 layout(set = 0, binding = 0) uniform GlobalUbo{
     mat4 projection;
     mat4 view;
-    vec3 lightPosition;
-    vec3 lightColor;
     vec3 viewPos;
 } ubo;
 
-layout(push_constant) uniform Push {
+struct InstanceData {
     mat4 modelMatrix;
     mat4 normalMatrix;
-} push;
+};
+
+// Transforms of every instance drawn this frame. Each instanced draw starts at the first
+// transform of its group through firstInstance.
+layout(set = 2, binding = 0) readonly buffer Instances {
+    InstanceData instances[];
+};
+
+// Must match the depth pre-pass shader bit for bit, see pbr_depth.vert.
+invariant gl_Position;
 
 void main() {
+    mat4 modelMatrix = instances[gl_InstanceIndex].modelMatrix;
+    mat4 normalMatrix = instances[gl_InstanceIndex].normalMatrix;
+
     // Transform model's vertex position to world space
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
 
     // Apply view and then projection.
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
     // After scaling, the model's normals will not be properly aligned in world space anymore,
     // so we must apply this transformation to transform it back to world space.
-    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    fragNormalWorld = normalize(mat3(normalMatrix) * normal);
 
     // The fragments position in world space will be interpolated in frag shader.
     fragPosWorld = positionWorld.xyz;
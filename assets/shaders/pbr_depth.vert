@@ -0,0 +1,31 @@
+#version 450
+
+// Depth-only variant of pbr.vert for the depth pre-pass. Only positions are read, from their own
+// tightly packed stream. gl_Position is invariant here and in pbr.vert, so both compute the exact
+// same depth and the main pass can test against it with VK_COMPARE_OP_EQUAL.
+
+layout(location = 0) in vec3 position;
+
+// Set and binding numbers must match the descriptor set layout.
+layout(set = 0, binding = 0) uniform GlobalUbo{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+} ubo;
+
+struct InstanceData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+layout(set = 2, binding = 0) readonly buffer Instances {
+    InstanceData instances[];
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = instances[gl_InstanceIndex].modelMatrix;
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+}
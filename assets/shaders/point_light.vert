@@ -10,23 +10,42 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout(location = 0) out vec2 fragOffset;
+layout(location = 1) out vec3 fragColor;
 
 // Set and binding numbers must match the descriptor set layout.
 layout(set = 0, binding = 0) uniform GlobalUbo{
     mat4 projection;
     mat4 view;
-    vec3 lightPosition;
-    vec3 lightColor;
     vec3 viewPos;
 } ubo;
 
+// Laid out to match std430 in pbr.frag.
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(set = 0, binding = 1) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+
+// Lights whose billboards passed frustum culling, one per instance.
+layout(set = 1, binding = 0) readonly buffer VisibleLights {
+    uint visibleLights[];
+};
+
+// Must match PointLightSystem::BILLBOARD_RADIUS.
 const float LIGHT_RADIUS = 0.1;
 
 void main() {
     fragOffset = OFFSETS[gl_VertexIndex];
+    PointLight light = pointLights[visibleLights[gl_InstanceIndex]];
+    fragColor = light.color;
 
     // Get the light's position in camera space.
-    vec4 lightPosCam = ubo.view * vec4(ubo.lightPosition, 1.0);
+    vec4 lightPosCam = ubo.view * vec4(light.position, 1.0);
 
     // Calculate the vertex's position in camera space.
     // Billboard will always be axis-aligned in camera space.
@@ -0,0 +1,18 @@
+#version 450
+
+// Draws shadow casters into one cascade of the shadow map. Only positions are read, from their own
+// tightly packed stream, and there is no fragment stage.
+
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) readonly buffer Instances {
+    mat4 modelMatrices[];
+};
+
+layout(push_constant) uniform Push {
+    mat4 viewProjection;  // Of the cascade being drawn.
+} push;
+
+void main() {
+    gl_Position = push.viewProjection * modelMatrices[gl_InstanceIndex] * vec4(position, 1.0);
+}
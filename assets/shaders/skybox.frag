@@ -8,8 +8,6 @@ layout(location = 0) out vec4 outColor;
 layout(set = 0, binding = 0) uniform GlobalUbo{
     mat4 projection;
     mat4 view;
-    vec3 lightPosition;
-    vec3 lightColor;
     vec3 viewPos;
 } ubo;
 
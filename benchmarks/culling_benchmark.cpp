@@ -0,0 +1,69 @@
+// Measures the frustum culling kernels on random boxes.
+//
+// Usage: CullingBenchmark [box count] [iterations]
+
+#include "Core/ve_culling.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    // Boxes scattered all around a camera at the origin, only some of them in view.
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> position{-200.f, 200.f};
+    std::uniform_real_distribution<float> size{0.1f, 4.f};
+    ve::CullBoxes boxes;
+    boxes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center{position(rng), position(rng), position(rng)};
+        glm::vec3 extent{size(rng), size(rng), size(rng)};
+        boxes.add({center - extent, center + extent});
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(50.f), 16.f / 9.f, .1f, 1000.f);
+    glm::mat4 view =
+        glm::lookAt(glm::vec3{0.f}, glm::vec3{0.f, 0.f, 1.f}, glm::vec3{0.f, -1.f, 0.f});
+    ve::Frustum frustum = ve::Frustum::fromMatrix(projection * view);
+
+    std::vector<uint8_t> reference(count);
+    size_t referenceVisible =
+        ve::cullBoxes(frustum, boxes, reference.data(), ve::CullPath::Scalar);
+    std::cout << count << " boxes, " << referenceVisible << " visible, " << iterations
+              << " iterations\n";
+
+    bool mismatch = false;
+    for (auto path : {ve::CullPath::Scalar, ve::CullPath::SSE, ve::CullPath::AVX2}) {
+        if (!ve::isCullPathSupported(path)) {
+            std::cout << ve::cullPathName(path) << ": not supported\n";
+            continue;
+        }
+
+        std::vector<uint8_t> visible(count);
+        size_t visibleCount = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            visibleCount = ve::cullBoxes(frustum, boxes, visible.data(), path);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double micros = std::chrono::duration<double, std::micro>(end - start).count();
+        double objectsPerMicro = static_cast<double>(count) * iterations / micros;
+        bool matches = visibleCount == referenceVisible && visible == reference;
+        mismatch = mismatch || !matches;
+        std::cout << ve::cullPathName(path) << ": " << objectsPerMicro << " objects/us"
+                  << (matches ? "" : " (MISMATCH with scalar)") << '\n';
+    }
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+// Renders a scene headless along its camera path and reports CPU and GPU frame time percentiles
+// as JSON, or compares two such reports.
+//
+// Usage: FrameBenchmark [--scene <name> [size]] [--lights <count>] [--frames <count>]
+//                       [--warmup <count>] [--cpu] [--depth-prepass] [--no-occlusion]
+//                       [--out <report.json>]
+//        FrameBenchmark --compare <baseline.json> <current.json> [threshold %]
+//
+// Run from a directory one level below the repository root, such as the build directory, like
+// the app: shaders, models and textures are loaded from ../assets. The report is printed when
+// there is no --out. Comparing exits with 1 if a percentile of the current run is slower
+// than the baseline's by more than the threshold, 5% by default, or if the current run lacks a
+// percentile the baseline has.
+
+#include "Core/ve_scene.hpp"
+#include "app_config.hpp"
+#include "headless.hpp"
+
+// std
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char *PERCENTILES[] = {"p50", "p95", "p99"};
+
+// Nearest rank percentile of sorted times.
+double percentile(const std::vector<double> &sorted, double p) {
+    auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::string jsonString(const std::string &value) {
+    std::string escaped = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+// Summary of one kind of frame time, null without any.
+std::string timesJson(std::vector<double> times) {
+    if (times.empty()) {
+        return "null";
+    }
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (double time : times) {
+        sum += time;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(4) << "{\"samples\": " << times.size()
+        << ", \"mean\": " << sum / static_cast<double>(times.size())
+        << ", \"min\": " << times.front() << ", \"max\": " << times.back();
+    out << ", \"p50\": " << percentile(times, 50.0) << ", \"p95\": " << percentile(times, 95.0)
+        << ", \"p99\": " << percentile(times, 99.0) << "}";
+    return out.str();
+}
+
+std::string reportJson(const ve::AppConfig &config, const ve::Headless &app) {
+    std::ostringstream out;
+    out << "{\n"
+        << "  \"scene\": " << jsonString(config.scene) << ",\n"
+        << "  \"sceneSize\": " << config.sceneSize << ",\n"
+        << "  \"lights\": " << config.stressLights << ",\n"
+        << "  \"gpuDriven\": " << (config.cpuRendering ? "false" : "true") << ",\n"
+        << "  \"depthPrepass\": " << (config.depthPrepass ? "true" : "false") << ",\n"
+        << "  \"occlusionCulling\": " << (config.occlusionCulling ? "true" : "false") << ",\n"
+        << "  \"device\": " << jsonString(app.getDeviceName()) << ",\n"
+        << "  \"width\": " << ve::Headless::WIDTH << ",\n"
+        << "  \"height\": " << ve::Headless::HEIGHT << ",\n"
+        << "  \"warmupFrames\": " << config.warmupFrames << ",\n"
+        << "  \"frames\": " << config.headlessFrames << ",\n"
+        << "  \"cpu\": " << timesJson(app.getCpuTimes()) << ",\n"
+        << "  \"gpu\": " << timesJson(app.getGpuTimes()) << "\n"
+        << "}\n";
+    return out.str();
+}
+
+// Just enough of a JSON reader for reports written above: the text of a top level value.
+std::optional<std::string> findValue(const std::string &json, const std::string &key) {
+    size_t keyPos = json.find("\"" + key + "\"");
+    if (keyPos == std::string::npos) {
+        return std::nullopt;
+    }
+    size_t start = json.find(':', keyPos);
+    if (start == std::string::npos) {
+        return std::nullopt;
+    }
+    start = json.find_first_not_of(" \t\n", start + 1);
+    if (start == std::string::npos) {
+        return std::nullopt;
+    }
+    size_t end = json[start] == '{' ? json.find('}', start) + 1 : json.find_first_of(",\n}", start);
+    return json.substr(start, end - start);
+}
+
+std::optional<double> findMetric(const std::string &json,
+                                 const std::string &section,
+                                 const std::string &key) {
+    auto object = findValue(json, section);
+    if (!object || object->front() != '{') {
+        return std::nullopt;
+    }
+    auto value = findValue(*object, key);
+    if (!value) {
+        return std::nullopt;
+    }
+    return std::strtod(value->c_str(), nullptr);
+}
+
+std::optional<std::string> readFile(const char *path) {
+    std::ifstream file{path};
+    if (!file) {
+        return std::nullopt;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+int compare(const char *baselinePath, const char *currentPath, double threshold) {
+    auto baseline = readFile(baselinePath);
+    auto current = readFile(currentPath);
+    if (!baseline || !current) {
+        std::cerr << "Can't read " << (baseline ? currentPath : baselinePath) << '\n';
+        return EXIT_FAILURE;
+    }
+    for (const char *key : {"scene", "sceneSize", "lights", "device", "width", "height"}) {
+        auto before = findValue(*baseline, key).value_or("nothing");
+        auto after = findValue(*current, key).value_or("nothing");
+        if (before != after) {
+            std::cout << "Warning: runs differ in " << key << ", " << before << " vs " << after
+                      << '\n';
+        }
+    }
+
+    std::cout << std::left << std::setw(10) << "metric" << std::right << std::setw(12)
+              << "baseline" << std::setw(12) << "current" << std::setw(10) << "change" << '\n';
+    bool regressed = false;
+    bool missing = false;
+    for (const char *section : {"cpu", "gpu"}) {
+        for (const char *key : PERCENTILES) {
+            auto before = findMetric(*baseline, section, key);
+            auto after = findMetric(*current, section, key);
+            if (!before || *before <= 0.0) {
+                continue;
+            }
+            // Losing a measurement, e.g. GPU timestamps, must not pass as no regression.
+            if (!after) {
+                missing = true;
+                std::cout << std::left << std::setw(10) << (std::string(section) + " " + key)
+                          << std::right << "  missing from " << currentPath << '\n';
+                continue;
+            }
+            double change = (*after - *before) / *before * 100.0;
+            bool regression = change > threshold;
+            regressed |= regression;
+            std::cout << std::left << std::setw(10) << (std::string(section) + " " + key)
+                      << std::right << std::fixed << std::setprecision(3) << std::setw(9)
+                      << *before << " ms" << std::setw(9) << *after << " ms" << std::showpos
+                      << std::setprecision(1) << std::setw(9) << change << "%" << std::noshowpos
+                      << (regression ? "  REGRESSION" : "") << '\n';
+        }
+    }
+
+    std::cout << (regressed ? "Regressions" : "No regressions") << " beyond " << threshold
+              << "%\n";
+    if (missing) {
+        std::cout << "Metrics of the baseline are missing from the current run\n";
+    }
+    return regressed || missing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc > 3 && std::strcmp(argv[1], "--compare") == 0) {
+        double threshold = argc > 4 ? std::strtod(argv[4], nullptr) : 5.0;
+        return compare(argv[2], argv[3], threshold);
+    }
+
+    ve::AppConfig config{};
+    config.headless = true;
+    config.headlessFrames = 600;
+    config.warmupFrames = 120;
+    const char *outPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            config.scene = argv[i + 1];
+            if (i + 2 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 2][0]))) {
+                config.sceneSize = static_cast<uint32_t>(std::strtoul(argv[i + 2], nullptr, 10));
+            }
+        } else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            config.stressLights = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            config.headlessFrames = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            config.warmupFrames = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--cpu") == 0) {
+            config.cpuRendering = true;
+        } else if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+            config.depthPrepass = true;
+        } else if (std::strcmp(argv[i], "--no-occlusion") == 0) {
+            config.occlusionCulling = false;
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[i + 1];
+        }
+    }
+
+    const auto &scenes = ve::VeScene::names();
+    if (std::find(scenes.begin(), scenes.end(), config.scene) == scenes.end()) {
+        std::cerr << "Unknown scene " << config.scene << ", scenes are:";
+        for (const auto &name : scenes) {
+            std::cerr << ' ' << name;
+        }
+        std::cerr << '\n';
+        return EXIT_FAILURE;
+    }
+
+    try {
+        ve::Headless app{config};
+        app.run();
+
+        std::string report = reportJson(config, app);
+        if (outPath == nullptr) {
+            std::cout << report;
+        } else {
+            std::ofstream out{outPath};
+            if (!(out << report)) {
+                std::cerr << "Can't write " << outPath << '\n';
+                return EXIT_FAILURE;
+            }
+            std::cout << "Wrote " << outPath << '\n';
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+// Measures the occlusion rasterizer and box tests on a few walls hiding random boxes.
+//
+// Usage: OcclusionBenchmark [box count] [iterations]
+
+#include "Core/ve_occlusion.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    glm::mat4 projection = glm::perspective(glm::radians(50.f), 16.f / 9.f, .1f, 1000.f);
+    glm::mat4 view =
+        glm::lookAt(glm::vec3{0.f}, glm::vec3{0.f, 0.f, 1.f}, glm::vec3{0.f, -1.f, 0.f});
+    glm::mat4 viewProjection = projection * view;
+
+    // A row of walls with gaps between them, and a few pillars in front.
+    std::vector<ve::OccluderMesh> occluders;
+    for (int i = -3; i <= 3; i++) {
+        auto x = static_cast<float>(i) * 12.f;
+        occluders.push_back(
+            ve::OccluderMesh::fromBox({{x - 5.f, -8.f, 40.f}, {x + 5.f, 8.f, 41.f}}));
+    }
+    for (int i = -2; i <= 2; i++) {
+        auto x = static_cast<float>(i) * 6.f;
+        occluders.push_back(
+            ve::OccluderMesh::fromBox({{x - .5f, -4.f, 15.f}, {x + .5f, 4.f, 16.f}}));
+    }
+    size_t triangles = 0;
+    for (const auto &occluder : occluders) {
+        triangles += occluder.triangleCount();
+    }
+
+    // Boxes behind and between the walls, most of them in view.
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> position{-40.f, 40.f};
+    std::uniform_real_distribution<float> distance{5.f, 200.f};
+    std::uniform_real_distribution<float> size{0.1f, 2.f};
+    ve::CullBoxes boxes;
+    boxes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center{position(rng), position(rng) * 0.3f, distance(rng)};
+        glm::vec3 extent{size(rng), size(rng), size(rng)};
+        boxes.add({center - extent, center + extent});
+    }
+
+    auto run = [&](ve::OcclusionBuffer &buffer, std::vector<uint8_t> &visible, ve::CullPath path) {
+        buffer.clear(viewProjection);
+        for (const auto &occluder : occluders) {
+            buffer.renderOccluder(occluder, glm::mat4{1.f}, path);
+        }
+        std::fill(visible.begin(), visible.end(), 1);
+        return buffer.testBoxes(boxes, visible.data(), 0, count, path);
+    };
+
+    ve::OcclusionBuffer reference{320, 180};
+    std::vector<uint8_t> referenceVisible(count);
+    size_t referenceHidden = run(reference, referenceVisible, ve::CullPath::Scalar);
+    std::cout << count << " boxes, " << occluders.size() << " occluders (" << triangles
+              << " triangles) at " << reference.getWidth() << "x" << reference.getHeight() << ", "
+              << referenceHidden << " hidden, " << iterations << " iterations\n";
+
+    bool mismatch = false;
+    for (auto path : {ve::CullPath::Scalar, ve::CullPath::SSE, ve::CullPath::AVX2}) {
+        if (!ve::isCullPathSupported(path)) {
+            std::cout << ve::cullPathName(path) << ": not supported\n";
+            continue;
+        }
+
+        ve::OcclusionBuffer buffer{320, 180};
+        std::vector<uint8_t> visible(count);
+        size_t hidden = 0;
+        double renderMicros = 0.0;
+        double testMicros = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            buffer.clear(viewProjection);
+            for (const auto &occluder : occluders) {
+                buffer.renderOccluder(occluder, glm::mat4{1.f}, path);
+            }
+            auto rendered = std::chrono::high_resolution_clock::now();
+            std::fill(visible.begin(), visible.end(), 1);
+            hidden = buffer.testBoxes(boxes, visible.data(), 0, count, path);
+            auto end = std::chrono::high_resolution_clock::now();
+            renderMicros += std::chrono::duration<double, std::micro>(rendered - start).count();
+            testMicros += std::chrono::duration<double, std::micro>(end - rendered).count();
+        }
+
+        bool matches = hidden == referenceHidden && visible == referenceVisible;
+        for (uint32_t y = 0; y < buffer.getHeight() && matches; y++) {
+            for (uint32_t x = 0; x < buffer.getWidth() && matches; x++) {
+                matches = buffer.depthAt(x, y) == reference.depthAt(x, y);
+            }
+        }
+        mismatch = mismatch || !matches;
+        std::cout << ve::cullPathName(path) << ": render " << renderMicros / iterations
+                  << " us, test " << static_cast<double>(count) * iterations / testMicros
+                  << " boxes/us" << (matches ? "" : " (MISMATCH with scalar)") << '\n';
+    }
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
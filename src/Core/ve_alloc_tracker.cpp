@@ -0,0 +1,226 @@
+#include "ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace ve {
+
+std::atomic<uint64_t> VeAllocTracker::s_frameAllocations{0};
+std::atomic<uint64_t> VeAllocTracker::s_frameBytes{0};
+VeAllocTracker::FrameReport VeAllocTracker::s_lastFrame{};
+std::array<VeAllocTracker::FrameReport, VeAllocTracker::MAX_FLAGGED_FRAMES>
+    VeAllocTracker::s_flagged{};
+uint64_t VeAllocTracker::s_flaggedCount{0};
+uint64_t VeAllocTracker::s_frameCount{0};
+
+namespace {
+
+std::array<VeAllocTracker::ScopeStats, ALLOC_SCOPE_COUNT> g_scopeStats{};
+
+// Stored right in front of every block we hand out to Vulkan so we know its size and where the
+// underlying malloc'd block begins.
+struct AllocationHeader {
+    size_t size;
+    size_t offset;
+};
+
+AllocationHeader *headerOf(void *memory) { return static_cast<AllocationHeader *>(memory) - 1; }
+
+void *VKAPI_PTR trackedAllocation(void *pUserData,
+                                  size_t size,
+                                  size_t alignment,
+                                  VkSystemAllocationScope /*allocationScope*/) {
+    if (size == 0) {
+        return nullptr;
+    }
+
+    // Reserve room for the header and for aligning the block.
+    alignment = std::max(alignment, alignof(AllocationHeader));
+    auto *raw = static_cast<char *>(std::malloc(size + alignment + sizeof(AllocationHeader)));
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(AllocationHeader);
+    uintptr_t aligned = (start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+
+    auto *memory = reinterpret_cast<void *>(aligned);
+    auto *header = headerOf(memory);
+    header->size = size;
+    header->offset = aligned - reinterpret_cast<uintptr_t>(raw);
+
+    auto *stats = static_cast<VeAllocTracker::ScopeStats *>(pUserData);
+    stats->allocations.fetch_add(1, std::memory_order_relaxed);
+    uint64_t live = stats->liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = stats->peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !stats->peakBytes.compare_exchange_weak(peak, live)) {
+    }
+
+    return memory;
+}
+
+void VKAPI_PTR trackedFree(void *pUserData, void *pMemory) {
+    if (pMemory == nullptr) {
+        return;
+    }
+
+    auto *header = headerOf(pMemory);
+    auto *stats = static_cast<VeAllocTracker::ScopeStats *>(pUserData);
+    stats->frees.fetch_add(1, std::memory_order_relaxed);
+    stats->liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+    std::free(static_cast<char *>(pMemory) - header->offset);
+}
+
+void *VKAPI_PTR trackedReallocation(void *pUserData,
+                                    void *pOriginal,
+                                    size_t size,
+                                    size_t alignment,
+                                    VkSystemAllocationScope allocationScope) {
+    if (pOriginal == nullptr) {
+        return trackedAllocation(pUserData, size, alignment, allocationScope);
+    }
+    if (size == 0) {
+        trackedFree(pUserData, pOriginal);
+        return nullptr;
+    }
+
+    void *memory = trackedAllocation(pUserData, size, alignment, allocationScope);
+    if (memory == nullptr) {
+        // Original allocation must be left untouched on failure.
+        return nullptr;
+    }
+    std::memcpy(memory, pOriginal, std::min(size, headerOf(pOriginal)->size));
+    trackedFree(pUserData, pOriginal);
+    return memory;
+}
+
+std::array<VkAllocationCallbacks, ALLOC_SCOPE_COUNT> makeCallbacks() {
+    std::array<VkAllocationCallbacks, ALLOC_SCOPE_COUNT> callbacks{};
+    for (size_t i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+        callbacks[i].pUserData = &g_scopeStats[i];
+        callbacks[i].pfnAllocation = trackedAllocation;
+        callbacks[i].pfnReallocation = trackedReallocation;
+        callbacks[i].pfnFree = trackedFree;
+        callbacks[i].pfnInternalAllocation = nullptr;
+        callbacks[i].pfnInternalFree = nullptr;
+    }
+    return callbacks;
+}
+
+}  // namespace
+
+const char *allocScopeName(AllocScope scope) {
+    switch (scope) {
+        case AllocScope::Device:
+            return "Device";
+        case AllocScope::Pipeline:
+            return "Pipeline";
+        case AllocScope::Descriptor:
+            return "Descriptor";
+        case AllocScope::Command:
+            return "Command";
+    }
+    return "Unknown";
+}
+
+const VkAllocationCallbacks *VeAllocTracker::callbacks(AllocScope scope) {
+    if (!enabled()) {
+        return nullptr;
+    }
+    static const std::array<VkAllocationCallbacks, ALLOC_SCOPE_COUNT> s_callbacks =
+        makeCallbacks();
+    return &s_callbacks[static_cast<size_t>(scope)];
+}
+
+const VeAllocTracker::ScopeStats &VeAllocTracker::scopeStats(AllocScope scope) {
+    return g_scopeStats[static_cast<size_t>(scope)];
+}
+
+void VeAllocTracker::recordHeapAllocation(size_t size) {
+    s_frameAllocations.fetch_add(1, std::memory_order_relaxed);
+    s_frameBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VeAllocTracker::beginFrame() {
+    s_frameAllocations.store(0, std::memory_order_relaxed);
+    s_frameBytes.store(0, std::memory_order_relaxed);
+}
+
+void VeAllocTracker::endFrame(uint64_t frame) {
+    s_lastFrame.frame = frame;
+    s_lastFrame.allocations = s_frameAllocations.load(std::memory_order_relaxed);
+    s_lastFrame.bytes = s_frameBytes.load(std::memory_order_relaxed);
+    s_frameCount++;
+
+    if (s_lastFrame.allocations > 0) {
+        s_flagged[s_flaggedCount % MAX_FLAGGED_FRAMES] = s_lastFrame;
+        s_flaggedCount++;
+    }
+}
+
+size_t VeAllocTracker::flaggedFrames(std::array<FrameReport, MAX_FLAGGED_FRAMES> &out) {
+    size_t count = std::min<uint64_t>(s_flaggedCount, MAX_FLAGGED_FRAMES);
+    uint64_t first = s_flaggedCount - count;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = s_flagged[(first + i) % MAX_FLAGGED_FRAMES];
+    }
+    return count;
+}
+
+void VeAllocTracker::printReport(std::ostream &out) {
+    if (!enabled()) {
+        return;
+    }
+
+    out << "Host allocation report\n";
+    for (size_t i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+        const auto &stats = g_scopeStats[i];
+        out << "\t" << allocScopeName(static_cast<AllocScope>(i))
+            << ": allocations=" << stats.allocations.load()
+            << " frees=" << stats.frees.load() << " live=" << stats.liveBytes.load()
+            << "B peak=" << stats.peakBytes.load() << "B\n";
+    }
+
+    out << "\tframes allocating on the heap: " << s_flaggedCount << " / " << s_frameCount << "\n";
+    std::array<FrameReport, MAX_FLAGGED_FRAMES> frames{};
+    size_t count = flaggedFrames(frames);
+    for (size_t i = 0; i < count; i++) {
+        out << "\t\tframe " << frames[i].frame << ": " << frames[i].allocations
+            << " allocations, " << frames[i].bytes << "B\n";
+    }
+}
+
+}  // namespace ve
+
+#ifdef VE_TRACK_ALLOCATIONS
+// Replacements for the global allocation functions. Every allocation is counted towards the
+// current frame. Aligned (std::align_val_t) overloads are left to the standard library.
+void *operator new(std::size_t size) {
+    ve::VeAllocTracker::recordHeapAllocation(size);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    ve::VeAllocTracker::recordHeapAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace ve {
+
+// Engine subsystem that a Vulkan host allocation is made on behalf of.
+enum class AllocScope { Device, Pipeline, Descriptor, Command };
+constexpr size_t ALLOC_SCOPE_COUNT = 4;
+
+const char *allocScopeName(AllocScope scope);
+
+// Host memory instrumentation.
+//
+// Build with -DVE_TRACK_ALLOCATIONS=ON to enable. Vulkan host allocations are then routed through
+// VkAllocationCallbacks tagged by scope, and the global operator new is hooked so we can count how
+// many heap allocations each frame makes. When disabled callbacks() returns nullptr and nothing is
+// hooked, so there is no overhead.
+class VeAllocTracker {
+   public:
+    struct ScopeStats {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> peakBytes{0};
+    };
+
+    // A frame which touched the heap.
+    struct FrameReport {
+        uint64_t frame{0};
+        uint64_t allocations{0};
+        uint64_t bytes{0};
+    };
+    static constexpr size_t MAX_FLAGGED_FRAMES = 64;
+
+    [[nodiscard]] static constexpr bool enabled() {
+#ifdef VE_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Allocation callbacks to pass to Vulkan create and destroy calls. The same scope must be used
+    // for both.
+    [[nodiscard]] static const VkAllocationCallbacks *callbacks(AllocScope scope);
+    [[nodiscard]] static const ScopeStats &scopeStats(AllocScope scope);
+
+    // Counts a heap allocation towards the current frame. Called by the operator new hook, but can
+    // also be used by libraries with their own allocator hooks (e.g. ImGui).
+    static void recordHeapAllocation(size_t size);
+
+    // Frame bracketing for the main loop. Frames which allocate are flagged in the report.
+    static void beginFrame();
+    static void endFrame(uint64_t frame);
+
+    [[nodiscard]] static FrameReport lastFrame() { return s_lastFrame; }
+    [[nodiscard]] static uint64_t flaggedFrameCount() { return s_flaggedCount; }
+    [[nodiscard]] static uint64_t trackedFrameCount() { return s_frameCount; }
+    // Most recent flagged frames, oldest first.
+    static size_t flaggedFrames(std::array<FrameReport, MAX_FLAGGED_FRAMES> &out);
+
+    static void printReport(std::ostream &out);
+
+   private:
+    static std::atomic<uint64_t> s_frameAllocations;
+    static std::atomic<uint64_t> s_frameBytes;
+
+    static FrameReport s_lastFrame;
+    static std::array<FrameReport, MAX_FLAGGED_FRAMES> s_flagged;
+    static uint64_t s_flaggedCount;
+    static uint64_t s_frameCount;
+};
+
+}  // namespace ve
@@ -25,6 +25,8 @@ void VeCamera::setOrthographicProjection(
     m_projectionMatrix[3][0] = -(right + left) / (right - left);
     m_projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
     m_projectionMatrix[3][2] = -near / (far - near);
+    m_near = near;
+    m_far = far;
 }
 
 void VeCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far) {
@@ -36,6 +38,8 @@ void VeCamera::setPerspectiveProjection(float fovy, float aspect, float near, fl
     m_projectionMatrix[2][2] = far / (far - near);
     m_projectionMatrix[2][3] = 1.f;
     m_projectionMatrix[3][2] = -(far * near) / (far - near);
+    m_near = near;
+    m_far = far;
 }
 
 void VeCamera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ve_culling.hpp"
 #include "ve_window.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -36,6 +37,12 @@ class VeCamera {
 
     [[nodiscard]] const glm::mat4 &getProjection() const { return m_projectionMatrix; }
     [[nodiscard]] const glm::mat4 &getView() const { return m_viewMatrix; }
+    // Distances to the clip planes of the last projection set.
+    [[nodiscard]] float getNear() const { return m_near; }
+    [[nodiscard]] float getFar() const { return m_far; }
+    [[nodiscard]] Frustum getFrustum() const {
+        return Frustum::fromMatrix(m_projectionMatrix * m_viewMatrix);
+    }
 
    private:
     glm::mat4 m_projectionMatrix{1.f};
@@ -43,6 +50,8 @@ class VeCamera {
 
     glm::vec3 m_up{};
     glm::vec3 m_position{};
+    float m_near{0.f};
+    float m_far{1.f};
 };
 
 }  // namespace ve
\ No newline at end of file
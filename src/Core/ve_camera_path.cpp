@@ -0,0 +1,98 @@
+#include "Core/ve_camera_path.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace ve {
+
+namespace {
+
+// Uniform Catmull-Rom segment from p1 to p2, t in [0, 1].
+glm::vec3 catmullRom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (2.f * p1 + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 +
+                   (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+}  // namespace
+
+VeCameraPath::VeCameraPath(std::vector<Key> keys, float duration)
+    : keys{std::move(keys)}, duration{duration} {
+    assert(this->keys.size() >= 2 && "Camera path needs at least two keys!");
+    assert(duration > 0.f && "Camera path needs a positive duration!");
+}
+
+VeCameraPath VeCameraPath::orbit(const AABB &bounds, float duration) {
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+    float radius = glm::length(glm::vec2{extent.x, extent.z}) * 1.2f + 2.f;
+
+    // Every other key higher up, y being down.
+    constexpr int KEYS = 8;
+    std::vector<Key> keys;
+    for (int i = 0; i < KEYS; i++) {
+        float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(KEYS);
+        float height = extent.y + radius * (i % 2 == 0 ? 0.25f : 0.5f);
+        keys.push_back({{center.x + radius * std::cos(angle),
+                         center.y - height,
+                         center.z + radius * std::sin(angle)},
+                        center});
+    }
+    return {std::move(keys), duration};
+}
+
+VeCameraPath VeCameraPath::flythrough(const AABB &bounds, float duration) {
+    glm::vec3 size = bounds.max - bounds.min;
+    int along = size.x >= size.z ? 0 : 2;
+    int across = 2 - along;
+    // A third of the way up from the floor, which is at max.y as y is down.
+    float height = bounds.max.y - size.y / 3.f;
+
+    // Down one side and back up the other.
+    const float stops[] = {0.15f, 0.5f, 0.85f};
+    std::vector<glm::vec3> positions;
+    for (float side : {0.35f, 0.65f}) {
+        for (int i = 0; i < 3; i++) {
+            float stop = side < 0.5f ? stops[i] : stops[2 - i];
+            glm::vec3 position{0.f, height, 0.f};
+            position[along] = bounds.min[along] + size[along] * stop;
+            position[across] = bounds.min[across] + size[across] * side;
+            positions.push_back(position);
+        }
+    }
+
+    std::vector<Key> keys;
+    for (size_t i = 0; i < positions.size(); i++) {
+        keys.push_back({positions[i], positions[(i + 1) % positions.size()]});
+    }
+    return {std::move(keys), duration};
+}
+
+VeCameraPath::Key VeCameraPath::sample(float time) const {
+    auto count = static_cast<int>(keys.size());
+    float loop = time / duration;
+    float u = (loop - std::floor(loop)) * static_cast<float>(count);
+    int segment = std::min(static_cast<int>(u), count - 1);
+    float t = u - static_cast<float>(segment);
+
+    const Key &k0 = keys[(segment + count - 1) % count];
+    const Key &k1 = keys[segment];
+    const Key &k2 = keys[(segment + 1) % count];
+    const Key &k3 = keys[(segment + 2) % count];
+    return {catmullRom(k0.position, k1.position, k2.position, k3.position, t),
+            catmullRom(k0.target, k1.target, k2.target, k3.target, t)};
+}
+
+void VeCameraPath::apply(VeCamera &camera, float time) const {
+    Key key = sample(time);
+    camera.setViewTarget(key.position, key.target);
+}
+
+}  // namespace ve
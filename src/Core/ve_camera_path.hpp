@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Core/ve_camera.hpp"
+#include "Core/ve_culling.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <vector>
+
+namespace ve {
+
+// Scripted camera moving along a closed Catmull-Rom spline, for benchmarks that have to render
+// the same views every run.
+//
+// The path is sampled by time rather than advanced by frame times, so where the camera is only
+// depends on how far into the path it is.
+class VeCameraPath {
+   public:
+    // A point the spline passes through and the point the camera looks at while it does.
+    struct Key {
+        glm::vec3 position{0.f};
+        glm::vec3 target{0.f};
+    };
+
+    // Loops through keys once every duration seconds. Needs at least two keys.
+    VeCameraPath(std::vector<Key> keys, float duration);
+
+    // Circles bounds from outside, rising and sinking, always looking at their center.
+    static VeCameraPath orbit(const AABB &bounds, float duration);
+    // Weaves back and forth along the longest horizontal axis inside bounds, looking ahead. For
+    // interiors, where an orbit would only see the outer walls.
+    static VeCameraPath flythrough(const AABB &bounds, float duration);
+
+    [[nodiscard]] Key sample(float time) const;
+    // Points camera along the path at time, keeping its projection.
+    void apply(VeCamera &camera, float time) const;
+
+    [[nodiscard]] float getDuration() const { return duration; }
+
+   private:
+    std::vector<Key> keys;
+    float duration;
+};
+
+}  // namespace ve
@@ -0,0 +1,168 @@
+#include "ve_cpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace ve {
+
+namespace {
+
+// An event that readers may copy while its thread overwrites it. Its fields are atomics so a
+// torn copy is a detectable race rather than undefined behavior, see collectBuffer().
+struct Slot {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int64_t> start{0};
+    std::atomic<int64_t> end{0};
+    std::atomic<uint32_t> depth{0};
+};
+
+struct ThreadBuffer {
+    std::array<Slot, VeCpuProfiler::CAPACITY> slots{};
+    // Zones recorded so far, event i lives at i % CAPACITY. Only the owning thread writes.
+    std::atomic<uint64_t> head{0};
+    uint32_t depth{0};
+    std::string name;
+};
+
+// Buffers outlive their threads, so zones of finished threads can still be exported.
+std::mutex g_registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_registry;
+
+int64_t g_frameStart = 0;
+int64_t g_previousFrameStart = 0;
+
+ThreadBuffer &threadBuffer() {
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock{g_registryMutex};
+        g_registry.push_back(std::make_unique<ThreadBuffer>());
+        buffer = g_registry.back().get();
+        buffer->name = "thread " + std::to_string(g_registry.size() - 1);
+    }
+    return *buffer;
+}
+
+// Copies the events of buffer that ended at or after since. The writer may lap us while we copy,
+// so events it could have overwritten in the meantime are dropped afterwards, like a seqlock.
+void collectBuffer(const ThreadBuffer &buffer,
+                   int64_t since,
+                   std::vector<VeCpuProfiler::Event> &out) {
+    out.clear();
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+    uint64_t first = head > VeCpuProfiler::CAPACITY ? head - VeCpuProfiler::CAPACITY : 0;
+    // Events are recorded as they end, so walking back from the newest stops at the first one
+    // that ended too early.
+    uint64_t begin = head;
+    while (begin > first &&
+           buffer.slots[(begin - 1) % VeCpuProfiler::CAPACITY].end.load(
+               std::memory_order_relaxed) >= since) {
+        begin--;
+    }
+    for (uint64_t i = begin; i < head; i++) {
+        const Slot &slot = buffer.slots[i % VeCpuProfiler::CAPACITY];
+        out.push_back({slot.name.load(std::memory_order_relaxed),
+                       slot.start.load(std::memory_order_relaxed),
+                       slot.end.load(std::memory_order_relaxed),
+                       slot.depth.load(std::memory_order_relaxed)});
+    }
+
+    // Pairs with the writer's release fence: if we copied anything of event i + CAPACITY, the
+    // reload sees the head that was published before it was written. Event i is overwritten by
+    // event i + CAPACITY, which may be being written right now.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = buffer.head.load(std::memory_order_relaxed);
+    if (after + 1 > VeCpuProfiler::CAPACITY + begin) {
+        uint64_t valid = std::min(after + 1 - VeCpuProfiler::CAPACITY, head);
+        out.erase(out.begin(), out.begin() + static_cast<ptrdiff_t>(valid - begin));
+    }
+}
+
+}  // namespace
+
+VeCpuProfiler::Zone::Zone(const char *name) : name{name}, start{now()} {
+    depth = threadBuffer().depth++;
+}
+
+VeCpuProfiler::Zone::~Zone() {
+    ThreadBuffer &buffer = threadBuffer();
+    buffer.depth--;
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    int64_t end = now();
+    // Orders the head published by the previous zone before the slot's new contents, for readers
+    // checking whether they were lapped. A compiler barrier only on x86.
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = buffer.slots[head % CAPACITY];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+int64_t VeCpuProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void VeCpuProfiler::setThreadName(const char *name) {
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock{g_registryMutex};
+    buffer.name = name;
+}
+
+void VeCpuProfiler::markFrame() {
+    g_previousFrameStart = g_frameStart;
+    g_frameStart = now();
+}
+
+bool VeCpuProfiler::lastFrame(int64_t &start, int64_t &end) {
+    if (g_previousFrameStart == 0) {
+        return false;
+    }
+    start = g_previousFrameStart;
+    end = g_frameStart;
+    return true;
+}
+
+void VeCpuProfiler::collect(int64_t since, std::vector<Thread> &threads) {
+    std::lock_guard<std::mutex> lock{g_registryMutex};
+    threads.resize(g_registry.size());
+    for (size_t i = 0; i < g_registry.size(); i++) {
+        threads[i].name = g_registry[i]->name;
+        collectBuffer(*g_registry[i], since, threads[i].events);
+    }
+}
+
+void VeCpuProfiler::writeTrace(std::ostream &out) {
+    out << "{\"traceEvents\": [\n";
+    writeTraceEvents(out);
+    out << "\n]}\n";
+}
+
+void VeCpuProfiler::writeTraceEvents(std::ostream &out) {
+    std::vector<Thread> threads;
+    collect(INT64_MIN, threads);
+
+    // Microseconds, like VeGpuProfiler's events.
+    out << std::fixed << std::setprecision(3);
+    out << R"({"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "CPU"}})";
+    for (size_t tid = 0; tid < threads.size(); tid++) {
+        out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << tid
+            << R"(, "args": {"name": ")" << threads[tid].name << "\"}}";
+        for (const Event &event : threads[tid].events) {
+            out << ",\n{\"name\": \"" << event.name
+                << R"(", "cat": "cpu", "ph": "X", "pid": 0, "tid": )" << tid
+                << ", \"ts\": " << static_cast<double>(event.start) / 1000.0
+                << ", \"dur\": " << static_cast<double>(event.end - event.start) / 1000.0 << "}";
+        }
+    }
+}
+
+}  // namespace ve
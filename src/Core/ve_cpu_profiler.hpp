@@ -0,0 +1,95 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// CPU zone markers. Build with -DVE_PROFILE_CPU=ON to enable, otherwise they expand to nothing.
+#ifdef VE_PROFILE_CPU
+#define VE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define VE_PROFILE_CONCAT(a, b) VE_PROFILE_CONCAT_IMPL(a, b)
+// Times the rest of the enclosing block. name must be a string literal.
+#define VE_PROFILE_SCOPE(name) \
+    ::ve::VeCpuProfiler::Zone VE_PROFILE_CONCAT(veProfileZone, __LINE__) { name }
+// Marks the start of a frame, for the timeline.
+#define VE_PROFILE_FRAME() ::ve::VeCpuProfiler::markFrame()
+// Names the calling thread in the timeline and traces.
+#define VE_PROFILE_THREAD(name) ::ve::VeCpuProfiler::setThreadName(name)
+#else
+#define VE_PROFILE_SCOPE(name) ((void)0)
+#define VE_PROFILE_FRAME() ((void)0)
+#define VE_PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace ve {
+
+// CPU instrumentation.
+//
+// Every thread records the zones it finishes into a ring buffer of its own, so recording takes no
+// locks and never allocates after the thread's first zone. The newest CAPACITY zones of each
+// thread are kept. Timestamps are steady_clock nanoseconds, the clock VeGpuProfiler places its
+// frames on, so both traces line up.
+class VeCpuProfiler {
+   public:
+    // Zones kept per thread.
+    static constexpr size_t CAPACITY = 16384;
+
+    struct Event {
+        const char *name;
+        int64_t start;  // Nanoseconds, see now().
+        int64_t end;
+        uint32_t depth;  // Zones open on the thread when this one began.
+    };
+
+    struct Thread {
+        std::string name;
+        std::vector<Event> events;  // Oldest first.
+    };
+
+    // Records a zone on the calling thread when destroyed. Use VE_PROFILE_SCOPE().
+    class Zone {
+       public:
+        explicit Zone(const char *name);
+        ~Zone();
+
+        // Remove copy constructors.
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+       private:
+        const char *name;
+        int64_t start;
+        uint32_t depth;
+    };
+
+    [[nodiscard]] static constexpr bool enabled() {
+#ifdef VE_PROFILE_CPU
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // steady_clock time in nanoseconds.
+    [[nodiscard]] static int64_t now();
+
+    static void setThreadName(const char *name);
+
+    // Frame bracketing for the main loop. Only called from one thread.
+    static void markFrame();
+    // Start and end of the last finished frame. False until two frames have been marked.
+    static bool lastFrame(int64_t &start, int64_t &end);
+
+    // Copies the zones of every thread that ended at or after since, reusing the storage of
+    // threads. Safe to call while other threads record.
+    static void collect(int64_t since, std::vector<Thread> &threads);
+
+    // Writes the zones kept as a Chrome trace_event document.
+    static void writeTrace(std::ostream &out);
+    // Writes them as comma separated trace events only, to merge with other traces.
+    static void writeTraceEvents(std::ostream &out);
+};
+
+}  // namespace ve
@@ -0,0 +1,308 @@
+#include "ve_culling.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VE_CULLING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC doesn't need per function target attributes to use AVX intrinsics.
+#define VE_TARGET_AVX2
+#else
+#define VE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace ve {
+
+AABB AABB::transformed(const glm::mat4 &matrix) const {
+    // Arvo's method: the new extent along each axis is the sum of the absolute contributions of
+    // the old extents.
+    glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center(), 1.f));
+    glm::vec3 oldExtent = extent();
+    glm::vec3 newExtent{0.f};
+    for (int column = 0; column < 3; column++) {
+        newExtent += glm::abs(glm::vec3(matrix[column])) * oldExtent[column];
+    }
+    return {newCenter - newExtent, newCenter + newExtent};
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4 &matrix) const {
+    float scale = std::max({glm::length(glm::vec3(matrix[0])),
+                            glm::length(glm::vec3(matrix[1])),
+                            glm::length(glm::vec3(matrix[2]))});
+    return {glm::vec3(matrix * glm::vec4(center, 1.f)), radius * scale};
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProjection) {
+    // Gribb-Hartmann plane extraction from the rows of the matrix.
+    glm::mat4 rows = glm::transpose(viewProjection);
+    Frustum frustum{};
+    frustum.planes[0] = rows[3] + rows[0];  // Left.
+    frustum.planes[1] = rows[3] - rows[0];  // Right.
+    frustum.planes[2] = rows[3] + rows[1];  // Bottom.
+    frustum.planes[3] = rows[3] - rows[1];  // Top.
+    frustum.planes[4] = rows[2];            // Near.
+    frustum.planes[5] = rows[3] - rows[2];  // Far.
+    for (auto &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool Frustum::intersects(const AABB &box) const {
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    for (const auto &plane : planes) {
+        // Same operation order as the batch kernels so results match exactly.
+        float distance = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+        float radius = extent.x * std::abs(plane.x) + extent.y * std::abs(plane.y) +
+                       extent.z * std::abs(plane.z);
+        if (distance + radius < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingSphere &sphere) const {
+    for (const auto &plane : planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CullBoxes::clear() {
+    count = 0;
+    for (auto *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        array->clear();
+    }
+}
+
+void CullBoxes::reserve(size_t capacity) {
+    size_t padded = (capacity + PADDING - 1) / PADDING * PADDING;
+    for (auto *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        array->reserve(padded);
+    }
+}
+
+void CullBoxes::add(const AABB &box) {
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+
+    // Start a new padded block when the current one is full. Padding boxes are empty and sit at
+    // the origin, their results are never written out.
+    if (count == centerX.size()) {
+        for (auto *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+            array->resize(array->size() + PADDING, 0.f);
+        }
+    }
+    centerX[count] = center.x;
+    centerY[count] = center.y;
+    centerZ[count] = center.z;
+    extentX[count] = extent.x;
+    extentY[count] = extent.y;
+    extentZ[count] = extent.z;
+    count++;
+}
+
+namespace {
+
+size_t cullScalar(const Frustum &frustum, const CullBoxes &boxes, uint8_t *visible) {
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        bool inside = true;
+        for (const auto &plane : frustum.planes) {
+            float distance = boxes.centerX[i] * plane.x + boxes.centerY[i] * plane.y +
+                             boxes.centerZ[i] * plane.z + plane.w;
+            float radius = boxes.extentX[i] * std::abs(plane.x) +
+                           boxes.extentY[i] * std::abs(plane.y) +
+                           boxes.extentZ[i] * std::abs(plane.z);
+            inside = inside && distance + radius >= 0.f;
+        }
+        visible[i] = inside ? 1 : 0;
+        visibleCount += inside ? 1 : 0;
+    }
+    return visibleCount;
+}
+
+#ifdef VE_CULLING_X86
+
+// Writes the lanes of a mask that hold real boxes and returns how many of them are set.
+size_t writeMask(int mask, size_t first, size_t lanes, size_t count, uint8_t *visible) {
+    size_t valid = std::min(lanes, count - first);
+    size_t visibleCount = 0;
+    for (size_t lane = 0; lane < valid; lane++) {
+        uint8_t bit = (mask >> lane) & 1;
+        visible[first + lane] = bit;
+        visibleCount += bit;
+    }
+    return visibleCount;
+}
+
+size_t cullSse(const Frustum &frustum, const CullBoxes &boxes, uint8_t *visible) {
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+        absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+        absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+    }
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < boxes.size(); i += 4) {
+        __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, planeX[p]), _mm_mul_ps(cy, planeY[p])),
+                           _mm_mul_ps(cz, planeZ[p])),
+                planeW[p]);
+            __m128 radius =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absX[p]), _mm_mul_ps(ey, absY[p])),
+                           _mm_mul_ps(ez, absZ[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+        visibleCount += writeMask(_mm_movemask_ps(inside), i, 4, boxes.size(), visible);
+    }
+    return visibleCount;
+}
+
+VE_TARGET_AVX2 size_t cullAvx2(const Frustum &frustum, const CullBoxes &boxes, uint8_t *visible) {
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m256 absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+        absX[p] = _mm256_andnot_ps(signMask, planeX[p]);
+        absY[p] = _mm256_andnot_ps(signMask, planeY[p]);
+        absZ[p] = _mm256_andnot_ps(signMask, planeZ[p]);
+    }
+
+    // No FMA on purpose: fused results would round differently from the scalar reference.
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < boxes.size(); i += 8) {
+        __m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&boxes.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&boxes.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&boxes.extentZ[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(cx, planeX[p]), _mm256_mul_ps(cy, planeY[p])),
+                    _mm256_mul_ps(cz, planeZ[p])),
+                planeW[p]);
+            __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(ex, absX[p]), _mm256_mul_ps(ey, absY[p])),
+                _mm256_mul_ps(ez, absZ[p]));
+            inside = _mm256_and_ps(
+                inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+        visibleCount += writeMask(_mm256_movemask_ps(inside), i, 8, boxes.size(), visible);
+    }
+    return visibleCount;
+}
+
+bool cpuHasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+}  // namespace
+
+const char *cullPathName(CullPath path) {
+    switch (path) {
+        case CullPath::Scalar:
+            return "scalar";
+        case CullPath::SSE:
+            return "SSE";
+        case CullPath::AVX2:
+            return "AVX2";
+    }
+    return "unknown";
+}
+
+bool isCullPathSupported(CullPath path) {
+    switch (path) {
+        case CullPath::Scalar:
+            return true;
+#ifdef VE_CULLING_X86
+        case CullPath::SSE:
+            return true;  // Part of the x86-64 baseline.
+        case CullPath::AVX2: {
+            static const bool hasAvx2 = cpuHasAvx2();
+            return hasAvx2;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+CullPath bestCullPath() {
+    if (isCullPathSupported(CullPath::AVX2)) {
+        return CullPath::AVX2;
+    }
+    if (isCullPathSupported(CullPath::SSE)) {
+        return CullPath::SSE;
+    }
+    return CullPath::Scalar;
+}
+
+size_t cullBoxes(const Frustum &frustum,
+                 const CullBoxes &boxes,
+                 uint8_t *visible,
+                 CullPath path) {
+    assert(isCullPathSupported(path) && "Culling path not supported on this CPU");
+    switch (path) {
+#ifdef VE_CULLING_X86
+        case CullPath::SSE:
+            return cullSse(frustum, boxes, visible);
+        case CullPath::AVX2:
+            return cullAvx2(frustum, boxes, visible);
+#endif
+        default:
+            return cullScalar(frustum, boxes, visible);
+    }
+}
+
+}  // namespace ve
@@ -0,0 +1,91 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+
+// Axis aligned bounding box.
+struct AABB {
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+
+    [[nodiscard]] glm::vec3 center() const { return (min + max) * 0.5f; }
+    [[nodiscard]] glm::vec3 extent() const { return (max - min) * 0.5f; }
+    // Smallest box containing this one after it has been transformed.
+    [[nodiscard]] AABB transformed(const glm::mat4 &matrix) const;
+};
+
+struct BoundingSphere {
+    glm::vec3 center{0.f};
+    float radius{0.f};
+
+    // Non-uniform scales are covered by scaling the radius by the largest axis.
+    [[nodiscard]] BoundingSphere transformed(const glm::mat4 &matrix) const;
+};
+
+// View frustum as six planes (normal in xyz, distance in w) pointing inwards.
+struct Frustum {
+    std::array<glm::vec4, 6> planes{};
+
+    // Planes are normalized so plane distances are in world units. Expects depth in [0, 1].
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+    [[nodiscard]] bool intersects(const AABB &box) const;
+    [[nodiscard]] bool intersects(const BoundingSphere &sphere) const;
+};
+
+// World space boxes in structure of arrays layout, so the culling kernels can test four or eight
+// boxes at once. Capacity is kept between frames, so refilling it doesn't allocate.
+class CullBoxes {
+   public:
+    // Boxes are padded to a multiple of this so the kernels never need a scalar tail loop.
+    static constexpr size_t PADDING = 8;
+
+    void clear();
+    void reserve(size_t count);
+    void add(const AABB &box);
+
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] size_t paddedSize() const { return centerX.size(); }
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+   private:
+    size_t count{0};
+};
+
+enum class CullPath { Scalar, SSE, AVX2 };
+
+const char *cullPathName(CullPath path);
+// Fastest path the CPU we are running on supports.
+CullPath bestCullPath();
+[[nodiscard]] bool isCullPathSupported(CullPath path);
+
+// Tests every box against the frustum and writes 1 into visible for boxes that intersect it and 0
+// for those that don't. visible must hold at least boxes.size() entries. Returns the number of
+// visible boxes. Every path does the same operations in the same order as the scalar reference,
+// so results match unless the compiler is allowed to fuse multiplies and adds.
+size_t cullBoxes(const Frustum &frustum,
+                 const CullBoxes &boxes,
+                 uint8_t *visible,
+                 CullPath path = bestCullPath());
+
+// Per frame culling counters.
+struct CullStats {
+    uint32_t tested{0};
+    uint32_t culled{0};     // Outside the frustum.
+    uint32_t occluders{0};  // Drawn into the occlusion buffer.
+    uint32_t occluded{0};   // Inside the frustum but hidden behind occluders.
+};
+
+}  // namespace ve
@@ -4,9 +4,42 @@
 
 #include "ve_camera.hpp"
 #include "ve_game_object.hpp"
+#include "ve_light_clusters.hpp"
+#include "ve_shadow_cascades.hpp"
 
 namespace ve {
 
+// Rendering options which can be toggled while running.
+struct RenderSettings {
+    // Lay down depth in a depth-only pass first, so the main pass shades each pixel only once.
+    bool depthPrepass{false};
+    // Replace shading with a constant additive color, so brightness shows overdraw.
+    bool showOverdraw{false};
+    // Cull objects hidden behind other objects, against the previous frame's depth with GPU
+    // driven rendering and against occluders rasterized on the CPU otherwise. Not a pipeline
+    // variant since it only changes culling.
+    bool occlusionCulling{true};
+
+    // Render systems create a pipeline for every combination of the settings above, so they can
+    // be toggled without waiting for pipeline compilation.
+    static constexpr uint32_t PIPELINE_VARIANTS = 4;
+    [[nodiscard]] uint32_t pipelineVariant() const {
+        return (depthPrepass ? 1u : 0u) | (showOverdraw ? 2u : 0u);
+    }
+    static RenderSettings fromPipelineVariant(uint32_t variant) {
+        return {(variant & 1u) != 0, (variant & 2u) != 0};
+    }
+};
+
+// Uniforms of the global descriptor set, matching GlobalUbo in the shaders.
+struct GlobalUbo {
+    glm::mat4 projection{1.f};
+    glm::mat4 view{1.f};
+    alignas(16) glm::vec3 viewPos;
+    alignas(16) ClusterUniforms clusters;
+    alignas(16) ShadowUniforms shadows;
+};
+
 struct FrameInfo {
     int frameIndex;
     float frameTime;
@@ -14,6 +47,7 @@ struct FrameInfo {
     VeCamera &camera;
     VkDescriptorSet globalDescriptorSet;
     VeGameObject::Map &gameObjects;
+    RenderSettings settings{};
 };
 
 }  // namespace ve
\ No newline at end of file
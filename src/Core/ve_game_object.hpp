@@ -19,6 +19,10 @@ struct TransformComponent {
 
     [[nodiscard]] glm::mat4 mat4() const;
     [[nodiscard]] glm::mat3 normalMatrix() const;
+    // World space box around model space bounds placed with this transform.
+    [[nodiscard]] AABB transformBounds(const AABB &localBounds) const {
+        return localBounds.transformed(mat4());
+    }
 };
 
 // TODO: Handle normal maps too.
@@ -51,6 +55,8 @@ class VeGameObject {
     glm::vec3 color{};
     TransformComponent transform{};
     std::shared_ptr<Material> material{};
+    // Static objects are not expected to move, which lets shadow maps cache them.
+    bool isStatic{false};
 
     // std::shared_ptr<VeTexture> albedoMap{};
     // std::shared_ptr<VeTexture> metallicMap{};
@@ -0,0 +1,27 @@
+#include "ve_light_clusters.hpp"
+
+// std
+#include <cmath>
+
+namespace ve {
+
+void LightClusterGrid::setFar(float far) {
+    // Slice 0 ends at SLICE_NEAR, the others split the rest of the depth range at equal ratios:
+    // slice = log(z) * scale + bias.
+    sliceScale = static_cast<float>(SLICES - 1) / std::log(far / SLICE_NEAR);
+    sliceBias = 1.f - std::log(SLICE_NEAR) * sliceScale;
+}
+
+ClusterUniforms LightClusterGrid::uniforms(uint32_t lightCount,
+                                           uint32_t width,
+                                           uint32_t height) const {
+    ClusterUniforms result{};
+    result.grid = {TILES_X, TILES_Y, SLICES, lightCount};
+    result.params = {sliceScale,
+                     sliceBias,
+                     static_cast<float>(TILES_X) / static_cast<float>(width),
+                     static_cast<float>(TILES_Y) / static_cast<float>(height)};
+    return result;
+}
+
+}  // namespace ve
@@ -0,0 +1,77 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+
+namespace ve {
+
+// Point light whose contribution fades to nothing at radius, so it only reaches the clusters its
+// sphere overlaps. Laid out to match std430 in pbr.frag, so lights are uploaded as they are.
+struct PointLight {
+    glm::vec3 position{0.f};
+    float radius{10.f};
+    glm::vec3 color{1.f};
+    float intensity{1.f};
+};
+
+// Per frame point light counters.
+struct PointLightStats {
+    uint32_t uploaded{0};  // Lights written to the frame's buffer because they changed.
+    uint32_t drawn{0};     // Billboards left after frustum culling.
+};
+
+// Cluster grid parameters the fragment shader needs to find its cluster. Laid out to match the
+// end of GlobalUbo in pbr.frag.
+struct ClusterUniforms {
+    glm::uvec4 grid{0};     // Tiles across, tiles down, depth slices, light count.
+    glm::vec4 params{0.f};  // Slice scale and bias, tiles per pixel across and down.
+};
+
+// Per frame clustering counters, written by the GPU.
+struct LightClusterStats {
+    uint32_t lights{0};
+    uint32_t maxPerCluster{0};
+    uint32_t indices{0};       // Light references summed over every cluster.
+    uint32_t fullClusters{0};  // Reached by more lights than they can list.
+};
+
+// Splits the view frustum into clusters, screen tiles times exponentially spaced depth slices,
+// so shading a fragment only loops over the lights reaching its own cluster.
+//
+// Lights are binned on the GPU, by light_clusters.comp. This holds the grid parameters it and
+// pbr.frag share, which only change with the camera's far plane.
+class LightClusterGrid {
+   public:
+    static constexpr uint32_t TILES_X = 16;
+    static constexpr uint32_t TILES_Y = 9;
+    static constexpr uint32_t SLICES = 24;
+    static constexpr uint32_t CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    // Depth the first slice ends at a fixed ratio after. Everything closer than this shares the
+    // first slice, rather than spending slices on the few units in front of the near plane.
+    static constexpr float SLICE_NEAR = 1.f;
+
+    // Laid out to match std430 in pbr.frag.
+    struct Cluster {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Spreads the slices over the depth range of a perspective camera with its far plane at far.
+    void setFar(float far);
+
+    // Shader parameters for lightCount lights and a framebuffer of the given size.
+    [[nodiscard]] ClusterUniforms uniforms(uint32_t lightCount,
+                                           uint32_t width,
+                                           uint32_t height) const;
+
+   private:
+    float sliceScale{0.f};
+    float sliceBias{0.f};
+};
+
+}  // namespace ve
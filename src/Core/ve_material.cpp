@@ -2,7 +2,26 @@
 
 namespace ve {
 
-Material::Material(std::shared_ptr<VeTexture> emptyTexture) {
+std::vector<uint32_t> MaterialFeatures::fragmentConstants(uint32_t features) {
+    std::vector<uint32_t> constants(COUNT);
+    for (uint32_t i = 0; i < COUNT; i++) {
+        constants[i] = (features >> i) & 1u;
+    }
+    return constants;
+}
+
+std::string MaterialFeatures::name(uint32_t features) {
+    static const char *names[COUNT] = {"albedo", "metallic", "roughness", "ao"};
+    std::string result;
+    for (uint32_t i = 0; i < COUNT; i++) {
+        if (features & (1u << i)) {
+            result += result.empty() ? names[i] : std::string("+") + names[i];
+        }
+    }
+    return result.empty() ? "no maps" : result;
+}
+
+Material::Material(std::shared_ptr<VeTexture> emptyTexture) : m_emptyTexture{emptyTexture} {
     // Set texture maps to empty texture so we use material params by default.
     m_albedoMap = emptyTexture;
     m_metallicMap = emptyTexture;
@@ -14,6 +33,15 @@ std::unique_ptr<Material> Material::createDefaultMaterial(VeDevice &device) {
     return std::make_unique<Material>(VeTexture::createEmptyTexture(device));
 }
 
+uint32_t Material::getFeatures() const {
+    uint32_t features = 0;
+    if (m_albedoMap != m_emptyTexture) features |= MaterialFeatures::ALBEDO_MAP;
+    if (m_metallicMap != m_emptyTexture) features |= MaterialFeatures::METALLIC_MAP;
+    if (m_roughnessMap != m_emptyTexture) features |= MaterialFeatures::ROUGHNESS_MAP;
+    if (m_aoMap != m_emptyTexture) features |= MaterialFeatures::AO_MAP;
+    return features;
+}
+
 // Material::Material(VeDevice& device, glm::vec3 albedo, float metallic, float roughness, float ao)
 //     : m_device{device}, m_albedo{albedo}, m_metallic{metallic}, m_roughness{roughness}, m_ao{ao} {
 //     m_emptyTexture = VeTexture::createEmptyTexture(m_device);
@@ -5,8 +5,30 @@
 
 #include <glm/glm.hpp>
 
+// std
+#include <string>
+#include <vector>
+
 namespace ve {
 
+// Texture maps a material samples. pbr.frag is specialized on them, each map being a boolean
+// specialization constant whose constant_id is the index of its bit, so maps left at the empty
+// texture aren't sampled at all.
+struct MaterialFeatures {
+    static constexpr uint32_t ALBEDO_MAP = 1u << 0;
+    static constexpr uint32_t METALLIC_MAP = 1u << 1;
+    static constexpr uint32_t ROUGHNESS_MAP = 1u << 2;
+    static constexpr uint32_t AO_MAP = 1u << 3;
+    static constexpr uint32_t COUNT = 4;
+    // Every combination of features, a shader permutation each.
+    static constexpr uint32_t PERMUTATIONS = 1u << COUNT;
+
+    // Specialization constants selecting the permutation, see PipelineConfigInfo.
+    static std::vector<uint32_t> fragmentConstants(uint32_t features);
+    // The maps in features, for logging.
+    static std::string name(uint32_t features);
+};
+
 // Struct definition for material parameters which we upload to the device.
 struct DeviceMaterial {
     glm::vec3 albedo{1.f, 1.f, 1.f};
@@ -22,6 +44,9 @@ class Material {
 
     static std::unique_ptr<Material> createDefaultMaterial(VeDevice &device);
 
+    // MaterialFeatures of the maps that were replaced with a texture of their own.
+    [[nodiscard]] uint32_t getFeatures() const;
+
     // Material parameters.
     glm::vec3 m_albedo{1.f, 1.f, 1.f};
     float m_metallic{0.5f};
@@ -33,6 +58,9 @@ class Material {
     std::shared_ptr<VeTexture> m_metallicMap;
     std::shared_ptr<VeTexture> m_roughnessMap;
     std::shared_ptr<VeTexture> m_aoMap;
+
+   private:
+    std::shared_ptr<VeTexture> m_emptyTexture;
 };
 
 };  // namespace ve
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 
 // Pathing is done from the build directory, so we define a macro to orient us automatically
@@ -37,6 +38,7 @@ namespace ve {
 VeModel::VeModel(VeDevice &veDevice, const VeModel::Builder &builder) : veDevice{veDevice} {
     createVertexBuffers(builder.vertices);
     createIndexBuffers(builder.indices);
+    computeBounds(builder.vertices);
 }
 
 VeModel::~VeModel() {}
@@ -46,29 +48,16 @@ void VeModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
     // Check that model contains at least one triangle.
     assert(vertexCount >= 3 && "Vertex count must be at least 3!");
 
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-    uint32_t vertexSize = sizeof(vertices[0]);
+    vertexBuffer = createDeviceLocalBuffer(
+        vertices.data(), sizeof(vertices[0]), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 
-    // Create the staging buffer.
-    VeBuffer stagingBuffer{
-        veDevice,
-        vertexSize,
-        vertexCount,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-    // Write vertex data to the staging buffer.
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void *)vertices.data());
-
-    // Create the vertex buffer.
-    vertexBuffer = std::make_unique<VeBuffer>(
-        veDevice,
-        vertexSize,
-        vertexCount,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    veDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto &vertex : vertices) {
+        positions.push_back(vertex.position);
+    }
+    positionBuffer = createDeviceLocalBuffer(
+        positions.data(), sizeof(positions[0]), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
 void VeModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
@@ -79,30 +68,70 @@ void VeModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
         return;
     }
 
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-    uint32_t indexSize = sizeof(indices[0]);
+    indexBuffer = createDeviceLocalBuffer(
+        indices.data(), sizeof(indices[0]), indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+void VeModel::computeBounds(const std::vector<Vertex> &vertices) {
+    // Sphere around the center of the bounding box. Not the tightest fit, but cheap and stable.
+    glm::vec3 min{vertices[0].position};
+    glm::vec3 max{vertices[0].position};
+    for (const auto &vertex : vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+
+    boundingBox = {min, max};
+    glm::vec3 center = boundingBox.center();
+    float radiusSquared = 0.f;
+    for (const auto &vertex : vertices) {
+        glm::vec3 offset = vertex.position - center;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+    }
+    boundingSphere = {center, glm::sqrt(radiusSquared)};
+}
+
+std::unique_ptr<VeBuffer> VeModel::createDeviceLocalBuffer(const void *data,
+                                                           uint32_t instanceSize,
+                                                           uint32_t instanceCount,
+                                                           VkBufferUsageFlags usage) {
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(instanceSize) * instanceCount;
+
+    // With resizable BAR (or unified memory) we can write straight into device local memory and
+    // skip both the staging buffer and the copy submission.
+    if (veDevice.supportsDirectWrite(veDevice.getBufferMemoryRequirements(bufferSize, usage))) {
+        auto buffer = std::make_unique<VeBuffer>(veDevice,
+                                                 instanceSize,
+                                                 instanceCount,
+                                                 usage,
+                                                 VeDevice::DIRECT_WRITE_MEMORY_PROPERTIES);
+        buffer->map();
+        buffer->writeToBuffer(const_cast<void *>(data));
+        buffer->unmap();
+        return buffer;
+    }
 
     // Create the staging buffer.
     VeBuffer stagingBuffer{
         veDevice,
-        indexSize,
-        indexCount,
+        instanceSize,
+        instanceCount,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
 
-    // Write vertex data to the staging buffer.
+    // Write data to the staging buffer.
     stagingBuffer.map();  // Unmapped when destructor is called.
-    stagingBuffer.writeToBuffer((void *)indices.data());
+    stagingBuffer.writeToBuffer(const_cast<void *>(data));
 
-    // Create the vertex buffer.
-    indexBuffer = std::make_unique<VeBuffer>(
-        veDevice,
-        indexSize,
-        indexCount,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // Create the device local buffer.
+    auto buffer = std::make_unique<VeBuffer>(veDevice,
+                                             instanceSize,
+                                             instanceCount,
+                                             usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    veDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+    veDevice.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), bufferSize);
+    return buffer;
 }
 
 std::unique_ptr<VeModel> VeModel::createModelFromFile(VeDevice &device,
@@ -115,11 +144,59 @@ std::unique_ptr<VeModel> VeModel::createModelFromFile(VeDevice &device,
     return std::make_unique<VeModel>(device, builder);
 }
 
-void VeModel::draw(VkCommandBuffer commandBuffer) {
+std::unique_ptr<VeModel> VeModel::createModelWithLods(VeDevice &device,
+                                                      const std::string &filepath,
+                                                      uint32_t lodCount) {
+    // LODs cluster vertices on grids this many cells across at most, each next grid half as fine.
+    constexpr uint32_t LOD_GRID_SIZE = 16;
+    // Grids that remove less than a quarter of the previous LOD's triangles are skipped.
+    constexpr size_t MIN_REDUCTION = 4;
+
+    Builder builder{};
+    builder.loadModel(filepath);
+    auto model = std::make_unique<VeModel>(device, builder);
+
+    std::vector<std::shared_ptr<VeModel>> lodModels;
+    size_t previousIndices = builder.indices.size();
+    for (uint32_t gridSize = LOD_GRID_SIZE; lodModels.size() < lodCount && gridSize > 1;
+         gridSize /= 2) {
+        Builder lodBuilder = builder.simplified(gridSize);
+        if (lodBuilder.indices.empty() ||
+            lodBuilder.indices.size() > previousIndices - previousIndices / MIN_REDUCTION) {
+            continue;
+        }
+        previousIndices = lodBuilder.indices.size();
+        lodModels.push_back(std::make_shared<VeModel>(device, lodBuilder));
+    }
+    std::cout << filepath << ": " << lodModels.size() << " LODs, " << builder.indices.size() / 3;
+    for (const auto &lodModel : lodModels) {
+        std::cout << " -> " << lodModel->getIndexCount() / 3;
+    }
+    std::cout << " triangles\n";
+    model->setLods(std::move(lodModels));
+    return model;
+}
+
+std::shared_ptr<const OccluderMesh> VeModel::createOccluderFromFile(const std::string &filepath) {
+    Builder builder{};
+    builder.loadModel(filepath);
+
+    auto mesh = std::make_shared<OccluderMesh>();
+    mesh->vertices.reserve(builder.vertices.size());
+    for (const auto &vertex : builder.vertices) {
+        mesh->vertices.push_back(vertex.position);
+    }
+    mesh->indices = std::move(builder.indices);
+    return mesh;
+}
+
+void VeModel::draw(VkCommandBuffer commandBuffer) { draw(commandBuffer, 1, 0); }
+
+void VeModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
     if (hasIndexBuffer) {
-        vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
     } else {
-        vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+        vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
     }
 }
 
@@ -133,6 +210,16 @@ void VeModel::bind(VkCommandBuffer commandBuffer) {
     }
 }
 
+void VeModel::bindPositions(VkCommandBuffer commandBuffer) {
+    VkBuffer buffers[] = {positionBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+    if (hasIndexBuffer) {
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+}
+
 std::vector<VkVertexInputBindingDescription> VeModel::Vertex::getBindingDescriptions() {
     std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
     bindingDescriptions[0].binding = 0;
@@ -151,6 +238,18 @@ std::vector<VkVertexInputAttributeDescription> VeModel::Vertex::getAttributeDesc
     return attributeDescriptions;
 }
 
+std::vector<VkVertexInputBindingDescription> VeModel::Vertex::getPositionBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(glm::vec3);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> VeModel::Vertex::getPositionAttributeDescriptions() {
+    return {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}};
+}
+
 void VeModel::Builder::loadModel(const std::string &filepath) {
     std::string enginePath = ENGINE_DIR + filepath;
     tinyobj::attrib_t attrib;
@@ -209,4 +308,60 @@ void VeModel::Builder::loadModel(const std::string &filepath) {
     std::cout << "Vertice count: " << vertices.size() << "\n";
 }
 
+VeModel::Builder VeModel::Builder::simplified(uint32_t gridSize) const {
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+    glm::vec3 extent = max - min;
+    float cellSize = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f)) /
+                     static_cast<float>(gridSize);
+
+    // Sum the vertices of each cell, then divide. Vertices that only differ in their UVs along a
+    // seam are merged too, which smears the texture but not enough to see at a distance.
+    Builder coarse{};
+    std::vector<uint32_t> clusterCounts;
+    std::vector<uint32_t> remap(vertices.size());
+    std::unordered_map<uint64_t, uint32_t> clusters;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::uvec3 cell{glm::min((vertices[i].position - min) / cellSize,
+                                 glm::vec3(static_cast<float>(gridSize - 1)))};
+        uint64_t key = (uint64_t{cell.x} << 42) | (uint64_t{cell.y} << 21) | cell.z;
+        auto [it, inserted] =
+            clusters.try_emplace(key, static_cast<uint32_t>(coarse.vertices.size()));
+        if (inserted) {
+            coarse.vertices.push_back({});
+            clusterCounts.push_back(0);
+        }
+        Vertex &sum = coarse.vertices[it->second];
+        sum.position += vertices[i].position;
+        sum.color += vertices[i].color;
+        sum.normal += vertices[i].normal;
+        sum.uv += vertices[i].uv;
+        clusterCounts[it->second]++;
+        remap[i] = it->second;
+    }
+    for (size_t i = 0; i < coarse.vertices.size(); i++) {
+        Vertex &vertex = coarse.vertices[i];
+        float count = static_cast<float>(clusterCounts[i]);
+        vertex.position /= count;
+        vertex.color /= count;
+        vertex.uv /= count;
+        float length = glm::length(vertex.normal);
+        vertex.normal = length > 0.f ? vertex.normal / length : glm::vec3{0.f, -1.f, 0.f};
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i + 1]];
+        uint32_t c = remap[indices[i + 2]];
+        if (a != b && b != c && a != c) {
+            coarse.indices.insert(coarse.indices.end(), {a, b, c});
+        }
+    }
+    return coarse;
+}
+
 }  // namespace ve
\ No newline at end of file
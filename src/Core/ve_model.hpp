@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Core/ve_culling.hpp"
+#include "Core/ve_occlusion.hpp"
 #include "Renderer/ve_buffer.hpp"
 #include "Renderer/ve_device.hpp"
 
@@ -24,6 +26,9 @@ class VeModel {
 
         static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
         static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        // Descriptions of the position-only stream bound by bindPositions().
+        static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
 
         // Overload the equality operator.
         bool operator==(const Vertex &other) const {
@@ -37,6 +42,10 @@ class VeModel {
         std::vector<uint32_t> indices{};
 
         void loadModel(const std::string &filepath);
+        // A coarser copy made by vertex clustering. Vertices in the same cell of a grid with
+        // gridSize cells along the longest side of the bounds are merged into their average, and
+        // triangles that collapse are dropped.
+        [[nodiscard]] Builder simplified(uint32_t gridSize) const;
     };
 
     VeModel(VeDevice &veDevice, const VeModel::Builder &buider);
@@ -48,9 +57,37 @@ class VeModel {
 
     static std::unique_ptr<VeModel> createModelFromFile(VeDevice &device,
                                                         const std::string &filepath);
+    // Also generates up to lodCount lower detail versions of the model, see setLods(). Fewer are
+    // made if the model runs out of triangles to remove.
+    static std::unique_ptr<VeModel> createModelWithLods(VeDevice &device,
+                                                        const std::string &filepath,
+                                                        uint32_t lodCount);
+    // Loads a low-poly stand-in for a model to set with setOccluder(). Only positions are kept.
+    static std::shared_ptr<const OccluderMesh> createOccluderFromFile(const std::string &filepath);
 
     void bind(VkCommandBuffer commandBuffer);
+    // Binds the tightly packed vertex positions instead of the full vertices, for depth-only
+    // passes which would otherwise fetch 44 bytes per vertex to use 12 of them.
+    void bindPositions(VkCommandBuffer commandBuffer);
     void draw(VkCommandBuffer commandBuffer);
+    // Draws instanceCount copies, with gl_InstanceIndex starting at firstInstance.
+    void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance);
+
+    [[nodiscard]] bool hasIndices() const { return hasIndexBuffer; }
+    [[nodiscard]] uint32_t getIndexCount() const { return indexCount; }
+    // Model space bounds, computed once when the model is loaded.
+    [[nodiscard]] const AABB &getBoundingBox() const { return boundingBox; }
+    [[nodiscard]] const BoundingSphere &getBoundingSphere() const { return boundingSphere; }
+
+    // Lower detail versions of this model, from most to least detailed. The GPU driven renderer
+    // switches to them as the model gets further away.
+    void setLods(std::vector<std::shared_ptr<VeModel>> lodModels) { lods = std::move(lodModels); }
+    [[nodiscard]] const std::vector<std::shared_ptr<VeModel>> &getLods() const { return lods; }
+
+    // Triangles drawn into the CPU occlusion buffer in place of this model. Models without one
+    // can be hidden but never hide anything.
+    void setOccluder(std::shared_ptr<const OccluderMesh> mesh) { occluder = std::move(mesh); }
+    [[nodiscard]] const OccluderMesh *getOccluder() const { return occluder.get(); }
 
     // TODO: This should not be public, just a temp fix.
     VeDevice &veDevice;
@@ -58,14 +95,26 @@ class VeModel {
    private:
     void createVertexBuffers(const std::vector<Vertex> &vertices);
     void createIndexBuffers(const std::vector<uint32_t> &indices);
+    void computeBounds(const std::vector<Vertex> &vertices);
+    // Uploads data to a device local buffer, directly when possible and through staging otherwise.
+    std::unique_ptr<VeBuffer> createDeviceLocalBuffer(const void *data,
+                                                      uint32_t instanceSize,
+                                                      uint32_t instanceCount,
+                                                      VkBufferUsageFlags usage);
 
 
     std::unique_ptr<VeBuffer> vertexBuffer;
+    std::unique_ptr<VeBuffer> positionBuffer;
     uint32_t vertexCount;
 
     bool hasIndexBuffer{false};
     std::unique_ptr<VeBuffer> indexBuffer;
     uint32_t indexCount;
+
+    AABB boundingBox{};
+    BoundingSphere boundingSphere{};
+    std::vector<std::shared_ptr<VeModel>> lods;
+    std::shared_ptr<const OccluderMesh> occluder;
 };
 
 }  // namespace ve
\ No newline at end of file
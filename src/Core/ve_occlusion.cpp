@@ -0,0 +1,475 @@
+#include "ve_occlusion.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VE_OCCLUSION_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+// MSVC doesn't need per function target attributes to use AVX intrinsics.
+#define VE_TARGET_AVX2
+#else
+#define VE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace ve {
+
+namespace {
+
+constexpr uint32_t TILE_PIXELS = OcclusionBuffer::TILE_WIDTH * OcclusionBuffer::TILE_HEIGHT;
+// Triangles are clipped to this many times the screen size around its center, which keeps screen
+// coordinates small enough for the edge functions to stay precise.
+constexpr float GUARD_BAND = 4.f;
+
+// Edge functions and depth plane of a triangle, each as a * x + b * y + c in pixels. Pixels are
+// inside when all three edge functions are non-negative at their center.
+struct TriangleSetup {
+    std::array<float, 3> edgeA;
+    std::array<float, 3> edgeB;
+    std::array<float, 3> edgeC;
+    float depthA;
+    float depthB;
+    float depthC;
+};
+
+// Every path does the same operations in the same order as the scalar reference, so the buffers
+// they produce are identical. Each returns whether any depth got nearer.
+bool drawTileScalar(float *tile, float x0, float y0, const TriangleSetup &t) {
+    bool changed = false;
+    for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+        float py = y0 + (static_cast<float>(row) + 0.5f);
+        for (uint32_t column = 0; column < OcclusionBuffer::TILE_WIDTH; column++) {
+            float px = x0 + (static_cast<float>(column) + 0.5f);
+            bool inside = true;
+            for (int e = 0; e < 3; e++) {
+                inside = inside && t.edgeA[e] * px + t.edgeB[e] * py + t.edgeC[e] >= 0.f;
+            }
+            float z = t.depthA * px + t.depthB * py + t.depthC;
+            float &pixel = tile[row * OcclusionBuffer::TILE_WIDTH + column];
+            if (inside && z < pixel) {
+                pixel = z;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Bits of the columns first to last of a tile row.
+uint32_t columnMask(int first, int last) {
+    return ((1u << (last + 1)) - 1) & ~((1u << first) - 1);
+}
+
+bool isRowVisibleScalar(const float *row, float boxDepth, uint32_t mask) {
+    for (uint32_t column = 0; column < OcclusionBuffer::TILE_WIDTH; column++) {
+        if (((mask >> column) & 1) != 0 && row[column] >= boxDepth) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef VE_OCCLUSION_X86
+
+bool drawTileSse(float *tile, float x0, float y0, const TriangleSetup &t) {
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 a[3], b[3], c[3];
+    for (int e = 0; e < 3; e++) {
+        a[e] = _mm_set1_ps(t.edgeA[e]);
+        b[e] = _mm_set1_ps(t.edgeB[e]);
+        c[e] = _mm_set1_ps(t.edgeC[e]);
+    }
+    const __m128 depthA = _mm_set1_ps(t.depthA);
+    const __m128 depthB = _mm_set1_ps(t.depthB);
+    const __m128 depthC = _mm_set1_ps(t.depthC);
+    const __m128 zero = _mm_setzero_ps();
+
+    int changed = 0;
+    for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+        __m128 py = _mm_set1_ps(y0 + (static_cast<float>(row) + 0.5f));
+        for (uint32_t half = 0; half < 2; half++) {
+            __m128 px = _mm_add_ps(_mm_set1_ps(x0 + static_cast<float>(half * 4)), offsets);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int e = 0; e < 3; e++) {
+                __m128 edge =
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[e], px), _mm_mul_ps(b[e], py)), c[e]);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+            }
+            __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, px), _mm_mul_ps(depthB, py)),
+                                  depthC);
+
+            // SSE2 has no blend, select with masks instead.
+            float *pixels = tile + row * OcclusionBuffer::TILE_WIDTH + half * 4;
+            __m128 old = _mm_loadu_ps(pixels);
+            __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+            _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(nearer, z), _mm_andnot_ps(nearer, old)));
+            changed |= _mm_movemask_ps(nearer);
+        }
+    }
+    return changed != 0;
+}
+
+bool isRowVisibleSse(const float *row, float boxDepth, uint32_t mask) {
+    __m128 depth = _mm_set1_ps(boxDepth);
+    int low = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row), depth));
+    int high = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + 4), depth));
+    return ((static_cast<uint32_t>(low | high << 4)) & mask) != 0;
+}
+
+VE_TARGET_AVX2 bool drawTileAvx2(float *tile, float x0, float y0, const TriangleSetup &t) {
+    const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    __m256 a[3], b[3], c[3];
+    for (int e = 0; e < 3; e++) {
+        a[e] = _mm256_set1_ps(t.edgeA[e]);
+        b[e] = _mm256_set1_ps(t.edgeB[e]);
+        c[e] = _mm256_set1_ps(t.edgeC[e]);
+    }
+    const __m256 depthA = _mm256_set1_ps(t.depthA);
+    const __m256 depthB = _mm256_set1_ps(t.depthB);
+    const __m256 depthC = _mm256_set1_ps(t.depthC);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 px = _mm256_add_ps(_mm256_set1_ps(x0), offsets);
+
+    // No FMA on purpose: fused results would round differently from the scalar reference.
+    int changed = 0;
+    for (uint32_t row = 0; row < OcclusionBuffer::TILE_HEIGHT; row++) {
+        __m256 py = _mm256_set1_ps(y0 + (static_cast<float>(row) + 0.5f));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int e = 0; e < 3; e++) {
+            __m256 edge = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(a[e], px), _mm256_mul_ps(b[e], py)), c[e]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge, zero, _CMP_GE_OQ));
+        }
+        __m256 z = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(depthA, px), _mm256_mul_ps(depthB, py)), depthC);
+
+        float *pixels = tile + row * OcclusionBuffer::TILE_WIDTH;
+        __m256 old = _mm256_loadu_ps(pixels);
+        __m256 nearer = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+        _mm256_storeu_ps(pixels, _mm256_blendv_ps(old, z, nearer));
+        changed |= _mm256_movemask_ps(nearer);
+    }
+    return changed != 0;
+}
+
+VE_TARGET_AVX2 bool isRowVisibleAvx2(const float *row, float boxDepth, uint32_t mask) {
+    __m256 visible = _mm256_cmp_ps(_mm256_loadu_ps(row), _mm256_set1_ps(boxDepth), _CMP_GE_OQ);
+    return (static_cast<uint32_t>(_mm256_movemask_ps(visible)) & mask) != 0;
+}
+
+#endif
+
+bool drawTile(float *tile, float x0, float y0, const TriangleSetup &t, CullPath path) {
+    switch (path) {
+#ifdef VE_OCCLUSION_X86
+        case CullPath::SSE:
+            return drawTileSse(tile, x0, y0, t);
+        case CullPath::AVX2:
+            return drawTileAvx2(tile, x0, y0, t);
+#endif
+        default:
+            return drawTileScalar(tile, x0, y0, t);
+    }
+}
+
+bool isRowVisible(const float *row, float boxDepth, uint32_t mask, CullPath path) {
+    switch (path) {
+#ifdef VE_OCCLUSION_X86
+        case CullPath::SSE:
+            return isRowVisibleSse(row, boxDepth, mask);
+        case CullPath::AVX2:
+            return isRowVisibleAvx2(row, boxDepth, mask);
+#endif
+        default:
+            return isRowVisibleScalar(row, boxDepth, mask);
+    }
+}
+
+}  // namespace
+
+OccluderMesh OccluderMesh::fromBox(const AABB &box, float scale) {
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent() * scale;
+
+    OccluderMesh mesh{};
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        mesh.vertices.push_back(center + glm::vec3{(corner & 1) ? extent.x : -extent.x,
+                                                   (corner & 2) ? extent.y : -extent.y,
+                                                   (corner & 4) ? extent.z : -extent.z});
+    }
+    // Two triangles per face. Both faces of every triangle are drawn, so winding doesn't matter.
+    constexpr uint32_t faces[6][4] = {
+        {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+    for (const auto &face : faces) {
+        mesh.indices.insert(mesh.indices.end(),
+                            {face[0], face[1], face[2], face[0], face[2], face[3]});
+    }
+    return mesh;
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+    : width{(width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH},
+      height{(height + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT},
+      tilesX{(width + TILE_WIDTH - 1) / TILE_WIDTH},
+      tilesY{(height + TILE_HEIGHT - 1) / TILE_HEIGHT} {
+    assert(width > 0 && height > 0 && "Occlusion buffer can't be empty");
+    depth.resize(static_cast<size_t>(tilesX) * tilesY * TILE_PIXELS, 1.f);
+    tileMaxDepth.resize(static_cast<size_t>(tilesX) * tilesY, 1.f);
+}
+
+void OcclusionBuffer::clear(const glm::mat4 &matrix) {
+    viewProjection = matrix;
+    std::fill(depth.begin(), depth.end(), 1.f);
+    std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.f);
+}
+
+void OcclusionBuffer::renderOccluder(const OccluderMesh &mesh,
+                                     const glm::mat4 &modelMatrix,
+                                     CullPath path) {
+    assert(isCullPathSupported(path) && "Culling path not supported on this CPU");
+    glm::mat4 matrix = viewProjection * modelMatrix;
+    clipVertices.clear();
+    for (const auto &vertex : mesh.vertices) {
+        clipVertices.push_back(matrix * glm::vec4(vertex, 1.f));
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        drawTriangle(clipVertices[mesh.indices[i]],
+                     clipVertices[mesh.indices[i + 1]],
+                     clipVertices[mesh.indices[i + 2]],
+                     path);
+    }
+}
+
+void OcclusionBuffer::drawTriangle(const glm::vec4 &a,
+                                   const glm::vec4 &b,
+                                   const glm::vec4 &c,
+                                   CullPath path) {
+    // Planes as dot(plane, vertex) >= 0: near, then the guard band left, right, top and bottom.
+    // Beyond the far plane depth ends up above 1 and never passes the depth test.
+    static const std::array<glm::vec4, 5> planes{glm::vec4{0.f, 0.f, 1.f, 0.f},
+                                                 glm::vec4{1.f, 0.f, 0.f, GUARD_BAND},
+                                                 glm::vec4{-1.f, 0.f, 0.f, GUARD_BAND},
+                                                 glm::vec4{0.f, 1.f, 0.f, GUARD_BAND},
+                                                 glm::vec4{0.f, -1.f, 0.f, GUARD_BAND}};
+
+    // Triangles entirely outside the screen on one side are dropped right away.
+    auto outside = [](const glm::vec4 &v) {
+        return (v.x < -v.w ? 1 : 0) | (v.x > v.w ? 2 : 0) | (v.y < -v.w ? 4 : 0) |
+               (v.y > v.w ? 8 : 0) | (v.z < 0.f ? 16 : 0);
+    };
+    if ((outside(a) & outside(b) & outside(c)) != 0) {
+        return;
+    }
+
+    // Sutherland-Hodgman, each plane adds at most one vertex.
+    std::array<glm::vec4, 3 + planes.size()> polygon{a, b, c};
+    std::array<glm::vec4, 3 + planes.size()> clipped{};
+    size_t count = 3;
+    for (const auto &plane : planes) {
+        size_t clippedCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            const glm::vec4 &from = polygon[i];
+            const glm::vec4 &to = polygon[(i + 1) % count];
+            float fromDistance = glm::dot(plane, from);
+            float toDistance = glm::dot(plane, to);
+            if (fromDistance >= 0.f) {
+                clipped[clippedCount++] = from;
+            }
+            if ((fromDistance >= 0.f) != (toDistance >= 0.f)) {
+                float t = fromDistance / (fromDistance - toDistance);
+                clipped[clippedCount++] = from + (to - from) * t;
+            }
+        }
+        polygon = clipped;
+        count = clippedCount;
+        if (count < 3) {
+            return;
+        }
+    }
+
+    // Screen space, with depth divided by w so it is linear across the screen.
+    std::array<glm::vec3, 3 + planes.size()> screen{};
+    for (size_t i = 0; i < count; i++) {
+        float invW = 1.f / polygon[i].w;
+        screen[i] = {(polygon[i].x * invW * 0.5f + 0.5f) * static_cast<float>(width),
+                     (polygon[i].y * invW * 0.5f + 0.5f) * static_cast<float>(height),
+                     polygon[i].z * invW};
+    }
+    for (size_t i = 1; i + 1 < count; i++) {
+        rasterize(screen[0], screen[i], screen[i + 1], path);
+    }
+}
+
+void OcclusionBuffer::rasterize(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, CullPath path) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area < 0.f) {
+        // Back facing, draw it as if it were front facing.
+        std::swap(v1, v2);
+        area = -area;
+    }
+    if (area < 1e-6f) {
+        return;
+    }
+
+    float minX = std::min({v0.x, v1.x, v2.x});
+    float maxX = std::max({v0.x, v1.x, v2.x});
+    float minY = std::min({v0.y, v1.y, v2.y});
+    float maxY = std::max({v0.y, v1.y, v2.y});
+    if (maxX < 0.f || maxY < 0.f || minX >= static_cast<float>(width) ||
+        minY >= static_cast<float>(height)) {
+        return;
+    }
+
+    TriangleSetup setup{};
+    std::array<glm::vec3, 3> vertices{v0, v1, v2};
+    for (int e = 0; e < 3; e++) {
+        const glm::vec3 &from = vertices[e];
+        const glm::vec3 &to = vertices[(e + 1) % 3];
+        setup.edgeA[e] = from.y - to.y;
+        setup.edgeB[e] = to.x - from.x;
+        setup.edgeC[e] = from.x * to.y - from.y * to.x;
+    }
+    float depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    setup.depthA = depthX;
+    setup.depthB = depthY;
+    setup.depthC = v0.z - depthX * v0.x - depthY * v0.y;
+    float minDepth = std::min({v0.z, v1.z, v2.z});
+
+    auto firstTileX = static_cast<uint32_t>(std::max(minX, 0.f)) / TILE_WIDTH;
+    auto lastTileX =
+        static_cast<uint32_t>(std::min(maxX, static_cast<float>(width - 1))) / TILE_WIDTH;
+    auto firstTileY = static_cast<uint32_t>(std::max(minY, 0.f)) / TILE_HEIGHT;
+    auto lastTileY =
+        static_cast<uint32_t>(std::min(maxY, static_cast<float>(height - 1))) / TILE_HEIGHT;
+
+    for (uint32_t tileY = firstTileY; tileY <= lastTileY; tileY++) {
+        for (uint32_t tileX = firstTileX; tileX <= lastTileX; tileX++) {
+            size_t tileIndex = static_cast<size_t>(tileY) * tilesX + tileX;
+            // Everything in the tile is already nearer than the triangle.
+            if (minDepth >= tileMaxDepth[tileIndex]) {
+                continue;
+            }
+
+            // Edge functions are linear, so if all four corner pixels are outside one edge the
+            // whole tile is.
+            auto x0 = static_cast<float>(tileX * TILE_WIDTH);
+            auto y0 = static_cast<float>(tileY * TILE_HEIGHT);
+            float x1 = x0 + (static_cast<float>(TILE_WIDTH) - 0.5f);
+            float y1 = y0 + (static_cast<float>(TILE_HEIGHT) - 0.5f);
+            bool rejected = false;
+            for (int e = 0; e < 3 && !rejected; e++) {
+                float left = setup.edgeA[e] * (x0 + 0.5f);
+                float right = setup.edgeA[e] * x1;
+                float top = setup.edgeB[e] * (y0 + 0.5f);
+                float bottom = setup.edgeB[e] * y1;
+                rejected = std::max(left, right) + std::max(top, bottom) + setup.edgeC[e] < 0.f;
+            }
+            if (rejected) {
+                continue;
+            }
+
+            float *tile = &depth[tileIndex * TILE_PIXELS];
+            if (drawTile(tile, x0, y0, setup, path)) {
+                tileMaxDepth[tileIndex] = *std::max_element(tile, tile + TILE_PIXELS);
+            }
+        }
+    }
+}
+
+size_t OcclusionBuffer::testBoxes(const CullBoxes &boxes,
+                                  uint8_t *visible,
+                                  size_t begin,
+                                  size_t end,
+                                  CullPath path) const {
+    assert(isCullPathSupported(path) && "Culling path not supported on this CPU");
+    assert(end <= boxes.size() && "Box range out of bounds");
+    size_t hidden = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (visible[i] && !isBoxVisible(boxes, i, path)) {
+            visible[i] = 0;
+            hidden++;
+        }
+    }
+    return hidden;
+}
+
+bool OcclusionBuffer::isBoxVisible(const CullBoxes &boxes, size_t index, CullPath path) const {
+    glm::vec3 center{boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]};
+    glm::vec3 extent{boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]};
+
+    // Screen space bounds of the corners. Depth only grows with distance, so the nearest corner
+    // is the nearest point of the box.
+    float minX = static_cast<float>(width);
+    float maxX = 0.f;
+    float minY = static_cast<float>(height);
+    float maxY = 0.f;
+    float boxDepth = 1.f;
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec3 position = center + glm::vec3{(corner & 1) ? extent.x : -extent.x,
+                                                (corner & 2) ? extent.y : -extent.y,
+                                                (corner & 4) ? extent.z : -extent.z};
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.f);
+        if (clip.z < 0.f) {
+            return true;
+        }
+        float invW = 1.f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * static_cast<float>(width);
+        float y = (clip.y * invW * 0.5f + 0.5f) * static_cast<float>(height);
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        boxDepth = std::min(boxDepth, clip.z * invW);
+    }
+
+    // Every pixel the bounds touch, not just the ones whose center they cover.
+    int firstX = std::max(static_cast<int>(std::floor(minX)), 0);
+    int lastX = std::min(static_cast<int>(std::ceil(maxX)) - 1, static_cast<int>(width) - 1);
+    int firstY = std::max(static_cast<int>(std::floor(minY)), 0);
+    int lastY = std::min(static_cast<int>(std::ceil(maxY)) - 1, static_cast<int>(height) - 1);
+    if (firstX > lastX || firstY > lastY) {
+        // Off screen, which is for frustum culling to decide.
+        return true;
+    }
+
+    for (int tileY = firstY / static_cast<int>(TILE_HEIGHT);
+         tileY <= lastY / static_cast<int>(TILE_HEIGHT);
+         tileY++) {
+        int y0 = tileY * static_cast<int>(TILE_HEIGHT);
+        int firstRow = std::max(firstY - y0, 0);
+        int lastRow = std::min(lastY - y0, static_cast<int>(TILE_HEIGHT) - 1);
+        for (int tileX = firstX / static_cast<int>(TILE_WIDTH);
+             tileX <= lastX / static_cast<int>(TILE_WIDTH);
+             tileX++) {
+            size_t tileIndex = static_cast<size_t>(tileY) * tilesX + tileX;
+            // Every pixel of the tile is nearer than the box.
+            if (boxDepth > tileMaxDepth[tileIndex]) {
+                continue;
+            }
+            int x0 = tileX * static_cast<int>(TILE_WIDTH);
+            uint32_t mask = columnMask(std::max(firstX - x0, 0),
+                                       std::min(lastX - x0, static_cast<int>(TILE_WIDTH) - 1));
+            const float *tile = &depth[tileIndex * TILE_PIXELS];
+            for (int row = firstRow; row <= lastRow; row++) {
+                if (isRowVisible(tile + row * TILE_WIDTH, boxDepth, mask, path)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+float OcclusionBuffer::depthAt(uint32_t x, uint32_t y) const {
+    assert(x < width && y < height && "Pixel out of bounds");
+    size_t tileIndex = static_cast<size_t>(y / TILE_HEIGHT) * tilesX + x / TILE_WIDTH;
+    return depth[tileIndex * TILE_PIXELS + (y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH];
+}
+
+}  // namespace ve
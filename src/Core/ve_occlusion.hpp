@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Core/ve_culling.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+
+// Triangles an object is drawn with into the occlusion buffer, in model space. They have to stay
+// inside the object they stand in for, or objects seen past its edges would be culled.
+struct OccluderMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    // Box around the center of box, with its extent multiplied by scale. Box shaped models can use
+    // their bounds as they are, rounder ones need a smaller box that fits inside them.
+    static OccluderMesh fromBox(const AABB &box, float scale = 1.f);
+
+    [[nodiscard]] size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Low resolution depth buffer rasterized on the CPU, to cull objects hidden behind large occluders
+// before anything is submitted.
+//
+// Depth follows the renderer, 0 at the near plane and 1 at the far plane. Every pixel keeps the
+// nearest occluder depth, and a box is hidden when its nearest point is behind that depth across
+// every pixel it touches. Pixels are stored in tiles of 8x4, so a tile row fills an AVX2 register,
+// and every tile remembers its farthest depth so triangles and boxes behind all of it skip it.
+class OcclusionBuffer {
+   public:
+    static constexpr uint32_t TILE_WIDTH = 8;
+    static constexpr uint32_t TILE_HEIGHT = 4;
+
+    // The size is rounded up to whole tiles.
+    OcclusionBuffer(uint32_t width, uint32_t height);
+
+    [[nodiscard]] uint32_t getWidth() const { return width; }
+    [[nodiscard]] uint32_t getHeight() const { return height; }
+
+    // Starts a frame seen through viewProjection, with every pixel at the far plane.
+    void clear(const glm::mat4 &viewProjection);
+    // Draws both faces of every triangle of mesh, placed with modelMatrix.
+    void renderOccluder(const OccluderMesh &mesh,
+                        const glm::mat4 &modelMatrix,
+                        CullPath path = bestCullPath());
+
+    // Tests the boxes in [begin, end) whose entry in visible is set, and clears it for the hidden
+    // ones. Returns how many were hidden. Only reads the buffer, so disjoint ranges can be tested
+    // concurrently. Boxes crossing the near plane are always visible.
+    size_t testBoxes(const CullBoxes &boxes,
+                     uint8_t *visible,
+                     size_t begin,
+                     size_t end,
+                     CullPath path = bestCullPath()) const;
+
+    // Depth of a pixel, (0, 0) being the top left one.
+    [[nodiscard]] float depthAt(uint32_t x, uint32_t y) const;
+
+   private:
+    // Clips a clip space triangle against the near plane and the guard band, then rasterizes it.
+    void drawTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, CullPath path);
+    void rasterize(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, CullPath path);
+    [[nodiscard]] bool isBoxVisible(const CullBoxes &boxes, size_t index, CullPath path) const;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    glm::mat4 viewProjection{1.f};
+    // Tile after tile, row by row within each tile.
+    std::vector<float> depth;
+    std::vector<float> tileMaxDepth;
+    // Scratch space for transformed vertices, kept between occluders so it doesn't allocate.
+    std::vector<glm::vec4> clipVertices;
+};
+
+}  // namespace ve
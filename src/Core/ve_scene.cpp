@@ -0,0 +1,257 @@
+#include "Core/ve_scene.hpp"
+
+#include "Core/ve_occlusion.hpp"
+#include "Renderer/ve_texture.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+// Same as in ve_model.cpp, which the path is loaded through.
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace ve {
+
+namespace {
+
+const char *SPONZA_PATH = "assets/models/sponza/sponza.obj";
+
+}  // namespace
+
+VeScene::VeScene(VeDevice &device) : veDevice{device} {}
+
+const std::vector<std::string> &VeScene::names() {
+    static const std::vector<std::string> sceneNames = {
+        "test", "stress", "spheres", "materials", "lights", "sponza"};
+    return sceneNames;
+}
+
+void VeScene::load(const std::string &sceneName, uint32_t size) {
+    if (std::find(names().begin(), names().end(), sceneName) == names().end()) {
+        throw std::runtime_error("failed to load scene, unknown scene " + sceneName + "!");
+    }
+    name = sceneName;
+    interior = false;
+    gameObjects.clear();
+    lights.clear();
+    lightAnchors.clear();
+    loadAssets();
+
+    if (name == "test") {
+        loadTestScene();
+    } else if (name == "stress") {
+        loadStressScene(size > 0 ? size : 10000);
+    } else if (name == "spheres") {
+        loadSphereGrid(size > 0 ? size : 32, false);
+    } else if (name == "materials") {
+        loadSphereGrid(size > 0 ? size : 16, true);
+    } else if (name == "lights") {
+        loadSphereGrid(16, false);
+        scatterLights(size > 0 ? size : 1024);
+    } else if (name == "sponza") {
+        loadSponza();
+    }
+}
+
+void VeScene::loadAssets() {
+    if (!m_models.empty()) {
+        return;
+    }
+    m_textures["empty"] = VeTexture::createEmptyTexture(veDevice);
+
+    m_models["cube"] = VeModel::createModelFromFile(veDevice, "assets/models/cube/cube.obj");
+    // The sphere grids get far enough from the camera for the GPU driven renderer to pick LODs.
+    m_models["sphere"] = VeModel::createModelWithLods(veDevice, "assets/models/sphere.obj", 3);
+
+    // Occluders for CPU occlusion culling. The cube hides everything its bounds do, the sphere
+    // only what a box well inside it does, as the corners of its bounds are empty.
+    const AABB &cubeBounds = m_models["cube"]->getBoundingBox();
+    const AABB &sphereBounds = m_models["sphere"]->getBoundingBox();
+    m_models["cube"]->setOccluder(
+        std::make_shared<OccluderMesh>(OccluderMesh::fromBox(cubeBounds)));
+    m_models["sphere"]->setOccluder(
+        std::make_shared<OccluderMesh>(OccluderMesh::fromBox(sphereBounds, 0.5f)));
+
+    m_materials["default"] = std::make_shared<Material>(m_textures["empty"]);
+}
+
+void VeScene::addObject(std::shared_ptr<VeModel> model,
+                        std::shared_ptr<Material> material,
+                        const TransformComponent &transform) {
+    auto obj = VeGameObject::createGameObject();
+    obj.model = std::move(model);
+    obj.material = std::move(material);
+    obj.transform = transform;
+    obj.isStatic = true;
+    gameObjects.emplace(obj.getId(), std::move(obj));
+}
+
+void VeScene::loadTestScene() {
+    TransformComponent cubeTransform{};
+    cubeTransform.scale *= 5.0f;
+    addObject(m_models["cube"], m_materials["default"], cubeTransform);
+
+    int numSpheres = 4;
+    for (int i = 0; i < numSpheres; i++) {
+        for (int j = 0; j < numSpheres; j++) {
+            TransformComponent transform{};
+            transform.translation = {
+                static_cast<float>(j) * 2.5f, -static_cast<float>(i) * 2.5f, 15.f};
+            addObject(m_models["sphere"], m_materials["default"], transform);
+        }
+    }
+
+    lights.push_back({{0.f, -4.f, 0.f}, 50.f, {1.f, 1.f, 1.f}, 150.f});
+}
+
+void VeScene::loadStressScene(uint32_t count) {
+    // Spheres on a cubic grid centered in front of the camera.
+    auto side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+    float spacing = 3.f;
+    float offset = static_cast<float>(side - 1) * spacing * 0.5f;
+    for (uint32_t i = 0; i < count; i++) {
+        auto x = static_cast<float>(i % side);
+        auto y = static_cast<float>((i / side) % side);
+        auto z = static_cast<float>(i / (side * side));
+
+        TransformComponent transform{};
+        transform.translation = {x * spacing - offset, y * spacing - offset, z * spacing + 10.f};
+        addObject(m_models["sphere"], m_materials["default"], transform);
+    }
+
+    lights.push_back({{0.f, -4.f, 0.f}, 50.f, {1.f, 1.f, 1.f}, 150.f});
+}
+
+void VeScene::loadSphereGrid(uint32_t side, bool ownMaterials) {
+    // Spheres lying on the ground plane, centered on the origin.
+    float spacing = 2.5f;
+    float offset = static_cast<float>(side - 1) * spacing * 0.5f;
+    // Roughness also follows the wood's grain across each sphere. It is linear data, so the
+    // texture is UNORM, which gets its mip chain from the compute path of VeMipGenerator.
+    if (ownMaterials && m_textures.count("wood") == 0) {
+        m_textures["wood"] = VeTexture::createTextureFromFile(
+            veDevice, "assets/textures/wood.png", VK_FORMAT_R8G8B8A8_UNORM);
+    }
+    for (uint32_t i = 0; i < side; i++) {
+        for (uint32_t j = 0; j < side; j++) {
+            std::shared_ptr<Material> material = m_materials["default"];
+            if (ownMaterials) {
+                // Metallic along one axis, roughness along the other and a hue each.
+                auto delta = 1.f / static_cast<float>(side);
+                float hue =
+                    glm::two_pi<float>() * static_cast<float>(i * side + j) * delta * delta;
+                material = std::make_shared<Material>(m_textures["empty"]);
+                material->m_albedo = glm::vec3{0.5f} + 0.5f * glm::vec3{std::cos(hue),
+                                                                        std::cos(hue + 2.1f),
+                                                                        std::cos(hue + 4.2f)};
+                material->m_metallic = static_cast<float>(i) * delta;
+                material->m_roughness = std::min(static_cast<float>(j) * delta + 0.05f, 1.f);
+                material->m_roughnessMap = m_textures["wood"];
+            }
+
+            TransformComponent transform{};
+            transform.translation = {static_cast<float>(j) * spacing - offset,
+                                     0.f,
+                                     static_cast<float>(i) * spacing - offset};
+            addObject(m_models["sphere"], material, transform);
+        }
+    }
+
+    // One light above the middle, reaching the corners.
+    float radius = std::max(50.f, offset * 2.f);
+    lights.push_back({{0.f, -10.f, 0.f}, radius, {1.f, 1.f, 1.f}, 3.f * radius});
+}
+
+void VeScene::loadSponza() {
+    // Only the materials and textures are checked in, the model has to be added by hand.
+    if (!std::ifstream{std::string(ENGINE_DIR) + SPONZA_PATH}) {
+        throw std::runtime_error(std::string("failed to load sponza, ") + ENGINE_DIR + SPONZA_PATH +
+                                 " is missing!");
+    }
+    m_models["sponza"] = VeModel::createModelFromFile(veDevice, SPONZA_PATH);
+    auto material = std::make_shared<Material>(m_textures["empty"]);
+    material->m_albedo = {0.9f, 0.9f, 0.9f};
+    material->m_metallic = 0.f;
+    material->m_roughness = 0.9f;
+    m_materials["sponza"] = material;
+
+    // Authored y up in centimeters.
+    TransformComponent transform{};
+    transform.rotation.x = glm::pi<float>();
+    transform.scale = glm::vec3{0.01f};
+    addObject(m_models["sponza"], material, transform);
+    interior = true;
+
+    // A row of lights down the middle of the atrium, halfway up.
+    AABB bounds = getBounds();
+    glm::vec3 size = bounds.max - bounds.min;
+    int along = size.x >= size.z ? 0 : 2;
+    float radius = size[along] / 3.f;
+    for (int i = 0; i < 4; i++) {
+        glm::vec3 position = bounds.center();
+        float stop = 0.125f + 0.25f * static_cast<float>(i);
+        position[along] = bounds.min[along] + size[along] * stop;
+        lights.push_back({position, radius, {1.f, 0.9f, 0.8f}, 3.f * radius});
+    }
+}
+
+void VeScene::scatterLights(uint32_t count) {
+    // Lights scattered through the bounds of the scene, each circling its own anchor.
+    AABB bounds = getBounds();
+    bounds.min -= glm::vec3{2.f};
+    bounds.max += glm::vec3{2.f};
+
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    lights.clear();
+    lightAnchors.clear();
+    lights.reserve(count);
+    lightAnchors.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 anchor{bounds.min.x + unit(rng) * (bounds.max.x - bounds.min.x),
+                         bounds.min.y + unit(rng) * (bounds.max.y - bounds.min.y),
+                         bounds.min.z + unit(rng) * (bounds.max.z - bounds.min.z)};
+        glm::vec3 color{0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng)};
+        float radius = 2.f + 4.f * unit(rng);
+        lights.push_back({anchor, radius, color, radius * radius});
+        lightAnchors.push_back(anchor);
+    }
+}
+
+bool VeScene::updateLights(float time) {
+    for (uint32_t i = 0; i < lightAnchors.size(); i++) {
+        // Lights circle at different speeds and phases, so they don't move in lockstep.
+        float angle = time * (0.5f + static_cast<float>(i % 7) * 0.15f) + static_cast<float>(i);
+        lights[i].position = lightAnchors[i] + glm::vec3{std::cos(angle), 0.f, std::sin(angle)};
+    }
+    return !lightAnchors.empty();
+}
+
+AABB VeScene::getBounds() const {
+    AABB bounds{glm::vec3{std::numeric_limits<float>::max()},
+                glm::vec3{std::numeric_limits<float>::lowest()}};
+    for (const auto &kv : gameObjects) {
+        const auto &obj = kv.second;
+        AABB objectBounds = obj.transform.transformBounds(obj.model->getBoundingBox());
+        bounds.min = glm::min(bounds.min, objectBounds.min);
+        bounds.max = glm::max(bounds.max, objectBounds.max);
+    }
+    return bounds;
+}
+
+VeCameraPath VeScene::cameraPath(float duration) const {
+    AABB bounds = getBounds();
+    return interior ? VeCameraPath::flythrough(bounds, duration)
+                    : VeCameraPath::orbit(bounds, duration);
+}
+
+}  // namespace ve
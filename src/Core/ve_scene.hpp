@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Core/ve_camera_path.hpp"
+#include "Core/ve_culling.hpp"
+#include "Core/ve_game_object.hpp"
+#include "Core/ve_light_clusters.hpp"
+#include "Core/ve_material.hpp"
+#include "Renderer/ve_device.hpp"
+
+// std
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ve {
+
+// The objects and point lights of a scene, with the models, materials and textures they use.
+//
+// Scenes are built in code by name, so the windowed app, headless runs and benchmarks can all
+// load the same ones:
+//   "test"      A cube in front of a 4x4 grid of spheres.
+//   "stress"    size spheres on a cubic grid (default 10000).
+//   "spheres"   size x size spheres sharing a model and material, drawn instanced (default 32).
+//   "materials" size x size spheres, each with a material of its own (default 16).
+//   "lights"    A 16x16 grid of spheres lit by size moving lights (default 1024).
+//   "sponza"    The Sponza atrium, from assets/models/sponza/sponza.obj.
+class VeScene {
+   public:
+    explicit VeScene(VeDevice &device);
+    ~VeScene() = default;
+
+    // Remove copy constructors.
+    VeScene(const VeScene &) = delete;
+    VeScene &operator=(const VeScene &) = delete;
+
+    [[nodiscard]] static const std::vector<std::string> &names();
+
+    // Loads the named scene and its lights, size being 0 for the scene's default. Throws on
+    // unknown names.
+    void load(const std::string &name, uint32_t size = 0);
+    // Replaces the lights with count small lights scattered through the scene, each circling
+    // a point of its own.
+    void scatterLights(uint32_t count);
+    // Moves the scattered lights to where they are time seconds in. Returns false if no light
+    // moves.
+    bool updateLights(float time);
+
+    // Box around every object.
+    [[nodiscard]] AABB getBounds() const;
+    // Path through the scene taking duration seconds, around it or inside it for interiors.
+    [[nodiscard]] VeCameraPath cameraPath(float duration) const;
+
+    [[nodiscard]] const std::string &getName() const { return name; }
+    [[nodiscard]] VeGameObject::Map &getGameObjects() { return gameObjects; }
+    [[nodiscard]] const std::vector<PointLight> &getLights() const { return lights; }
+
+   private:
+    void loadAssets();
+    void loadTestScene();
+    void loadStressScene(uint32_t count);
+    void loadSphereGrid(uint32_t side, bool ownMaterials);
+    void loadSponza();
+    void addObject(std::shared_ptr<VeModel> model,
+                   std::shared_ptr<Material> material,
+                   const TransformComponent &transform);
+
+    VeDevice &veDevice;
+    std::string name;
+    bool interior{false};
+    VeGameObject::Map gameObjects;
+    std::vector<PointLight> lights;
+    // Centers the scattered lights circle around, one per light.
+    std::vector<glm::vec3> lightAnchors;
+
+    // Assets
+    std::unordered_map<std::string, std::shared_ptr<VeTexture>> m_textures;
+    std::unordered_map<std::string, std::shared_ptr<VeModel>> m_models;
+    std::unordered_map<std::string, std::shared_ptr<Material>> m_materials;
+};
+
+}  // namespace ve
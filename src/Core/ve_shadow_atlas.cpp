@@ -0,0 +1,111 @@
+#include "ve_shadow_atlas.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace ve {
+
+namespace {
+
+uint32_t packTile(uint32_t x, uint32_t y) { return (y << 16) | x; }
+
+}  // namespace
+
+ShadowAtlas::ShadowAtlas(uint32_t size, uint32_t minTileSize)
+    : size{size}, minTileSize{minTileSize} {
+    assert((size & (size - 1)) == 0 && (minTileSize & (minTileSize - 1)) == 0 &&
+           "Atlas and tile sizes must be powers of two");
+    assert(minTileSize <= size && size <= 65536 && "Atlas size out of range");
+    freeTiles.resize(levelOf(minTileSize) + 1);
+    freeTiles[0].push_back(packTile(0, 0));
+}
+
+uint32_t ShadowAtlas::levelOf(uint32_t tileSize) const {
+    uint32_t level = 0;
+    while ((size >> (level + 1)) >= tileSize && (size >> (level + 1)) >= minTileSize) {
+        level++;
+    }
+    return level;
+}
+
+bool ShadowAtlas::split(uint32_t level) {
+    // Makes sure the level has a free tile, by splitting one of the level above.
+    if (!freeTiles[level].empty()) {
+        return true;
+    }
+    if (level == 0 || !split(level - 1)) {
+        return false;
+    }
+    uint32_t parent = freeTiles[level - 1].back();
+    freeTiles[level - 1].pop_back();
+    uint32_t x = parent & 0xffffu;
+    uint32_t y = parent >> 16;
+    uint32_t half = tileSizeOf(level);
+    // Pushed in reverse, so tiles are handed out top left first.
+    freeTiles[level].push_back(packTile(x + half, y + half));
+    freeTiles[level].push_back(packTile(x, y + half));
+    freeTiles[level].push_back(packTile(x + half, y));
+    freeTiles[level].push_back(packTile(x, y));
+    return true;
+}
+
+std::optional<AtlasTile> ShadowAtlas::allocate(uint32_t tileSize) {
+    tileSize = std::clamp(tileSize, minTileSize, size);
+    uint32_t level = levelOf(tileSize);
+    // A size between two powers of two gets the larger one.
+    if (tileSizeOf(level) < tileSize && level > 0) {
+        level--;
+    }
+    if (!split(level)) {
+        return std::nullopt;
+    }
+    uint32_t packed = freeTiles[level].back();
+    freeTiles[level].pop_back();
+    uint32_t allocated = tileSizeOf(level);
+    usedTiles += (allocated / minTileSize) * (allocated / minTileSize);
+    return AtlasTile{packed & 0xffffu, packed >> 16, allocated};
+}
+
+void ShadowAtlas::free(const AtlasTile &tile) {
+    uint32_t level = levelOf(tile.size);
+    assert(tileSizeOf(level) == tile.size && "Tile was not allocated from this atlas");
+    usedTiles -= (tile.size / minTileSize) * (tile.size / minTileSize);
+
+    uint32_t x = tile.x;
+    uint32_t y = tile.y;
+    while (level > 0) {
+        // Merge with the three siblings if they are all free.
+        uint32_t parentSize = tileSizeOf(level - 1);
+        uint32_t parentX = x / parentSize * parentSize;
+        uint32_t parentY = y / parentSize * parentSize;
+        uint32_t half = tileSizeOf(level);
+        auto &list = freeTiles[level];
+        std::array<uint32_t, 3> siblings{};
+        uint32_t found = 0;
+        for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+            uint32_t sx = parentX + (quadrant & 1u) * half;
+            uint32_t sy = parentY + (quadrant >> 1) * half;
+            if (sx == x && sy == y) {
+                continue;
+            }
+            if (std::find(list.begin(), list.end(), packTile(sx, sy)) == list.end()) {
+                break;
+            }
+            siblings[found++] = packTile(sx, sy);
+        }
+        if (found < siblings.size()) {
+            break;
+        }
+        for (uint32_t sibling : siblings) {
+            list.erase(std::find(list.begin(), list.end(), sibling));
+        }
+        x = parentX;
+        y = parentY;
+        level--;
+    }
+    freeTiles[level].push_back(packTile(x, y));
+}
+
+}  // namespace ve
@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ve {
+
+// Square region of a shadow atlas, in texels.
+struct AtlasTile {
+    uint32_t x{0};
+    uint32_t y{0};
+    uint32_t size{0};
+};
+
+// Per frame point light shadow counters.
+struct PointShadowStats {
+    uint32_t shadowedLights{0};
+    uint32_t facesDrawn{0};
+    uint32_t facesEmpty{0};    // Faces without casters, never drawn.
+    uint32_t facesPending{0};  // Out of date faces left for later frames by the budget.
+    uint32_t casters{0};       // Instances drawn, summed over every face.
+    uint32_t tilesUsed{0};     // Atlas area in use, in tiles of the smallest size.
+};
+
+// Hands out power of two tiles of a square shadow atlas.
+//
+// A buddy allocator: every level splits the tiles of the one above into four, down to the
+// smallest tile size. A tile is taken from the free list of its size, splitting a larger one when
+// that is empty, and freeing a tile whose three siblings are free merges them back.
+class ShadowAtlas {
+   public:
+    // size and minTileSize must be powers of two.
+    ShadowAtlas(uint32_t size, uint32_t minTileSize);
+
+    // Returns nothing when no tile of that size is left. tileSize is rounded up to a power of
+    // two and clamped to the tile size range.
+    std::optional<AtlasTile> allocate(uint32_t tileSize);
+    void free(const AtlasTile &tile);
+
+    [[nodiscard]] uint32_t getSize() const { return size; }
+    [[nodiscard]] uint32_t getMinTileSize() const { return minTileSize; }
+    // Area in use, in tiles of the smallest size.
+    [[nodiscard]] uint32_t getUsedTiles() const { return usedTiles; }
+
+   private:
+    [[nodiscard]] uint32_t levelOf(uint32_t tileSize) const;
+    [[nodiscard]] uint32_t tileSizeOf(uint32_t level) const { return size >> level; }
+    bool split(uint32_t level);
+
+    uint32_t size;
+    uint32_t minTileSize;
+    uint32_t usedTiles{0};
+    // Free tiles of each level, level 0 being the whole atlas, as (y << 16) | x.
+    std::vector<std::vector<uint32_t>> freeTiles;
+};
+
+}  // namespace ve
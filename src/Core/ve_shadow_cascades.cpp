@@ -0,0 +1,132 @@
+#include "ve_shadow_cascades.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace ve {
+
+void ShadowCascades::setCascadeCount(uint32_t count) {
+    cascadeCount = std::clamp<uint32_t>(count, 2, MAX_CASCADES);
+}
+
+void ShadowCascades::update(const glm::mat4 &view,
+                            const glm::mat4 &projection,
+                            float near,
+                            float far,
+                            const glm::vec3 &lightDirection,
+                            float casterMin,
+                            float casterMax) {
+    // Light space looks down the light direction from the world origin. It only depends on the
+    // light, so the grid centers are snapped to stays put while the camera moves.
+    const glm::vec3 w = glm::normalize(lightDirection);
+    const glm::vec3 up =
+        std::abs(w.z) < 0.99f ? glm::vec3{0.f, 0.f, 1.f} : glm::vec3{1.f, 0.f, 0.f};
+    const glm::vec3 u = glm::normalize(glm::cross(w, up));
+    const glm::vec3 v = glm::cross(w, u);
+    glm::mat4 lightView{1.f};
+    lightView[0][0] = u.x;
+    lightView[1][0] = u.y;
+    lightView[2][0] = u.z;
+    lightView[0][1] = v.x;
+    lightView[1][1] = v.y;
+    lightView[2][1] = v.z;
+    lightView[0][2] = w.x;
+    lightView[1][2] = w.y;
+    lightView[2][2] = w.z;
+
+    float depthMin = std::floor(casterMin / DEPTH_STEP) * DEPTH_STEP;
+    float depthMax =
+        std::max(std::ceil(casterMax / DEPTH_STEP) * DEPTH_STEP, depthMin + DEPTH_STEP);
+
+    // Split depths, the practical split scheme.
+    float shadowFar = std::max(std::min(far, shadowDistance), near * 2.f);
+    std::array<float, MAX_CASCADES + 1> splits{};
+    for (uint32_t i = 0; i <= cascadeCount; i++) {
+        float t = static_cast<float>(i) / static_cast<float>(cascadeCount);
+        float logSplit = near * std::pow(shadowFar / near, t);
+        float uniformSplit = near + (shadowFar - near) * t;
+        splits[i] = splitLambda * logSplit + (1.f - splitLambda) * uniformSplit;
+    }
+
+    // A corner of the slice at view depth z is z * tanSquared away from the view axis, squared.
+    float tanX = 1.f / projection[0][0];
+    float tanY = 1.f / projection[1][1];
+    float tanSquared = tanX * tanX + tanY * tanY;
+
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        float splitNear = splits[i];
+        float splitFar = splits[i + 1];
+
+        // Smallest sphere centered on the view axis through the corners of both ends of the
+        // slice. Only depends on the projection, so it doesn't change as the camera turns.
+        float center = 0.5f * (splitNear + splitFar) * (1.f + tanSquared);
+        float radius;
+        if (center >= splitFar) {
+            center = splitFar;
+            radius = splitFar * std::sqrt(tanSquared);
+        } else {
+            radius = std::sqrt(splitFar * splitFar * tanSquared +
+                               (splitFar - center) * (splitFar - center));
+        }
+        // Rounded up, so float noise doesn't change the texel size from frame to frame.
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        // The view matrix is a rotation and a translation, so undoing it is transposing the
+        // rotation.
+        glm::vec3 local = glm::vec3{0.f, 0.f, center} - glm::vec3{view[3]};
+        glm::vec3 centerWorld{glm::dot(glm::vec3{view[0]}, local),
+                              glm::dot(glm::vec3{view[1]}, local),
+                              glm::dot(glm::vec3{view[2]}, local)};
+
+        // The center is snapped to a multiple of step, which moves it up to half a step away
+        // from the sphere's, so the projection is that much larger than the sphere.
+        float texelSize;
+        float step;
+        if (isCached(i)) {
+            texelSize = 2.f * radius * (1.f + CACHE_STEP) / static_cast<float>(resolution);
+            step = std::max(std::floor(CACHE_STEP * radius / texelSize), 1.f) * texelSize;
+        } else {
+            texelSize = 2.f * radius / static_cast<float>(resolution - 1);
+            step = texelSize;
+        }
+        float halfSize = 0.5f * texelSize * static_cast<float>(resolution);
+        float centerX = std::round(glm::dot(u, centerWorld) / step) * step;
+        float centerY = std::round(glm::dot(v, centerWorld) / step) * step;
+
+        // Casters can be anywhere towards the light, receivers are inside the sphere.
+        float zNear = depthMin;
+        float zFar = std::ceil((glm::dot(w, centerWorld) + halfSize) / DEPTH_STEP) * DEPTH_STEP;
+        zFar = std::max(std::min(zFar, depthMax), zNear + DEPTH_STEP);
+
+        glm::mat4 ortho{1.f};
+        ortho[0][0] = 1.f / halfSize;
+        ortho[1][1] = 1.f / halfSize;
+        ortho[2][2] = 1.f / (zFar - zNear);
+        ortho[3][0] = -centerX / halfSize;
+        ortho[3][1] = -centerY / halfSize;
+        ortho[3][2] = -zNear / (zFar - zNear);
+
+        ShadowCascade &cascade = cascades[i];
+        cascade.viewProjection = ortho * lightView;
+        cascade.frustum = Frustum::fromMatrix(cascade.viewProjection);
+        cascade.splitNear = splitNear;
+        cascade.splitFar = splitFar;
+        cascade.texelSize = texelSize;
+    }
+}
+
+ShadowUniforms ShadowCascades::uniforms(const DirectionalLight &light) const {
+    ShadowUniforms result{};
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        result.cascades[i] = cascades[i].viewProjection;
+        result.splits[i] = cascades[i].splitFar;
+        result.texelSizes[i] = cascades[i].texelSize;
+    }
+    result.lightDirection =
+        glm::vec4{glm::normalize(light.direction) * -1.f, static_cast<float>(cascadeCount)};
+    result.lightColor = glm::vec4{light.color * light.intensity, 1.f};
+    return result;
+}
+
+}  // namespace ve
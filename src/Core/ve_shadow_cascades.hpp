@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Core/ve_culling.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+
+namespace ve {
+
+// Light infinitely far away, reaching the whole scene from a single direction like the sun.
+struct DirectionalLight {
+    glm::vec3 direction{0.3f, 1.f, 0.2f};  // Direction the light travels in, y being down.
+    glm::vec3 color{1.f, 0.95f, 0.85f};
+    float intensity{3.f};
+};
+
+// Shadow parameters pbr.frag needs to find and sample a fragment's cascade. Laid out to match the
+// end of GlobalUbo in pbr.frag.
+struct ShadowUniforms {
+    std::array<glm::mat4, 4> cascades{};  // World to shadow map clip space.
+    glm::vec4 splits{0.f};                // View space depth each cascade ends at.
+    glm::vec4 texelSizes{0.f};            // World space size of a shadow map texel per cascade.
+    glm::vec4 lightDirection{0.f};        // Towards the light, w is the cascade count.
+    glm::vec4 lightColor{0.f};            // Color times intensity.
+};
+
+// Per frame shadow counters.
+struct ShadowStats {
+    uint32_t cascades{0};
+    uint32_t casters{0};      // Instances drawn, summed over every cascade and cache update.
+    uint32_t drawCalls{0};
+    uint32_t cachedCascades{0};  // Cascades whose static casters came from their cache.
+    uint32_t cacheUpdates{0};    // Cascades whose cache had to be redrawn.
+};
+
+// One slice of the view frustum and the orthographic light projection covering it.
+struct ShadowCascade {
+    glm::mat4 viewProjection{1.f};
+    Frustum frustum{};
+    float splitNear{0.f};  // View space depth range of the slice.
+    float splitFar{0.f};
+    float texelSize{0.f};  // World space size of a shadow map texel.
+};
+
+// Fits directional light shadow cascades to a perspective camera.
+//
+// The view frustum up to the shadow distance is split at depths blending logarithmic and uniform
+// spacing (the practical split scheme), and each slice gets an orthographic projection around the
+// bounding sphere of its corners. The sphere's size doesn't change as the camera turns, and its
+// center is snapped to whole texels in light space, so the shadow map texels stay fixed in the
+// world and shadow edges don't shimmer as the camera moves.
+//
+// Cascades from FIRST_CACHED_CASCADE on snap to a much coarser grid instead, a fraction of their
+// radius, with room to spare around the sphere. Their projection only changes every few units of
+// camera movement, so what is drawn into them stays valid in between and can be cached.
+class ShadowCascades {
+   public:
+    static constexpr uint32_t MAX_CASCADES = 4;
+    static constexpr uint32_t FIRST_CACHED_CASCADE = 2;
+    // Cached cascades move in steps of this fraction of their radius.
+    static constexpr float CACHE_STEP = 0.25f;
+    // The caster depth range is rounded out to multiples of this, in world units, so casters
+    // moving a little don't change the projection of every cascade.
+    static constexpr float DEPTH_STEP = 8.f;
+
+    explicit ShadowCascades(uint32_t resolution) : resolution{resolution} {}
+
+    // Clamped to [2, MAX_CASCADES].
+    void setCascadeCount(uint32_t count);
+    // 0 splits uniformly, 1 logarithmically.
+    void setSplitLambda(float lambda) { splitLambda = lambda; }
+    // Nothing farther than this from the camera is shadowed.
+    void setShadowDistance(float distance) { shadowDistance = distance; }
+
+    // Fits the cascades to a perspective camera looking down +z in view space. casterMin and
+    // casterMax bound the depth of every shadow caster along the light direction, so nothing
+    // between the light and a cascade gets clipped.
+    void update(const glm::mat4 &view,
+                const glm::mat4 &projection,
+                float near,
+                float far,
+                const glm::vec3 &lightDirection,
+                float casterMin,
+                float casterMax);
+
+    [[nodiscard]] uint32_t getCascadeCount() const { return cascadeCount; }
+    [[nodiscard]] const ShadowCascade &getCascade(uint32_t index) const { return cascades[index]; }
+    [[nodiscard]] static bool isCached(uint32_t index) { return index >= FIRST_CACHED_CASCADE; }
+    [[nodiscard]] ShadowUniforms uniforms(const DirectionalLight &light) const;
+
+   private:
+    uint32_t resolution;
+    uint32_t cascadeCount{MAX_CASCADES};
+    float splitLambda{0.75f};
+    float shadowDistance{100.f};
+    std::array<ShadowCascade, MAX_CASCADES> cascades{};
+};
+
+}  // namespace ve
@@ -1,5 +1,9 @@
 #pragma once
 
+// std
+#include <cstddef>
+#include <functional>
+
 namespace ve {
 
 // from: https://stackoverflow.com/a/57595105
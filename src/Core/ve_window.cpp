@@ -2,6 +2,7 @@
 
 #include <stdexcept>
 
+#include "ve_alloc_tracker.hpp"
 #include "ve_input.hpp"
 
 namespace ve {
@@ -26,7 +27,10 @@ void VeWindow::initWindow() {
 }
 
 void VeWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface) {
-    if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
+    if (glfwCreateWindowSurface(instance,
+                                window,
+                                VeAllocTracker::callbacks(AllocScope::Device),
+                                surface) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface");
     }
 }
@@ -1,7 +1,29 @@
 #include "ve_imgui.h"
 
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
 namespace ve {
 
+namespace {
+
+// ImGui allocates through malloc rather than operator new, so route it through the tracker.
+void *imguiAlloc(size_t size, void * /*userData*/) {
+    VeAllocTracker::recordHeapAllocation(size);
+    return std::malloc(size);
+}
+
+void imguiFree(void *ptr, void * /*userData*/) { std::free(ptr); }
+
+}  // namespace
+
 // Resources used:
 // - https://vkguide.dev/docs/extra-chapter/implementing_imgui/
 // - https://frguthmann.github.io/posts/vulkan_imgui/
@@ -11,6 +33,9 @@ VeImGui::VeImGui(VeRenderer &veRenderer) {
 
     // Setup ImGui context
     IMGUI_CHECKVERSION();
+    if (VeAllocTracker::enabled()) {
+        ImGui::SetAllocatorFunctions(imguiAlloc, imguiFree);
+    }
     ImGui::CreateContext();
 
     // Setup Imgui style.
@@ -38,9 +63,9 @@ VeImGui::VeImGui(VeRenderer &veRenderer) {
     initInfo.PhysicalDevice = veDevice.getPhysicalDevice();
     initInfo.Device = veDevice.device();
     initInfo.Queue = veDevice.graphicsQueue();
-    initInfo.PipelineCache = VK_NULL_HANDLE;
+    initInfo.PipelineCache = veDevice.pipelineCache().getHandle();
     initInfo.DescriptorPool = imguiPool->pool();
-    initInfo.Allocator = nullptr;
+    initInfo.Allocator = VeAllocTracker::callbacks(AllocScope::Device);
     initInfo.MinImageCount = veRenderer.getSwapChainImageCount();
     initInfo.ImageCount = veRenderer.getSwapChainImageCount();
     // TODO: Change this later when doing multisampling?
@@ -72,6 +97,342 @@ void VeImGui::render(VkCommandBuffer cmdBuffer) {
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer);
 }
 
+void VeImGui::drawMemoryBudget(const VeDevice &veDevice) {
+    constexpr float MiB = 1024.f * 1024.f;
+    const auto &tracker = veDevice.getMemoryTracker();
+
+    ImGui::Begin("GPU Memory");
+    ImGui::Text("Source: %s",
+                tracker.usingBudgetExtension() ? "VK_EXT_memory_budget" : "software tracking");
+    ImGui::Text("Allocations: %zu", tracker.allocationCount());
+
+    // Per heap usage against the budget.
+    auto heaps = veDevice.getMemoryBudget();
+    for (size_t i = 0; i < heaps.size(); i++) {
+        const auto &heap = heaps[i];
+        float fraction = heap.budget > 0 ? static_cast<float>(heap.usage) /
+                                               static_cast<float>(heap.budget)
+                                         : 0.f;
+        char overlay[64];
+        snprintf(overlay,
+                 sizeof(overlay),
+                 "%.1f / %.1f MiB",
+                 static_cast<float>(heap.usage) / MiB,
+                 static_cast<float>(heap.budget) / MiB);
+        ImGui::Text("Heap %zu (%s, %.0f MiB, engine: %.1f MiB)",
+                    i,
+                    heap.deviceLocal ? "device local" : "host",
+                    static_cast<float>(heap.size) / MiB,
+                    static_cast<float>(heap.tracked) / MiB);
+        ImGui::ProgressBar(fraction, ImVec2(-1.f, 0.f), overlay);
+    }
+
+    // Per category usage.
+    ImGui::Separator();
+    for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        auto category = static_cast<MemoryCategory>(i);
+        ImGui::Text("%-12s %8.2f MiB",
+                    memoryCategoryName(category),
+                    static_cast<float>(tracker.categoryUsage(category)) / MiB);
+    }
+    ImGui::End();
+}
 
+void VeImGui::drawHostAllocations() {
+    if (!VeAllocTracker::enabled()) {
+        return;
+    }
+
+    ImGui::Begin("Host Allocations");
+    for (size_t i = 0; i < ALLOC_SCOPE_COUNT; i++) {
+        auto scope = static_cast<AllocScope>(i);
+        const auto &stats = VeAllocTracker::scopeStats(scope);
+        ImGui::Text("%-10s %6llu live, %8.1f KiB (peak %.1f KiB)",
+                    allocScopeName(scope),
+                    static_cast<unsigned long long>(stats.allocations.load() - stats.frees.load()),
+                    static_cast<float>(stats.liveBytes.load()) / 1024.f,
+                    static_cast<float>(stats.peakBytes.load()) / 1024.f);
+    }
+
+    ImGui::Separator();
+    auto last = VeAllocTracker::lastFrame();
+    ImGui::Text("Last frame: %llu allocations, %llu bytes",
+                static_cast<unsigned long long>(last.allocations),
+                static_cast<unsigned long long>(last.bytes));
+    ImGui::Text("Frames allocating: %llu / %llu",
+                static_cast<unsigned long long>(VeAllocTracker::flaggedFrameCount()),
+                static_cast<unsigned long long>(VeAllocTracker::trackedFrameCount()));
+    ImGui::End();
+}
+
+bool VeImGui::drawRenderGraph(const VeRenderGraph &renderGraph) {
+    constexpr float MiB = 1024.f * 1024.f;
+    const auto &stats = renderGraph.getStats();
+
+    ImGui::Begin("Render Graph");
+    ImGui::Text("Passes: %u (%u culled)", stats.passes, stats.culledPasses);
+    ImGui::Text("Barriers: %u batches, %u image (%u transitions), %u buffer",
+                stats.barrierBatches,
+                stats.imageBarriers,
+                stats.layoutTransitions,
+                stats.bufferBarriers);
+    ImGui::Text("Transient memory: %.1f MiB (%.1f MiB without aliasing)",
+                static_cast<float>(stats.allocatedBytes) / MiB,
+                static_cast<float>(stats.transientBytes) / MiB);
+    bool dump = ImGui::Button("Dump to console");
+    ImGui::End();
+    return dump;
+}
+
+void VeImGui::drawCullingStats(const CullStats &cullStats,
+                               const SubmissionStats &submissionStats) {
+    ImGui::Begin("Culling");
+    ImGui::Text("Path: %s", cullPathName(bestCullPath()));
+    ImGui::Text("Objects: %u tested, %u culled, %u occluded, %u drawn",
+                cullStats.tested,
+                cullStats.culled,
+                cullStats.occluded,
+                cullStats.tested - cullStats.culled - cullStats.occluded);
+    ImGui::Text("Occluders: %u", cullStats.occluders);
+    ImGui::Separator();
+    ImGui::Text("Draw packets: %u, draw calls: %u",
+                submissionStats.packets,
+                submissionStats.drawCalls);
+    ImGui::Text("State changes: %u unsorted, %u sorted",
+                submissionStats.unsorted.total(),
+                submissionStats.sorted.total());
+    ImGui::Text("  materials %u -> %u, meshes %u -> %u",
+                submissionStats.unsorted.materials,
+                submissionStats.sorted.materials,
+                submissionStats.unsorted.meshes,
+                submissionStats.sorted.meshes);
+    ImGui::Text("Recording: %.3f ms on %u thread(s)",
+                submissionStats.recordMilliseconds,
+                submissionStats.recordThreads);
+    ImGui::End();
+}
+
+void VeImGui::drawLightStats(const LightClusterStats &clusterStats,
+                             const PointLightStats &pointLightStats) {
+    ImGui::Begin("Lights");
+    float framerate = ImGui::GetIO().Framerate;
+    ImGui::Text("Frame time: %.3f ms (%.1f FPS)", 1000.f / framerate, framerate);
+    ImGui::Text("Point lights: %u", clusterStats.lights);
+    ImGui::Text("Uploaded: %u, billboards drawn: %u",
+                pointLightStats.uploaded,
+                pointLightStats.drawn);
+    ImGui::Text("Cluster light indices: %u, at most %u per cluster",
+                clusterStats.indices,
+                clusterStats.maxPerCluster);
+    ImGui::Text("Clusters out of room: %u", clusterStats.fullClusters);
+    ImGui::End();
+}
+
+void VeImGui::drawShadows(DirectionalLight &light, int &cascadeCount, const ShadowStats &stats) {
+    ImGui::Begin("Shadows");
+    ImGui::SliderFloat3("Sun direction", &light.direction.x, -1.f, 1.f);
+    ImGui::ColorEdit3("Sun color", &light.color.x);
+    ImGui::SliderFloat("Sun intensity", &light.intensity, 0.f, 10.f);
+    ImGui::SliderInt("Cascades", &cascadeCount, 2, static_cast<int>(ShadowCascades::MAX_CASCADES));
+    ImGui::Text("Casters drawn: %u in %u draw calls", stats.casters, stats.drawCalls);
+    ImGui::Text("Cached cascades: %u reused, %u redrawn", stats.cachedCascades, stats.cacheUpdates);
+    ImGui::End();
+}
+
+void VeImGui::drawPointShadows(int &faceBudget, const PointShadowStats &stats) {
+    ImGui::Begin("Point Shadows");
+    ImGui::SliderInt("Faces per frame", &faceBudget, 1, 96);
+    ImGui::Text("Shadowed lights: %u", stats.shadowedLights);
+    ImGui::Text("Faces: %u drawn, %u pending, %u empty",
+                stats.facesDrawn,
+                stats.facesPending,
+                stats.facesEmpty);
+    ImGui::Text("Casters drawn: %u", stats.casters);
+    ImGui::Text("Atlas tiles used: %u", stats.tilesUsed);
+    ImGui::End();
+}
+
+void VeImGui::drawRenderSettings(RenderSettings &settings,
+                                 const VePipelineStatistics *statistics) {
+    ImGui::Begin("Render Settings");
+    ImGui::Checkbox("Depth pre-pass", &settings.depthPrepass);
+    ImGui::Checkbox("Show overdraw", &settings.showOverdraw);
+    ImGui::Checkbox("Occlusion culling", &settings.occlusionCulling);
+    if (statistics != nullptr) {
+        // Everything shaded in the frame, skybox and UI included. The depth pre-pass has no
+        // fragment shader, so it adds nothing.
+        ImGui::Text("Fragment shader invocations: %llu",
+                    static_cast<unsigned long long>(statistics->getFragmentInvocations()));
+    } else {
+        ImGui::Text("Fragment shader invocations: not supported");
+    }
+    ImGui::End();
+}
+
+bool VeImGui::drawGpuProfiler(const VeGpuProfiler &profiler) {
+    constexpr float ROW_HEIGHT = 20.f;
+    static float frameTimes[VeGpuProfiler::HISTORY];
+
+    ImGui::Begin("GPU Profiler");
+    size_t frameCount = profiler.getFrameCount();
+    if (frameCount == 0) {
+        ImGui::Text("No frames read back yet");
+        bool exportTrace = ImGui::Button("Export trace");
+        ImGui::End();
+        return exportTrace;
+    }
+
+    float average = 0.f;
+    for (size_t i = 0; i < frameCount; i++) {
+        frameTimes[i] = static_cast<float>(profiler.getFrame(i).milliseconds);
+        average += frameTimes[i];
+    }
+    average /= static_cast<float>(frameCount);
+    char overlay[32];
+    std::snprintf(overlay, sizeof(overlay), "avg %.3f ms", average);
+    ImGui::PlotLines("Frame (ms)",
+                     frameTimes,
+                     static_cast<int>(frameCount),
+                     0,
+                     overlay,
+                     0.f,
+                     FLT_MAX,
+                     ImVec2(0.f, 60.f));
+
+    // Flame view of the newest frame, scaled so the frame spans the window.
+    const auto &newest = profiler.getFrame(frameCount - 1);
+    uint32_t maxDepth = 0;
+    for (const auto &zone : newest.zones) {
+        maxDepth = std::max(maxDepth, zone.depth);
+    }
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x;
+    float scale = newest.milliseconds > 0.0 ? width / static_cast<float>(newest.milliseconds) : 0.f;
+    ImGui::InvisibleButton("flame", ImVec2(width, ROW_HEIGHT * static_cast<float>(maxDepth + 1)));
+    bool hovered = ImGui::IsItemHovered();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    for (const auto &zone : newest.zones) {
+        ImVec2 min{origin.x + static_cast<float>(zone.start) * scale,
+                   origin.y + ROW_HEIGHT * static_cast<float>(zone.depth)};
+        ImVec2 max{origin.x + static_cast<float>(zone.end) * scale, min.y + ROW_HEIGHT - 1.f};
+        max.x = std::max(max.x, min.x + 1.f);
+        ImU32 color = ImColor::HSV(static_cast<float>(zone.name % 8) / 8.f, 0.5f, 0.7f);
+        drawList->AddRectFilled(min, max, color);
+        const char *name = profiler.getName(zone.name).c_str();
+        if (ImGui::CalcTextSize(name).x < max.x - min.x - 4.f) {
+            drawList->PushClipRect(min, max, true);
+            drawList->AddText(ImVec2(min.x + 2.f, min.y + 2.f), IM_COL32_WHITE, name);
+            drawList->PopClipRect();
+        }
+
+        if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y &&
+            mouse.y < max.y) {
+            // Average of the scope over the history, summed within each frame it appears in.
+            double total = 0.0;
+            size_t frames = 0;
+            for (size_t i = 0; i < frameCount; i++) {
+                double frameTotal = 0.0;
+                bool found = false;
+                for (const auto &other : profiler.getFrame(i).zones) {
+                    if (other.name == zone.name) {
+                        frameTotal += other.end - other.start;
+                        found = true;
+                    }
+                }
+                total += frameTotal;
+                frames += found ? 1 : 0;
+            }
+            ImGui::SetTooltip("%s\n%.3f ms, %.3f ms on average over %zu frames",
+                              name,
+                              zone.end - zone.start,
+                              frames > 0 ? total / static_cast<double>(frames) : 0.0,
+                              frames);
+        }
+    }
+
+    bool exportTrace = ImGui::Button("Export trace");
+    ImGui::End();
+    return exportTrace;
+}
+
+bool VeImGui::drawCpuProfiler() {
+    if (!VeCpuProfiler::enabled()) {
+        return false;
+    }
+    constexpr float ROW_HEIGHT = 20.f;
+    // Kept between frames so collecting reuses their storage.
+    static std::vector<VeCpuProfiler::Thread> threads;
+
+    ImGui::Begin("CPU Profiler");
+    int64_t frameStart = 0;
+    int64_t frameEnd = 0;
+    if (!VeCpuProfiler::lastFrame(frameStart, frameEnd)) {
+        ImGui::Text("No frames marked yet");
+        bool exportTrace = ImGui::Button("Export trace");
+        ImGui::End();
+        return exportTrace;
+    }
+    VeCpuProfiler::collect(frameStart, threads);
+    double frameMilliseconds = static_cast<double>(frameEnd - frameStart) * 1e-6;
+    ImGui::Text("Last frame: %.3f ms", frameMilliseconds);
+
+    // A lane per thread, zones clipped to the frame and scaled so it spans the window.
+    float width = ImGui::GetContentRegionAvail().x;
+    float scale = width / static_cast<float>(frameEnd - frameStart);
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    for (const auto &thread : threads) {
+        uint32_t maxDepth = 0;
+        bool any = false;
+        for (const auto &event : thread.events) {
+            if (event.start < frameEnd) {
+                maxDepth = std::max(maxDepth, event.depth);
+                any = true;
+            }
+        }
+        if (!any) {
+            continue;
+        }
+
+        ImGui::TextUnformatted(thread.name.c_str());
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::PushID(&thread);
+        ImGui::InvisibleButton("lane",
+                               ImVec2(width, ROW_HEIGHT * static_cast<float>(maxDepth + 1)));
+        ImGui::PopID();
+        bool hovered = ImGui::IsItemHovered();
+        for (const auto &event : thread.events) {
+            if (event.start >= frameEnd) {
+                continue;
+            }
+            int64_t start = std::max(event.start, frameStart) - frameStart;
+            int64_t end = std::min(event.end, frameEnd) - frameStart;
+            ImVec2 min{origin.x + static_cast<float>(start) * scale,
+                       origin.y + ROW_HEIGHT * static_cast<float>(event.depth)};
+            ImVec2 max{origin.x + static_cast<float>(end) * scale, min.y + ROW_HEIGHT - 1.f};
+            max.x = std::max(max.x, min.x + 1.f);
+            // Names are string literals, so their address picks a stable color.
+            auto hue = static_cast<float>(reinterpret_cast<uintptr_t>(event.name) / 8 % 12) / 12.f;
+            drawList->AddRectFilled(min, max, ImColor::HSV(hue, 0.5f, 0.7f));
+            if (ImGui::CalcTextSize(event.name).x < max.x - min.x - 4.f) {
+                drawList->PushClipRect(min, max, true);
+                drawList->AddText(ImVec2(min.x + 2.f, min.y + 2.f), IM_COL32_WHITE, event.name);
+                drawList->PopClipRect();
+            }
+            if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y &&
+                mouse.y < max.y) {
+                ImGui::SetTooltip("%s\n%.3f ms",
+                                  event.name,
+                                  static_cast<double>(event.end - event.start) * 1e-6);
+            }
+        }
+    }
+
+    bool exportTrace = ImGui::Button("Export trace");
+    ImGui::End();
+    return exportTrace;
+}
 
-}  // namespace ve
\ No newline at end of file
+}  // namespace ve
@@ -1,6 +1,16 @@
 #pragma once
 
+#include "Core/ve_cpu_profiler.hpp"
+#include "Core/ve_culling.hpp"
+#include "Core/ve_frame_info.hpp"
+#include "Core/ve_light_clusters.hpp"
+#include "Core/ve_shadow_atlas.hpp"
+#include "Core/ve_shadow_cascades.hpp"
 #include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_draw_packets.hpp"
+#include "Renderer/ve_gpu_profiler.hpp"
+#include "Renderer/ve_pipeline_statistics.hpp"
+#include "Renderer/ve_render_graph.hpp"
 #include "Renderer/ve_renderer.hpp"
 
 // lib
@@ -23,6 +33,34 @@ class VeImGui {
     static void beginFrame();
     static void render(VkCommandBuffer cmdBuffer);
 
+    // Debug windows.
+    static void drawMemoryBudget(const VeDevice& veDevice);
+    // Host allocation counters, only shown when built with VE_TRACK_ALLOCATIONS.
+    static void drawHostAllocations();
+    // Stats of the last compiled render graph. Returns true if a dump was requested.
+    static bool drawRenderGraph(const VeRenderGraph& renderGraph);
+    // Objects tested and culled by the CPU frustum and occlusion culling last frame, and how the
+    // rest were submitted.
+    static void drawCullingStats(const CullStats& cullStats,
+                                 const SubmissionStats& submissionStats);
+    // Point lights binned into clusters and drawn last frame, with the average frame time.
+    static void drawLightStats(const LightClusterStats& clusterStats,
+                               const PointLightStats& pointLightStats);
+    // Sun direction, color and shadow cascade count, with what the shadow map took last frame.
+    static void drawShadows(DirectionalLight& light, int& cascadeCount, const ShadowStats& stats);
+    // Faces redrawn per frame, with the last frame's point light shadow counters.
+    static void drawPointShadows(int& faceBudget, const PointShadowStats& stats);
+    // Render setting toggles, with the fragment shader invocations of the last measured frame
+    // when statistics is non-null.
+    static void drawRenderSettings(RenderSettings& settings,
+                                   const VePipelineStatistics* statistics);
+    // Timeline of the last frame's CPU zones on every thread, only shown when built with
+    // VE_PROFILE_CPU. Returns true if a trace export was requested.
+    static bool drawCpuProfiler();
+    // GPU frame times and a flame view of the newest frame's scopes. Returns true if a trace
+    // export was requested.
+    static bool drawGpuProfiler(const VeGpuProfiler& profiler);
+
    private:
     std::unique_ptr<VeDescriptorPool> imguiPool{};
 };
@@ -7,6 +7,8 @@
 
 #include "ve_buffer.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+
 // std
 #include <cassert>
 #include <cstring>
@@ -34,7 +36,8 @@ VeBuffer::VeBuffer(VeDevice &device,
                    uint32_t instanceCount,
                    VkBufferUsageFlags usageFlags,
                    VkMemoryPropertyFlags memoryPropertyFlags,
-                   VkDeviceSize minOffsetAlignment)
+                   VkDeviceSize minOffsetAlignment,
+                   VkMemoryPropertyFlags preferredMemoryFlags)
     : veDevice{device},
       instanceSize{instanceSize},
       instanceCount{instanceCount},
@@ -42,13 +45,18 @@ VeBuffer::VeBuffer(VeDevice &device,
       memoryPropertyFlags{memoryPropertyFlags} {
     alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
     bufferSize = alignmentSize * instanceCount;
-    device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+    device.createBuffer(
+        bufferSize, usageFlags, memoryPropertyFlags, buffer, memory, preferredMemoryFlags);
 }
 
 VeBuffer::~VeBuffer() {
     unmap();
-    vkDestroyBuffer(veDevice.device(), buffer, nullptr);
-    vkFreeMemory(veDevice.device(), memory, nullptr);
+
+    // The buffer may still be in use by a frame in flight, so defer destruction until it retires.
+    veDevice.deletionQueue().push([&device = veDevice, buffer = buffer, memory = memory]() {
+        vkDestroyBuffer(device.device(), buffer, VeAllocTracker::callbacks(AllocScope::Device));
+        device.freeMemory(memory);
+    });
 }
 
 /**
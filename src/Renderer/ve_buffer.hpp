@@ -13,7 +13,8 @@ class VeBuffer {
              uint32_t instanceCount,
              VkBufferUsageFlags usageFlags,
              VkMemoryPropertyFlags memoryPropertyFlags,
-             VkDeviceSize minOffsetAlignment = 1);
+             VkDeviceSize minOffsetAlignment = 1,
+             VkMemoryPropertyFlags preferredMemoryFlags = 0);
     ~VeBuffer();
 
     VeBuffer(const VeBuffer&) = delete;
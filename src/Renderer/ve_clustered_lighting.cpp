@@ -0,0 +1,193 @@
+#include "ve_clustered_lighting.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
+// std
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+constexpr uint32_t GROUP_SIZE = 128;  // Must match local_size_x in the shader.
+
+}  // namespace
+
+VeClusteredLighting::VeClusteredLighting(VeDevice &device) : veDevice{device} {
+    createFrameData();
+    createPipeline();
+}
+
+VeClusteredLighting::~VeClusteredLighting() {
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void VeClusteredLighting::createFrameData() {
+    descriptorPool = VeDescriptorPool::Builder(veDevice)
+                         .setMaxSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                      4 * VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                         .build();
+    binLayout = VeDescriptorSetLayout::Builder(veDevice)
+                    .addBinding(0,
+                                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Lights
+                    .addBinding(1,
+                                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Clusters
+                    .addBinding(2,
+                                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Light indices
+                    .addBinding(3,
+                                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Stats
+                    .build();
+
+    for (auto &frame : frames) {
+        // Only touched by the GPU. Every cluster owns MAX_LIGHTS_PER_CLUSTER of the indices.
+        frame.clusters = std::make_unique<VeBuffer>(veDevice,
+                                                    sizeof(LightClusterGrid::Cluster),
+                                                    LightClusterGrid::CLUSTER_COUNT,
+                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.lightIndices = std::make_unique<VeBuffer>(
+            veDevice,
+            sizeof(uint32_t),
+            LightClusterGrid::CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.stats = std::make_unique<VeBuffer>(veDevice,
+                                                 sizeof(GpuStats),
+                                                 1,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.stats->map();
+        *static_cast<GpuStats *>(frame.stats->getMappedMemory()) = {};
+
+        // The lights are written in update(), their buffer can move.
+        auto clustersInfo = frame.clusters->descriptorInfo();
+        auto lightIndicesInfo = frame.lightIndices->descriptorInfo();
+        auto statsInfo = frame.stats->descriptorInfo();
+        if (!VeDescriptorWriter(*binLayout, *descriptorPool)
+                 .writeBuffer(1, &clustersInfo)
+                 .writeBuffer(2, &lightIndicesInfo)
+                 .writeBuffer(3, &statsInfo)
+                 .build(frame.binSet)) {
+            throw std::runtime_error("failed to allocate light cluster descriptor set!");
+        }
+    }
+}
+
+void VeClusteredLighting::createPipeline() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstantData);
+
+    VkDescriptorSetLayout layout = binLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &layout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &layoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    pipeline = std::make_unique<VeComputePipeline>(
+        veDevice, "../assets/shaders/light_clusters.comp.spv", pipelineLayout);
+}
+
+void VeClusteredLighting::update(int frameIndex,
+                                 VkDescriptorBufferInfo lightsInfo,
+                                 uint32_t lightCount,
+                                 const VeCamera &camera,
+                                 VkExtent2D extent) {
+    VE_PROFILE_SCOPE("VeClusteredLighting::update");
+    FrameData &frame = frames[frameIndex];
+
+    // The frame's fence has been waited on, so the counters are final and can be cleared for
+    // this frame's pass.
+    auto *gpuStats = static_cast<GpuStats *>(frame.stats->getMappedMemory());
+    stats.maxPerCluster = gpuStats->maxPerCluster;
+    stats.indices = gpuStats->indices;
+    stats.fullClusters = gpuStats->fullClusters;
+    *gpuStats = {};
+    stats.lights = lightCount;
+
+    VeDescriptorWriter(*binLayout, *descriptorPool)
+        .writeBuffer(0, &lightsInfo)
+        .overwrite(frame.binSet);
+
+    grid.setFar(camera.getFar());
+    const glm::mat4 &projection = camera.getProjection();
+    push.view = camera.getView();
+    push.projection = {projection[0][0], projection[1][1], camera.getNear(), camera.getFar()};
+    push.clusters = grid.uniforms(lightCount, extent.width, extent.height);
+}
+
+void VeClusteredLighting::addPass(VeRenderGraph &renderGraph, int frameIndex) {
+    const FrameData &frame = frames[frameIndex];
+    // Every cluster is written in full, so the contents of the previous frame don't matter.
+    clustersHandle = renderGraph.importBuffer("light clusters",
+                                              frame.clusters->getBuffer(),
+                                              frame.clusters->getBufferSize());
+    lightIndicesHandle = renderGraph.importBuffer("light indices",
+                                                  frame.lightIndices->getBuffer(),
+                                                  frame.lightIndices->getBufferSize());
+
+    renderGraph.addPass(
+        "light binning",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.write(clustersHandle, RGAccess::ComputeStorageWrite);
+            builder.write(lightIndicesHandle, RGAccess::ComputeStorageWrite);
+        },
+        [this, push = push, binSet = frame.binSet](VkCommandBuffer commandBuffer) {
+            pipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    pipelineLayout,
+                                    0,
+                                    1,
+                                    &binSet,
+                                    0,
+                                    nullptr);
+            vkCmdPushConstants(commandBuffer,
+                               pipelineLayout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(PushConstantData),
+                               &push);
+            vkCmdDispatch(commandBuffer,
+                          VeComputePipeline::groupCount(LightClusterGrid::CLUSTER_COUNT,
+                                                        GROUP_SIZE),
+                          1,
+                          1);
+
+            // The graph only orders accesses within the frame. The counters are read back by
+            // update() once the frame is done.
+            VeComputePipeline::computeWriteBarrier(commandBuffer,
+                                                   VK_PIPELINE_STAGE_HOST_BIT,
+                                                   VK_ACCESS_HOST_READ_BIT);
+        });
+}
+
+void VeClusteredLighting::declareReads(VeRenderGraph::PassBuilder &builder) const {
+    builder.read(clustersHandle, RGAccess::GraphicsStorageRead);
+    builder.read(lightIndicesHandle, RGAccess::GraphicsStorageRead);
+}
+
+std::array<VkDescriptorBufferInfo, 2> VeClusteredLighting::descriptorInfos(int frameIndex) const {
+    const FrameData &frame = frames[frameIndex];
+    return {frame.clusters->descriptorInfo(), frame.lightIndices->descriptorInfo()};
+}
+
+}  // namespace ve
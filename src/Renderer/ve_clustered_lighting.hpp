@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Core/ve_camera.hpp"
+#include "Core/ve_light_clusters.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_compute_pipeline.hpp"
+#include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// GPU side of clustered forward shading. A compute pass bins PointLightSystem's lights into the
+// clusters of a LightClusterGrid every frame, reading them from the frame's light buffer where
+// they already are. Every frame in flight has its own copy of the cluster grid and the light
+// index list, which pbr.frag reads through the global descriptor set.
+class VeClusteredLighting {
+   public:
+    // Global set bindings of the two buffers, the lights being binding 1.
+    static constexpr uint32_t CLUSTERS_BINDING = 2;
+    static constexpr uint32_t LIGHT_INDICES_BINDING = 3;
+    // Lights a cluster can list, the ones after that are left out of it. Must match
+    // light_clusters.comp.
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+    explicit VeClusteredLighting(VeDevice &device);
+    ~VeClusteredLighting();
+
+    // Remove copy constructors.
+    VeClusteredLighting(const VeClusteredLighting &) = delete;
+    VeClusteredLighting &operator=(const VeClusteredLighting &) = delete;
+
+    // Sets up binning lightCount lights from the frame's light buffer for the camera, and reads
+    // back the counters of the last time the frame was binned. The frame's fence must have been
+    // waited on.
+    void update(int frameIndex,
+                VkDescriptorBufferInfo lightsInfo,
+                uint32_t lightCount,
+                const VeCamera &camera,
+                VkExtent2D extent);
+
+    // Adds the compute pass binning the frame's lights. Passes shading with the clusters have to
+    // declare the reads with declareReads().
+    void addPass(VeRenderGraph &renderGraph, int frameIndex);
+    void declareReads(VeRenderGraph::PassBuilder &builder) const;
+
+    // Clusters and light indices of the frame, in binding order.
+    [[nodiscard]] std::array<VkDescriptorBufferInfo, 2> descriptorInfos(int frameIndex) const;
+    [[nodiscard]] const ClusterUniforms &uniforms() const { return push.clusters; }
+    // Counters of the last frame the GPU has finished binning.
+    [[nodiscard]] const LightClusterStats &getStats() const { return stats; }
+
+   private:
+    // Laid out to match the push constants of light_clusters.comp.
+    struct PushConstantData {
+        glm::mat4 view{1.f};
+        glm::vec4 projection{0.f};  // Scale across and down, near and far plane.
+        ClusterUniforms clusters{};
+    };
+
+    // Laid out to match the Stats buffer of light_clusters.comp.
+    struct GpuStats {
+        uint32_t maxPerCluster;
+        uint32_t indices;
+        uint32_t fullClusters;
+    };
+
+    struct FrameData {
+        std::unique_ptr<VeBuffer> clusters;
+        std::unique_ptr<VeBuffer> lightIndices;
+        std::unique_ptr<VeBuffer> stats;  // Host visible, read back once the frame is done.
+        VkDescriptorSet binSet{};
+    };
+
+    void createFrameData();
+    void createPipeline();
+
+    VeDevice &veDevice;
+    LightClusterGrid grid;
+    std::array<FrameData, VeSwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+
+    std::unique_ptr<VeDescriptorPool> descriptorPool;
+    std::unique_ptr<VeDescriptorSetLayout> binLayout;
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    std::unique_ptr<VeComputePipeline> pipeline;
+
+    // The frame being declared.
+    PushConstantData push{};
+    RGHandle clustersHandle;
+    RGHandle lightIndicesHandle;
+    LightClusterStats stats{};
+};
+
+}  // namespace ve
@@ -0,0 +1,96 @@
+#include "ve_compute_pipeline.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+
+// std
+#include <stdexcept>
+
+namespace ve {
+
+VeComputePipeline::VeComputePipeline(VeDevice& device,
+                                     const std::string& compFilepath,
+                                     VkPipelineLayout pipelineLayout)
+    : veDevice{device} {
+    // The module is owned by the pipeline library, shared with any other pipeline using it.
+    VkShaderModule compShaderModule = veDevice.pipelineLibrary().getShaderModule(compFilepath);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    if (veDevice.pipelineCache().createComputePipeline(pipelineInfo, &computePipeline) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline");
+    }
+}
+
+VeComputePipeline::~VeComputePipeline() {
+    vkDestroyPipeline(veDevice.device(),
+                      computePipeline,
+                      VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void VeComputePipeline::bind(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
+void VeComputePipeline::computeWriteBarrier(VkCommandBuffer commandBuffer,
+                                            VkPipelineStageFlags dstStages,
+                                            VkAccessFlags dstAccess) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         dstStages,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+}
+
+void VeComputePipeline::imageBarrier(VkCommandBuffer commandBuffer,
+                                     VkImage image,
+                                     uint32_t baseLevel,
+                                     uint32_t levelCount,
+                                     VkImageLayout oldLayout,
+                                     VkImageLayout newLayout,
+                                     VkPipelineStageFlags srcStages,
+                                     VkAccessFlags srcAccess,
+                                     VkPipelineStageFlags dstStages,
+                                     VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, VK_REMAINING_ARRAY_LAYERS};
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStages,
+                         dstStages,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+}
+
+}  // namespace ve
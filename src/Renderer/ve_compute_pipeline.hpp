@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include "Renderer/ve_device.hpp"
+
+namespace ve {
+
+// Compute counterpart of VePipeline. As with graphics pipelines, the pipeline layout is created
+// and owned by the system using the pipeline.
+class VeComputePipeline {
+   public:
+    VeComputePipeline(VeDevice& device,
+                      const std::string& compFilepath,
+                      VkPipelineLayout pipelineLayout);
+
+    ~VeComputePipeline();
+
+    // Remove copy constructors.
+    VeComputePipeline(const VeComputePipeline&) = delete;
+    VeComputePipeline& operator=(const VeComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+    // Number of workgroups of groupSize invocations needed to cover count invocations.
+    static uint32_t groupCount(uint32_t count, uint32_t groupSize) {
+        return (count + groupSize - 1) / groupSize;
+    }
+
+    // Barriers for work recorded outside the render graph, which orders its own passes.
+
+    // Makes compute shader writes visible to later accesses, such as another dispatch reading
+    // them (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT) or draws taking
+    // their commands from them (VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    // VK_ACCESS_INDIRECT_COMMAND_READ_BIT).
+    static void computeWriteBarrier(VkCommandBuffer commandBuffer,
+                                    VkPipelineStageFlags dstStages,
+                                    VkAccessFlags dstAccess);
+    // Transitions mip levels [baseLevel, baseLevel + levelCount) of a color image, all layers.
+    static void imageBarrier(VkCommandBuffer commandBuffer,
+                             VkImage image,
+                             uint32_t baseLevel,
+                             uint32_t levelCount,
+                             VkImageLayout oldLayout,
+                             VkImageLayout newLayout,
+                             VkPipelineStageFlags srcStages,
+                             VkAccessFlags srcAccess,
+                             VkPipelineStageFlags dstStages,
+                             VkAccessFlags dstAccess);
+
+   private:
+    VeDevice& veDevice;
+    VkPipeline computePipeline = VK_NULL_HANDLE;
+};
+
+}  // namespace ve
@@ -0,0 +1,71 @@
+#include "ve_deletion_queue.hpp"
+
+#include "Renderer/ve_swap_chain.hpp"
+
+namespace ve {
+
+VeDeletionQueue::VeDeletionQueue() : slots(VeSwapChain::MAX_FRAMES_IN_FLIGHT) {}
+
+VeDeletionQueue::~VeDeletionQueue() { flushAll(); }
+
+void VeDeletionQueue::push(std::function<void()> &&deletor) {
+    slots[frameNumber % slots.size()].push_back({frameNumber, std::move(deletor)});
+}
+
+void VeDeletionQueue::beginFrame() {
+    frameNumber++;
+    frameInProgress = true;
+
+    // The slot we are about to reuse was last filled MAX_FRAMES_IN_FLIGHT frames ago. The fence
+    // for that frame has just been waited on, so nothing in it can still be in use.
+    // Deletors may queue further deletions, so take the entries out of the slot first.
+    auto entries = std::move(slots[frameNumber % slots.size()]);
+    slots[frameNumber % slots.size()].clear();
+    for (auto &entry : entries) {
+        entry.deletor();
+    }
+}
+
+void VeDeletionQueue::flushIdle() {
+    std::vector<Entry> retired;
+    for (auto &slot : slots) {
+        std::vector<Entry> remaining;
+        for (auto &entry : slot) {
+            // Objects queued during a frame that is still being recorded may be referenced by
+            // commands that haven't been submitted yet.
+            if (frameInProgress && entry.frame == frameNumber) {
+                remaining.push_back(std::move(entry));
+            } else {
+                retired.push_back(std::move(entry));
+            }
+        }
+        slot = std::move(remaining);
+    }
+
+    for (auto &entry : retired) {
+        entry.deletor();
+    }
+}
+
+void VeDeletionQueue::flushAll() {
+    // Keep going until deletors stop queueing more work.
+    while (pendingCount() > 0) {
+        for (auto &slot : slots) {
+            auto entries = std::move(slot);
+            slot.clear();
+            for (auto &entry : entries) {
+                entry.deletor();
+            }
+        }
+    }
+}
+
+size_t VeDeletionQueue::pendingCount() const {
+    size_t count = 0;
+    for (const auto &slot : slots) {
+        count += slot.size();
+    }
+    return count;
+}
+
+}  // namespace ve
@@ -0,0 +1,53 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ve {
+
+// Holds on to Vulkan objects until the GPU can no longer be using them.
+//
+// Every deletion is tagged with the frame that was being recorded (or was last submitted) when it
+// was queued and stored in that frame's slot. A slot is only flushed after the renderer has waited
+// on the in-flight fence of the frame that reuses it, at which point every frame that could have
+// referenced the queued objects has retired.
+class VeDeletionQueue {
+   public:
+    VeDeletionQueue();
+    ~VeDeletionQueue();
+
+    VeDeletionQueue(const VeDeletionQueue &) = delete;
+    VeDeletionQueue &operator=(const VeDeletionQueue &) = delete;
+
+    // Queue a function which destroys one or more Vulkan objects.
+    void push(std::function<void()> &&deletor);
+
+    // Called by the renderer once the in-flight fence for the next frame has been waited on.
+    // Destroys everything queued MAX_FRAMES_IN_FLIGHT frames ago.
+    void beginFrame();
+    // Called by the renderer once the frame's command buffer has been submitted.
+    void endFrame() { frameInProgress = false; }
+
+    // Destroys everything that can't be referenced by pending work. Only valid to call right after
+    // the graphics queue or device has been waited on.
+    void flushIdle();
+    // Destroys everything. Only valid when the device is idle.
+    void flushAll();
+
+    [[nodiscard]] uint64_t getFrameNumber() const { return frameNumber; }
+    [[nodiscard]] size_t pendingCount() const;
+
+   private:
+    struct Entry {
+        uint64_t frame;
+        std::function<void()> deletor;
+    };
+
+    std::vector<std::vector<Entry>> slots;
+    uint64_t frameNumber{0};
+    bool frameInProgress{false};
+};
+
+}  // namespace ve
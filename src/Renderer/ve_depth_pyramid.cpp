@@ -0,0 +1,293 @@
+#include "ve_depth_pyramid.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+constexpr uint32_t GROUP_SIZE = 8;  // Must match local_size_x and local_size_y in the shader.
+constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+}  // namespace
+
+VeDepthPyramid::VeDepthPyramid(VeDevice &device) : veDevice{device} {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+    if (vkCreateSampler(veDevice.device(),
+                        &samplerInfo,
+                        VeAllocTracker::callbacks(AllocScope::Device),
+                        &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+
+    createDescriptorSets();
+    createPipeline();
+}
+
+VeDepthPyramid::~VeDepthPyramid() {
+    // The device is idle when systems are torn down, so nothing can still use the pyramids.
+    for (auto &pyramid : pyramids) {
+        for (auto view : pyramid.levelViews) {
+            vkDestroyImageView(veDevice.device(),
+                               view,
+                               VeAllocTracker::callbacks(AllocScope::Device));
+        }
+        vkDestroyImageView(veDevice.device(),
+                           pyramid.view,
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyImage(veDevice.device(),
+                       pyramid.image,
+                       VeAllocTracker::callbacks(AllocScope::Device));
+        veDevice.freeMemory(pyramid.memory);
+    }
+    vkDestroySampler(veDevice.device(), sampler, VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void VeDepthPyramid::resize(VkExtent2D newDepthExtent) {
+    if (newDepthExtent.width == depthExtent.width &&
+        newDepthExtent.height == depthExtent.height) {
+        return;
+    }
+    destroyPyramids();
+
+    depthExtent = newDepthExtent;
+    extent = {std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u)};
+    levelCount = 1;
+    while ((std::max(extent.width, extent.height) >> levelCount) > 0) {
+        levelCount++;
+    }
+    assert(levelCount <= MAX_LEVELS && "Depth buffer too large for the pyramid");
+
+    createPyramids();
+}
+
+void VeDepthPyramid::createPyramids() {
+    for (auto &pyramid : pyramids) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = PYRAMID_FORMAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        veDevice.createImageWithInfo(
+            imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid.image, pyramid.memory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = pyramid.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = PYRAMID_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &pyramid.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view!");
+        }
+
+        // Levels are written one at a time, each reading the one before it.
+        pyramid.levelViews.resize(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            viewInfo.subresourceRange.baseMipLevel = level;
+            viewInfo.subresourceRange.levelCount = 1;
+            if (vkCreateImageView(veDevice.device(),
+                                  &viewInfo,
+                                  VeAllocTracker::callbacks(AllocScope::Device),
+                                  &pyramid.levelViews[level]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create depth pyramid level view!");
+            }
+        }
+    }
+
+    // Culling binds the pyramid before the first frame has built it, so it has to be in the
+    // layout it is sampled in from the start.
+    VkCommandBuffer commandBuffer = veDevice.beginSingleTimeCommands();
+    for (const auto &pyramid : pyramids) {
+        VeComputePipeline::imageBarrier(commandBuffer,
+                                        pyramid.image,
+                                        0,
+                                        levelCount,
+                                        VK_IMAGE_LAYOUT_UNDEFINED,
+                                        VK_IMAGE_LAYOUT_GENERAL,
+                                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                        0,
+                                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+    veDevice.endSingleTimeCommands(commandBuffer);
+}
+
+void VeDepthPyramid::destroyPyramids() {
+    for (auto &pyramid : pyramids) {
+        if (pyramid.image == VK_NULL_HANDLE) {
+            continue;
+        }
+        // Frames in flight may still be culling against the old pyramids.
+        veDevice.deletionQueue().push([&device = veDevice, old = pyramid]() {
+            for (auto view : old.levelViews) {
+                vkDestroyImageView(device.device(),
+                                   view,
+                                   VeAllocTracker::callbacks(AllocScope::Device));
+            }
+            vkDestroyImageView(device.device(),
+                               old.view,
+                               VeAllocTracker::callbacks(AllocScope::Device));
+            vkDestroyImage(device.device(),
+                           old.image,
+                           VeAllocTracker::callbacks(AllocScope::Device));
+            device.freeMemory(old.memory);
+        });
+        pyramid = {};
+    }
+}
+
+void VeDepthPyramid::createDescriptorSets() {
+    auto setCount = static_cast<uint32_t>(MAX_LEVELS * VeSwapChain::MAX_FRAMES_IN_FLIGHT);
+    descriptorPool = VeDescriptorPool::Builder(veDevice)
+                         .setMaxSets(setCount)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+                         .build();
+    setLayout = VeDescriptorSetLayout::Builder(veDevice)
+                    .addBinding(0,
+                                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Source
+                    .addBinding(1,
+                                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Destination
+                    .build();
+
+    // Written right before use, since the depth buffer alternates with the swap chain images.
+    for (auto &frameSets : descriptorSets) {
+        for (auto &set : frameSets) {
+            if (!VeDescriptorWriter(*setLayout, *descriptorPool).build(set)) {
+                throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+            }
+        }
+    }
+}
+
+void VeDepthPyramid::createPipeline() {
+    VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &layout;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &layoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    pipeline = std::make_unique<VeComputePipeline>(
+        veDevice, "../assets/shaders/depth_pyramid.comp.spv", pipelineLayout);
+}
+
+RGHandle VeDepthPyramid::addBuildPass(VeRenderGraph &renderGraph,
+                                      RGHandle depth,
+                                      VkImageView depthView,
+                                      int frameIndex) {
+    assert(levelCount > 0 && "Depth pyramid used before resize()");
+    const Pyramid &pyramid = pyramids[frameIndex];
+
+    auto &sets = descriptorSets[frameIndex];
+    for (uint32_t level = 0; level < levelCount; level++) {
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = sampler;
+        sourceInfo.imageView = level == 0 ? depthView : pyramid.levelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                            : VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = pyramid.levelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        VeDescriptorWriter(*setLayout, *descriptorPool)
+            .writeImage(0, &sourceInfo)
+            .writeImage(1, &destinationInfo)
+            .overwrite(sets[level]);
+    }
+
+    // Rebuilt from scratch every frame, so the contents of the previous one don't matter.
+    RGHandle handle = renderGraph.importImage("depth pyramid",
+                                              pyramid.image,
+                                              pyramid.view,
+                                              {PYRAMID_FORMAT, extent, VK_IMAGE_ASPECT_COLOR_BIT},
+                                              VK_IMAGE_LAYOUT_UNDEFINED,
+                                              VK_IMAGE_LAYOUT_GENERAL);
+
+    renderGraph.addPass(
+        "depth pyramid",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.read(depth, RGAccess::ComputeSampled);
+            builder.write(handle, RGAccess::ComputeStorageWrite);
+        },
+        [this, frameIndex, image = pyramid.image](VkCommandBuffer commandBuffer) {
+            pipeline->bind(commandBuffer);
+            for (uint32_t level = 0; level < levelCount; level++) {
+                vkCmdBindDescriptorSets(commandBuffer,
+                                        VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        pipelineLayout,
+                                        0,
+                                        1,
+                                        &descriptorSets[frameIndex][level],
+                                        0,
+                                        nullptr);
+                uint32_t width = std::max(extent.width >> level, 1u);
+                uint32_t height = std::max(extent.height >> level, 1u);
+                vkCmdDispatch(commandBuffer,
+                              VeComputePipeline::groupCount(width, GROUP_SIZE),
+                              VeComputePipeline::groupCount(height, GROUP_SIZE),
+                              1);
+
+                // The next level reads this one.
+                VeComputePipeline::imageBarrier(commandBuffer,
+                                                image,
+                                                level,
+                                                1,
+                                                VK_IMAGE_LAYOUT_GENERAL,
+                                                VK_IMAGE_LAYOUT_GENERAL,
+                                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                VK_ACCESS_SHADER_WRITE_BIT,
+                                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                VK_ACCESS_SHADER_READ_BIT);
+            }
+        });
+    return handle;
+}
+
+VkDescriptorImageInfo VeDepthPyramid::descriptorInfo(int frameIndex) const {
+    VkDescriptorImageInfo info{};
+    info.sampler = sampler;
+    info.imageView = pyramids[frameIndex].view;
+    info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    return info;
+}
+
+}  // namespace ve
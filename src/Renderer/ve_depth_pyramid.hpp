@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ve_compute_pipeline.hpp"
+#include "ve_descriptors.hpp"
+#include "ve_device.hpp"
+#include "ve_render_graph.hpp"
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Hierarchical depth buffer for occlusion culling.
+//
+// Level 0 is half the resolution of the depth buffer and every level after that halves it again,
+// down to a single texel. Each texel holds the farthest depth it covers, so a bounding volume whose
+// nearest depth is farther than the texels under its screen space bounds is hidden.
+//
+// Every frame in flight has its own pyramid, so building one never races with the previous frame
+// still reading the other. The pyramids stay in VK_IMAGE_LAYOUT_GENERAL, they are written as
+// storage images and sampled in that layout.
+class VeDepthPyramid {
+   public:
+    // Enough for a 65536 texel wide depth buffer.
+    static constexpr uint32_t MAX_LEVELS = 16;
+
+    explicit VeDepthPyramid(VeDevice &device);
+    ~VeDepthPyramid();
+
+    // Remove copy constructors.
+    VeDepthPyramid(const VeDepthPyramid &) = delete;
+    VeDepthPyramid &operator=(const VeDepthPyramid &) = delete;
+
+    // Recreates the pyramids if the depth buffer changed size. Views handed out before stay valid
+    // until the frames using them have retired.
+    void resize(VkExtent2D depthExtent);
+
+    // Adds the compute pass reducing depth into the frame's pyramid and returns the pyramid.
+    RGHandle addBuildPass(VeRenderGraph &renderGraph,
+                          RGHandle depth,
+                          VkImageView depthView,
+                          int frameIndex);
+
+    // All levels of the frame's pyramid, for sampling with texelFetch.
+    [[nodiscard]] VkDescriptorImageInfo descriptorInfo(int frameIndex) const;
+    [[nodiscard]] VkExtent2D getDepthExtent() const { return depthExtent; }
+    [[nodiscard]] uint32_t getLevelCount() const { return levelCount; }
+
+   private:
+    struct Pyramid {
+        VkImage image{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};  // Every level.
+        std::vector<VkImageView> levelViews;
+    };
+
+    void createPyramids();
+    void destroyPyramids();
+    void createDescriptorSets();
+    void createPipeline();
+
+    VeDevice &veDevice;
+    VkExtent2D depthExtent{0, 0};
+    VkExtent2D extent{0, 0};  // Of level 0.
+    uint32_t levelCount{0};
+    std::array<Pyramid, VeSwapChain::MAX_FRAMES_IN_FLIGHT> pyramids{};
+
+    VkSampler sampler{VK_NULL_HANDLE};
+    std::unique_ptr<VeDescriptorPool> descriptorPool{};
+    std::unique_ptr<VeDescriptorSetLayout> setLayout{};
+    // One set per level and frame, rewritten every frame since the depth view changes.
+    std::array<std::array<VkDescriptorSet, MAX_LEVELS>, VeSwapChain::MAX_FRAMES_IN_FLIGHT>
+        descriptorSets{};
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    std::unique_ptr<VeComputePipeline> pipeline;
+};
+
+}  // namespace ve
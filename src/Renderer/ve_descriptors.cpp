@@ -1,5 +1,7 @@
 #include "ve_descriptors.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+
 // std
 #include <cassert>
 #include <stdexcept>
@@ -43,14 +45,19 @@ VeDescriptorSetLayout::VeDescriptorSetLayout(
     descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
     if (vkCreateDescriptorSetLayout(
-            veDevice.device(), &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout) !=
+            veDevice.device(),
+            &descriptorSetLayoutInfo,
+            VeAllocTracker::callbacks(AllocScope::Descriptor),
+            &descriptorSetLayout) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
 }
 
 VeDescriptorSetLayout::~VeDescriptorSetLayout() {
-    vkDestroyDescriptorSetLayout(veDevice.device(), descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(veDevice.device(),
+                                 descriptorSetLayout,
+                                 VeAllocTracker::callbacks(AllocScope::Descriptor));
 }
 
 // *************** Descriptor Pool Builder *********************
@@ -89,14 +96,19 @@ VeDescriptorPool::VeDescriptorPool(VeDevice &veDevice,
     descriptorPoolInfo.maxSets = maxSets;
     descriptorPoolInfo.flags = poolFlags;
 
-    if (vkCreateDescriptorPool(veDevice.device(), &descriptorPoolInfo, nullptr, &descriptorPool) !=
+    if (vkCreateDescriptorPool(veDevice.device(),
+                               &descriptorPoolInfo,
+                               VeAllocTracker::callbacks(AllocScope::Descriptor),
+                               &descriptorPool) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 }
 
 VeDescriptorPool::~VeDescriptorPool() {
-    vkDestroyDescriptorPool(veDevice.device(), descriptorPool, nullptr);
+    vkDestroyDescriptorPool(veDevice.device(),
+                            descriptorPool,
+                            VeAllocTracker::callbacks(AllocScope::Descriptor));
 }
 
 bool VeDescriptorPool::allocateDescriptor(const VkDescriptorSetLayout descriptorSetLayout,
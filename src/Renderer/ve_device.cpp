@@ -1,5 +1,9 @@
 #include "ve_device.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+#include "Renderer/ve_mip_generator.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+
 // std headers
 #include <cstring>
 #include <iostream>
@@ -15,6 +19,9 @@ debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
               const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
               void *pUserData) {
     std::cerr << "validation layer: " << pCallbackData->pMessage << "\n";
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        static_cast<std::atomic<uint32_t> *>(pUserData)->fetch_add(1);
+    }
 
     return VK_FALSE;
 }
@@ -50,25 +57,42 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 // Class member functions
 
 // Constructor
-VeDevice::VeDevice(VeWindow &veWindow) : veWindow{veWindow} {
+VeDevice::VeDevice(VeWindow &veWindow) : VeDevice{&veWindow} {}
+
+VeDevice::VeDevice() : VeDevice{nullptr} {}
+
+VeDevice::VeDevice(VeWindow *window) : veWindow{window} {
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    pipelineCache_ = std::make_unique<VePipelineCache>(device_, properties, hasCreationFeedback);
+    pipelineLibrary_ = std::make_unique<VePipelineLibrary>(*this);
 }
 
 VeDevice::~VeDevice() {
-    vkDestroyCommandPool(device_, commandPool, nullptr);
-    vkDestroyDevice(device_, nullptr);
+    // Anything still waiting on frames to retire can go now.
+    vkDeviceWaitIdle(device_);
+    deletionQueue_.flushAll();
+    mipGenerator_.reset();
+    // Stops the compile threads, which still use the cache.
+    pipelineLibrary_.reset();
+    // Written to disk on the way out.
+    pipelineCache_.reset();
+
+    vkDestroyCommandPool(device_, commandPool, VeAllocTracker::callbacks(AllocScope::Command));
+    vkDestroyDevice(device_, VeAllocTracker::callbacks(AllocScope::Device));
 
     if (enableValidationLayers) {
-        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+        DestroyDebugUtilsMessengerEXT(instance,
+                                      debugMessenger,
+                                      VeAllocTracker::callbacks(AllocScope::Device));
     }
 
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
-    vkDestroyInstance(instance, nullptr);
+    vkDestroySurfaceKHR(instance, surface_, VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyInstance(instance, VeAllocTracker::callbacks(AllocScope::Device));
 }
 
 // Initializes the Vulkan instance.
@@ -90,6 +114,12 @@ void VeDevice::createInstance() {
     createInfo.pApplicationInfo = &appInfo;
 
     auto extensions = getRequiredExtensions();
+    // Needed to query VK_EXT_memory_budget. Optional since we can track memory ourselves.
+    hasPhysicalDeviceProperties2 =
+        isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    if (hasPhysicalDeviceProperties2) {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -105,7 +135,9 @@ void VeDevice::createInstance() {
         createInfo.pNext = nullptr;
     }
 
-    if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+    if (vkCreateInstance(&createInfo,
+                         VeAllocTracker::callbacks(AllocScope::Device),
+                         &instance) != VK_SUCCESS) {
         throw std::runtime_error("failed to create instance!");
     }
 
@@ -154,9 +186,19 @@ void VeDevice::createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.fillModeNonSolid = VK_TRUE;
+    // Optional, used by GPU driven rendering.
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    // Optional, used to count shader invocations, including from secondary command buffers.
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+    enabledFeatures = deviceFeatures;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -164,9 +206,49 @@ void VeDevice::createLogicalDevice() {
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+    // Optional extensions are enabled on top of the required ones if the device supports them.
+    std::vector<const char *> enabledExtensions = getRequiredDeviceExtensions();
+    hasMemoryBudget = hasPhysicalDeviceProperties2 &&
+                      isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (hasMemoryBudget) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    bool hasDrawIndirectCount =
+        isDeviceExtensionAvailable(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (hasDrawIndirectCount) {
+        enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    // Tells pipeline cache hits from misses.
+    hasCreationFeedback = isDeviceExtensionAvailable(
+        physicalDevice, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if (hasCreationFeedback) {
+        enabledExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    }
+
+    // Lets the driver report what shaders compiled to, such as instruction counts.
+    VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR executableFeatures{};
+    executableFeatures.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR;
+    if (hasPhysicalDeviceProperties2 &&
+        isDeviceExtensionAvailable(physicalDevice,
+                                   VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME)) {
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceFeatures2KHR");
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &executableFeatures;
+        getFeatures2(physicalDevice, &features2);
+        hasExecutableProperties = executableFeatures.pipelineExecutableInfo == VK_TRUE;
+    }
+    if (hasExecutableProperties) {
+        enabledExtensions.push_back(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+        executableFeatures.pNext = nullptr;
+        createInfo.pNext = &executableFeatures;
+    }
+
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -177,12 +259,46 @@ void VeDevice::createLogicalDevice() {
         createInfo.enabledLayerCount = 0;
     }
 
-    if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device_) != VK_SUCCESS) {
+    if (vkCreateDevice(physicalDevice,
+                       &createInfo,
+                       VeAllocTracker::callbacks(AllocScope::Device),
+                       &device_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+    if (hasDrawIndirectCount) {
+        cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            device_, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+    if (hasExecutableProperties) {
+        executableFunctions.getProperties =
+            (PFN_vkGetPipelineExecutablePropertiesKHR)vkGetDeviceProcAddr(
+                device_, "vkGetPipelineExecutablePropertiesKHR");
+        executableFunctions.getStatistics =
+            (PFN_vkGetPipelineExecutableStatisticsKHR)vkGetDeviceProcAddr(
+                device_, "vkGetPipelineExecutableStatisticsKHR");
+    }
+
+    // Fall back to tracking allocations ourselves if the driver can't report the budget.
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+    if (hasMemoryBudget) {
+        getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    }
+    memoryTracker.init(physicalDevice, getMemoryProperties2);
+    std::cout << "memory budget: "
+              << (memoryTracker.usingBudgetExtension() ? "VK_EXT_memory_budget" : "software")
+              << std::endl;
+}
+
+VeMipGenerator &VeDevice::mipGenerator() {
+    if (!mipGenerator_) {
+        mipGenerator_ = std::make_unique<VeMipGenerator>(*this);
+    }
+    return *mipGenerator_;
 }
 
 void VeDevice::createCommandPool() {
@@ -194,21 +310,28 @@ void VeDevice::createCommandPool() {
     poolInfo.flags =
         VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(device_,
+                            &poolInfo,
+                            VeAllocTracker::callbacks(AllocScope::Command),
+                            &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
 }
 
-// Creates the surface which we present images to.
-void VeDevice::createSurface() { veWindow.createWindowSurface(instance, &surface_); }
+// Creates the surface which we present images to. Headless devices have none.
+void VeDevice::createSurface() {
+    if (veWindow != nullptr) {
+        veWindow->createWindowSurface(instance, &surface_);
+    }
+}
 
 bool VeDevice::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = isHeadless();
+    if (extensionsSupported && !isHeadless()) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate =
             !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -230,7 +353,7 @@ void VeDevice::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoE
                              VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
                              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
     createInfo.pfnUserCallback = debugCallback;
-    createInfo.pUserData = nullptr;  // Optional
+    createInfo.pUserData = &validationErrors;
 }
 
 // Setup validation layers for debugging.
@@ -238,7 +361,10 @@ void VeDevice::setupDebugMessenger() {
     if (!enableValidationLayers) return;
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
     populateDebugMessengerCreateInfo(createInfo);
-    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) !=
+    if (CreateDebugUtilsMessengerEXT(instance,
+                                     &createInfo,
+                                     VeAllocTracker::callbacks(AllocScope::Device),
+                                     &debugMessenger) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to set up debug messenger!");
     }
@@ -270,9 +396,12 @@ bool VeDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> VeDevice::getRequiredExtensions() const {
+    // GLFW isn't initialized without a window, and there is no surface to need its extensions.
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = nullptr;
+    if (!isHeadless()) {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 
     std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
@@ -283,6 +412,13 @@ std::vector<const char *> VeDevice::getRequiredExtensions() const {
     return extensions;
 }
 
+std::vector<const char *> VeDevice::getRequiredDeviceExtensions() const {
+    if (isHeadless()) {
+        return {};
+    }
+    return deviceExtensions;
+}
+
 void VeDevice::hasGflwRequiredInstanceExtensions() {
     uint32_t extensionCount = 0;
     vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -314,7 +450,8 @@ bool VeDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     vkEnumerateDeviceExtensionProperties(
         device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::vector<const char *> required = getRequiredDeviceExtensions();
+    std::set<std::string> requiredExtensions(required.begin(), required.end());
 
     for (const auto &extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -323,6 +460,34 @@ bool VeDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool VeDevice::isInstanceExtensionAvailable(const char *extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+    for (const auto &extension : extensions) {
+        if (strcmp(extensionName, extension.extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VeDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+    for (const auto &extension : extensions) {
+        if (strcmp(extensionName, extension.extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 QueueFamilyIndices VeDevice::findQueueFamilies(VkPhysicalDevice device) {
     QueueFamilyIndices indices;
 
@@ -338,8 +503,11 @@ QueueFamilyIndices VeDevice::findQueueFamilies(VkPhysicalDevice device) {
             indices.graphicsFamily = i;
             indices.graphicsFamilyHasValue = true;
         }
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        // Nothing is presented without a surface, so the graphics queue stands in for it.
+        VkBool32 presentSupport = isHeadless() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        if (!isHeadless()) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        }
         if (queueFamily.queueCount > 0 && presentSupport) {
             indices.presentFamily = i;
             indices.presentFamilyHasValue = true;
@@ -396,45 +564,161 @@ VkFormat VeDevice::findSupportedFormat(const std::vector<VkFormat> &candidates,
     throw std::runtime_error("failed to find supported format!");
 }
 
-uint32_t VeDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+uint32_t VeDevice::findMemoryType(uint32_t typeFilter,
+                                  VkMemoryPropertyFlags properties,
+                                  VkMemoryPropertyFlags preferredProperties) const {
+    const auto &memProperties = memoryTracker.memoryProperties();
+
+    // Rank every suitable type by how many of the preferred properties it has. Ties go to the lower
+    // index, since drivers list their best types first.
+    uint32_t bestType = UINT32_MAX;
+    int bestScore = -1;
     for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+        VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+        if (!(typeFilter & (1 << i)) || (flags & properties) != properties) {
+            continue;
+        }
+
+        int score = 0;
+        for (VkMemoryPropertyFlags matched = flags & preferredProperties; matched != 0;
+             matched &= matched - 1) {
+            score++;
+        }
+        if (score > bestScore) {
+            bestType = i;
+            bestScore = score;
         }
     }
 
-    throw std::runtime_error("failed to find suitable memory type!");
+    if (bestType == UINT32_MAX) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+    return bestType;
+}
+
+bool VeDevice::supportsDirectWrite(const VkMemoryRequirements &memRequirements) const {
+    const auto &memProperties = memoryTracker.memoryProperties();
+    auto heaps = memoryTracker.queryBudget();
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        const auto &type = memProperties.memoryTypes[i];
+        // The buffer may not be allowed in every host visible device local type.
+        if (!(memRequirements.memoryTypeBits & (1u << i)) ||
+            (type.propertyFlags & DIRECT_WRITE_MEMORY_PROPERTIES) !=
+                DIRECT_WRITE_MEMORY_PROPERTIES) {
+            continue;
+        }
+
+        const auto &heap = heaps[type.heapIndex];
+        if (heap.usage >= heap.budget) {
+            continue;
+        }
+        if (memRequirements.size <= (heap.budget - heap.usage) / DIRECT_WRITE_BUDGET_DIVISOR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+VkMemoryRequirements VeDevice::getBufferMemoryRequirements(VkDeviceSize size,
+                                                           VkBufferUsageFlags usage) {
+    // Creating a buffer doesn't allocate its memory, so a throwaway one is cheap.
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer;
+    if (vkCreateBuffer(device_,
+                       &bufferInfo,
+                       VeAllocTracker::callbacks(AllocScope::Device),
+                       &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+    vkDestroyBuffer(device_, buffer, VeAllocTracker::callbacks(AllocScope::Device));
+    return memRequirements;
+}
+
+// Buffers and images don't know what they are used for, so we guess a category from their usage.
+static MemoryCategory categoryFromBufferUsage(VkBufferUsageFlags usage) {
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+        return MemoryCategory::Geometry;
+    }
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        return MemoryCategory::Uniform;
+    }
+    if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+        return MemoryCategory::Staging;
+    }
+    return MemoryCategory::Other;
+}
+
+static MemoryCategory categoryFromImageUsage(VkImageUsageFlags usage) {
+    if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+        return MemoryCategory::Attachment;
+    }
+    return MemoryCategory::Texture;
+}
+
+VkDeviceMemory VeDevice::allocateMemory(const VkMemoryRequirements &memRequirements,
+                                        VkMemoryPropertyFlags properties,
+                                        MemoryCategory category,
+                                        VkMemoryPropertyFlags preferredProperties) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex =
+        findMemoryType(memRequirements.memoryTypeBits, properties, preferredProperties);
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(device_,
+                         &allocInfo,
+                         VeAllocTracker::callbacks(AllocScope::Device),
+                         &memory) != VK_SUCCESS) {
+        throw std::runtime_error(std::string("failed to allocate ") +
+                                 memoryCategoryName(category) + " memory!");
+    }
+
+    memoryTracker.recordAllocation(
+        memory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category);
+    return memory;
+}
+
+void VeDevice::freeMemory(VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    memoryTracker.recordFree(memory);
+    vkFreeMemory(device_, memory, VeAllocTracker::callbacks(AllocScope::Device));
 }
 
 void VeDevice::createBuffer(VkDeviceSize size,
                             VkBufferUsageFlags usage,
                             VkMemoryPropertyFlags properties,
                             VkBuffer &buffer,
-                            VkDeviceMemory &bufferMemory) {
+                            VkDeviceMemory &bufferMemory,
+                            VkMemoryPropertyFlags preferredProperties) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    if (vkCreateBuffer(device_,
+                       &bufferInfo,
+                       VeAllocTracker::callbacks(AllocScope::Device),
+                       &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer!");
     }
 
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
+    bufferMemory = allocateMemory(
+        memRequirements, properties, categoryFromBufferUsage(usage), preferredProperties);
 
     vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
@@ -468,6 +752,9 @@ void VeDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
     vkQueueWaitIdle(graphicsQueue_);
 
+    // The queue is idle, so take the chance to destroy anything that was waiting on it.
+    deletionQueue_.flushIdle();
+
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
@@ -509,21 +796,18 @@ void VeDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                    VkMemoryPropertyFlags properties,
                                    VkImage &image,
                                    VkDeviceMemory &imageMemory) {
-    if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    if (vkCreateImage(device_,
+                      &imageInfo,
+                      VeAllocTracker::callbacks(AllocScope::Device),
+                      &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
 
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    imageMemory =
+        allocateMemory(memRequirements, properties, categoryFromImageUsage(imageInfo.usage));
 
     if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
         throw std::runtime_error("failed to bind image memory!");
@@ -1,19 +1,33 @@
 #pragma once
 
 // std
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Core/ve_window.hpp"
+#include "Renderer/ve_deletion_queue.hpp"
+#include "Renderer/ve_memory_tracker.hpp"
+#include "Renderer/ve_pipeline_cache.hpp"
 
 namespace ve {
 
+class VeMipGenerator;
+class VePipelineLibrary;
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// VK_KHR_pipeline_executable_properties entry points, null when the extension isn't enabled.
+struct PipelineExecutableFunctions {
+    PFN_vkGetPipelineExecutablePropertiesKHR getProperties = nullptr;
+    PFN_vkGetPipelineExecutableStatisticsKHR getStatistics = nullptr;
+};
+
 struct QueueFamilyIndices {
     uint32_t graphicsFamily{};
     uint32_t presentFamily{};
@@ -33,6 +47,9 @@ class VeDevice {
 #endif
 
     explicit VeDevice(VeWindow &veWindow);
+    // Creates a device without a surface, for rendering offscreen. Nothing can be presented, so
+    // neither a present queue nor the swap chain extension are required.
+    VeDevice();
     ~VeDevice();
 
     // Not copyable or movable
@@ -48,20 +65,68 @@ class VeDevice {
     VkQueue presentQueue() { return presentQueue_; }
     VkInstance getInstance() { return instance; }
     VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
+    [[nodiscard]] bool isHeadless() const { return veWindow == nullptr; }
+    // Errors the validation layers reported so far. Always 0 when they are disabled.
+    [[nodiscard]] uint32_t getValidationErrorCount() const { return validationErrors.load(); }
+    // Objects that may still be referenced by frames in flight are destroyed through this.
+    VeDeletionQueue &deletionQueue() { return deletionQueue_; }
+    // Every pipeline is created through this, so compiled pipelines are kept between runs.
+    VePipelineCache &pipelineCache() { return *pipelineCache_; }
+    // Shared shader modules, and pipelines compiled in the background.
+    VePipelineLibrary &pipelineLibrary() { return *pipelineLibrary_; }
+    // Fills texture mip chains on the GPU. Created the first time it is needed.
+    VeMipGenerator &mipGenerator();
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    // Returns the memory type matching typeFilter with all the required properties. Among those,
+    // the type with the most preferred properties wins.
+    uint32_t findMemoryType(uint32_t typeFilter,
+                            VkMemoryPropertyFlags properties,
+                            VkMemoryPropertyFlags preferredProperties = 0) const;
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
     VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates,
                                  VkImageTiling tiling,
                                  VkFormatFeatureFlags features);
 
+    // Memory helper functions. All device memory should be allocated and freed through these so
+    // that it shows up in the memory budget.
+    VkDeviceMemory allocateMemory(const VkMemoryRequirements &memRequirements,
+                                  VkMemoryPropertyFlags properties,
+                                  MemoryCategory category,
+                                  VkMemoryPropertyFlags preferredProperties = 0);
+    void freeMemory(VkDeviceMemory memory);
+    // Whether a buffer with these requirements can live in memory that is both device local and
+    // host visible (resizable BAR or unified memory) and fits its budget, so it can be written
+    // directly instead of via staging.
+    [[nodiscard]] bool supportsDirectWrite(const VkMemoryRequirements &memRequirements) const;
+    // Requirements of a buffer created with the given size and usage, without allocating one.
+    [[nodiscard]] VkMemoryRequirements getBufferMemoryRequirements(VkDeviceSize size,
+                                                                   VkBufferUsageFlags usage);
+    [[nodiscard]] std::vector<MemoryHeapBudget> getMemoryBudget() const {
+        return memoryTracker.queryBudget();
+    }
+    [[nodiscard]] const VeMemoryTracker &getMemoryTracker() const { return memoryTracker; }
+
+    // Optional features which were enabled because the device supports them.
+    [[nodiscard]] const VkPhysicalDeviceFeatures &getEnabledFeatures() const {
+        return enabledFeatures;
+    }
+    // vkCmdDrawIndexedIndirectCountKHR, or nullptr if VK_KHR_draw_indirect_count isn't supported.
+    [[nodiscard]] PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount() const {
+        return cmdDrawIndexedIndirectCount;
+    }
+    // Pipelines are created with their statistics captured when the functions are available.
+    [[nodiscard]] const PipelineExecutableFunctions &pipelineExecutableFunctions() const {
+        return executableFunctions;
+    }
+
     // Buffer helper functions
     void createBuffer(VkDeviceSize size,
                       VkBufferUsageFlags usage,
                       VkMemoryPropertyFlags properties,
                       VkBuffer &buffer,
-                      VkDeviceMemory &bufferMemory);
+                      VkDeviceMemory &bufferMemory,
+                      VkMemoryPropertyFlags preferredProperties = 0);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -81,7 +146,17 @@ class VeDevice {
    public:
     VkPhysicalDeviceProperties properties{};
 
+    // Memory properties a buffer needs for the direct write path.
+    static constexpr VkMemoryPropertyFlags DIRECT_WRITE_MEMORY_PROPERTIES =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    // Without resizable BAR the host visible device local heap is small (usually 256 MiB), so a
+    // single direct write allocation may only take up this fraction of its remaining budget.
+    static constexpr VkDeviceSize DIRECT_WRITE_BUDGET_DIVISOR = 4;
+
    private:
+    explicit VeDevice(VeWindow *window);
+
     void createInstance();
     void setupDebugMessenger();
     void createSurface();
@@ -92,18 +167,23 @@ class VeDevice {
     // Helper functions.
     bool isDeviceSuitable(VkPhysicalDevice device);
     [[nodiscard]] std::vector<const char *> getRequiredExtensions() const;
+    [[nodiscard]] std::vector<const char *> getRequiredDeviceExtensions() const;
     bool checkValidationLayerSupport();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
-    static void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
+    void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
     void hasGflwRequiredInstanceExtensions();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    static bool isInstanceExtensionAvailable(const char *extensionName);
+    static bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
    private:
     VkInstance instance = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
+    // Counted by the debug messenger, which may be called from any thread.
+    std::atomic<uint32_t> validationErrors{0};
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    VeWindow &veWindow;
+    VeWindow *veWindow;  // Null when headless.
     VkCommandPool commandPool{};  // Command buffers are allocated from this memory.
 
     VkDevice device_ = VK_NULL_HANDLE;
@@ -111,6 +191,19 @@ class VeDevice {
     VkQueue graphicsQueue_ = VK_NULL_HANDLE;
     VkQueue presentQueue_ = VK_NULL_HANDLE;
 
+    VeMemoryTracker memoryTracker;
+    VeDeletionQueue deletionQueue_;
+    std::unique_ptr<VePipelineCache> pipelineCache_;
+    std::unique_ptr<VePipelineLibrary> pipelineLibrary_;
+    std::unique_ptr<VeMipGenerator> mipGenerator_;
+    bool hasPhysicalDeviceProperties2 = false;  // VK_KHR_get_physical_device_properties2
+    bool hasMemoryBudget = false;               // VK_EXT_memory_budget
+    VkPhysicalDeviceFeatures enabledFeatures{};
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+    bool hasCreationFeedback = false;      // VK_EXT_pipeline_creation_feedback
+    bool hasExecutableProperties = false;  // VK_KHR_pipeline_executable_properties
+    PipelineExecutableFunctions executableFunctions{};
+
     const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
@@ -0,0 +1,93 @@
+#include "ve_draw_packets.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace ve {
+
+uint64_t DrawPacket::makeKey(
+    uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+    assert(pass < (1u << PASS_BITS) && "Pass id doesn't fit the draw key");
+    assert(pipeline < (1u << PIPELINE_BITS) && "Pipeline id doesn't fit the draw key");
+    assert(material < (1u << MATERIAL_BITS) && "Material id doesn't fit the draw key");
+    assert(mesh < (1u << MESH_BITS) && "Mesh id doesn't fit the draw key");
+    return static_cast<uint64_t>(pass) << PASS_SHIFT |
+           static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT |
+           static_cast<uint64_t>(material) << MATERIAL_SHIFT |
+           static_cast<uint64_t>(mesh) << MESH_SHIFT |
+           static_cast<uint64_t>(quantizeDepth(depth)) << DEPTH_SHIFT;
+}
+
+uint32_t DrawPacket::quantizeDepth(float depth) {
+    // Objects behind the camera can still be visible if their bounds straddle it.
+    if (!(depth > 0.f)) {
+        return 0;
+    }
+    // Bits of positive floats sort like the floats themselves. The sign bit is always zero here,
+    // so the top DEPTH_BITS of the remaining 31 bits keep the order.
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (31 - DEPTH_BITS);
+}
+
+void radixSortPackets(std::vector<DrawPacket> &packets, std::vector<DrawPacket> &scratch) {
+    constexpr int DIGITS = 8;
+    constexpr int RADIX = 256;
+
+    size_t count = packets.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    // Histograms of every digit in a single pass over the keys.
+    std::array<std::array<uint32_t, RADIX>, DIGITS> histograms{};
+    for (const auto &packet : packets) {
+        for (int digit = 0; digit < DIGITS; digit++) {
+            histograms[digit][(packet.key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    DrawPacket *source = packets.data();
+    DrawPacket *destination = scratch.data();
+    for (int digit = 0; digit < DIGITS; digit++) {
+        auto &histogram = histograms[digit];
+
+        // When every key has the same digit this pass wouldn't move anything.
+        if (histogram[(source[0].key >> (digit * 8)) & 0xff] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (auto &bucket : histogram) {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            destination[histogram[(source[i].key >> (digit * 8)) & 0xff]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != packets.data()) {
+        packets.swap(scratch);
+    }
+}
+
+StateChanges countStateChanges(const std::vector<DrawPacket> &packets) {
+    StateChanges changes{};
+    for (size_t i = 0; i < packets.size(); i++) {
+        const auto &packet = packets[i];
+        bool first = i == 0;
+        changes.pipelines += first || packet.pipeline() != packets[i - 1].pipeline() ? 1 : 0;
+        changes.materials += first || packet.material() != packets[i - 1].material() ? 1 : 0;
+        changes.meshes += first || packet.mesh() != packets[i - 1].mesh() ? 1 : 0;
+    }
+    return changes;
+}
+
+}  // namespace ve
@@ -0,0 +1,78 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ve {
+
+// A draw waiting to be submitted. The key decides submission order, the index points back at
+// whatever the render system needs to record the draw.
+//
+// Key layout, most significant bits first, so sorting groups draws by the most expensive state:
+//   pass (4) | pipeline (8) | material (16) | mesh (16) | depth (20)
+struct DrawPacket {
+    static constexpr uint32_t PASS_BITS = 4;
+    static constexpr uint32_t PIPELINE_BITS = 8;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t MESH_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS = 20;
+
+    static constexpr uint32_t DEPTH_SHIFT = 0;
+    static constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    static constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+    static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+    static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+    static_assert(PASS_SHIFT + PASS_BITS == 64, "Draw key fields must fill 64 bits");
+
+    // Packs the fields into a key. Ids must fit their field, depth is a view space distance.
+    static uint64_t makeKey(
+        uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+    // Maps a non-negative distance to DEPTH_BITS while keeping its order. Uses the top bits of the
+    // float, so precision is relative to the distance like a floating point depth buffer.
+    static uint32_t quantizeDepth(float depth);
+
+    [[nodiscard]] uint32_t pipeline() const { return field(PIPELINE_SHIFT, PIPELINE_BITS); }
+    [[nodiscard]] uint32_t material() const { return field(MATERIAL_SHIFT, MATERIAL_BITS); }
+    [[nodiscard]] uint32_t mesh() const { return field(MESH_SHIFT, MESH_BITS); }
+
+    uint64_t key;
+    uint32_t index;
+
+   private:
+    [[nodiscard]] uint32_t field(uint32_t shift, uint32_t bits) const {
+        return static_cast<uint32_t>((key >> shift) & ((uint64_t{1} << bits) - 1));
+    }
+};
+
+// Number of times each kind of state had to be bound by a sequence of packets.
+struct StateChanges {
+    uint32_t pipelines{0};
+    uint32_t materials{0};
+    uint32_t meshes{0};
+
+    [[nodiscard]] uint32_t total() const { return pipelines + materials + meshes; }
+};
+
+// Per frame submission counters, state changes are reported for the order packets were emitted
+// in and for the order they were submitted in.
+struct SubmissionStats {
+    uint32_t packets{0};
+    uint32_t drawCalls{0};
+    StateChanges unsorted{};
+    StateChanges sorted{};
+    // CPU time spent recording the draws and how many threads shared it.
+    float recordMilliseconds{0.f};
+    uint32_t recordThreads{1};
+};
+
+// Sorts packets by key with an LSD radix sort over 8 bit digits. Digits every key shares are
+// skipped. scratch is resized as needed and should be kept around between frames.
+void radixSortPackets(std::vector<DrawPacket> &packets, std::vector<DrawPacket> &scratch);
+
+// Counts the binds needed to submit packets in the given order, skipping redundant ones.
+StateChanges countStateChanges(const std::vector<DrawPacket> &packets);
+
+}  // namespace ve
@@ -0,0 +1,223 @@
+#include "ve_gpu_profiler.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+uint32_t timestampValidBits(VeDevice &device) {
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        device.getPhysicalDevice(), &familyCount, families.data());
+    return families[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+}
+
+}  // namespace
+
+VeGpuProfiler::Scope::Scope(VeGpuProfiler *profiler,
+                            VkCommandBuffer commandBuffer,
+                            const char *name)
+    : profiler{profiler}, commandBuffer{commandBuffer}, scope{UINT32_MAX} {
+    if (profiler != nullptr) {
+        scope = profiler->beginScope(commandBuffer, name);
+    }
+}
+
+VeGpuProfiler::Scope::~Scope() {
+    if (profiler != nullptr) {
+        profiler->endScope(commandBuffer, scope);
+    }
+}
+
+VeGpuProfiler::VeGpuProfiler(VeDevice &device) : veDevice{device} {
+    uint32_t validBits = timestampValidBits(veDevice);
+    validMask = validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+    nanosecondsPerTick = static_cast<double>(veDevice.properties.limits.timestampPeriod);
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * MAX_SCOPES;
+    for (auto &pending : pendingFrames) {
+        if (vkCreateQueryPool(veDevice.device(),
+                              &poolInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &pending.queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        pending.scopes.reserve(MAX_SCOPES);
+    }
+
+    // Everything a frame needs is allocated up front, so profiling doesn't allocate per frame.
+    openScopes.reserve(MAX_SCOPES);
+    timestamps.resize(2 * MAX_SCOPES);
+    history.resize(HISTORY);
+    for (auto &frame : history) {
+        frame.zones.reserve(MAX_SCOPES);
+    }
+}
+
+VeGpuProfiler::~VeGpuProfiler() {
+    for (auto &pending : pendingFrames) {
+        vkDestroyQueryPool(
+            veDevice.device(), pending.queryPool, VeAllocTracker::callbacks(AllocScope::Device));
+    }
+}
+
+bool VeGpuProfiler::isSupported(VeDevice &device) {
+    return device.properties.limits.timestampPeriod > 0.f && timestampValidBits(device) > 0;
+}
+
+void VeGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+    assert(recording == nullptr && "Can't begin a profiled frame while one is in progress!");
+
+    PendingFrame &pending = pendingFrames[frameIndex];
+    readBack(pending);
+
+    pending.number = framesBegun++;
+    pending.cpuMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    pending.scopes.clear();
+    recording = &pending;
+    vkCmdResetQueryPool(commandBuffer, pending.queryPool, 0, 2 * MAX_SCOPES);
+    beginScope(commandBuffer, "frame");
+}
+
+void VeGpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+    assert(recording != nullptr && "Can't end a profiled frame that hasn't begun!");
+    assert(openScopes.size() == 1 && "Scopes are still open at the end of the frame!");
+
+    while (!openScopes.empty()) {
+        endScope(commandBuffer, openScopes.back());
+    }
+    recording->issued = true;
+    recording = nullptr;
+}
+
+void VeGpuProfiler::flush() {
+    // Oldest first, so the history stays in order.
+    std::array<PendingFrame *, VeSwapChain::MAX_FRAMES_IN_FLIGHT> inFlight{};
+    for (size_t i = 0; i < pendingFrames.size(); i++) {
+        inFlight[i] = &pendingFrames[i];
+    }
+    std::sort(inFlight.begin(), inFlight.end(), [](const PendingFrame *a, const PendingFrame *b) {
+        return a->number < b->number;
+    });
+    for (PendingFrame *pending : inFlight) {
+        readBack(*pending);
+    }
+}
+
+uint32_t VeGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char *name) {
+    if (recording == nullptr || recording->scopes.size() == MAX_SCOPES) {
+        return UINT32_MAX;
+    }
+
+    auto scope = static_cast<uint32_t>(recording->scopes.size());
+    recording->scopes.push_back({intern(name), static_cast<uint32_t>(openScopes.size())});
+    openScopes.push_back(scope);
+    vkCmdWriteTimestamp(
+        commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, recording->queryPool, 2 * scope);
+    return scope;
+}
+
+void VeGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (recording == nullptr || scope == UINT32_MAX) {
+        return;
+    }
+    assert(openScopes.back() == scope && "Scopes must be closed in the reverse order they opened!");
+
+    openScopes.pop_back();
+    vkCmdWriteTimestamp(
+        commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, recording->queryPool, 2 * scope + 1);
+}
+
+void VeGpuProfiler::readBack(PendingFrame &pending) {
+    if (!pending.issued) {
+        return;
+    }
+    pending.issued = false;
+
+    // The fence guarantees the queries finished, but don't wait if the driver disagrees.
+    auto queryCount = static_cast<uint32_t>(2 * pending.scopes.size());
+    if (vkGetQueryPoolResults(veDevice.device(),
+                              pending.queryPool,
+                              0,
+                              queryCount,
+                              queryCount * sizeof(uint64_t),
+                              timestamps.data(),
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+
+    // Reuse the oldest frame once the history is full.
+    if (historyCount == HISTORY) {
+        historyStart = (historyStart + 1) % HISTORY;
+        historyCount--;
+    }
+    Frame &frame = history[(historyStart + historyCount) % HISTORY];
+    historyCount++;
+
+    auto toMilliseconds = [&](uint64_t timestamp) {
+        uint64_t ticks = (timestamp - timestamps[0]) & validMask;
+        return static_cast<double>(ticks) * nanosecondsPerTick * 1e-6;
+    };
+    frame.number = pending.number;
+    frame.cpuMicros = pending.cpuMicros;
+    frame.zones.clear();
+    for (size_t i = 0; i < pending.scopes.size(); i++) {
+        frame.zones.push_back({pending.scopes[i].name,
+                               pending.scopes[i].depth,
+                               toMilliseconds(timestamps[2 * i]),
+                               toMilliseconds(timestamps[2 * i + 1])});
+    }
+    frame.milliseconds = frame.zones.empty() ? 0.0 : frame.zones[0].end;
+}
+
+uint32_t VeGpuProfiler::intern(const char *name) {
+    // A few dozen distinct names at most, a linear search doesn't allocate.
+    for (size_t i = 0; i < names.size(); i++) {
+        if (std::strcmp(names[i].c_str(), name) == 0) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    names.emplace_back(name);
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+void VeGpuProfiler::writeTrace(std::ostream &out) const {
+    out << "{\"traceEvents\": [\n";
+    writeTraceEvents(out);
+    out << "\n]}\n";
+}
+
+void VeGpuProfiler::writeTraceEvents(std::ostream &out) const {
+    // Names are written as they are, they come from code rather than user input. Timestamps are
+    // microseconds since the clock's epoch, too large for the default precision.
+    out << std::fixed << std::setprecision(3);
+    out << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "GPU"}})";
+    for (size_t i = 0; i < historyCount; i++) {
+        const Frame &frame = getFrame(i);
+        for (const Zone &zone : frame.zones) {
+            out << ",\n{\"name\": \"" << names[zone.name]
+                << R"(", "cat": "gpu", "ph": "X", "pid": 1, "tid": 0, "ts": )"
+                << static_cast<double>(frame.cpuMicros) + zone.start * 1000.0
+                << ", \"dur\": " << (zone.end - zone.start) * 1000.0 << "}";
+        }
+    }
+}
+
+}  // namespace ve
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Times GPU work with timestamp queries, in scopes that nest.
+//
+// Every frame in flight has a query pool of its own. A frame's timestamps are read back when its
+// index comes around again, after its fence has been waited on, so reading never stalls and
+// results lag MAX_FRAMES_IN_FLIGHT frames. Scopes must be recorded on the thread recording the
+// frame, into command buffers that execute in the order the scopes were opened.
+class VeGpuProfiler {
+   public:
+    // Scopes per frame, including the frame itself. Scopes beyond it aren't timed.
+    static constexpr uint32_t MAX_SCOPES = 128;
+    // Finished frames kept for the UI and traces.
+    static constexpr size_t HISTORY = 240;
+
+    // A scope of a finished frame, in milliseconds since the frame started.
+    struct Zone {
+        uint32_t name;  // See getName().
+        uint32_t depth;
+        double start;
+        double end;
+    };
+
+    struct Frame {
+        uint64_t number{0};  // Frames begun before this one.
+        int64_t cpuMicros{0};  // steady_clock time the frame was recorded at.
+        double milliseconds{0.0};
+        std::vector<Zone> zones;  // In the order they were opened, the frame itself first.
+    };
+
+    // Times the commands recorded into commandBuffer during its lifetime. Does nothing when
+    // profiler is null, so call sites don't need to check.
+    class Scope {
+       public:
+        Scope(VeGpuProfiler *profiler, VkCommandBuffer commandBuffer, const char *name);
+        ~Scope();
+
+        // Remove copy constructors.
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+       private:
+        VeGpuProfiler *profiler;
+        VkCommandBuffer commandBuffer;
+        uint32_t scope;
+    };
+
+    explicit VeGpuProfiler(VeDevice &device);
+    ~VeGpuProfiler();
+
+    // Remove copy constructors.
+    VeGpuProfiler(const VeGpuProfiler &) = delete;
+    VeGpuProfiler &operator=(const VeGpuProfiler &) = delete;
+
+    // Needs timestamps on the graphics queue.
+    static bool isSupported(VeDevice &device);
+
+    // Reads back the frame that last used frameIndex and opens this frame's scope. Recorded first
+    // in the frame's command buffer, after its fence has been waited on.
+    void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+    // Closes the frame's scope, recorded last in its command buffer.
+    void endFrame(VkCommandBuffer commandBuffer);
+    // Reads back the frames still in flight. Only once the device is idle.
+    void flush();
+
+    // Finished frames, oldest first. The newest is the last one read back.
+    [[nodiscard]] size_t getFrameCount() const { return historyCount; }
+    [[nodiscard]] const Frame &getFrame(size_t i) const {
+        return history[(historyStart + i) % HISTORY];
+    }
+    [[nodiscard]] const std::string &getName(uint32_t name) const { return names[name]; }
+
+    // Writes the finished frames as a Chrome trace_event document.
+    void writeTrace(std::ostream &out) const;
+    // Writes them as comma separated trace events only, to merge with other traces. Frames are
+    // placed at the steady_clock time they were recorded at, the GPU being a process of its own.
+    void writeTraceEvents(std::ostream &out) const;
+
+   private:
+    struct PendingScope {
+        uint32_t name;
+        uint32_t depth;
+    };
+    // Scopes of a frame whose timestamps haven't been read back yet. Scope i writes queries 2i
+    // and 2i + 1.
+    struct PendingFrame {
+        VkQueryPool queryPool{VK_NULL_HANDLE};
+        bool issued{false};
+        uint64_t number{0};
+        int64_t cpuMicros{0};
+        std::vector<PendingScope> scopes;
+    };
+
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char *name);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+    void readBack(PendingFrame &pending);
+    uint32_t intern(const char *name);
+
+    VeDevice &veDevice;
+    uint64_t validMask{0};  // Timestamps only have timestampValidBits bits.
+    double nanosecondsPerTick{1.0};
+
+    std::array<PendingFrame, VeSwapChain::MAX_FRAMES_IN_FLIGHT> pendingFrames{};
+    PendingFrame *recording{nullptr};
+    std::vector<uint32_t> openScopes;
+    std::vector<uint64_t> timestamps;
+    uint64_t framesBegun{0};
+
+    std::vector<std::string> names;
+    std::vector<Frame> history;
+    size_t historyStart{0};
+    size_t historyCount{0};
+};
+
+}  // namespace ve
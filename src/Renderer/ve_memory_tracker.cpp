@@ -0,0 +1,89 @@
+#include "ve_memory_tracker.hpp"
+
+// std
+#include <cassert>
+
+namespace ve {
+
+const char *memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Geometry:
+            return "Geometry";
+        case MemoryCategory::Texture:
+            return "Textures";
+        case MemoryCategory::Attachment:
+            return "Attachments";
+        case MemoryCategory::Staging:
+            return "Staging";
+        case MemoryCategory::Uniform:
+            return "Uniform";
+        case MemoryCategory::Other:
+            return "Other";
+    }
+    return "Unknown";
+}
+
+void VeMemoryTracker::init(VkPhysicalDevice device,
+                           PFN_vkGetPhysicalDeviceMemoryProperties2KHR getProperties2) {
+    physicalDevice = device;
+    getMemoryProperties2 = getProperties2;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+}
+
+void VeMemoryTracker::recordAllocation(VkDeviceMemory memory,
+                                       VkDeviceSize size,
+                                       uint32_t memoryTypeIndex,
+                                       MemoryCategory category) {
+    assert(memoryTypeIndex < memProperties.memoryTypeCount && "Invalid memory type index");
+    uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+    allocations[memory] = {size, heapIndex, category};
+    heapBytes[heapIndex] += size;
+    categoryBytes[static_cast<size_t>(category)] += size;
+}
+
+void VeMemoryTracker::recordFree(VkDeviceMemory memory) {
+    auto it = allocations.find(memory);
+    if (it == allocations.end()) {
+        return;
+    }
+
+    heapBytes[it->second.heapIndex] -= it->second.size;
+    categoryBytes[static_cast<size_t>(it->second.category)] -= it->second.size;
+    allocations.erase(it);
+}
+
+std::vector<MemoryHeapBudget> VeMemoryTracker::queryBudget() const {
+    std::vector<MemoryHeapBudget> heaps(memProperties.memoryHeapCount);
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if (getMemoryProperties2 != nullptr) {
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        getMemoryProperties2(physicalDevice, &properties2);
+    }
+
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+        auto &heap = heaps[i];
+        heap.size = memProperties.memoryHeaps[i].size;
+        heap.deviceLocal =
+            (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.tracked = heapBytes[i];
+
+        if (getMemoryProperties2 != nullptr) {
+            heap.budget = budgetProperties.heapBudget[i];
+            heap.usage = budgetProperties.heapUsage[i];
+        } else {
+            // Software fallback: we only know about what we allocated ourselves.
+            heap.budget = static_cast<VkDeviceSize>(static_cast<double>(heap.size) *
+                                                    FALLBACK_BUDGET_FRACTION);
+            heap.usage = heap.tracked;
+        }
+    }
+
+    return heaps;
+}
+
+}  // namespace ve
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace ve {
+
+// What a device memory allocation is used for. Used purely for accounting purposes.
+enum class MemoryCategory { Geometry, Texture, Attachment, Staging, Uniform, Other };
+constexpr size_t MEMORY_CATEGORY_COUNT = 6;
+
+const char *memoryCategoryName(MemoryCategory category);
+
+// Snapshot of a single memory heap.
+struct MemoryHeapBudget {
+    VkDeviceSize size{0};     // Total size of the heap.
+    VkDeviceSize budget{0};   // How much we can allocate from the heap before running into trouble.
+    VkDeviceSize usage{0};    // How much of the heap our process is using.
+    VkDeviceSize tracked{0};  // How much of the heap the engine has allocated itself.
+    bool deviceLocal{false};
+};
+
+// Keeps track of every VkDeviceMemory the engine allocates, broken down per heap and per
+// category. When VK_EXT_memory_budget is available the driver reported budget and usage are
+// used, otherwise we fall back to our own bookkeeping and a conservative budget estimate.
+class VeMemoryTracker {
+   public:
+    // Fraction of a heap we assume to be usable when the driver can't tell us.
+    static constexpr double FALLBACK_BUDGET_FRACTION = 0.8;
+
+    void init(VkPhysicalDevice physicalDevice,
+              PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2);
+
+    void recordAllocation(VkDeviceMemory memory,
+                          VkDeviceSize size,
+                          uint32_t memoryTypeIndex,
+                          MemoryCategory category);
+    void recordFree(VkDeviceMemory memory);
+
+    [[nodiscard]] std::vector<MemoryHeapBudget> queryBudget() const;
+    [[nodiscard]] VkDeviceSize categoryUsage(MemoryCategory category) const {
+        return categoryBytes[static_cast<size_t>(category)];
+    }
+    [[nodiscard]] size_t allocationCount() const { return allocations.size(); }
+    [[nodiscard]] bool usingBudgetExtension() const { return getMemoryProperties2 != nullptr; }
+    [[nodiscard]] const VkPhysicalDeviceMemoryProperties &memoryProperties() const {
+        return memProperties;
+    }
+
+   private:
+    struct Allocation {
+        VkDeviceSize size;
+        uint32_t heapIndex;
+        MemoryCategory category;
+    };
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+    VkPhysicalDeviceMemoryProperties memProperties{};
+
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapBytes{};
+    std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes{};
+};
+
+}  // namespace ve
@@ -0,0 +1,316 @@
+#include "ve_mip_generator.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+constexpr uint32_t GROUP_SIZE = 8;  // Must match local_size_x and local_size_y in the shader.
+// The storage image format the shader writes, declared as rgba8.
+constexpr VkFormat COMPUTE_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+bool hasFormatFeatures(VeDevice &device, VkFormat format, VkFormatFeatureFlags features) {
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &properties);
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+}  // namespace
+
+VeMipGenerator::VeMipGenerator(VeDevice &device) : veDevice{device} {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    // The shader only fetches texels.
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(veDevice.device(),
+                        &samplerInfo,
+                        VeAllocTracker::callbacks(AllocScope::Device),
+                        &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mip generator sampler!");
+    }
+
+    // A set per level written, reset after every image.
+    descriptorPool = VeDescriptorPool::Builder(veDevice)
+                         .setMaxSets(MAX_LEVELS)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_LEVELS)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_LEVELS)
+                         .build();
+    setLayout = VeDescriptorSetLayout::Builder(veDevice)
+                    .addBinding(0,
+                                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Previous level
+                    .addBinding(1,
+                                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                VK_SHADER_STAGE_COMPUTE_BIT)  // Level written
+                    .build();
+
+    VkDescriptorSetLayout layout = setLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &layout;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &layoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    pipeline = std::make_unique<VeComputePipeline>(
+        veDevice, "../assets/shaders/mip_downsample.comp.spv", pipelineLayout);
+}
+
+VeMipGenerator::~VeMipGenerator() {
+    vkDestroySampler(veDevice.device(), sampler, VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+uint32_t VeMipGenerator::levelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+bool VeMipGenerator::supportsCompute(VeDevice &device, VkFormat format) {
+    return format == COMPUTE_FORMAT &&
+           hasFormatFeatures(device,
+                             format,
+                             VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                 VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+VkImageUsageFlags VeMipGenerator::requiredUsage(VeDevice &device, VkFormat format) {
+    if (supportsCompute(device, format)) {
+        return VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+    if (hasFormatFeatures(device,
+                          format,
+                          VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+        return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    return 0;
+}
+
+void VeMipGenerator::generate(VkImage image,
+                              VkFormat format,
+                              VkExtent2D extent,
+                              uint32_t levelCount) {
+    assert(levelCount <= MAX_LEVELS && "Too many mip levels for the mip generator");
+
+    if (levelCount == 1) {
+        VkCommandBuffer commandBuffer = veDevice.beginSingleTimeCommands();
+        VeComputePipeline::imageBarrier(commandBuffer,
+                                        image,
+                                        0,
+                                        1,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                        VK_ACCESS_SHADER_READ_BIT);
+        veDevice.endSingleTimeCommands(commandBuffer);
+        return;
+    }
+    assert(requiredUsage(veDevice, format) != 0 && "Mips can't be generated for the format");
+    if (!supportsCompute(veDevice, format)) {
+        VkCommandBuffer commandBuffer = veDevice.beginSingleTimeCommands();
+        recordBlits(commandBuffer, image, extent, levelCount);
+        veDevice.endSingleTimeCommands(commandBuffer);
+        return;
+    }
+
+    // A view per level, each read by the dispatch after the one writing it.
+    std::array<VkImageView, MAX_LEVELS> levelViews{};
+    for (uint32_t level = 0; level < levelCount; level++) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create mip level view!");
+        }
+    }
+
+    VkCommandBuffer commandBuffer = veDevice.beginSingleTimeCommands();
+    recordCompute(commandBuffer, image, extent, levelCount, levelViews.data());
+    veDevice.endSingleTimeCommands(commandBuffer);
+
+    // The queue is idle again, so the views and sets can go.
+    for (uint32_t level = 0; level < levelCount; level++) {
+        vkDestroyImageView(veDevice.device(),
+                           levelViews[level],
+                           VeAllocTracker::callbacks(AllocScope::Device));
+    }
+    descriptorPool->resetPool();
+}
+
+void VeMipGenerator::recordCompute(VkCommandBuffer commandBuffer,
+                                   VkImage image,
+                                   VkExtent2D extent,
+                                   uint32_t levelCount,
+                                   const VkImageView *levelViews) {
+    // Level 0 was just uploaded. The others are written as storage images, and every level is
+    // moved to shader reads once written, since the next level samples it.
+    VeComputePipeline::imageBarrier(
+        commandBuffer,
+        image,
+        0,
+        1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT);
+    VeComputePipeline::imageBarrier(commandBuffer,
+                                    image,
+                                    1,
+                                    levelCount - 1,
+                                    VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_GENERAL,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                    0,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                    VK_ACCESS_SHADER_WRITE_BIT);
+
+    pipeline->bind(commandBuffer);
+    for (uint32_t level = 1; level < levelCount; level++) {
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = sampler;
+        sourceInfo.imageView = levelViews[level - 1];
+        sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView = levelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorSet set{};
+        if (!VeDescriptorWriter(*setLayout, *descriptorPool)
+                 .writeImage(0, &sourceInfo)
+                 .writeImage(1, &destinationInfo)
+                 .build(set)) {
+            throw std::runtime_error("failed to allocate mip generator descriptor set!");
+        }
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipelineLayout,
+                                0,
+                                1,
+                                &set,
+                                0,
+                                nullptr);
+        uint32_t width = std::max(extent.width >> level, 1u);
+        uint32_t height = std::max(extent.height >> level, 1u);
+        vkCmdDispatch(commandBuffer,
+                      VeComputePipeline::groupCount(width, GROUP_SIZE),
+                      VeComputePipeline::groupCount(height, GROUP_SIZE),
+                      1);
+
+        // Read by the next dispatch, and by fragment shaders once the texture is in use.
+        VeComputePipeline::imageBarrier(
+            commandBuffer,
+            image,
+            level,
+            1,
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT);
+    }
+}
+
+void VeMipGenerator::recordBlits(VkCommandBuffer commandBuffer,
+                                 VkImage image,
+                                 VkExtent2D extent,
+                                 uint32_t levelCount) {
+    // Every level is a blit destination first and then the source of the next one.
+    VeComputePipeline::imageBarrier(commandBuffer,
+                                    image,
+                                    1,
+                                    levelCount - 1,
+                                    VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                    0,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_ACCESS_TRANSFER_WRITE_BIT);
+    for (uint32_t level = 1; level < levelCount; level++) {
+        VeComputePipeline::imageBarrier(commandBuffer,
+                                        image,
+                                        level - 1,
+                                        1,
+                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_ACCESS_TRANSFER_READ_BIT);
+
+        VkImageBlit blit{};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[1] = {static_cast<int32_t>(std::max(extent.width >> (level - 1), 1u)),
+                              static_cast<int32_t>(std::max(extent.height >> (level - 1), 1u)),
+                              1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[1] = {static_cast<int32_t>(std::max(extent.width >> level, 1u)),
+                              static_cast<int32_t>(std::max(extent.height >> level, 1u)),
+                              1};
+        vkCmdBlitImage(commandBuffer,
+                       image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1,
+                       &blit,
+                       VK_FILTER_LINEAR);
+
+        VeComputePipeline::imageBarrier(commandBuffer,
+                                        image,
+                                        level - 1,
+                                        1,
+                                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                        VK_ACCESS_TRANSFER_READ_BIT,
+                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                        VK_ACCESS_SHADER_READ_BIT);
+    }
+    // The last level was never a source.
+    VeComputePipeline::imageBarrier(commandBuffer,
+                                    image,
+                                    levelCount - 1,
+                                    1,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                    VK_ACCESS_SHADER_READ_BIT);
+}
+
+}  // namespace ve
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ve_compute_pipeline.hpp"
+#include "ve_descriptors.hpp"
+#include "ve_device.hpp"
+
+// std
+#include <memory>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Fills the mip chain of a 2D image from its first level.
+//
+// Each level is a 2x2 box filter of the one before it, written by a compute shader that fetches
+// the previous level's texels. When a level has an odd size, the texels at its far edge average 3
+// texels across, so none are skipped. The shader writes levels as storage images, which most
+// devices don't allow for sRGB formats, so images of those are downsampled with linear blits
+// instead.
+class VeMipGenerator {
+   public:
+    // Enough for a 65536 texel wide image.
+    static constexpr uint32_t MAX_LEVELS = 16;
+
+    explicit VeMipGenerator(VeDevice &device);
+    ~VeMipGenerator();
+
+    // Remove copy constructors.
+    VeMipGenerator(const VeMipGenerator &) = delete;
+    VeMipGenerator &operator=(const VeMipGenerator &) = delete;
+
+    // Levels of a full mip chain, down to a single texel.
+    static uint32_t levelCount(uint32_t width, uint32_t height);
+    // Usage an image of the given format needs on top of its own for generate(). Mips can't be
+    // generated at all when this returns 0, then the image should only have one level.
+    static VkImageUsageFlags requiredUsage(VeDevice &device, VkFormat format);
+
+    // Writes levels [1, levelCount) from level 0, which has to be in
+    // VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL. Leaves every level in
+    // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ready for fragment shaders. Blocks until done.
+    void generate(VkImage image, VkFormat format, VkExtent2D extent, uint32_t levelCount);
+
+   private:
+    static bool supportsCompute(VeDevice &device, VkFormat format);
+    void recordCompute(VkCommandBuffer commandBuffer,
+                       VkImage image,
+                       VkExtent2D extent,
+                       uint32_t levelCount,
+                       const VkImageView *levelViews);
+    void recordBlits(VkCommandBuffer commandBuffer,
+                     VkImage image,
+                     VkExtent2D extent,
+                     uint32_t levelCount);
+
+    VeDevice &veDevice;
+    VkSampler sampler{VK_NULL_HANDLE};
+    std::unique_ptr<VeDescriptorPool> descriptorPool{};
+    std::unique_ptr<VeDescriptorSetLayout> setLayout{};
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    std::unique_ptr<VeComputePipeline> pipeline;
+};
+
+}  // namespace ve
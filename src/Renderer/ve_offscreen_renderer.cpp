@@ -0,0 +1,182 @@
+#include "ve_offscreen_renderer.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <limits>
+#include <stdexcept>
+
+namespace ve {
+
+VeOffscreenRenderer::VeOffscreenRenderer(VeDevice &device, VkExtent2D extent)
+    : veDevice{device}, extent{extent} {
+    createTargets();
+    createCommandBuffers();
+    createSyncObjects();
+}
+
+VeOffscreenRenderer::~VeOffscreenRenderer() {
+    // Frames still in flight may be rendering to the images.
+    vkWaitForFences(veDevice.device(),
+                    static_cast<uint32_t>(inFlightFences.size()),
+                    inFlightFences.data(),
+                    VK_TRUE,
+                    std::numeric_limits<uint64_t>::max());
+
+    for (auto fence : inFlightFences) {
+        vkDestroyFence(veDevice.device(), fence, VeAllocTracker::callbacks(AllocScope::Device));
+    }
+    vkFreeCommandBuffers(veDevice.device(),
+                         veDevice.getCommandPool(),
+                         static_cast<uint32_t>(commandBuffers.size()),
+                         commandBuffers.data());
+    for (auto &target : targets) {
+        destroyImage(target.color);
+        destroyImage(target.depth);
+    }
+}
+
+VkCommandBuffer VeOffscreenRenderer::beginFrame() {
+    assert(!isFrameStarted && "Can't call beginFrame while frame already in progress!");
+
+    vkWaitForFences(veDevice.device(),
+                    1,
+                    &inFlightFences[currentFrameIndex],
+                    VK_TRUE,
+                    std::numeric_limits<uint64_t>::max());
+    veDevice.deletionQueue().beginFrame();
+
+    isFrameStarted = true;
+    auto commandBuffer = commandBuffers[currentFrameIndex];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    return commandBuffer;
+}
+
+void VeOffscreenRenderer::endFrame() {
+    assert(isFrameStarted && "Can't call endFrame() while frame is not in progress!");
+
+    auto commandBuffer = commandBuffers[currentFrameIndex];
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to end command buffer!");
+    }
+
+    // Without a swap chain image to wait for or present, the fence is all the frame needs.
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkResetFences(veDevice.device(), 1, &inFlightFences[currentFrameIndex]);
+    if (vkQueueSubmit(veDevice.graphicsQueue(),
+                      1,
+                      &submitInfo,
+                      inFlightFences[currentFrameIndex]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    veDevice.deletionQueue().endFrame();
+
+    isFrameStarted = false;
+    currentFrameIndex = (currentFrameIndex + 1) % VeSwapChain::MAX_FRAMES_IN_FLIGHT;
+}
+
+void VeOffscreenRenderer::createTargets() {
+    // The formats a swap chain would usually have, so pipelines behave the same as on screen.
+    colorFormat = veDevice.findSupportedFormat({VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+                                               VK_IMAGE_TILING_OPTIMAL,
+                                               VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+    depthFormat = veDevice.findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+    for (auto &target : targets) {
+        createImage(colorFormat,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT,
+                    target.color);
+        // Sampled when building the depth pyramid for occlusion culling.
+        createImage(depthFormat,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_IMAGE_ASPECT_DEPTH_BIT,
+                    target.depth);
+    }
+}
+
+void VeOffscreenRenderer::createImage(VkFormat format,
+                                      VkImageUsageFlags usage,
+                                      VkImageAspectFlags aspect,
+                                      Image &image) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = extent.width;
+    imageInfo.extent.height = extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    veDevice.createImageWithInfo(
+        imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+    if (vkCreateImageView(veDevice.device(),
+                          &viewInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &image.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create offscreen image view!");
+    }
+}
+
+void VeOffscreenRenderer::destroyImage(Image &image) {
+    vkDestroyImageView(veDevice.device(),
+                       image.view,
+                       VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyImage(veDevice.device(), image.image, VeAllocTracker::callbacks(AllocScope::Device));
+    veDevice.freeMemory(image.memory);
+    image = {};
+}
+
+void VeOffscreenRenderer::createCommandBuffers() {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = veDevice.getCommandPool();
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    if (vkAllocateCommandBuffers(veDevice.device(), &allocInfo, commandBuffers.data()) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers");
+    }
+}
+
+void VeOffscreenRenderer::createSyncObjects() {
+    // Signaled, so the first frames don't wait on anything.
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    for (auto &fence : inFlightFences) {
+        if (vkCreateFence(veDevice.device(),
+                          &fenceInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+}
+
+}  // namespace ve
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <cassert>
+
+namespace ve {
+
+// Counterpart of VeRenderer for rendering without a window.
+//
+// Frames are rendered to color and depth images owned by the renderer, one set per frame in
+// flight, instead of to swap chain images. Nothing is presented, so frames are only limited by
+// how fast the GPU renders them. Color images can be copied from, to read finished frames back.
+class VeOffscreenRenderer {
+   public:
+    VeOffscreenRenderer(VeDevice &device, VkExtent2D extent);
+    ~VeOffscreenRenderer();
+
+    // Remove copy constructors.
+    VeOffscreenRenderer(const VeOffscreenRenderer &) = delete;
+    VeOffscreenRenderer &operator=(const VeOffscreenRenderer &) = delete;
+
+    // Waits for the frame that last used this frame's images and command buffer to retire.
+    VkCommandBuffer beginFrame();
+    void endFrame();
+
+    [[nodiscard]] bool isFrameInProgress() const { return isFrameStarted; }
+    [[nodiscard]] int getFrameIndex() const {
+        assert(isFrameStarted && "Cannot get frame index when frame not in progress!");
+        return currentFrameIndex;
+    }
+    [[nodiscard]] VkExtent2D getExtent() const { return extent; }
+    [[nodiscard]] float getAspectRatio() const {
+        return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+    }
+    [[nodiscard]] VkFormat getColorFormat() const { return colorFormat; }
+    [[nodiscard]] VkFormat getDepthFormat() const { return depthFormat; }
+    // Images of the current frame.
+    [[nodiscard]] VkImage getColorImage() const { return currentTarget().color.image; }
+    [[nodiscard]] VkImageView getColorImageView() const { return currentTarget().color.view; }
+    [[nodiscard]] VkImage getDepthImage() const { return currentTarget().depth.image; }
+    [[nodiscard]] VkImageView getDepthImageView() const { return currentTarget().depth.view; }
+
+    void setClearColor(VkClearColorValue _clearColor) { clearColor = _clearColor; }
+    [[nodiscard]] VkClearColorValue getClearColor() const { return clearColor; }
+
+   private:
+    struct Image {
+        VkImage image{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+    };
+    struct Target {
+        Image color;
+        Image depth;
+    };
+
+    void createTargets();
+    void createImage(VkFormat format,
+                     VkImageUsageFlags usage,
+                     VkImageAspectFlags aspect,
+                     Image &image);
+    void destroyImage(Image &image);
+    void createCommandBuffers();
+    void createSyncObjects();
+
+    [[nodiscard]] const Target &currentTarget() const {
+        assert(isFrameStarted && "Cannot get frame images when frame not in progress");
+        return targets[currentFrameIndex];
+    }
+
+    VeDevice &veDevice;
+    VkExtent2D extent;
+    VkFormat colorFormat{VK_FORMAT_UNDEFINED};
+    VkFormat depthFormat{VK_FORMAT_UNDEFINED};
+
+    std::array<Target, VeSwapChain::MAX_FRAMES_IN_FLIGHT> targets{};
+    std::array<VkCommandBuffer, VeSwapChain::MAX_FRAMES_IN_FLIGHT> commandBuffers{};
+    std::array<VkFence, VeSwapChain::MAX_FRAMES_IN_FLIGHT> inFlightFences{};
+
+    VkClearColorValue clearColor{0.f, 0.f, 0.f, 1.f};
+    int currentFrameIndex{0};
+    bool isFrameStarted{false};
+};
+
+}  // namespace ve
@@ -0,0 +1,226 @@
+#include "ve_parallel_recorder.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace ve {
+
+VeParallelRecorder::VeParallelRecorder(VeDevice &device, uint32_t threadCount)
+    : veDevice{device} {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads.resize(threadCount);
+    activeThreads = threadCount;
+    jobResults.resize(threadCount);
+    jobErrors.resize(threadCount);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = veDevice.findPhysicalQueueFamilies().graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    for (auto &thread : threads) {
+        for (auto &pool : thread.pools) {
+            if (vkCreateCommandPool(veDevice.device(),
+                                    &poolInfo,
+                                    VeAllocTracker::callbacks(AllocScope::Command),
+                                    &pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create recording thread command pool!");
+            }
+        }
+    }
+
+    // The calling thread records range 0, so it doesn't need a worker.
+    for (uint32_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&VeParallelRecorder::workerLoop, this, i);
+    }
+}
+
+VeParallelRecorder::~VeParallelRecorder() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // Destroying a pool frees its command buffers. Callers wait for the device to go idle before
+    // tearing the renderer down, so none of them can still be pending.
+    for (auto &thread : threads) {
+        for (auto pool : thread.pools) {
+            vkDestroyCommandPool(veDevice.device(),
+                                 pool,
+                                 VeAllocTracker::callbacks(AllocScope::Command));
+        }
+    }
+}
+
+void VeParallelRecorder::setActiveThreads(uint32_t count) {
+    activeThreads = std::clamp(count, 1u, getThreadCount());
+}
+
+void VeParallelRecorder::beginFrame(int frame) {
+    assert(!inRenderPass && "Can't begin a frame while recording a render pass");
+    frameIndex = frame;
+    for (auto &thread : threads) {
+        vkResetCommandPool(veDevice.device(), thread.pools[frameIndex], 0);
+        thread.used = 0;
+    }
+}
+
+void VeParallelRecorder::beginRenderPass(VkRenderPass renderPass,
+                                         VkFramebuffer framebuffer,
+                                         VkExtent2D renderExtent) {
+    assert(!inRenderPass && "Render pass already begun");
+    inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+    inheritanceInfo.pipelineStatistics = inheritedStatistics;
+    extent = renderExtent;
+    inRenderPass = true;
+    recorded.clear();
+}
+
+void VeParallelRecorder::endRenderPass(VkCommandBuffer primaryCommandBuffer) {
+    assert(inRenderPass && "No render pass to end");
+    if (!recorded.empty()) {
+        vkCmdExecuteCommands(primaryCommandBuffer,
+                             static_cast<uint32_t>(recorded.size()),
+                             recorded.data());
+    }
+    inRenderPass = false;
+}
+
+void VeParallelRecorder::recordRanges(uint32_t count,
+                                      RangeFn fn,
+                                      void *context,
+                                      uint32_t maxThreads) {
+    assert(inRenderPass && "Secondaries can only be recorded inside a render pass");
+    if (count == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        jobFn = fn;
+        jobContext = context;
+        jobCount = count;
+        jobThreads = std::min({activeThreads, count, maxThreads});
+        jobPending = jobThreads - 1;
+        jobGeneration++;
+    }
+    if (jobThreads > 1) {
+        jobReady.notify_all();
+    }
+
+    recordRange(0);
+
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        jobDone.wait(lock, [this] { return jobPending == 0; });
+    }
+
+    for (uint32_t i = 0; i < jobThreads; i++) {
+        if (jobErrors[i]) {
+            std::exception_ptr error = jobErrors[i];
+            std::fill(jobErrors.begin(), jobErrors.end(), nullptr);
+            std::rethrow_exception(error);
+        }
+        recorded.push_back(jobResults[i]);
+    }
+}
+
+void VeParallelRecorder::recordRange(uint32_t threadIndex) {
+    VE_PROFILE_SCOPE("VeParallelRecorder::recordRange");
+    try {
+        // Ranges differ in size by at most one.
+        uint32_t begin = static_cast<uint32_t>(uint64_t{jobCount} * threadIndex / jobThreads);
+        uint32_t end = static_cast<uint32_t>(uint64_t{jobCount} * (threadIndex + 1) / jobThreads);
+
+        VkCommandBuffer commandBuffer = acquireSecondary(threads[threadIndex]);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+
+        // Dynamic state isn't inherited from the primary.
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{0, 0}, extent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        jobFn(jobContext, commandBuffer, begin, end);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+        }
+        jobResults[threadIndex] = commandBuffer;
+    } catch (...) {
+        jobErrors[threadIndex] = std::current_exception();
+    }
+}
+
+VkCommandBuffer VeParallelRecorder::acquireSecondary(ThreadData &thread) {
+    auto &buffers = thread.buffers[frameIndex];
+    if (thread.used == buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = thread.pools[frameIndex];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(veDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        buffers.push_back(commandBuffer);
+    }
+    return buffers[thread.used++];
+}
+
+void VeParallelRecorder::workerLoop(uint32_t threadIndex) {
+    VE_PROFILE_THREAD(("recording worker " + std::to_string(threadIndex)).c_str());
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            jobReady.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = jobGeneration;
+            if (threadIndex >= jobThreads) {
+                continue;
+            }
+        }
+
+        recordRange(threadIndex);
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            jobPending--;
+        }
+        jobDone.notify_one();
+    }
+}
+
+}  // namespace ve
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Records the contents of a render pass on several threads at once.
+//
+// Every recording thread owns one command pool per frame in flight, so threads never share a pool
+// and a frame's pools can be reset as a whole once its fence has been waited on. Work is split into
+// contiguous ranges, each recorded into its own secondary command buffer, and the secondaries are
+// executed in range order so the result matches recording everything on one thread.
+//
+// The calling thread records the first range itself, the rest go to persistent worker threads.
+class VeParallelRecorder {
+   public:
+    // Number of recording threads, including the calling one. 0 uses every hardware thread.
+    explicit VeParallelRecorder(VeDevice &device, uint32_t threadCount = 0);
+    ~VeParallelRecorder();
+
+    // Remove copy constructors.
+    VeParallelRecorder(const VeParallelRecorder &) = delete;
+    VeParallelRecorder &operator=(const VeParallelRecorder &) = delete;
+
+    [[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(threads.size()); }
+    // Limits how many threads record, so thread counts can be compared at runtime.
+    void setActiveThreads(uint32_t count);
+    [[nodiscard]] uint32_t getActiveThreads() const { return activeThreads; }
+
+    // Pipeline statistics the secondaries inherit, needed when they are executed while a
+    // statistics query is active. Requires the inheritedQueries feature.
+    void setInheritedPipelineStatistics(VkQueryPipelineStatisticFlags statistics) {
+        inheritedStatistics = statistics;
+    }
+
+    // Resets the command pools of the frame. Its in-flight fence must have been waited on.
+    void beginFrame(int frameIndex);
+
+    // Secondaries recorded until endRenderPass() continue this render pass. The pass must have
+    // been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+    // Executes everything recorded since beginRenderPass(), in recording order.
+    void endRenderPass(VkCommandBuffer primaryCommandBuffer);
+
+    // Splits [0, count) into one range per active thread and calls
+    // fn(commandBuffer, begin, end) for each of them, every range into its own secondary. fn is
+    // called concurrently, so it may only touch state that isn't shared between ranges.
+    template <typename Fn>
+    void record(uint32_t count, Fn &&fn) {
+        recordRanges(count, &invokeRange<Fn>, &fn);
+    }
+    // Records fn(commandBuffer) into a single secondary on the calling thread.
+    template <typename Fn>
+    void recordInline(Fn &&fn) {
+        recordRanges(1, &invokeInline<Fn>, &fn, 1);
+    }
+
+   private:
+    using RangeFn = void (*)(void *context, VkCommandBuffer, uint32_t begin, uint32_t end);
+
+    template <typename Fn>
+    static void invokeRange(void *context, VkCommandBuffer commandBuffer, uint32_t b, uint32_t e) {
+        (*static_cast<std::remove_reference_t<Fn> *>(context))(commandBuffer, b, e);
+    }
+    template <typename Fn>
+    static void invokeInline(void *context, VkCommandBuffer commandBuffer, uint32_t, uint32_t) {
+        (*static_cast<std::remove_reference_t<Fn> *>(context))(commandBuffer);
+    }
+
+    struct ThreadData {
+        std::array<VkCommandPool, VeSwapChain::MAX_FRAMES_IN_FLIGHT> pools{};
+        // Secondaries are allocated once and reused every time the frame comes around.
+        std::array<std::vector<VkCommandBuffer>, VeSwapChain::MAX_FRAMES_IN_FLIGHT> buffers{};
+        size_t used{0};
+    };
+
+    void recordRanges(uint32_t count, RangeFn fn, void *context, uint32_t maxThreads = UINT32_MAX);
+    // Records one range on the thread owning threadIndex.
+    void recordRange(uint32_t threadIndex);
+    VkCommandBuffer acquireSecondary(ThreadData &thread);
+    void workerLoop(uint32_t threadIndex);
+
+    VeDevice &veDevice;
+    std::vector<ThreadData> threads;
+    uint32_t activeThreads;
+    int frameIndex{0};
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    VkQueryPipelineStatisticFlags inheritedStatistics{0};
+    VkExtent2D extent{};
+    bool inRenderPass{false};
+    std::vector<VkCommandBuffer> recorded;
+
+    // The job being recorded. Ranges are written by the thread recording them and read back once
+    // every thread is done.
+    RangeFn jobFn{nullptr};
+    void *jobContext{nullptr};
+    uint32_t jobCount{0};
+    uint32_t jobThreads{0};
+    std::vector<VkCommandBuffer> jobResults;
+    std::vector<std::exception_ptr> jobErrors;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    uint64_t jobGeneration{0};
+    uint32_t jobPending{0};
+    bool stopping{false};
+};
+
+}  // namespace ve
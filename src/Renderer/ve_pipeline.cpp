@@ -1,6 +1,8 @@
 #include "ve_pipeline.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
 #include "Core/ve_model.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
 
 // std
 #include <cassert>
@@ -25,9 +27,9 @@ VePipeline::VePipeline(VeDevice& device,
 }
 
 VePipeline::~VePipeline() {
-    vkDestroyShaderModule(veDevice.device(), vertShaderModule, nullptr);
-    vkDestroyShaderModule(veDevice.device(), fragShaderModule, nullptr);
-    vkDestroyPipeline(veDevice.device(), graphicsPipeline, nullptr);
+    vkDestroyPipeline(veDevice.device(),
+                      graphicsPipeline,
+                      VeAllocTracker::callbacks(AllocScope::Pipeline));
 }
 
 void VePipeline::bind(VkCommandBuffer commandBuffer) {
@@ -35,6 +37,67 @@ void VePipeline::bind(VkCommandBuffer commandBuffer) {
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 }
 
+void VePipeline::logFragmentStatistics() {
+    const auto& functions = veDevice.pipelineExecutableFunctions();
+    if (functions.getStatistics == nullptr) {
+        std::cout << "    no driver statistics, VK_KHR_pipeline_executable_properties missing\n";
+        return;
+    }
+
+    VkPipelineInfoKHR pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR;
+    pipelineInfo.pipeline = graphicsPipeline;
+    uint32_t executableCount = 0;
+    functions.getProperties(veDevice.device(), &pipelineInfo, &executableCount, nullptr);
+    std::vector<VkPipelineExecutablePropertiesKHR> executables(executableCount);
+    for (auto& executable : executables) {
+        executable.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR;
+    }
+    functions.getProperties(
+        veDevice.device(), &pipelineInfo, &executableCount, executables.data());
+
+    for (uint32_t i = 0; i < executableCount; i++) {
+        if ((executables[i].stages & VK_SHADER_STAGE_FRAGMENT_BIT) == 0) {
+            continue;
+        }
+        VkPipelineExecutableInfoKHR executableInfo{};
+        executableInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR;
+        executableInfo.pipeline = graphicsPipeline;
+        executableInfo.executableIndex = i;
+        uint32_t statisticCount = 0;
+        functions.getStatistics(veDevice.device(), &executableInfo, &statisticCount, nullptr);
+        std::vector<VkPipelineExecutableStatisticKHR> statistics(statisticCount);
+        for (auto& statistic : statistics) {
+            statistic.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR;
+        }
+        functions.getStatistics(
+            veDevice.device(), &executableInfo, &statisticCount, statistics.data());
+
+        // Names are up to the driver, instruction and sample counts are reported by most.
+        std::cout << "    " << executables[i].name << ":";
+        for (const auto& statistic : statistics) {
+            std::cout << " " << statistic.name << "=";
+            switch (statistic.format) {
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+                    std::cout << (statistic.value.b32 ? "true" : "false");
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+                    std::cout << statistic.value.i64;
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+                    std::cout << statistic.value.u64;
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+                    std::cout << statistic.value.f64;
+                    break;
+                default:
+                    std::cout << "?";
+            }
+        }
+        std::cout << "\n";
+    }
+}
+
 void VePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
     // Initialize viewport create info. Since we have a dynamic viewport and scissor, pointers are
     // left NULL for now.
@@ -125,6 +188,60 @@ void VePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
     configInfo.attributeDescriptions = VeModel::Vertex::getAttributeDescriptions();
 }
 
+void VePipeline::depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+    defaultPipelineConfigInfo(configInfo);
+
+    // Only positions are needed to rasterize depth, so vertices are read from the tightly packed
+    // position stream instead of the full interleaved vertices.
+    configInfo.bindingDescriptions = VeModel::Vertex::getPositionBindingDescriptions();
+    configInfo.attributeDescriptions = VeModel::Vertex::getPositionAttributeDescriptions();
+
+    // Depth-only render passes have no color attachments.
+    configInfo.colorBlendInfo.attachmentCount = 0;
+    configInfo.colorBlendInfo.pAttachments = nullptr;
+}
+
+void VePipeline::depthPrepassedPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+    // Depth is already final, so only the closest fragment of each pixel passes and the depth
+    // buffer doesn't need to be written again.
+    configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    configInfo.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+}
+
+void VePipeline::overdrawPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+    // Every fragment adds its color on top of what is already there, so the brightness of a pixel
+    // shows how many fragments were shaded for it.
+    configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+    configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void VePipeline::copyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst) {
+    dst.bindingDescriptions = src.bindingDescriptions;
+    dst.attributeDescriptions = src.attributeDescriptions;
+    dst.viewportInfo = src.viewportInfo;
+    dst.inputAssemblyInfo = src.inputAssemblyInfo;
+    dst.rasterizationInfo = src.rasterizationInfo;
+    dst.multisampleInfo = src.multisampleInfo;
+    dst.colorBlendAttachment = src.colorBlendAttachment;
+    dst.colorBlendInfo = src.colorBlendInfo;
+    if (src.colorBlendInfo.pAttachments == &src.colorBlendAttachment) {
+        dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+    }
+    dst.depthStencilInfo = src.depthStencilInfo;
+    dst.dynamicStateEnables = src.dynamicStateEnables;
+    dst.dynamicStateInfo = src.dynamicStateInfo;
+    dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+    dst.fragmentConstants = src.fragmentConstants;
+    dst.pipelineLayout = src.pipelineLayout;
+    dst.renderPass = src.renderPass;
+    dst.subpass = src.subpass;
+}
+
 std::vector<char> VePipeline::readFile(const std::string& filepath) {
     std::string enginePath = ENGINE_DIR + filepath;
     // Open file and seek to end of filestream.
@@ -157,13 +274,14 @@ void VePipeline::createGraphicsPipeline(const std::string& vertFilepath,
     assert(configInfo.renderPass != VK_NULL_HANDLE &&
            "Cannot create graphics pipeline:: no renderPass provided in configInfo");
 
-    // Store the GLSL source code of our vert and frag shaders.
-    auto vertCode = readFile(vertFilepath);
-    auto fragCode = readFile(fragFilepath);
+    // Modules are shared with every other pipeline using the same SPIR-V.
+    VePipelineLibrary& library = veDevice.pipelineLibrary();
+    VkShaderModule vertShaderModule = library.getShaderModule(vertFilepath);
 
-    // Create shader modules.
-    createShaderModule(vertCode, &vertShaderModule);
-    createShaderModule(fragCode, &fragShaderModule);
+    // Without a fragment shader only depth is written, used for depth-only passes.
+    bool hasFragmentStage = !fragFilepath.empty();
+    VkShaderModule fragShaderModule =
+        hasFragmentStage ? library.getShaderModule(fragFilepath) : VK_NULL_HANDLE;
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -181,6 +299,23 @@ void VePipeline::createGraphicsPipeline(const std::string& vertFilepath,
     shaderStages[1].pNext = nullptr;
     shaderStages[1].pSpecializationInfo = nullptr;
 
+    // Fragment specialization constants, constant_id i taking fragmentConstants[i].
+    const auto& fragmentConstants = configInfo.fragmentConstants;
+    std::vector<VkSpecializationMapEntry> constantEntries(fragmentConstants.size());
+    for (uint32_t i = 0; i < constantEntries.size(); i++) {
+        constantEntries[i].constantID = i;
+        constantEntries[i].offset = i * static_cast<uint32_t>(sizeof(uint32_t));
+        constantEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(constantEntries.size());
+    specializationInfo.pMapEntries = constantEntries.data();
+    specializationInfo.dataSize = fragmentConstants.size() * sizeof(uint32_t);
+    specializationInfo.pData = fragmentConstants.data();
+    if (!fragmentConstants.empty()) {
+        shaderStages[1].pSpecializationInfo = &specializationInfo;
+    }
+
     auto& bindingDescriptions = configInfo.bindingDescriptions;
     auto& attributeDescriptions = configInfo.attributeDescriptions;
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -195,7 +330,7 @@ void VePipeline::createGraphicsPipeline(const std::string& vertFilepath,
     // Create the graphics pipeline.
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = hasFragmentStage ? 2 : 1;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
@@ -212,23 +347,13 @@ void VePipeline::createGraphicsPipeline(const std::string& vertFilepath,
 
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    if (veDevice.pipelineExecutableFunctions().getStatistics != nullptr) {
+        pipelineInfo.flags |= VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR;
+    }
 
-    if (vkCreateGraphicsPipelines(
-            veDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) !=
+    if (veDevice.pipelineCache().createGraphicsPipeline(pipelineInfo, &graphicsPipeline) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline");
     }
 }
-
-void VePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    // Expects a uint32_t * but code is GLSL code as a char vector.
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    if (vkCreateShaderModule(veDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create shader module");
-    }
-}
 }  // namespace ve
\ No newline at end of file
@@ -49,14 +49,21 @@ struct PipelineConfigInfo {
     std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineDynamicStateCreateInfo dynamicStateInfo;
 
+    // Values of the fragment shader's specialization constants, constant_id i takes the i-th.
+    // Empty leaves every constant at its default.
+    std::vector<uint32_t> fragmentConstants{};
+
     // These values are initialized by the application layer.
     VkPipelineLayout pipelineLayout;
     VkRenderPass renderPass;
     uint32_t subpass = 0;
 };
 
+// Compiles on the calling thread. Shader modules come from the device's VePipelineLibrary,
+// which can also share identical pipelines and compile them in the background.
 class VePipeline {
    public:
+    // An empty fragFilepath creates a pipeline without a fragment stage, which only writes depth.
     VePipeline(VeDevice& device,
                const std::string& vertFilepath,
                const std::string& fragFilepath,
@@ -71,27 +78,38 @@ class VePipeline {
 
     void bind(VkCommandBuffer commandBuffer);
 
+    // Prints the driver's statistics of the fragment shader this compiled to, such as its
+    // instruction and texture sample counts. Needs VK_KHR_pipeline_executable_properties.
+    void logFragmentStatistics();
+
     // Initializes a default pipeline configuration.
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Initializes a default configuration for depth-only passes, reading only vertex positions.
+    static void depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Switches an initialized configuration to testing against depth laid down by a depth
+    // pre-pass, with EQUAL and without depth writes.
+    static void depthPrepassedPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Switches an initialized configuration to additive blending, used to visualize overdraw.
+    static void overdrawPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Copies a configuration, pointing the copy's color blend and dynamic state infos at its own
+    // attachment and dynamic states.
+    static void copyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
 
-   private:
     // Returns a buffer containing the contents of a file.
     static std::vector<char> readFile(const std::string& filepath);
 
+   private:
+
     void createGraphicsPipeline(const std::string& vertFilepath,
                                 const std::string& fragFilepath,
                                 const PipelineConfigInfo& configInfo);
 
-    void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
-
    private:
     // Potentially memory unsafe if our device is freed before our pipeline.
     // Reference member will implicitly outlive the class since a pipeline MUST have a
     // device to exist (aggregation relationship).
     VeDevice& veDevice;
     VkPipeline graphicsPipeline = VK_NULL_HANDLE;
-    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
-    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
 };
 
 }  // namespace ve
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "ve_pipeline_cache.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace ve {
+
+namespace {
+
+// Our header in front of the driver's data.
+constexpr std::array<char, 4> FILE_MAGIC{'V', 'E', 'P', 'C'};
+constexpr uint32_t FILE_VERSION = 1;
+struct FileHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t dataSize;
+    uint64_t checksum;
+};
+
+// Size of VkPipelineCacheHeaderVersionOne: header size, header version, vendor and device IDs
+// and the cache UUID.
+constexpr size_t DRIVER_HEADER_SIZE = 16 + VK_UUID_SIZE;
+// Enough for every stage of a graphics pipeline.
+constexpr uint32_t MAX_STAGES = 5;
+
+// FNV-1a, only there to catch files damaged on disk.
+uint64_t checksum(const std::vector<char> &data) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint32_t readUint32(const std::vector<char> &data, size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+}  // namespace
+
+VePipelineCache::VePipelineCache(VkDevice device,
+                                 const VkPhysicalDeviceProperties &properties,
+                                 bool creationFeedback,
+                                 std::string path)
+    : device{device},
+      properties{properties},
+      creationFeedback{creationFeedback},
+      path{std::move(path)} {
+    std::vector<char> data = load();
+    stats.loadedBytes = data.size();
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device,
+                              &cacheInfo,
+                              VeAllocTracker::callbacks(AllocScope::Pipeline),
+                              &cache) != VK_SUCCESS) {
+        // The data passed every check we could make but the driver still refused it.
+        std::cerr << "pipeline cache: driver rejected " << this->path << ", starting empty\n";
+        stats.loadedBytes = 0;
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(device,
+                                  &cacheInfo,
+                                  VeAllocTracker::callbacks(AllocScope::Pipeline),
+                                  &cache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+}
+
+VePipelineCache::~VePipelineCache() {
+    save();
+    vkDestroyPipelineCache(device, cache, VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+std::vector<char> VePipelineCache::load() {
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file.is_open()) {
+        std::cout << "pipeline cache: no cache at " << path << std::endl;
+        return {};
+    }
+    auto discard = [&](const char *reason) {
+        std::cout << "pipeline cache: discarding " << path << " (" << reason << ")" << std::endl;
+        return std::vector<char>{};
+    };
+
+    auto fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize < sizeof(FileHeader)) {
+        return discard("truncated");
+    }
+    FileHeader header{};
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+        return discard("not a cache file");
+    }
+    if (header.dataSize != fileSize - sizeof(FileHeader)) {
+        return discard("truncated");
+    }
+    std::vector<char> data(header.dataSize);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file || checksum(data) != header.checksum) {
+        return discard("checksum mismatch");
+    }
+
+    // Data from another device or driver version is useless, and the driver may not check.
+    if (data.size() < DRIVER_HEADER_SIZE || readUint32(data, 0) < DRIVER_HEADER_SIZE ||
+        readUint32(data, 0) > data.size() ||
+        readUint32(data, 4) != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        return discard("bad driver header");
+    }
+    if (readUint32(data, 8) != properties.vendorID || readUint32(data, 12) != properties.deviceID ||
+        std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        return discard("written by another device or driver");
+    }
+
+    std::cout << "pipeline cache: loaded " << data.size() << " bytes from " << path << std::endl;
+    return data;
+}
+
+void VePipelineCache::save() {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+        std::cerr << "pipeline cache: failed to read cache data\n";
+        return;
+    }
+    data.resize(size);
+
+    FileHeader header{FILE_MAGIC, FILE_VERSION, data.size(), checksum(data)};
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::cerr << "pipeline cache: failed to write " << tempPath << "\n";
+            return;
+        }
+    }
+    // Replace the old file in one step. Windows' rename doesn't overwrite.
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "pipeline cache: failed to write " << path << "\n";
+    }
+}
+
+VkResult VePipelineCache::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo &createInfo,
+                                                 VkPipeline *pipeline) {
+    assert(createInfo.stageCount <= MAX_STAGES && "Too many shader stages");
+    VkGraphicsPipelineCreateInfo info = createInfo;
+    VkPipelineCreationFeedbackEXT feedback{};
+    std::array<VkPipelineCreationFeedbackEXT, MAX_STAGES> stageFeedbacks{};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+    if (creationFeedback) {
+        feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+        feedbackInfo.pNext = info.pNext;
+        feedbackInfo.pPipelineCreationFeedback = &feedback;
+        feedbackInfo.pipelineStageCreationFeedbackCount = info.stageCount;
+        feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+        info.pNext = &feedbackInfo;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    VkResult result = vkCreateGraphicsPipelines(
+        device, cache, 1, &info, VeAllocTracker::callbacks(AllocScope::Pipeline), pipeline);
+    if (result == VK_SUCCESS) {
+        record(feedback, millisecondsSince(start));
+    }
+    return result;
+}
+
+VkResult VePipelineCache::createComputePipeline(const VkComputePipelineCreateInfo &createInfo,
+                                                VkPipeline *pipeline) {
+    VkComputePipelineCreateInfo info = createInfo;
+    VkPipelineCreationFeedbackEXT feedback{};
+    VkPipelineCreationFeedbackEXT stageFeedback{};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+    if (creationFeedback) {
+        feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+        feedbackInfo.pNext = info.pNext;
+        feedbackInfo.pPipelineCreationFeedback = &feedback;
+        feedbackInfo.pipelineStageCreationFeedbackCount = 1;
+        feedbackInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+        info.pNext = &feedbackInfo;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    VkResult result = vkCreateComputePipelines(
+        device, cache, 1, &info, VeAllocTracker::callbacks(AllocScope::Pipeline), pipeline);
+    if (result == VK_SUCCESS) {
+        record(feedback, millisecondsSince(start));
+    }
+    return result;
+}
+
+void VePipelineCache::record(const VkPipelineCreationFeedbackEXT &feedback, double milliseconds) {
+    std::lock_guard<std::mutex> lock{statsMutex};
+    if ((feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) == 0) {
+        stats.unknown++;
+        stats.unknownMilliseconds += milliseconds;
+    } else if ((feedback.flags &
+                VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0) {
+        stats.hits++;
+        stats.hitMilliseconds += milliseconds;
+    } else {
+        stats.misses++;
+        stats.missMilliseconds += milliseconds;
+    }
+}
+
+PipelineCacheStats VePipelineCache::getStats() {
+    std::lock_guard<std::mutex> lock{statsMutex};
+    return stats;
+}
+
+void VePipelineCache::logStats() {
+    PipelineCacheStats current = getStats();
+    std::cout << std::fixed << std::setprecision(2) << "pipeline cache: " << current.hits
+              << " hits in " << current.hitMilliseconds << " ms, " << current.misses
+              << " misses in " << current.missMilliseconds << " ms";
+    if (current.unknown > 0) {
+        std::cout << ", " << current.unknown << " without feedback in "
+                  << current.unknownMilliseconds << " ms";
+    }
+    std::cout << std::defaultfloat << std::endl;
+}
+
+}  // namespace ve
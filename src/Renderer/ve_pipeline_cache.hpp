@@ -0,0 +1,79 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Pipeline creations since startup, split by whether the driver found them in the cache.
+struct PipelineCacheStats {
+    size_t loadedBytes{0};  // 0 when nothing usable was on disk.
+    uint32_t hits{0};
+    uint32_t misses{0};
+    uint32_t unknown{0};  // Created without VK_EXT_pipeline_creation_feedback to tell.
+    double hitMilliseconds{0.0};
+    double missMilliseconds{0.0};
+    double unknownMilliseconds{0.0};
+};
+
+// The VkPipelineCache every pipeline is created through, kept on disk between runs so pipelines
+// compiled once don't have to be compiled again.
+//
+// The file is the driver's cache data behind a small header of our own with its size and a
+// checksum. A file that is truncated, corrupt or was written by another device or driver is
+// discarded and the cache starts out empty; drivers are not required to reject bad data
+// themselves. The cache is written back when it is destroyed, through a temporary file so a crash
+// never leaves half a file behind.
+class VePipelineCache {
+   public:
+    static constexpr const char *DEFAULT_PATH = "pipeline_cache.bin";
+
+    // creationFeedback is whether VK_EXT_pipeline_creation_feedback is enabled, without it hits
+    // and misses can't be told apart.
+    VePipelineCache(VkDevice device,
+                    const VkPhysicalDeviceProperties &properties,
+                    bool creationFeedback,
+                    std::string path = DEFAULT_PATH);
+    ~VePipelineCache();
+
+    // Remove copy constructors.
+    VePipelineCache(const VePipelineCache &) = delete;
+    VePipelineCache &operator=(const VePipelineCache &) = delete;
+
+    // vkCreateGraphicsPipelines and vkCreateComputePipelines through the cache, timed. Safe to
+    // call from several threads at once.
+    VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo &createInfo,
+                                    VkPipeline *pipeline);
+    VkResult createComputePipeline(const VkComputePipelineCreateInfo &createInfo,
+                                   VkPipeline *pipeline);
+
+    // Writes the cache to disk. Failing to is only logged, the cache is an optimization.
+    void save();
+    // Prints the creations so far and how long they took.
+    void logStats();
+
+    [[nodiscard]] VkPipelineCache getHandle() const { return cache; }
+    [[nodiscard]] PipelineCacheStats getStats();
+
+   private:
+    // Returns the driver data in the file, or nothing if the file is missing or not usable.
+    std::vector<char> load();
+    void record(const VkPipelineCreationFeedbackEXT &feedback, double milliseconds);
+
+    VkDevice device;
+    VkPhysicalDeviceProperties properties;
+    bool creationFeedback;
+    std::string path;
+    VkPipelineCache cache{VK_NULL_HANDLE};
+
+    std::mutex statsMutex;
+    PipelineCacheStats stats{};
+};
+
+}  // namespace ve
@@ -0,0 +1,272 @@
+#include "ve_pipeline_library.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ve {
+
+namespace {
+
+// FNV-1a over the bytes of plain values. Structs are hashed field by field, their padding and
+// pNext pointers say nothing about the pipeline.
+class Hasher {
+   public:
+    template <typename T>
+    void add(const T &value) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+                      "Hash structs field by field");
+        addBytes(&value, sizeof(value));
+    }
+
+    void addBytes(const void *data, size_t size) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    [[nodiscard]] uint64_t get() const { return hash; }
+
+   private:
+    uint64_t hash{14695981039346656037ull};
+};
+
+void hashStencilOp(Hasher &hasher, const VkStencilOpState &state) {
+    hasher.add(state.failOp);
+    hasher.add(state.passOp);
+    hasher.add(state.depthFailOp);
+    hasher.add(state.compareOp);
+    hasher.add(state.compareMask);
+    hasher.add(state.writeMask);
+    hasher.add(state.reference);
+}
+
+void hashConfig(Hasher &hasher, const PipelineConfigInfo &config) {
+    hasher.add(config.bindingDescriptions.size());
+    for (const auto &binding : config.bindingDescriptions) {
+        hasher.add(binding.binding);
+        hasher.add(binding.stride);
+        hasher.add(binding.inputRate);
+    }
+    hasher.add(config.attributeDescriptions.size());
+    for (const auto &attribute : config.attributeDescriptions) {
+        hasher.add(attribute.location);
+        hasher.add(attribute.binding);
+        hasher.add(attribute.format);
+        hasher.add(attribute.offset);
+    }
+
+    hasher.add(config.viewportInfo.viewportCount);
+    hasher.add(config.viewportInfo.scissorCount);
+    hasher.add(config.inputAssemblyInfo.topology);
+    hasher.add(config.inputAssemblyInfo.primitiveRestartEnable);
+
+    const auto &raster = config.rasterizationInfo;
+    hasher.add(raster.depthClampEnable);
+    hasher.add(raster.rasterizerDiscardEnable);
+    hasher.add(raster.polygonMode);
+    hasher.add(raster.cullMode);
+    hasher.add(raster.frontFace);
+    hasher.add(raster.depthBiasEnable);
+    hasher.add(raster.depthBiasConstantFactor);
+    hasher.add(raster.depthBiasClamp);
+    hasher.add(raster.depthBiasSlopeFactor);
+    hasher.add(raster.lineWidth);
+
+    const auto &multisample = config.multisampleInfo;
+    hasher.add(multisample.rasterizationSamples);
+    hasher.add(multisample.sampleShadingEnable);
+    hasher.add(multisample.minSampleShading);
+    hasher.add(multisample.alphaToCoverageEnable);
+    hasher.add(multisample.alphaToOneEnable);
+
+    const auto &blend = config.colorBlendInfo;
+    hasher.add(blend.logicOpEnable);
+    hasher.add(blend.logicOp);
+    hasher.add(blend.attachmentCount);
+    for (uint32_t i = 0; i < blend.attachmentCount; i++) {
+        const auto &attachment = blend.pAttachments[i];
+        hasher.add(attachment.blendEnable);
+        hasher.add(attachment.srcColorBlendFactor);
+        hasher.add(attachment.dstColorBlendFactor);
+        hasher.add(attachment.colorBlendOp);
+        hasher.add(attachment.srcAlphaBlendFactor);
+        hasher.add(attachment.dstAlphaBlendFactor);
+        hasher.add(attachment.alphaBlendOp);
+        hasher.add(attachment.colorWriteMask);
+    }
+    for (float constant : blend.blendConstants) {
+        hasher.add(constant);
+    }
+
+    const auto &depthStencil = config.depthStencilInfo;
+    hasher.add(depthStencil.depthTestEnable);
+    hasher.add(depthStencil.depthWriteEnable);
+    hasher.add(depthStencil.depthCompareOp);
+    hasher.add(depthStencil.depthBoundsTestEnable);
+    hasher.add(depthStencil.stencilTestEnable);
+    hashStencilOp(hasher, depthStencil.front);
+    hashStencilOp(hasher, depthStencil.back);
+    hasher.add(depthStencil.minDepthBounds);
+    hasher.add(depthStencil.maxDepthBounds);
+
+    hasher.add(config.dynamicStateEnables.size());
+    for (VkDynamicState state : config.dynamicStateEnables) {
+        hasher.add(state);
+    }
+
+    hasher.add(config.fragmentConstants.size());
+    for (uint32_t constant : config.fragmentConstants) {
+        hasher.add(constant);
+    }
+
+    hasher.add(config.pipelineLayout);
+    hasher.add(config.renderPass);
+    hasher.add(config.subpass);
+}
+
+}  // namespace
+
+VePipelineLibrary::VePipelineLibrary(VeDevice &device, uint32_t threadCount) : veDevice{device} {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&VePipelineLibrary::workerLoop, this);
+    }
+}
+
+VePipelineLibrary::~VePipelineLibrary() {
+    {
+        std::lock_guard<std::mutex> lock{pipelineMutex};
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Pipelines go first, nothing can be using them or the modules anymore.
+    pipelines.clear();
+    for (auto &kv : modulesByHash) {
+        vkDestroyShaderModule(veDevice.device(),
+                              kv.second,
+                              VeAllocTracker::callbacks(AllocScope::Pipeline));
+    }
+}
+
+VkShaderModule VePipelineLibrary::getShaderModule(const std::string &filepath) {
+    return loadShaderModule(filepath).module;
+}
+
+VePipelineLibrary::ShaderModule VePipelineLibrary::loadShaderModule(const std::string &filepath) {
+    std::lock_guard<std::mutex> lock{moduleMutex};
+    auto loaded = modulesByPath.find(filepath);
+    if (loaded != modulesByPath.end()) {
+        return loaded->second;
+    }
+
+    auto code = VePipeline::readFile(filepath);
+    Hasher hasher;
+    hasher.addBytes(code.data(), code.size());
+    uint64_t hash = hasher.get();
+
+    // Identical SPIR-V under another name shares its module.
+    auto shared = modulesByHash.find(hash);
+    if (shared != modulesByHash.end()) {
+        stats.sharedModules++;
+        return modulesByPath[filepath] = {shared->second, hash};
+    }
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    VkShaderModule module;
+    if (vkCreateShaderModule(veDevice.device(),
+                             &createInfo,
+                             VeAllocTracker::callbacks(AllocScope::Pipeline),
+                             &module) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module");
+    }
+    stats.shaderModules++;
+    modulesByHash[hash] = module;
+    return modulesByPath[filepath] = {module, hash};
+}
+
+PipelineFuture VePipelineLibrary::requestPipeline(const std::string &vertFilepath,
+                                                  const std::string &fragFilepath,
+                                                  const PipelineConfigInfo &configInfo) {
+    // Shaders are identified by their contents, loading them here also means a missing file
+    // throws on the requesting thread.
+    Hasher hasher;
+    hasher.add(loadShaderModule(vertFilepath).hash);
+    hasher.add(fragFilepath.empty() ? 0 : loadShaderModule(fragFilepath).hash);
+    hashConfig(hasher, configInfo);
+    uint64_t key = hasher.get();
+
+    std::lock_guard<std::mutex> lock{pipelineMutex};
+    auto existing = pipelines.find(key);
+    if (existing != pipelines.end()) {
+        stats.sharedPipelines++;
+        return existing->second;
+    }
+
+    std::shared_ptr<PipelineConfigInfo> config{new PipelineConfigInfo{}};
+    VePipeline::copyPipelineConfigInfo(configInfo, *config);
+    auto task = std::make_shared<std::packaged_task<std::shared_ptr<VePipeline>()>>(
+        [this, vertFilepath, fragFilepath, config]() {
+            return std::make_shared<VePipeline>(veDevice, vertFilepath, fragFilepath, *config);
+        });
+    PipelineFuture future = task->get_future().share();
+    pipelines.emplace(key, future);
+    stats.pipelines++;
+    pendingJobs++;
+    jobs.emplace([task]() { (*task)(); });
+    jobAvailable.notify_one();
+    return future;
+}
+
+void VePipelineLibrary::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock{pipelineMutex};
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        // Failures end up in the future, and are thrown where it is waited on.
+        job();
+
+        std::lock_guard<std::mutex> lock{pipelineMutex};
+        pendingJobs--;
+        if (pendingJobs == 0) {
+            jobsDone.notify_all();
+        }
+    }
+}
+
+void VePipelineLibrary::waitIdle() {
+    std::unique_lock<std::mutex> lock{pipelineMutex};
+    jobsDone.wait(lock, [this]() { return pendingJobs == 0; });
+}
+
+PipelineLibraryStats VePipelineLibrary::getStats() {
+    std::lock_guard<std::mutex> moduleLock{moduleMutex};
+    std::lock_guard<std::mutex> pipelineLock{pipelineMutex};
+    PipelineLibraryStats result = stats;
+    result.pendingPipelines = pendingJobs;
+    return result;
+}
+
+}  // namespace ve
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_pipeline.hpp"
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+using PipelineFuture = std::shared_future<std::shared_ptr<VePipeline>>;
+
+// Whether a requested pipeline has finished compiling, so getting it won't block.
+inline bool isPipelineReady(const PipelineFuture &future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+struct PipelineLibraryStats {
+    uint32_t shaderModules{0};     // Distinct SPIR-V loaded.
+    uint32_t sharedModules{0};     // Loads that found the same SPIR-V already loaded.
+    uint32_t pipelines{0};         // Distinct pipelines requested.
+    uint32_t sharedPipelines{0};   // Requests that got an already requested pipeline.
+    uint32_t pendingPipelines{0};  // Still compiling.
+};
+
+// Shares shader modules and pipelines across render systems and compiles pipelines in the
+// background.
+//
+// Shader modules are keyed by the hash of their SPIR-V, so a file is only turned into a module
+// once however many pipelines use it. Pipelines are keyed by a hash of their shaders and every
+// field of their PipelineConfigInfo, so systems asking for the same pipeline share one.
+//
+// Requested pipelines are compiled on a pool of worker threads, all through the device's pipeline
+// cache. Systems request every pipeline they may need up front, so they compile in parallel,
+// and only wait on a future the first time a pipeline is bound.
+class VePipelineLibrary {
+   public:
+    // Number of compile threads, 0 leaves one hardware thread to the main thread.
+    explicit VePipelineLibrary(VeDevice &device, uint32_t threadCount = 0);
+    ~VePipelineLibrary();
+
+    // Remove copy constructors.
+    VePipelineLibrary(const VePipelineLibrary &) = delete;
+    VePipelineLibrary &operator=(const VePipelineLibrary &) = delete;
+
+    // Module of a SPIR-V file, loaded the first time it is asked for. Owned by the library.
+    VkShaderModule getShaderModule(const std::string &filepath);
+
+    // Queues the pipeline for compilation, unless an identical one was already requested. An
+    // empty fragFilepath creates a depth-only pipeline, as with VePipeline. configInfo is copied,
+    // so it doesn't have to outlive the call.
+    PipelineFuture requestPipeline(const std::string &vertFilepath,
+                                   const std::string &fragFilepath,
+                                   const PipelineConfigInfo &configInfo);
+
+    // Blocks until every requested pipeline has been compiled.
+    void waitIdle();
+    [[nodiscard]] PipelineLibraryStats getStats();
+
+   private:
+    struct ShaderModule {
+        VkShaderModule module;
+        uint64_t hash;
+    };
+
+    // Loads the module if needed, returning it with its hash.
+    ShaderModule loadShaderModule(const std::string &filepath);
+    void workerLoop();
+
+    VeDevice &veDevice;
+
+    std::mutex moduleMutex;
+    std::unordered_map<std::string, ShaderModule> modulesByPath;
+    std::unordered_map<uint64_t, VkShaderModule> modulesByHash;
+
+    std::mutex pipelineMutex;
+    std::unordered_map<uint64_t, PipelineFuture> pipelines;
+    PipelineLibraryStats stats{};
+
+    std::queue<std::function<void()>> jobs;
+    uint32_t pendingJobs{0};
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    bool stopping{false};
+    std::vector<std::thread> threads;
+};
+
+}  // namespace ve
@@ -0,0 +1,58 @@
+#include "ve_pipeline_statistics.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+
+// std
+#include <stdexcept>
+
+namespace ve {
+
+VePipelineStatistics::VePipelineStatistics(VeDevice &device) : veDevice{device} {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = VeSwapChain::MAX_FRAMES_IN_FLIGHT;
+    poolInfo.pipelineStatistics = STATISTICS;
+    if (vkCreateQueryPool(veDevice.device(),
+                          &poolInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline statistics query pool!");
+    }
+}
+
+VePipelineStatistics::~VePipelineStatistics() {
+    vkDestroyQueryPool(veDevice.device(), queryPool, VeAllocTracker::callbacks(AllocScope::Device));
+}
+
+bool VePipelineStatistics::isSupported(VeDevice &device) {
+    return device.getEnabledFeatures().pipelineStatisticsQuery == VK_TRUE;
+}
+
+void VePipelineStatistics::begin(VkCommandBuffer commandBuffer, int frameIndex) {
+    auto query = static_cast<uint32_t>(frameIndex);
+    if (issued[frameIndex]) {
+        // The fence guarantees the query finished, but don't wait if the driver disagrees.
+        uint64_t result = 0;
+        if (vkGetQueryPoolResults(veDevice.device(),
+                                  queryPool,
+                                  query,
+                                  1,
+                                  sizeof(result),
+                                  &result,
+                                  sizeof(result),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            fragmentInvocations = result;
+        }
+    }
+
+    vkCmdResetQueryPool(commandBuffer, queryPool, query, 1);
+    vkCmdBeginQuery(commandBuffer, queryPool, query, 0);
+}
+
+void VePipelineStatistics::end(VkCommandBuffer commandBuffer, int frameIndex) {
+    vkCmdEndQuery(commandBuffer, queryPool, static_cast<uint32_t>(frameIndex));
+    issued[frameIndex] = true;
+}
+
+}  // namespace ve
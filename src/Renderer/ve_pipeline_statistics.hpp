@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ve_device.hpp"
+#include "ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Counts fragment shader invocations on the GPU with a pipeline statistics query, so the shading
+// saved by a depth pre-pass can be measured rather than guessed from the overdraw view.
+//
+// Every frame in flight has its own query. Its result is read back the next time the frame comes
+// around, once its fence has been waited on, so reading never stalls and lags a couple of frames.
+class VePipelineStatistics {
+   public:
+    // Secondary command buffers executed while the query is active must inherit these.
+    static constexpr VkQueryPipelineStatisticFlags STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    explicit VePipelineStatistics(VeDevice &device);
+    ~VePipelineStatistics();
+
+    // Remove copy constructors.
+    VePipelineStatistics(const VePipelineStatistics &) = delete;
+    VePipelineStatistics &operator=(const VePipelineStatistics &) = delete;
+
+    // Needs the pipelineStatisticsQuery feature.
+    static bool isSupported(VeDevice &device);
+
+    // Reads back the last result of the frame and starts counting again. Both begin() and end()
+    // must be recorded outside of a render pass, after the frame's fence has been waited on.
+    void begin(VkCommandBuffer commandBuffer, int frameIndex);
+    void end(VkCommandBuffer commandBuffer, int frameIndex);
+
+    [[nodiscard]] uint64_t getFragmentInvocations() const { return fragmentInvocations; }
+
+   private:
+    VeDevice &veDevice;
+    VkQueryPool queryPool{VK_NULL_HANDLE};
+    // Whether the frame's query has been submitted at least once, so it has a result to read.
+    std::array<bool, VeSwapChain::MAX_FRAMES_IN_FLIGHT> issued{};
+    uint64_t fragmentInvocations{0};
+};
+
+}  // namespace ve
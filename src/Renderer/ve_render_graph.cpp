@@ -0,0 +1,1168 @@
+#include "ve_render_graph.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+#include "Core/ve_utils.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+// Framebuffers which haven't been used for this many frames are destroyed.
+constexpr uint64_t FRAMEBUFFER_EVICT_FRAMES = 16;
+
+constexpr VkAccessFlags WRITE_ACCESS_MASK =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+struct AccessInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    bool write;
+};
+
+AccessInfo accessInfo(RGAccess access) {
+    switch (access) {
+        case RGAccess::ColorAttachment:
+            return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    true};
+        case RGAccess::DepthAttachment:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    true};
+        case RGAccess::DepthAttachmentRead:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                    false};
+        case RGAccess::FragmentSampled:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    false};
+        case RGAccess::ComputeSampled:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    false};
+        case RGAccess::ComputeStorageRead:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    false};
+        case RGAccess::ComputeStorageWrite:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    true};
+        case RGAccess::GraphicsStorageRead:
+            return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL,
+                    false};
+        case RGAccess::VertexRead:
+            return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    false};
+        case RGAccess::IndirectRead:
+            return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    false};
+        case RGAccess::UniformRead:
+            return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_UNIFORM_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    false};
+        case RGAccess::TransferRead:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    false};
+        case RGAccess::TransferWrite:
+            return {VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    true};
+    }
+    throw std::runtime_error("unknown render graph access!");
+}
+
+const char *accessName(RGAccess access) {
+    switch (access) {
+        case RGAccess::ColorAttachment:
+            return "color attachment";
+        case RGAccess::DepthAttachment:
+            return "depth attachment";
+        case RGAccess::DepthAttachmentRead:
+            return "depth attachment (read only)";
+        case RGAccess::FragmentSampled:
+            return "sampled (fragment)";
+        case RGAccess::ComputeSampled:
+            return "sampled (compute)";
+        case RGAccess::ComputeStorageRead:
+            return "storage read (compute)";
+        case RGAccess::ComputeStorageWrite:
+            return "storage write (compute)";
+        case RGAccess::GraphicsStorageRead:
+            return "storage read (graphics)";
+        case RGAccess::VertexRead:
+            return "vertex input";
+        case RGAccess::IndirectRead:
+            return "indirect";
+        case RGAccess::UniformRead:
+            return "uniform";
+        case RGAccess::TransferRead:
+            return "transfer src";
+        case RGAccess::TransferWrite:
+            return "transfer dst";
+    }
+    return "unknown";
+}
+
+VkImageUsageFlags usageFromAccess(RGAccess access) {
+    switch (access) {
+        case RGAccess::ColorAttachment:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case RGAccess::DepthAttachment:
+        case RGAccess::DepthAttachmentRead:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case RGAccess::FragmentSampled:
+        case RGAccess::ComputeSampled:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case RGAccess::ComputeStorageRead:
+        case RGAccess::ComputeStorageWrite:
+        case RGAccess::GraphicsStorageRead:
+            return VK_IMAGE_USAGE_STORAGE_BIT;
+        case RGAccess::TransferRead:
+            return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        case RGAccess::TransferWrite:
+            return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        default:
+            return 0;
+    }
+}
+
+// Non-dispatchable handles are pointers on 64-bit platforms and integers elsewhere.
+template <typename T>
+uint64_t handleKey(T handle) {
+    uint64_t key = 0;
+    std::memcpy(&key, &handle, sizeof(handle));
+    return key;
+}
+
+}  // namespace
+
+VeRenderGraph::VeRenderGraph(VeDevice &device) : veDevice{device} {}
+
+VeRenderGraph::~VeRenderGraph() {
+    destroyTransientResources();
+
+    // Render passes and framebuffers may still be referenced by frames in flight.
+    auto renderPasses = renderPassCache;
+    auto framebuffers = framebufferCache;
+    veDevice.deletionQueue().push([&device = veDevice, renderPasses, framebuffers]() {
+        for (const auto &[key, entry] : framebuffers) {
+            vkDestroyFramebuffer(device.device(),
+                                 entry.framebuffer,
+                                 VeAllocTracker::callbacks(AllocScope::Device));
+        }
+        for (const auto &[key, renderPass] : renderPasses) {
+            vkDestroyRenderPass(device.device(),
+                                renderPass,
+                                VeAllocTracker::callbacks(AllocScope::Device));
+        }
+    });
+}
+
+void VeRenderGraph::reset() {
+    resources.clear();
+    passes.clear();
+    executionOrder.clear();
+    finalBarriers = {};
+    compiled = false;
+}
+
+RGHandle VeRenderGraph::importImage(const std::string &name,
+                                    VkImage image,
+                                    VkImageView view,
+                                    const RGImageDesc &desc,
+                                    VkImageLayout initialLayout,
+                                    VkImageLayout finalLayout) {
+    Resource resource{};
+    resource.name = name;
+    resource.imported = true;
+    resource.desc = desc;
+    resource.image = image;
+    resource.view = view;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    resources.push_back(std::move(resource));
+    return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+RGHandle VeRenderGraph::importBuffer(const std::string &name, VkBuffer buffer, VkDeviceSize size) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.buffer = buffer;
+    resource.size = size;
+    resources.push_back(std::move(resource));
+    return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+void VeRenderGraph::addPass(const std::string &name, SetupFn &&setup, ExecuteFn &&execute) {
+    assert(!compiled && "Cannot add passes to a compiled render graph, call reset() first");
+
+    Pass pass{};
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+
+    PassBuilder builder{*this, passes.back()};
+    setup(builder);
+}
+
+RGHandle VeRenderGraph::PassBuilder::createImage(const std::string &name,
+                                                 const RGImageDesc &desc) {
+    Resource resource{};
+    resource.name = name;
+    resource.desc = desc;
+    graph.resources.push_back(std::move(resource));
+    return {static_cast<uint32_t>(graph.resources.size() - 1)};
+}
+
+void VeRenderGraph::PassBuilder::writeColor(RGHandle handle,
+                                            VkAttachmentLoadOp loadOp,
+                                            VkClearColorValue clearColor) {
+    Attachment attachment{handle.index, loadOp, {}};
+    attachment.clearValue.color = clearColor;
+    pass.colorAttachments.push_back(attachment);
+    write(handle, RGAccess::ColorAttachment);
+}
+
+void VeRenderGraph::PassBuilder::writeDepth(RGHandle handle,
+                                            VkAttachmentLoadOp loadOp,
+                                            float clearDepth) {
+    assert(!pass.hasDepth && "Pass already has a depth attachment");
+    pass.hasDepth = true;
+    pass.depthReadOnly = false;
+    pass.depthAttachment = {handle.index, loadOp, {}};
+    pass.depthAttachment.clearValue.depthStencil = {clearDepth, 0};
+    write(handle, RGAccess::DepthAttachment);
+}
+
+void VeRenderGraph::PassBuilder::readDepth(RGHandle handle) {
+    assert(!pass.hasDepth && "Pass already has a depth attachment");
+    pass.hasDepth = true;
+    pass.depthReadOnly = true;
+    pass.depthAttachment = {handle.index, VK_ATTACHMENT_LOAD_OP_LOAD, {}};
+    read(handle, RGAccess::DepthAttachmentRead);
+}
+
+void VeRenderGraph::PassBuilder::read(RGHandle handle, RGAccess access) {
+    assert(handle.valid() && handle.index < graph.resources.size() && "Invalid resource handle");
+    assert(!accessInfo(access).write && "Write access declared as a read");
+    pass.uses.push_back({handle.index, access});
+    graph.resources[handle.index].usage |= usageFromAccess(access);
+}
+
+void VeRenderGraph::PassBuilder::write(RGHandle handle, RGAccess access) {
+    assert(handle.valid() && handle.index < graph.resources.size() && "Invalid resource handle");
+    assert(accessInfo(access).write && "Read access declared as a write");
+    pass.uses.push_back({handle.index, access});
+    graph.resources[handle.index].usage |= usageFromAccess(access);
+}
+
+void VeRenderGraph::compile() {
+    VE_PROFILE_SCOPE("VeRenderGraph::compile");
+    // Passes execute in the order they were declared, so every transient resource must have been
+    // written before it is read.
+    std::vector<bool> written(resources.size(), false);
+    for (const auto &pass : passes) {
+        for (const auto &use : pass.uses) {
+            const auto &resource = resources[use.resource];
+            bool loads = pass.hasDepth && pass.depthAttachment.resource == use.resource &&
+                         pass.depthAttachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+            for (const auto &attachment : pass.colorAttachments) {
+                loads |= attachment.resource == use.resource &&
+                         attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+            }
+            if ((!accessInfo(use.access).write || loads) && !resource.imported &&
+                !written[use.resource]) {
+                throw std::runtime_error("render graph pass '" + pass.name + "' reads '" +
+                                         resource.name + "' before it is written!");
+            }
+        }
+        for (const auto &use : pass.uses) {
+            written[use.resource] = written[use.resource] || accessInfo(use.access).write;
+        }
+    }
+
+    stats = {};
+    cullPasses();
+    computeLifetimes();
+    createTransientResources();
+    computeBarriers();
+
+    for (size_t position = 0; position < executionOrder.size(); position++) {
+        auto &pass = passes[executionOrder[position]];
+        if (!pass.colorAttachments.empty() || pass.hasDepth) {
+            pass.renderPass = getRenderPass(pass, static_cast<int>(position));
+        }
+    }
+
+    stats.passes = static_cast<uint32_t>(executionOrder.size());
+    stats.culledPasses = static_cast<uint32_t>(passes.size() - executionOrder.size());
+    compiled = true;
+}
+
+void VeRenderGraph::cullPasses() {
+    // Walk backwards from the outputs of the frame: imported resources that outlive it and passes
+    // with side effects. Every pass producing something those read is kept.
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); i++) {
+        const auto &resource = resources[i];
+        needed[i] = resource.imported &&
+                    (!resource.isImage || resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+    }
+
+    for (auto it = passes.rbegin(); it != passes.rend(); ++it) {
+        auto &pass = *it;
+        bool alive = pass.sideEffects;
+        for (const auto &use : pass.uses) {
+            alive |= accessInfo(use.access).write && needed[use.resource];
+        }
+        pass.culled = !alive;
+        if (!alive) {
+            continue;
+        }
+
+        for (const auto &use : pass.uses) {
+            if (!accessInfo(use.access).write) {
+                needed[use.resource] = true;
+            }
+        }
+        for (const auto &attachment : pass.colorAttachments) {
+            if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                needed[attachment.resource] = true;
+            }
+        }
+        if (pass.hasDepth && pass.depthAttachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+            needed[pass.depthAttachment.resource] = true;
+        }
+    }
+
+    executionOrder.clear();
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (!passes[i].culled) {
+            executionOrder.push_back(i);
+        }
+    }
+}
+
+void VeRenderGraph::computeLifetimes() {
+    for (auto &resource : resources) {
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+        resource.aliasBlock = -1;
+        resource.lastStages = 0;
+        resource.lastWriteAccess = 0;
+    }
+
+    for (int position = 0; position < static_cast<int>(executionOrder.size()); position++) {
+        const auto &pass = passes[executionOrder[position]];
+        for (const auto &use : pass.uses) {
+            auto &resource = resources[use.resource];
+            auto info = accessInfo(use.access);
+            if (resource.firstPass < 0) {
+                resource.firstPass = position;
+            }
+            if (resource.lastPass != position) {
+                resource.lastStages = 0;
+                resource.lastWriteAccess = 0;
+            }
+            resource.lastPass = position;
+            resource.lastStages |= info.stages;
+            resource.lastWriteAccess |= info.access & WRITE_ACCESS_MASK;
+        }
+    }
+}
+
+size_t VeRenderGraph::transientSignature() const {
+    // Hashed rather than printed, compile() runs every frame.
+    size_t signature = 0;
+    for (const auto &resource : resources) {
+        if (resource.imported || !resource.isImage || resource.firstPass < 0) {
+            continue;
+        }
+        hashCombine(signature,
+                    resource.name,
+                    resource.desc.format,
+                    resource.desc.extent.width,
+                    resource.desc.extent.height,
+                    resource.desc.aspect,
+                    resource.usage,
+                    resource.firstPass,
+                    resource.lastPass);
+    }
+    return signature;
+}
+
+void VeRenderGraph::createTransientResources() {
+    auto &transients = transientResources;
+    transients.clear();
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        const auto &resource = resources[i];
+        if (!resource.imported && resource.isImage && resource.firstPass >= 0) {
+            transients.push_back(i);
+        }
+    }
+
+    size_t signature = transientSignature();
+    if (signature != currentSignature || transientImages.size() != transients.size()) {
+        destroyTransientResources();
+        currentSignature = signature;
+
+        // Create the images first so we know how much memory each of them needs.
+        std::vector<VkMemoryRequirements> requirements(transients.size());
+        for (size_t i = 0; i < transients.size(); i++) {
+            const auto &resource = resources[transients[i]];
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = resource.desc.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = resource.usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VkImage image = VK_NULL_HANDLE;
+            if (vkCreateImage(veDevice.device(),
+                              &imageInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image '" + resource.name +
+                                         "'!");
+            }
+            transientImages.push_back(image);
+            vkGetImageMemoryRequirements(veDevice.device(), image, &requirements[i]);
+        }
+
+        // Greedily pack the largest images first into blocks whose current occupants are all dead
+        // by the time the image is first used (or only come alive after it is last used).
+        std::vector<size_t> bySize(transients.size());
+        for (size_t i = 0; i < bySize.size(); i++) {
+            bySize[i] = i;
+        }
+        std::sort(bySize.begin(), bySize.end(), [&](size_t a, size_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        std::vector<int> blockOf(transients.size(), -1);
+        std::vector<VkDeviceSize> blockAlignment;
+        for (size_t i : bySize) {
+            const auto &resource = resources[transients[i]];
+            for (size_t b = 0; b < aliasBlocks.size() && blockOf[i] < 0; b++) {
+                auto &block = aliasBlocks[b];
+                if ((block.memoryTypeBits & requirements[i].memoryTypeBits) == 0) {
+                    continue;
+                }
+                bool overlaps = false;
+                for (uint32_t other : block.transients) {
+                    const auto &occupant = resources[transients[other]];
+                    overlaps |= resource.firstPass <= occupant.lastPass &&
+                                occupant.firstPass <= resource.lastPass;
+                }
+                if (!overlaps) {
+                    blockOf[i] = static_cast<int>(b);
+                }
+            }
+
+            if (blockOf[i] < 0) {
+                blockOf[i] = static_cast<int>(aliasBlocks.size());
+                aliasBlocks.push_back({VK_NULL_HANDLE, 0, ~0u, {}});
+                blockAlignment.push_back(1);
+            }
+
+            auto &block = aliasBlocks[blockOf[i]];
+            block.size = std::max(block.size, requirements[i].size);
+            block.memoryTypeBits &= requirements[i].memoryTypeBits;
+            block.transients.push_back(static_cast<uint32_t>(i));
+            blockAlignment[blockOf[i]] =
+                std::max(blockAlignment[blockOf[i]], requirements[i].alignment);
+        }
+
+        for (size_t b = 0; b < aliasBlocks.size(); b++) {
+            auto &block = aliasBlocks[b];
+            VkMemoryRequirements blockRequirements{};
+            blockRequirements.size = block.size;
+            blockRequirements.alignment = blockAlignment[b];
+            blockRequirements.memoryTypeBits = block.memoryTypeBits;
+            block.memory = veDevice.allocateMemory(blockRequirements,
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                   MemoryCategory::Attachment);
+        }
+
+        for (size_t i = 0; i < transients.size(); i++) {
+            const auto &resource = resources[transients[i]];
+            vkBindImageMemory(veDevice.device(),
+                              transientImages[i],
+                              aliasBlocks[blockOf[i]].memory,
+                              0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = transientImages[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.desc.format;
+            viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            VkImageView view = VK_NULL_HANDLE;
+            if (vkCreateImageView(veDevice.device(),
+                                  &viewInfo,
+                                  VeAllocTracker::callbacks(AllocScope::Device),
+                                  &view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view '" +
+                                         resource.name + "'!");
+            }
+            transientViews.push_back(view);
+
+            transientRequestedBytes += requirements[i].size;
+        }
+    }
+
+    // Hook the physical images up to this frame's resources. Transients are listed in declaration
+    // order, which the signature guarantees is unchanged since they were created.
+    for (size_t i = 0; i < transients.size(); i++) {
+        auto &resource = resources[transients[i]];
+        resource.image = transientImages[i];
+        resource.view = transientViews[i];
+    }
+    stats.transientBytes = transientRequestedBytes;
+    for (size_t b = 0; b < aliasBlocks.size(); b++) {
+        stats.allocatedBytes += aliasBlocks[b].size;
+        for (uint32_t transient : aliasBlocks[b].transients) {
+            resources[transients[transient]].aliasBlock = static_cast<int>(b);
+        }
+    }
+}
+
+void VeRenderGraph::destroyTransientResources() {
+    if (transientImages.empty() && aliasBlocks.empty()) {
+        return;
+    }
+
+    auto images = std::move(transientImages);
+    auto views = std::move(transientViews);
+    auto blocks = std::move(aliasBlocks);
+    transientImages.clear();
+    transientViews.clear();
+    aliasBlocks.clear();
+    currentSignature = 0;
+    transientRequestedBytes = 0;
+
+    veDevice.deletionQueue().push([&device = veDevice, images, views, blocks]() {
+        for (auto view : views) {
+            vkDestroyImageView(device.device(),
+                               view,
+                               VeAllocTracker::callbacks(AllocScope::Device));
+        }
+        for (auto image : images) {
+            vkDestroyImage(device.device(), image, VeAllocTracker::callbacks(AllocScope::Device));
+        }
+        for (const auto &block : blocks) {
+            device.freeMemory(block.memory);
+        }
+    });
+}
+
+void VeRenderGraph::computeBarriers() {
+    struct State {
+        bool touched{false};
+        VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkPipelineStageFlags writeStages{0};
+        VkAccessFlags writeAccess{0};
+        VkPipelineStageFlags readStages{0};
+        VkPipelineStageFlags visibleStages{0};
+        VkAccessFlags visibleAccess{0};
+    };
+    std::vector<State> states(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        states[i].layout = resources[i].imported ? resources[i].initialLayout
+                                                 : VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    auto addBarrier = [&](BarrierBatch &batch,
+                          uint32_t resource,
+                          VkPipelineStageFlags srcStages,
+                          VkAccessFlags srcAccess,
+                          VkPipelineStageFlags dstStages,
+                          VkAccessFlags dstAccess,
+                          VkImageLayout oldLayout,
+                          VkImageLayout newLayout) {
+        if (srcStages == 0) {
+            srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+        batch.srcStages |= srcStages;
+        batch.dstStages |= dstStages;
+        batch.barriers.push_back({resource, srcStages, srcAccess, dstAccess, oldLayout, newLayout});
+    };
+
+    for (uint32_t index : executionOrder) {
+        auto &pass = passes[index];
+        pass.barriers = {};
+
+        // Merge multiple uses of the same resource within the pass.
+        std::vector<std::pair<uint32_t, AccessInfo>> merged;
+        for (const auto &use : pass.uses) {
+            auto info = accessInfo(use.access);
+            auto it = std::find_if(merged.begin(), merged.end(), [&](const auto &entry) {
+                return entry.first == use.resource;
+            });
+            if (it == merged.end()) {
+                merged.emplace_back(use.resource, info);
+                continue;
+            }
+            if (resources[use.resource].isImage && it->second.layout != info.layout) {
+                throw std::runtime_error("render graph pass '" + pass.name + "' uses '" +
+                                         resources[use.resource].name +
+                                         "' with conflicting layouts!");
+            }
+            it->second.stages |= info.stages;
+            it->second.access |= info.access;
+            it->second.write |= info.write;
+        }
+
+        for (const auto &[resourceIndex, use] : merged) {
+            const auto &resource = resources[resourceIndex];
+            auto &state = states[resourceIndex];
+            bool isImage = resource.isImage;
+            VkImageLayout newLayout = isImage ? use.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            bool barrier = false;
+
+            if (!state.touched && isImage && !resource.imported) {
+                // Transient image: its memory may have last been used by an aliased image, or by
+                // this image in the previous frame.
+                VkPipelineStageFlags srcStages = resource.lastStages;
+                VkAccessFlags srcAccess = resource.lastWriteAccess;
+                if (resource.aliasBlock >= 0) {
+                    for (uint32_t other : aliasBlocks[resource.aliasBlock].transients) {
+                        srcStages |= resources[transientResources[other]].lastStages;
+                        srcAccess |= resources[transientResources[other]].lastWriteAccess;
+                    }
+                }
+                addBarrier(pass.barriers,
+                           resourceIndex,
+                           srcStages,
+                           srcAccess,
+                           use.stages,
+                           use.access,
+                           VK_IMAGE_LAYOUT_UNDEFINED,
+                           newLayout);
+                barrier = true;
+            } else if (!state.touched) {
+                // Imported resource. Anything that happened before the frame is ordered by the
+                // submission (or, for the swap chain, the acquire semaphore which waits at the
+                // stage it is first used in), so only the layout needs to change.
+                if (isImage && state.layout != newLayout) {
+                    addBarrier(pass.barriers,
+                               resourceIndex,
+                               use.stages,
+                               0,
+                               use.stages,
+                               use.access,
+                               state.layout,
+                               newLayout);
+                    barrier = true;
+                }
+            } else if (isImage && state.layout != newLayout) {
+                addBarrier(pass.barriers,
+                           resourceIndex,
+                           state.writeStages | state.readStages,
+                           state.writeAccess,
+                           use.stages,
+                           use.access,
+                           state.layout,
+                           newLayout);
+                barrier = true;
+            } else if (use.write) {
+                if (state.writeStages != 0 || state.readStages != 0) {
+                    addBarrier(pass.barriers,
+                               resourceIndex,
+                               state.writeStages | state.readStages,
+                               state.writeAccess,
+                               use.stages,
+                               use.access,
+                               newLayout,
+                               newLayout);
+                    barrier = true;
+                }
+            } else if (state.writeStages != 0 &&
+                       ((state.visibleStages & use.stages) != use.stages ||
+                        (state.visibleAccess & use.access) != use.access)) {
+                addBarrier(pass.barriers,
+                           resourceIndex,
+                           state.writeStages,
+                           state.writeAccess,
+                           use.stages,
+                           use.access,
+                           newLayout,
+                           newLayout);
+                barrier = true;
+            }
+
+            bool transitioned = barrier && isImage && pass.barriers.barriers.back().oldLayout !=
+                                                          pass.barriers.barriers.back().newLayout;
+            state.touched = true;
+            state.layout = newLayout;
+            if (use.write) {
+                state.writeStages = use.stages;
+                state.writeAccess = use.access & WRITE_ACCESS_MASK;
+                state.readStages = 0;
+                state.visibleStages = 0;
+                state.visibleAccess = 0;
+            } else if (transitioned) {
+                // The layout transition counts as a write which is only visible to this use.
+                state.writeStages = use.stages;
+                state.writeAccess = 0;
+                state.readStages = use.stages;
+                state.visibleStages = use.stages;
+                state.visibleAccess = use.access;
+            } else {
+                state.readStages |= use.stages;
+                if (barrier) {
+                    state.visibleStages |= use.stages;
+                    state.visibleAccess |= use.access;
+                }
+            }
+        }
+    }
+
+    // Leave imported images in the layout their owner expects.
+    finalBarriers = {};
+    for (uint32_t i = 0; i < resources.size(); i++) {
+        const auto &resource = resources[i];
+        const auto &state = states[i];
+        if (!resource.imported || !resource.isImage ||
+            resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            state.layout == resource.finalLayout) {
+            continue;
+        }
+        addBarrier(finalBarriers,
+                   i,
+                   state.writeStages | state.readStages,
+                   state.writeAccess,
+                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                   0,
+                   state.layout,
+                   resource.finalLayout);
+    }
+
+    auto countBatch = [&](const BarrierBatch &batch) {
+        if (batch.barriers.empty()) {
+            return;
+        }
+        stats.barrierBatches++;
+        for (const auto &barrier : batch.barriers) {
+            if (resources[barrier.resource].isImage) {
+                stats.imageBarriers++;
+                stats.layoutTransitions += barrier.oldLayout != barrier.newLayout ? 1 : 0;
+            } else {
+                stats.bufferBarriers++;
+            }
+        }
+    };
+    for (uint32_t index : executionOrder) {
+        countBatch(passes[index].barriers);
+    }
+    countBatch(finalBarriers);
+}
+
+void VeRenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                   const BarrierBatch &batch) const {
+    if (batch.barriers.empty()) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    for (const auto &barrier : batch.barriers) {
+        const auto &resource = resources[barrier.resource];
+        if (resource.isImage) {
+            VkImageMemoryBarrier imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = barrier.srcAccess;
+            imageBarrier.dstAccessMask = barrier.dstAccess;
+            imageBarrier.oldLayout = barrier.oldLayout;
+            imageBarrier.newLayout = barrier.newLayout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = resource.image;
+            imageBarrier.subresourceRange.aspectMask = resource.desc.aspect;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            imageBarriers.push_back(imageBarrier);
+        } else {
+            VkBufferMemoryBarrier bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = barrier.srcAccess;
+            bufferBarrier.dstAccessMask = barrier.dstAccess;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = resource.buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         batch.srcStages,
+                         batch.dstStages,
+                         0,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()),
+                         bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()),
+                         imageBarriers.data());
+}
+
+void VeRenderGraph::execute(VkCommandBuffer commandBuffer) {
+    VE_PROFILE_SCOPE("VeRenderGraph::execute");
+    assert(compiled && "Render graph must be compiled before it is executed");
+    executeCount++;
+
+    for (uint32_t index : executionOrder) {
+        const auto &pass = passes[index];
+        // Outside of the render pass, where secondary contents would forbid the timestamps.
+        VeGpuProfiler::Scope scope{gpuProfiler, commandBuffer, pass.name.c_str()};
+        recordBarriers(commandBuffer, pass.barriers);
+
+        if (pass.renderPass == VK_NULL_HANDLE) {
+            pass.execute(commandBuffer);
+            continue;
+        }
+
+        uint32_t firstAttachment = pass.colorAttachments.empty()
+                                       ? pass.depthAttachment.resource
+                                       : pass.colorAttachments[0].resource;
+        VkExtent2D extent = resources[firstAttachment].desc.extent;
+
+        std::vector<VkClearValue> clearValues;
+        for (const auto &attachment : pass.colorAttachments) {
+            clearValues.push_back(attachment.clearValue);
+        }
+        if (pass.hasDepth) {
+            clearValues.push_back(pass.depthAttachment.clearValue);
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = getFramebuffer(pass, extent);
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        activeTarget = {pass.renderPass, renderPassInfo.framebuffer, extent};
+
+        if (pass.secondaryContents) {
+            vkCmdBeginRenderPass(
+                commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            pass.execute(commandBuffer);
+            vkCmdEndRenderPass(commandBuffer);
+            activeTarget = {};
+            continue;
+        }
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{0, 0}, extent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        pass.execute(commandBuffer);
+
+        vkCmdEndRenderPass(commandBuffer);
+        activeTarget = {};
+    }
+
+    recordBarriers(commandBuffer, finalBarriers);
+    evictFramebuffers();
+}
+
+VkRenderPass VeRenderGraph::getRenderPass(const Pass &pass, int position) {
+    std::vector<VkAttachmentDescription> attachments;
+    auto describe = [&](const Attachment &attachment, VkImageLayout layout) {
+        const auto &resource = resources[attachment.resource];
+        // Contents only need to be written out if a later pass or the frame's owner reads them.
+        bool keep = resource.lastPass > position ||
+                    (resource.imported && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+        VkAttachmentDescription description{};
+        description.format = resource.desc.format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = attachment.loadOp;
+        description.storeOp =
+            keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Barriers before the pass already put the image in the right layout.
+        description.initialLayout = layout;
+        description.finalLayout = layout;
+        attachments.push_back(description);
+    };
+
+    for (const auto &attachment : pass.colorAttachments) {
+        describe(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+    if (pass.hasDepth) {
+        describe(pass.depthAttachment,
+                 pass.depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    return getRenderPass(attachments, pass.hasDepth);
+}
+
+VkRenderPass VeRenderGraph::compatibleRenderPass(const std::vector<VkFormat> &colorFormats,
+                                                 VkFormat depthFormat) {
+    // Render pass compatibility only depends on attachment formats and sample counts.
+    std::vector<VkAttachmentDescription> attachments;
+    auto describe = [&](VkFormat format, VkImageLayout layout) {
+        VkAttachmentDescription description{};
+        description.format = format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = layout;
+        description.finalLayout = layout;
+        attachments.push_back(description);
+    };
+
+    for (VkFormat format : colorFormats) {
+        describe(format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+    bool hasDepth = depthFormat != VK_FORMAT_UNDEFINED;
+    if (hasDepth) {
+        describe(depthFormat, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    return getRenderPass(attachments, hasDepth);
+}
+
+VkRenderPass VeRenderGraph::getRenderPass(const std::vector<VkAttachmentDescription> &attachments,
+                                          bool hasDepth) {
+    std::ostringstream key;
+    for (const auto &attachment : attachments) {
+        key << attachment.format << ':' << attachment.loadOp << ':' << attachment.storeOp << ':'
+            << attachment.initialLayout << ';';
+    }
+    key << (hasDepth ? "depth" : "");
+    auto it = renderPassCache.find(key.str());
+    if (it != renderPassCache.end()) {
+        return it->second;
+    }
+
+    // Every attachment but the depth one is a color attachment.
+    std::vector<VkAttachmentReference> colorRefs;
+    uint32_t colorCount = static_cast<uint32_t>(attachments.size()) - (hasDepth ? 1 : 0);
+    for (uint32_t i = 0; i < colorCount; i++) {
+        colorRefs.push_back({i, attachments[i].initialLayout});
+    }
+    VkAttachmentReference depthRef{colorCount,
+                                   hasDepth ? attachments[colorCount].initialLayout
+                                            : VK_IMAGE_LAYOUT_UNDEFINED};
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = colorCount;
+    subpass.pColorAttachments = colorRefs.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    if (vkCreateRenderPass(veDevice.device(),
+                           &renderPassInfo,
+                           VeAllocTracker::callbacks(AllocScope::Device),
+                           &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph render pass!");
+    }
+    renderPassCache[key.str()] = renderPass;
+    return renderPass;
+}
+
+VkFramebuffer VeRenderGraph::getFramebuffer(const Pass &pass, VkExtent2D extent) {
+    std::vector<VkImageView> views;
+    for (const auto &attachment : pass.colorAttachments) {
+        views.push_back(resources[attachment.resource].view);
+    }
+    if (pass.hasDepth) {
+        views.push_back(resources[pass.depthAttachment.resource].view);
+    }
+
+    std::vector<uint64_t> key{handleKey(pass.renderPass), extent.width, extent.height};
+    for (auto view : views) {
+        key.push_back(handleKey(view));
+    }
+    auto it = framebufferCache.find(key);
+    if (it != framebufferCache.end()) {
+        it->second.lastUsed = executeCount;
+        return it->second.framebuffer;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    if (vkCreateFramebuffer(veDevice.device(),
+                            &framebufferInfo,
+                            VeAllocTracker::callbacks(AllocScope::Device),
+                            &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer for '" + pass.name + "'!");
+    }
+    framebufferCache[key] = {framebuffer, executeCount};
+    return framebuffer;
+}
+
+void VeRenderGraph::evictFramebuffers() {
+    for (auto it = framebufferCache.begin(); it != framebufferCache.end();) {
+        if (executeCount - it->second.lastUsed < FRAMEBUFFER_EVICT_FRAMES) {
+            ++it;
+            continue;
+        }
+        veDevice.deletionQueue().push(
+            [&device = veDevice, framebuffer = it->second.framebuffer]() {
+                vkDestroyFramebuffer(device.device(),
+                                     framebuffer,
+                                     VeAllocTracker::callbacks(AllocScope::Device));
+            });
+        it = framebufferCache.erase(it);
+    }
+}
+
+void VeRenderGraph::clearFramebuffers() {
+    for (const auto &[key, entry] : framebufferCache) {
+        veDevice.deletionQueue().push([&device = veDevice, framebuffer = entry.framebuffer]() {
+            vkDestroyFramebuffer(device.device(),
+                                 framebuffer,
+                                 VeAllocTracker::callbacks(AllocScope::Device));
+        });
+    }
+    framebufferCache.clear();
+}
+
+VkImage VeRenderGraph::getImage(RGHandle handle) const {
+    assert(handle.valid() && resources[handle.index].isImage && "Not an image resource");
+    return resources[handle.index].image;
+}
+
+VkImageView VeRenderGraph::getImageView(RGHandle handle) const {
+    assert(handle.valid() && resources[handle.index].isImage && "Not an image resource");
+    return resources[handle.index].view;
+}
+
+VkBuffer VeRenderGraph::getBuffer(RGHandle handle) const {
+    assert(handle.valid() && !resources[handle.index].isImage && "Not a buffer resource");
+    return resources[handle.index].buffer;
+}
+
+void VeRenderGraph::dump(std::ostream &out) const {
+    constexpr double MiB = 1024.0 * 1024.0;
+
+    out << "Render graph: " << stats.passes << " passes, " << stats.culledPasses << " culled\n";
+    for (uint32_t index = 0; index < passes.size(); index++) {
+        const auto &pass = passes[index];
+        if (pass.culled) {
+            out << "\t[culled] " << pass.name << "\n";
+            continue;
+        }
+
+        auto position =
+            std::find(executionOrder.begin(), executionOrder.end(), index) - executionOrder.begin();
+        out << "\t[" << position << "] " << pass.name
+            << (pass.renderPass != VK_NULL_HANDLE ? " (graphics)" : "")
+            << (pass.secondaryContents ? " (secondary command buffers)" : "") << "\n";
+        for (const auto &use : pass.uses) {
+            out << "\t\t" << (accessInfo(use.access).write ? "writes " : "reads  ")
+                << resources[use.resource].name << " as " << accessName(use.access) << "\n";
+        }
+
+        uint32_t transitions = 0;
+        for (const auto &barrier : pass.barriers.barriers) {
+            transitions += barrier.oldLayout != barrier.newLayout ? 1 : 0;
+        }
+        out << "\t\tbarriers: " << pass.barriers.barriers.size() << " (" << transitions
+            << " layout transitions)\n";
+    }
+    out << "\tfinal barriers: " << finalBarriers.barriers.size() << "\n";
+
+    out << "\ttransient images: " << stats.transientBytes / MiB << " MiB requested, "
+        << stats.allocatedBytes / MiB << " MiB allocated in " << aliasBlocks.size()
+        << " blocks\n";
+    for (size_t b = 0; b < aliasBlocks.size(); b++) {
+        out << "\t\tblock " << b << " (" << aliasBlocks[b].size / MiB << " MiB):";
+        for (uint32_t transient : aliasBlocks[b].transients) {
+            const auto &resource = resources[transientResources[transient]];
+            out << " " << resource.name << " [" << resource.firstPass << "-" << resource.lastPass
+                << "]";
+        }
+        out << "\n";
+    }
+
+    out << "\testimated barriers: " << stats.barrierBatches << " batches, " << stats.imageBarriers
+        << " image (" << stats.layoutTransitions << " layout transitions), "
+        << stats.bufferBarriers << " buffer\n";
+}
+
+}  // namespace ve
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_gpu_profiler.hpp"
+
+// std
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ve {
+
+// Handle to an image or buffer declared in a render graph. Only valid for the frame it was
+// declared in.
+struct RGHandle {
+    uint32_t index{UINT32_MAX};
+
+    [[nodiscard]] bool valid() const { return index != UINT32_MAX; }
+};
+
+// Ways a pass can use a resource. Each maps to a pipeline stage, access mask and (for images) a
+// layout, which is all the graph needs to work out barriers.
+enum class RGAccess {
+    ColorAttachment,
+    DepthAttachment,
+    DepthAttachmentRead,  // Depth testing without writes.
+    FragmentSampled,
+    ComputeSampled,
+    ComputeStorageRead,
+    ComputeStorageWrite,
+    GraphicsStorageRead,
+    VertexRead,  // Vertex and index buffers.
+    IndirectRead,
+    UniformRead,
+    TransferRead,
+    TransferWrite,
+};
+
+struct RGImageDesc {
+    VkFormat format{VK_FORMAT_UNDEFINED};
+    VkExtent2D extent{};
+    VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+};
+
+// Frame graph.
+//
+// Every frame the passes are declared again along with the images and buffers they read and write.
+// compile() then works out the execution order, culls passes whose results are never used, and
+// computes the barriers and layout transitions needed between passes. Transient images are owned
+// by the graph, and images whose lifetimes don't overlap share memory. Render passes, framebuffers
+// and transient images are cached across frames, so rebuilding an unchanged graph only costs the
+// CPU side bookkeeping.
+//
+// Passes with color or depth attachments are graphics passes: the graph begins a render pass
+// around their execute callback and sets the viewport and scissor to the attachment extent.
+// Pipelines used in such a pass can be created against compatibleRenderPass(). A graphics pass can
+// instead be recorded into secondary command buffers, which continue getActiveRenderTarget().
+class VeRenderGraph {
+   public:
+    class PassBuilder;
+    using SetupFn = std::function<void(PassBuilder &)>;
+    using ExecuteFn = std::function<void(VkCommandBuffer)>;
+
+    struct Stats {
+        uint32_t passes{0};
+        uint32_t culledPasses{0};
+        uint32_t barrierBatches{0};  // vkCmdPipelineBarrier calls.
+        uint32_t imageBarriers{0};
+        uint32_t layoutTransitions{0};
+        uint32_t bufferBarriers{0};
+        VkDeviceSize transientBytes{0};  // Memory transient images would need without aliasing.
+        VkDeviceSize allocatedBytes{0};  // Memory actually allocated for them.
+    };
+
+    // Render pass and framebuffer a graphics pass is executing in.
+    struct RenderTarget {
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        VkFramebuffer framebuffer{VK_NULL_HANDLE};
+        VkExtent2D extent{};
+    };
+
+    explicit VeRenderGraph(VeDevice &device);
+    ~VeRenderGraph();
+
+    // Remove copy constructors.
+    VeRenderGraph(const VeRenderGraph &) = delete;
+    VeRenderGraph &operator=(const VeRenderGraph &) = delete;
+
+    // Clears the declared passes and resources. Cached Vulkan objects are kept.
+    void reset();
+
+    // Resources owned outside of the graph. The image is transitioned from initialLayout on first
+    // use and to finalLayout after the last pass. A finalLayout of VK_IMAGE_LAYOUT_UNDEFINED means
+    // the contents aren't needed after the frame.
+    RGHandle importImage(const std::string &name,
+                         VkImage image,
+                         VkImageView view,
+                         const RGImageDesc &desc,
+                         VkImageLayout initialLayout,
+                         VkImageLayout finalLayout);
+    RGHandle importBuffer(const std::string &name, VkBuffer buffer, VkDeviceSize size);
+
+    void addPass(const std::string &name, SetupFn &&setup, ExecuteFn &&execute);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Times every pass executed, under the pass's name, while profiler is non-null.
+    void setProfiler(VeGpuProfiler *profiler) { gpuProfiler = profiler; }
+
+    // Physical resources, valid after compile().
+    [[nodiscard]] VkImage getImage(RGHandle handle) const;
+    [[nodiscard]] VkImageView getImageView(RGHandle handle) const;
+    [[nodiscard]] VkBuffer getBuffer(RGHandle handle) const;
+    // Only valid inside the execute callback of a graphics pass.
+    [[nodiscard]] const RenderTarget &getActiveRenderTarget() const { return activeTarget; }
+
+    // Render pass compatible with the one the graph creates for a pass with these attachments.
+    VkRenderPass compatibleRenderPass(const std::vector<VkFormat> &colorFormats,
+                                      VkFormat depthFormat);
+    // Drops cached framebuffers. Call when imported images have been recreated, since a new view
+    // may reuse the handle of a destroyed one.
+    void clearFramebuffers();
+
+    [[nodiscard]] const Stats &getStats() const { return stats; }
+    // Prints the compiled graph: execution order, culled passes, barriers and aliasing.
+    void dump(std::ostream &out) const;
+
+   private:
+    struct Resource {
+        std::string name;
+        bool isImage{true};
+        bool imported{false};
+
+        // Images.
+        RGImageDesc desc{};
+        VkImageUsageFlags usage{0};
+        VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkImage image{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+
+        // Buffers.
+        VkBuffer buffer{VK_NULL_HANDLE};
+        VkDeviceSize size{0};
+
+        // Filled in by compile().
+        int firstPass{-1};
+        int lastPass{-1};
+        int aliasBlock{-1};
+        VkPipelineStageFlags lastStages{0};
+        VkAccessFlags lastWriteAccess{0};
+    };
+
+    struct Use {
+        uint32_t resource;
+        RGAccess access;
+    };
+
+    struct Attachment {
+        uint32_t resource;
+        VkAttachmentLoadOp loadOp;
+        VkClearValue clearValue;
+    };
+
+    struct Barrier {
+        uint32_t resource;
+        VkPipelineStageFlags srcStages;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+    };
+
+    struct BarrierBatch {
+        VkPipelineStageFlags srcStages{0};
+        VkPipelineStageFlags dstStages{0};
+        std::vector<Barrier> barriers;
+    };
+
+    struct Pass {
+        std::string name;
+        ExecuteFn execute;
+        std::vector<Use> uses;
+        std::vector<Attachment> colorAttachments;
+        bool hasDepth{false};
+        Attachment depthAttachment{};
+        bool depthReadOnly{false};
+        bool sideEffects{false};
+        bool secondaryContents{false};
+
+        // Filled in by compile().
+        bool culled{false};
+        BarrierBatch barriers;
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+    };
+
+    // Transient images sharing one allocation.
+    struct AliasBlock {
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkDeviceSize size{0};
+        uint32_t memoryTypeBits{0};
+        std::vector<uint32_t> transients;  // Indices into transientResources.
+    };
+
+    struct FramebufferEntry {
+        VkFramebuffer framebuffer;
+        uint64_t lastUsed;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    void createTransientResources();
+    void destroyTransientResources();
+    void computeBarriers();
+    void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch) const;
+    VkRenderPass getRenderPass(const Pass &pass, int position);
+    VkRenderPass getRenderPass(const std::vector<VkAttachmentDescription> &attachments,
+                               bool hasDepth);
+    VkFramebuffer getFramebuffer(const Pass &pass, VkExtent2D extent);
+    void evictFramebuffers();
+    [[nodiscard]] size_t transientSignature() const;
+
+    VeDevice &veDevice;
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<uint32_t> executionOrder;
+    BarrierBatch finalBarriers;
+    bool compiled{false};
+    RenderTarget activeTarget{};
+    VeGpuProfiler *gpuProfiler{nullptr};
+
+    // Transient images from the previous compile, reused while the signature matches.
+    size_t currentSignature{0};
+    std::vector<uint32_t> transientResources;  // Resource index of each transient image.
+    VkDeviceSize transientRequestedBytes{0};
+    std::vector<VkImage> transientImages;
+    std::vector<VkImageView> transientViews;
+    std::vector<AliasBlock> aliasBlocks;
+
+    std::map<std::string, VkRenderPass> renderPassCache;
+    std::map<std::vector<uint64_t>, FramebufferEntry> framebufferCache;
+    uint64_t executeCount{0};
+
+    Stats stats{};
+
+    friend class PassBuilder;
+
+   public:
+    // Handed to a pass's setup callback to declare what it uses.
+    class PassBuilder {
+       public:
+        // Creates an image owned by the graph for the duration of the frame.
+        RGHandle createImage(const std::string &name, const RGImageDesc &desc);
+
+        void writeColor(RGHandle handle,
+                        VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                        VkClearColorValue clearColor = {{0.f, 0.f, 0.f, 1.f}});
+        void writeDepth(RGHandle handle,
+                        VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                        float clearDepth = 1.f);
+        // Depth attachment which is tested against but not written.
+        void readDepth(RGHandle handle);
+
+        void read(RGHandle handle, RGAccess access);
+        void write(RGHandle handle, RGAccess access);
+
+        // Keeps the pass from being culled even if nothing reads its results.
+        void setSideEffects() { pass.sideEffects = true; }
+        // The render pass is begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, and the
+        // execute callback may only call vkCmdExecuteCommands on the primary it is given. Dynamic
+        // state is not set either, since secondaries don't inherit it.
+        void useSecondaryCommandBuffers() { pass.secondaryContents = true; }
+
+       private:
+        PassBuilder(VeRenderGraph &graph, Pass &pass) : graph{graph}, pass{pass} {}
+
+        VeRenderGraph &graph;
+        Pass &pass;
+
+        friend class VeRenderGraph;
+    };
+};
+
+}  // namespace ve
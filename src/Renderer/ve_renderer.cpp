@@ -1,5 +1,7 @@
 #include "ve_renderer.hpp"
 
+#include "Core/ve_cpu_profiler.hpp"
+
 // std
 #include <stdexcept>
 #include <array>
@@ -14,6 +16,7 @@ VeRenderer::VeRenderer(VeWindow &window, VeDevice &device) : veWindow{window}, v
 VeRenderer::~VeRenderer() { freeCommandBuffers(); }
 
 VkCommandBuffer VeRenderer::beginFrame() {
+    VE_PROFILE_SCOPE("VeRenderer::beginFrame");
     assert(!isFrameStarted && "Can't call beginFrame while frame already in progress!");
 
     // Fetch the next swap chain image.
@@ -28,7 +31,11 @@ VkCommandBuffer VeRenderer::beginFrame() {
         throw std::runtime_error("failed to acquire next swap chain image!");
     }
 
-    // Successfully acquired next image - start recording new command buffer.
+    // Successfully acquired next image. The in-flight fence for this frame has been waited on, so
+    // resources queued for deletion MAX_FRAMES_IN_FLIGHT frames ago can be destroyed.
+    veDevice.deletionQueue().beginFrame();
+
+    // Start recording new command buffer.
     isFrameStarted = true;
     auto commandBuffer = getCurrentCommandBuffer();
     VkCommandBufferBeginInfo beginInfo{};
@@ -42,6 +49,7 @@ VkCommandBuffer VeRenderer::beginFrame() {
 }
 
 void VeRenderer::endFrame() {
+    VE_PROFILE_SCOPE("VeRenderer::endFrame");
     assert(isFrameStarted && "Can't call endFrame() while frame is not in progress!");
 
     // End command buffer.
@@ -52,8 +60,10 @@ void VeRenderer::endFrame() {
 
     // Submit command buffer to begin execution on GPU.
     auto result = veSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+    veDevice.deletionQueue().endFrame();
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
         veWindow.wasWindowResized()) {
+        veWindow.resetWindowResizedFlag();
         recreateSwapChain();
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swap chain image!");
@@ -140,21 +150,25 @@ void VeRenderer::recreateSwapChain() {
         glfwWaitEvents();
     }
 
-    // Wait until current swapchain is no longer being used before we create the new one.
-    vkDeviceWaitIdle(veDevice.device());
-
     if (veSwapChain == nullptr) {
         // Create new swap chain.
         veSwapChain = std::make_unique<VeSwapChain>(veDevice, extent);
     } else {
         std::shared_ptr<VeSwapChain> oldSwapChain = std::move(veSwapChain);
-        // Constructs a swap chain w/ a pointer to the previous one.
+        // Constructs a swap chain w/ a pointer to the previous one. The new swap chain takes over
+        // the old one's in-flight fences, so frames still being rendered are waited on as usual
+        // instead of draining the whole device here.
         veSwapChain = std::make_unique<VeSwapChain>(veDevice, extent, oldSwapChain);
 
         if (!oldSwapChain->compareSwapFormats(*veSwapChain)) {
             throw std::runtime_error("Swap chain image/depth format has changed!");
         }
+
+        // Frames in flight may still be rendering to the old swap chain's images, so keep it
+        // alive until they retire.
+        veDevice.deletionQueue().push([oldSwapChain]() mutable { oldSwapChain.reset(); });
     }
+    swapChainGeneration++;
 }
 
 }  // namespace ve
\ No newline at end of file
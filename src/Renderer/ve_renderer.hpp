@@ -41,10 +41,39 @@ class VeRenderer {
         return currentFrameIndex;
     }
     [[nodiscard]] uint32_t getSwapChainImageCount() const { return veSwapChain->imageCount(); }
+    [[nodiscard]] VkExtent2D getSwapChainExtent() const {
+        return veSwapChain->getSwapChainExtent();
+    }
+    [[nodiscard]] VkFormat getSwapChainImageFormat() const {
+        return veSwapChain->getSwapChainImageFormat();
+    }
+    [[nodiscard]] VkFormat getSwapChainDepthFormat() const {
+        return veSwapChain->getSwapChainDepthFormat();
+    }
+    // Images of the swap chain image acquired for the current frame.
+    [[nodiscard]] VkImage getSwapChainImage() const {
+        assert(isFrameStarted && "Cannot get swap chain image when frame not in progress");
+        return veSwapChain->getImage(static_cast<int>(currentImageIndex));
+    }
+    [[nodiscard]] VkImageView getSwapChainImageView() const {
+        assert(isFrameStarted && "Cannot get swap chain image when frame not in progress");
+        return veSwapChain->getImageView(static_cast<int>(currentImageIndex));
+    }
+    [[nodiscard]] VkImage getSwapChainDepthImage() const {
+        assert(isFrameStarted && "Cannot get swap chain image when frame not in progress");
+        return veSwapChain->getDepthImage(static_cast<int>(currentImageIndex));
+    }
+    [[nodiscard]] VkImageView getSwapChainDepthImageView() const {
+        assert(isFrameStarted && "Cannot get swap chain image when frame not in progress");
+        return veSwapChain->getDepthImageView(static_cast<int>(currentImageIndex));
+    }
+    // Incremented every time the swap chain is recreated.
+    [[nodiscard]] uint64_t getSwapChainGeneration() const { return swapChainGeneration; }
     [[nodiscard]] VeWindow& getWindow() const { return veWindow; }
     [[nodiscard]] VeDevice& getDevice() const { return veDevice; }
 
     void setClearColor(VkClearColorValue _clearColor) { clearColor = _clearColor; }
+    [[nodiscard]] VkClearColorValue getClearColor() const { return clearColor; }
 
    private:
     void createCommandBuffers();
@@ -60,6 +89,7 @@ class VeRenderer {
     uint32_t currentImageIndex{0};
     int currentFrameIndex{0};
     bool isFrameStarted{false};
+    uint64_t swapChainGeneration{0};
 };
 
 }  // namespace ve
\ No newline at end of file
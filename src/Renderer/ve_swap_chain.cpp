@@ -1,5 +1,8 @@
 #include "ve_swap_chain.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -40,43 +43,64 @@ void VeSwapChain::init() {
 // Destructor
 VeSwapChain::~VeSwapChain() {
     for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(veDevice.device(), imageView, nullptr);
+        vkDestroyImageView(veDevice.device(),
+                           imageView,
+                           VeAllocTracker::callbacks(AllocScope::Device));
     }
     swapChainImageViews.clear();
 
      if (swapChain != nullptr) {
-         vkDestroySwapchainKHR(veDevice.device(), swapChain, nullptr);
+         vkDestroySwapchainKHR(veDevice.device(),
+                               swapChain,
+                               VeAllocTracker::callbacks(AllocScope::Device));
          swapChain = nullptr;
      }
 //    vkDestroySwapchainKHR(veDevice.device(), swapChain, nullptr);
 
 
     for (int i = 0; i < depthImages.size(); i++) {
-        vkDestroyImageView(veDevice.device(), depthImageViews[i], nullptr);
-        vkDestroyImage(veDevice.device(), depthImages[i], nullptr);
-        vkFreeMemory(veDevice.device(), depthImageMemorys[i], nullptr);
+        vkDestroyImageView(veDevice.device(),
+                           depthImageViews[i],
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyImage(veDevice.device(),
+                       depthImages[i],
+                       VeAllocTracker::callbacks(AllocScope::Device));
+        veDevice.freeMemory(depthImageMemorys[i]);
     }
 
     for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(veDevice.device(), framebuffer, nullptr);
+        vkDestroyFramebuffer(veDevice.device(),
+                             framebuffer,
+                             VeAllocTracker::callbacks(AllocScope::Device));
     }
 
-    vkDestroyRenderPass(veDevice.device(), renderPass, nullptr);
-
-    // cleanup synchronization objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(veDevice.device(), renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(veDevice.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(veDevice.device(), inFlightFences[i], nullptr);
+    vkDestroyRenderPass(veDevice.device(),
+                        renderPass,
+                        VeAllocTracker::callbacks(AllocScope::Device));
+
+    // cleanup synchronization objects. These will be empty if a newer swap chain took them over.
+    for (size_t i = 0; i < inFlightFences.size(); i++) {
+        vkDestroySemaphore(veDevice.device(),
+                           renderFinishedSemaphores[i],
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroySemaphore(veDevice.device(),
+                           imageAvailableSemaphores[i],
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyFence(veDevice.device(),
+                       inFlightFences[i],
+                       VeAllocTracker::callbacks(AllocScope::Device));
     }
 }
 // Fetches the index of the frame we should render to next. Handles CPU and GPU synchronization.
 VkResult VeSwapChain::acquireNextImage(uint32_t *imageIndex) {
-    vkWaitForFences(veDevice.device(),
-                    1,
-                    &inFlightFences[currentFrame],
-                    VK_TRUE,
-                    std::numeric_limits<uint64_t>::max());
+    {
+        VE_PROFILE_SCOPE("wait for frame fence");
+        vkWaitForFences(veDevice.device(),
+                        1,
+                        &inFlightFences[currentFrame],
+                        VK_TRUE,
+                        std::numeric_limits<uint64_t>::max());
+    }
 
     VkResult result =
         vkAcquireNextImageKHR(veDevice.device(),
@@ -92,6 +116,7 @@ VkResult VeSwapChain::acquireNextImage(uint32_t *imageIndex) {
 
 VkResult VeSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, const uint32_t *imageIndex) {
     if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+        VE_PROFILE_SCOPE("wait for image fence");
         vkWaitForFences(veDevice.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
     }
     imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
@@ -113,9 +138,13 @@ VkResult VeSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, const
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(veDevice.device(), 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(veDevice.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    {
+        VE_PROFILE_SCOPE("vkQueueSubmit");
+        if (vkQueueSubmit(
+                veDevice.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
     }
 
     VkPresentInfoKHR presentInfo = {};
@@ -130,7 +159,11 @@ VkResult VeSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, const
 
     presentInfo.pImageIndices = imageIndex;
 
-    auto result = vkQueuePresentKHR(veDevice.presentQueue(), &presentInfo);
+    VkResult result;
+    {
+        VE_PROFILE_SCOPE("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(veDevice.presentQueue(), &presentInfo);
+    }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -182,7 +215,10 @@ void VeSwapChain::createSwapChain() {
 
     createInfo.oldSwapchain = oldSwapChain == nullptr ? VK_NULL_HANDLE : oldSwapChain->swapChain;
 
-    if (vkCreateSwapchainKHR(veDevice.device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+    if (vkCreateSwapchainKHR(veDevice.device(),
+                             &createInfo,
+                             VeAllocTracker::callbacks(AllocScope::Device),
+                             &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
 
@@ -215,7 +251,10 @@ void VeSwapChain::createImageViews() {
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(veDevice.device(), &viewInfo, nullptr, &swapChainImageViews[i]) !=
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &swapChainImageViews[i]) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create texture image view!");
         }
@@ -279,7 +318,10 @@ void VeSwapChain::createRenderPass() {
     renderPassInfo.pDependencies = &dependency;
 
     // Create render pass.
-    if (vkCreateRenderPass(veDevice.device(), &renderPassInfo, nullptr, &renderPass) !=
+    if (vkCreateRenderPass(veDevice.device(),
+                           &renderPassInfo,
+                           VeAllocTracker::callbacks(AllocScope::Device),
+                           &renderPass) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
@@ -301,7 +343,10 @@ void VeSwapChain::createFramebuffers() {
         framebufferInfo.layers = 1;
 
         if (vkCreateFramebuffer(
-                veDevice.device(), &framebufferInfo, nullptr, &swapChainFramebuffers[i]) !=
+                veDevice.device(),
+                &framebufferInfo,
+                VeAllocTracker::callbacks(AllocScope::Device),
+                &swapChainFramebuffers[i]) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create framebuffer!");
         }
@@ -329,7 +374,9 @@ void VeSwapChain::createDepthResources() {
         imageInfo.format = depthFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        // Sampled when building the depth pyramid for occlusion culling.
+        imageInfo.usage =
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -348,7 +395,10 @@ void VeSwapChain::createDepthResources() {
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(veDevice.device(), &viewInfo, nullptr, &depthImageViews[i]) !=
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &depthImageViews[i]) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create texture image view!");
         }
@@ -356,10 +406,24 @@ void VeSwapChain::createDepthResources() {
 }
 
 void VeSwapChain::createSyncObjects() {
+    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+
+    if (oldSwapChain != nullptr) {
+        // Take over the per-frame sync objects of the previous swap chain. Frames still in flight
+        // will signal these fences, so acquireNextImage() keeps waiting on the right ones.
+        imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+        renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+        inFlightFences = std::move(oldSwapChain->inFlightFences);
+        oldSwapChain->imageAvailableSemaphores.clear();
+        oldSwapChain->renderFinishedSemaphores.clear();
+        oldSwapChain->inFlightFences.clear();
+        currentFrame = oldSwapChain->currentFrame;
+        return;
+    }
+
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -370,12 +434,21 @@ void VeSwapChain::createSyncObjects() {
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(
-                veDevice.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
+                veDevice.device(),
+                &semaphoreInfo,
+                VeAllocTracker::callbacks(AllocScope::Device),
+                &imageAvailableSemaphores[i]) !=
                 VK_SUCCESS ||
             vkCreateSemaphore(
-                veDevice.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
+                veDevice.device(),
+                &semaphoreInfo,
+                VeAllocTracker::callbacks(AllocScope::Device),
+                &renderFinishedSemaphores[i]) !=
                 VK_SUCCESS ||
-            vkCreateFence(veDevice.device(), &fenceInfo, nullptr, &inFlightFences[i]) !=
+            vkCreateFence(veDevice.device(),
+                          &fenceInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &inFlightFences[i]) !=
                 VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
@@ -436,7 +509,7 @@ VkFormat VeSwapChain::findDepthFormat() {
     return veDevice.findSupportedFormat(
         {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 }  // namespace ve
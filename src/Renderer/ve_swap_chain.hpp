@@ -29,8 +29,12 @@ class VeSwapChain {
     VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
     VkRenderPass getRenderPass() { return renderPass; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+    VkImage getImage(int index) { return swapChainImages[index]; }
+    VkImage getDepthImage(int index) { return depthImages[index]; }
+    VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
     size_t imageCount() { return swapChainImages.size(); }  // Number of framebuffers.
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
+    VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
     [[nodiscard]] uint32_t width() const { return swapChainExtent.width; }
     [[nodiscard]] uint32_t height() const { return swapChainExtent.height; }
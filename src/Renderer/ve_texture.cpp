@@ -1,6 +1,8 @@
 #include "ve_texture.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
 #include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_mip_generator.hpp"
 
 // lib
 #define STB_IMAGE_IMPLEMENTATION
@@ -43,9 +45,17 @@ VeTexture::VeTexture(VeDevice& device,
 
 
 VeTexture::~VeTexture() {
-    vkDestroyImageView(veDevice.device(), textureImageView, nullptr);
-    vkDestroyImage(veDevice.device(), textureImage, nullptr);
-    vkFreeMemory(veDevice.device(), textureImageMemory, nullptr);
+    // The texture may still be sampled by a frame in flight, so defer destruction until it retires.
+    veDevice.deletionQueue().push([&device = veDevice,
+                                   imageView = textureImageView,
+                                   image = textureImage,
+                                   memory = textureImageMemory]() {
+        vkDestroyImageView(device.device(),
+                           imageView,
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyImage(device.device(), image, VeAllocTracker::callbacks(AllocScope::Device));
+        device.freeMemory(memory);
+    });
 }
 
 
@@ -199,19 +209,26 @@ void VeTexture::createTextureImageFromFile(const std::string& filepath) {
 
     stbi_image_free(pixels);
 
+    // Textures from disk get a full mip chain when the format allows generating one.
+    VkImageUsageFlags mipUsage = VeMipGenerator::requiredUsage(veDevice, m_format);
+    if (mipUsage != 0) {
+        mipLevels = VeMipGenerator::levelCount(static_cast<uint32_t>(texWidth),
+                                               static_cast<uint32_t>(texHeight));
+    }
+
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
     imageInfo.extent.width = static_cast<uint32_t>(texWidth);
     imageInfo.extent.height = static_cast<uint32_t>(texHeight);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = m_format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     // Going to be used as destination of our staging buffer and will be sampled in our shaders.
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | mipUsage;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;  // idk what this does.
     // Used for multisampling.
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -235,11 +252,12 @@ void VeTexture::createTextureImageFromFile(const std::string& filepath) {
                                static_cast<uint32_t>(texHeight),
                                1);
 
-    // Transition the image layout to be optimal for sampling.
-    veDevice.transitionImageLayout(textureImage,
-                                   VK_FORMAT_R8G8B8A8_SRGB,
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // Fill the other levels from the first, leaving all of them optimal for sampling.
+    veDevice.mipGenerator().generate(
+        textureImage,
+        m_format,
+        {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)},
+        mipLevels);
 }
 
 void VeTexture::createTextureImageFromPixels(const std::vector<unsigned char>& pixels,
@@ -312,11 +330,14 @@ void VeTexture::createTextureImageView() {
     viewInfo.format = m_format;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(veDevice.device(), &viewInfo, nullptr, &textureImageView) != VK_SUCCESS) {
+    if (vkCreateImageView(veDevice.device(),
+                          &viewInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &textureImageView) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture image view!");
     }
 }
@@ -333,7 +354,10 @@ void VeTexture::createCubemapImageView() {
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 6;
 
-    if (vkCreateImageView(veDevice.device(), &viewInfo, nullptr, &textureImageView) != VK_SUCCESS) {
+    if (vkCreateImageView(veDevice.device(),
+                          &viewInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &textureImageView) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture image view!");
     }
 
@@ -362,10 +386,13 @@ VkSampler VeTexture::createTextureSampler(VeDevice& veDevice) {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;  // Every mip level a texture has.
 
     VkSampler textureSampler{};
-    if (vkCreateSampler(veDevice.device(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+    if (vkCreateSampler(veDevice.device(),
+                        &samplerInfo,
+                        VeAllocTracker::callbacks(AllocScope::Device),
+                        &textureSampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
 
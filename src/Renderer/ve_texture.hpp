@@ -45,6 +45,7 @@ class VeTexture {
     VkImage textureImage{};
     VkDeviceMemory textureImageMemory{};
     VkImageView textureImageView{};
+    uint32_t mipLevels{1};
 };
 
 }  // namespace ve
\ No newline at end of file
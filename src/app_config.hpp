@@ -0,0 +1,38 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+
+namespace ve {
+
+// Command line options.
+struct AppConfig {
+    // Scene to load, one of VeScene::names(), and its size (0 for the scene's default).
+    std::string scene{"test"};
+    uint32_t sceneSize{0};
+    // With stressLights > 0 the scene is lit by that many small moving point lights instead of
+    // its own lights, and the average frame time is printed on exit.
+    uint32_t stressLights{0};
+    // Cull and draw on the CPU even when GPU driven rendering is supported.
+    bool cpuRendering{false};
+    // Merge objects sharing a model and material into instanced draws on the CPU path.
+    bool instancing{true};
+    // Record the main pass into secondary command buffers on recordingThreads threads (0 uses
+    // every hardware thread).
+    bool parallelRecording{false};
+    uint32_t recordingThreads{0};
+    // Measure CPU recording time with 1, 2, 4, ... recording threads, print the results and exit.
+    bool recordingBenchmark{false};
+    // Initial render settings, all of them can be toggled from the UI.
+    bool depthPrepass{false};
+    bool showOverdraw{false};
+    bool occlusionCulling{true};
+    // Render headlessFrames frames offscreen, without a window, print the average frame time and
+    // exit. They are preceded by warmupFrames frames that aren't timed.
+    bool headless{false};
+    uint32_t headlessFrames{0};
+    uint32_t warmupFrames{0};
+};
+
+}  // namespace ve
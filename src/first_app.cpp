@@ -1,14 +1,9 @@
 #include "first_app.hpp"
 
-#include "Core/camera_controller.hpp"
 #include "Core/movement_controller.hpp"
-#include "Core/ve_camera.hpp"
-#include "Core/ve_frame_info.hpp"
-#include "Core/ve_material.hpp"
-#include "Renderer/ve_texture.hpp"
-#include "systems/point_light_system.hpp"
-#include "systems/simple_render_system.hpp"
-#include "systems/skybox_render_system.hpp"
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -21,82 +16,92 @@
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace ve {
 
-struct GlobalUbo {
-    glm::mat4 projection{1.f};
-    glm::mat4 view{1.f};
-    glm::vec3 lightPosition{0.f, -4.f, 0.0};
-    alignas(16) glm::vec3 lightColor{150.f, 150.f, 150.f};
-    alignas(16) glm::vec3 viewPos;
+// Steps through recording thread counts, averaging the CPU time recording took with each.
+class FirstApp::RecordingBenchmark {
+   public:
+    explicit RecordingBenchmark(uint32_t maxThreads) {
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+        milliseconds.resize(threadCounts.size(), 0.0);
+    }
+
+    [[nodiscard]] uint32_t currentThreads() const { return threadCounts[step]; }
+
+    // Returns false once every thread count has been measured.
+    bool addFrame(float recordMilliseconds) {
+        frame++;
+        if (frame > WARMUP_FRAMES) {
+            milliseconds[step] += recordMilliseconds;
+        }
+        if (frame == WARMUP_FRAMES + MEASURED_FRAMES) {
+            milliseconds[step] /= MEASURED_FRAMES;
+            frame = 0;
+            step++;
+        }
+        return step < threadCounts.size();
+    }
+
+    void print(std::ostream &out) const {
+        out << "Recording benchmark, average over " << MEASURED_FRAMES << " frames:\n";
+        for (size_t i = 0; i < threadCounts.size(); i++) {
+            out << "\t" << std::setw(3) << threadCounts[i] << " threads: " << std::fixed
+                << std::setprecision(3) << milliseconds[i] << " ms, " << std::setprecision(2)
+                << milliseconds[0] / milliseconds[i] << "x\n";
+        }
+        out.unsetf(std::ios::fixed);
+    }
+
+   private:
+    static constexpr uint32_t WARMUP_FRAMES = 30;
+    static constexpr uint32_t MEASURED_FRAMES = 200;
+
+    std::vector<uint32_t> threadCounts;
+    std::vector<double> milliseconds;
+    size_t step{0};
+    uint32_t frame{0};
 };
 
-FirstApp::FirstApp() {
-    globalPool =
-        VeDescriptorPool::Builder(veDevice)
-            .setMaxSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VeSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .build();
+namespace {
 
+// Writes the CPU zones and the GPU scopes kept so far as one Chrome trace, viewable in
+// chrome://tracing or Perfetto.
+void writeTrace(const VeGpuProfiler *gpuProfiler) {
+    std::ofstream out{"trace.json"};
+    out << "{\"traceEvents\": [\n";
+    if (VeCpuProfiler::enabled()) {
+        VeCpuProfiler::writeTraceEvents(out);
+    }
+    if (gpuProfiler != nullptr) {
+        out << (VeCpuProfiler::enabled() ? ",\n" : "");
+        gpuProfiler->writeTraceEvents(out);
+    }
+    out << "\n]}\n";
+    std::cout << "Wrote trace.json\n";
+}
+
+}  // namespace
+
+FirstApp::FirstApp(const AppConfig &config) : config{config} {
     //    loadGameObjects();
     //    loadTestScene();
 
     initScene();
 }
 
-void FirstApp::run() {
-    // Set clear color.
-    veRenderer.setClearColor({0.05, 0.05, 0.05, 1.f});
-
-    // Create uniform buffer objects.
-    std::vector<std::unique_ptr<VeBuffer>> uboBuffers(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (auto& uboBuffer : uboBuffers) {
-        uboBuffer = std::make_unique<VeBuffer>(veDevice,
-                                               sizeof(GlobalUbo),
-                                               1,
-                                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        uboBuffer->map();
-    }
-
-    // Highest level set common to all of our shaders.
-    auto globalSetLayout =
-        VeDescriptorSetLayout::Builder(veDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-            .build();
-
-    std::vector<VkDescriptorSet> globalDescriptorSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++) {
-        // UBO info.
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-
-        // Write to descriptor.
-        VeDescriptorWriter(*globalSetLayout, *globalPool)
-            .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
-    }
+FirstApp::~FirstApp() = default;
 
-    // Initialize the render systems.
-    m_cubemap = VeTexture::createCubemapFromFile(veDevice, "assets/textures/skybox");
-    SkyboxSystem skyboxSystem{veDevice,
-                              veRenderer.getSwapChainRenderPass(),
-                              globalSetLayout->getDescriptorSetLayout(),
-                              m_cubemap};
-    SimpleRenderSystem simpleRenderSystem{veDevice,
-                                          veRenderer.getSwapChainRenderPass(),
-                                          globalSetLayout->getDescriptorSetLayout(),
-                                          gameObjects};
-    PointLightSystem pointLightSystem{
-        veDevice, veRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
-
-    // Initialize the camera and camera controller.
-    VeCamera camera{};
-    ArcballCam arcCam(veInput, glm::vec3(0.f, 0.f, 0.f));
-    MouseCameraController mouseCam(veInput, 25.f, 1.0f);
-    KeyboardCameraController keyCam(veInput, 25.f, 2.f);
+void FirstApp::run() {
+    initRenderer();
 
     // Initialize the current time.
     auto currentTime = std::chrono::high_resolution_clock::now();
@@ -104,7 +109,12 @@ void FirstApp::run() {
     uint64_t frame = 0;   // Current frame.
 
     // Start game loop.
+    VE_PROFILE_THREAD("main");
     while (!veWindow.shouldClose()) {
+        VE_PROFILE_FRAME();
+        VE_PROFILE_SCOPE("frame");
+        VeAllocTracker::beginFrame();
+
         // Update delta time.
         auto newTime = std::chrono::high_resolution_clock::now();
         float frameTime =
@@ -114,198 +124,248 @@ void FirstApp::run() {
         totalTime += frameTime;
 
         // Poll events.
-        veInput.pollEvents();
-        if (veInput.getKey(GLFW_KEY_ESCAPE)) break;
-
-        // Only update camera when mouse button is held.
-        if (veInput.getMouseButton(GLFW_MOUSE_BUTTON_LEFT) && !VeImGui::wantMouse()) {
-            veInput.setInputMode(GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-            mouseCam.update(camera, frameTime);
-        } else {
-            veInput.setInputMode(GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-            keyCam.update(camera, frameTime);
+        {
+            VE_PROFILE_SCOPE("poll input");
+            veInput.pollEvents();
         }
+        if (veInput.getKey(GLFW_KEY_ESCAPE)) break;
 
-        auto aspect = veRenderer.getAspectRatio();
-        camera.setPerspectiveProjection(glm::radians(50.f), aspect, .1, 1000);
-
-        // Imgui new frame
-        VeImGui::beginFrame();
-
-        // Imgui commands.
-        ImGui::ShowDemoWindow();
-
-        // Finalize the ImGui frame and prepare draw data.
-        ImGui::Render();
+        updateCamera(frameTime);
+        bool dumpRenderGraph = drawUi();
+        updateSettings();
 
         // beginFrame() will return a nullptr if swap chain needs to be recreated (window resized).
         if (auto commandBuffer = veRenderer.beginFrame()) {
-            int frameIndex = veRenderer.getFrameIndex();
-            FrameInfo frameInfo{frameIndex,
-                                frameTime,
-                                commandBuffer,
-                                camera,
-                                globalDescriptorSets[frameIndex],
-                                gameObjects};
-
-            // update
-            //  Set up ubo
-            GlobalUbo ubo{};
-            ubo.projection = camera.getProjection();
-            ubo.view = camera.getView();
-            ubo.viewPos = camera.getPosition();
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
-            uboBuffers[frameIndex]->flush();
-
-            // Begin render pass.
-            veRenderer.beginSwapChainRenderPass(commandBuffer);
-
-            simpleRenderSystem.renderGameObjects(frameInfo);
-            pointLightSystem.render(frameInfo);
-            skyboxSystem.renderSkybox(frameInfo);
-
-            // Render ImGui.
-            VeImGui::render(commandBuffer);
-
-            // End render pass and frame.
-            veRenderer.endSwapChainRenderPass(commandBuffer);
-            veRenderer.endFrame();
+            drawFrame(commandBuffer, frameTime, totalTime, dumpRenderGraph);
+            if (!stepRecordingBenchmark()) {
+                break;
+            }
         }
+
+        VeAllocTracker::endFrame(frame);
+        frame += 1;
     }
 
     // Wait for GPU to finish before exiting.
     vkDeviceWaitIdle(veDevice.device());
+    renderGraph.setProfiler(nullptr);
+
+    if (config.stressLights > 0 && frame > 0) {
+        std::cout << "Light stress: " << sceneRenderer->getPointLightSystem().getLights().size()
+                  << " lights, average frame time "
+                  << totalTime / static_cast<float>(frame) * 1000.f << " ms over " << frame
+                  << " frames\n";
+    }
 
-    frame += 1;
+    VeAllocTracker::printReport(std::cout);
 }
 
-void FirstApp::initScene() { 
-    loadAssets();
-    loadTestScene(); 
+void FirstApp::initScene() {
+    scene.load(config.scene, config.sceneSize);
+    if (config.stressLights > 0) {
+        scene.scatterLights(config.stressLights);
+    }
 }
 
-void FirstApp::loadAssets() {
-    // Load textures.
-    // m_textures["rustedIronAlbedo"] = VeTexture::createTextureFromFile(
-    //     veDevice, "assets/materials/rusted_iron2/rustediron2_albedo.png");
-    // m_textures["rustedIronMetallic"] = VeTexture::createTextureFromFile(
-    //     veDevice, "assets/materials/rusted_iron2/rustediron2_metallic.png");
-    // m_textures["rustedIronRoughness"] = VeTexture::createTextureFromFile(
-    //     veDevice, "assets/materials/rusted_iron2/rustediron2_roughness.png");
-    m_textures["empty"] = VeTexture::createEmptyTexture(veDevice);
-
-    // Load models.
-    m_models["cube"] = VeModel::createModelFromFile(veDevice, "assets/models/cube/cube.obj");
-    m_models["sphere"] = VeModel::createModelFromFile(veDevice, "assets/models/sphere.obj");
-
-    // Load materials.
-    m_materials["default"] = Material::createDefaultMaterial(veDevice);
+void FirstApp::initRenderer() {
+    // Set clear color.
+    veRenderer.setClearColor({0.05, 0.05, 0.05, 1.f});
+
+    // Initialize the render systems.
+    sceneRenderer = std::make_unique<SceneRenderer>(veDevice,
+                                                    renderGraph,
+                                                    scene,
+                                                    config,
+                                                    veRenderer.getSwapChainRenderPass(),
+                                                    veRenderer.getSwapChainDepthFormat());
+    sceneRenderer->setOverlay([](VkCommandBuffer cmd) { VeImGui::render(cmd); });
+    shadowCascades = static_cast<int>(sceneRenderer->getShadowRenderSystem().getCascadeCount());
+    pointShadowBudget = static_cast<int>(sceneRenderer->getPointShadowSystem().getFaceBudget());
+
+    if (config.parallelRecording) {
+        parallelRecorder = std::make_unique<VeParallelRecorder>(veDevice, config.recordingThreads);
+        std::cout << "Parallel recording on " << parallelRecorder->getThreadCount()
+                  << " threads\n";
+        sceneRenderer->setParallelRecorder(parallelRecorder.get());
+    }
+    if (config.recordingBenchmark) {
+        recordingBenchmark =
+            std::make_unique<RecordingBenchmark>(parallelRecorder->getThreadCount());
+    }
+
+    requestedSettings = {config.depthPrepass, config.showOverdraw, config.occlusionCulling};
+    settings = requestedSettings;
+    // Counts fragment shader invocations, to measure what the depth pre-pass saves. Secondaries
+    // executed inside the query have to inherit it, which needs inheritedQueries.
+    if (VePipelineStatistics::isSupported(veDevice) &&
+        (!parallelRecorder || veDevice.getEnabledFeatures().inheritedQueries)) {
+        pipelineStatistics = std::make_unique<VePipelineStatistics>(veDevice);
+        if (parallelRecorder) {
+            parallelRecorder->setInheritedPipelineStatistics(VePipelineStatistics::STATISTICS);
+        }
+    }
+
+    // Times the render graph's passes and the systems in the main pass.
+    if (VeGpuProfiler::isSupported(veDevice)) {
+        gpuProfiler = std::make_unique<VeGpuProfiler>(veDevice);
+        renderGraph.setProfiler(gpuProfiler.get());
+        sceneRenderer->setProfiler(gpuProfiler.get());
+    }
+
+    swapChainGeneration = veRenderer.getSwapChainGeneration();
 }
 
+void FirstApp::updateCamera(float frameTime) {
+    VE_PROFILE_SCOPE("update camera");
+    // Only update camera when mouse button is held.
+    if (veInput.getMouseButton(GLFW_MOUSE_BUTTON_LEFT) && !VeImGui::wantMouse()) {
+        veInput.setInputMode(GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        mouseCam.update(camera, frameTime);
+    } else {
+        veInput.setInputMode(GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        keyCam.update(camera, frameTime);
+    }
 
-void FirstApp::loadTestScene() {
-    // std::shared_ptr<VeTexture> woodTexture =
-        // VeTexture::createTextureFromFile(veDevice, "assets/textures/wood.png");
-    // std::shared_ptr<VeModel> sphereModel =
-    //     VeModel::createModelFromFile(veDevice, "assets/models/sphere.obj");
-    // std::shared_ptr<VeModel> cubeModel =
-    //     VeModel::createModelFromFile(veDevice, "assets/models/cube/cube.obj");
-    // std::shared_ptr<VeModel> monkeyModel =
-    //     VeModel::createModelFromFile(veDevice, "assets/models/suzanne.obj");
-    // std::shared_ptr<VeModel> bunnyModel =
-    //     VeModel::createModelFromFile(veDevice, "assets/models/bunny.obj");
-    // std::shared_ptr<VeModel> minecraft =
-    //     VeModel::createModelFromFile(veDevice, "assets/models/lost_empire/lost_empire.obj");
-
-    auto cubeObj = VeGameObject::createGameObject();
-    cubeObj.model = m_models["cube"];
-    cubeObj.transform.scale *= 5.0f;
-    cubeObj.material = m_materials["default"];
-    // cubeObj.albedoMap = m_textures["empty"];
-    // cubeObj.metallicMap = m_textures["empty"];
-    // cubeObj.roughnessMap = m_textures["empty"];
-    // cubeObj.aoMap = m_textures["empty"];
-    gameObjects.emplace(cubeObj.getId(), std::move(cubeObj));
-
-    int numSpheres = 4;
-
-    for (int i = 0; i < numSpheres; i++) {
-        for (int j = 0; j < numSpheres; j++) {
-            auto x = static_cast<float>(j);
-            auto y = static_cast<float>(i);
-            auto delta = 1.0f / static_cast<float>(numSpheres);
-
-            float metallic = y * delta;
-            float roughness = x * delta + 0.05f;
-            if (roughness > 1.0) {
-                roughness = 1.0;
-            }
+    auto aspect = veRenderer.getAspectRatio();
+    camera.setPerspectiveProjection(glm::radians(50.f), aspect, .1, 1000);
+}
 
-            auto sphereObj = VeGameObject::createGameObject();
-            sphereObj.model = m_models["sphere"];
-            sphereObj.transform.translation = {x * 2.5f, -y * 2.5f, 15.f};
-            sphereObj.material = m_materials["default"];
-            gameObjects.emplace(sphereObj.getId(), std::move(sphereObj));
+bool FirstApp::drawUi() {
+    VE_PROFILE_SCOPE("imgui");
+    // Imgui new frame
+    VeImGui::beginFrame();
+
+    // Imgui commands.
+    ImGui::ShowDemoWindow();
+    VeImGui::drawMemoryBudget(veDevice);
+    VeImGui::drawHostAllocations();
+    bool dumpRenderGraph = VeImGui::drawRenderGraph(renderGraph);
+    if (SimpleRenderSystem *simpleRenderSystem = sceneRenderer->getSimpleRenderSystem()) {
+        VeImGui::drawCullingStats(simpleRenderSystem->getCullStats(),
+                                  simpleRenderSystem->getSubmissionStats());
+    }
+    VeImGui::drawRenderSettings(requestedSettings, pipelineStatistics.get());
+    bool exportTrace = VeImGui::drawCpuProfiler();
+    exportTrace |= gpuProfiler && VeImGui::drawGpuProfiler(*gpuProfiler);
+    if (exportTrace) {
+        writeTrace(gpuProfiler.get());
+    }
+    VeImGui::drawLightStats(sceneRenderer->getClusteredLighting().getStats(),
+                            sceneRenderer->getPointLightSystem().getStats());
+    DirectionalLight &sun = sceneRenderer->getSun();
+    ShadowRenderSystem &shadowRenderSystem = sceneRenderer->getShadowRenderSystem();
+    VeImGui::drawShadows(sun, shadowCascades, shadowRenderSystem.getStats());
+    if (glm::dot(sun.direction, sun.direction) < 1e-6f) {
+        sun.direction = DirectionalLight{}.direction;
+    }
+    shadowRenderSystem.setCascadeCount(static_cast<uint32_t>(shadowCascades));
+    PointShadowSystem &pointShadowSystem = sceneRenderer->getPointShadowSystem();
+    VeImGui::drawPointShadows(pointShadowBudget, pointShadowSystem.getStats());
+    pointShadowSystem.setFaceBudget(static_cast<uint32_t>(pointShadowBudget));
+
+    // Finalize the ImGui frame and prepare draw data.
+    ImGui::Render();
+    return dumpRenderGraph;
+}
+
+void FirstApp::updateSettings() {
+    if (sceneRenderer->isPipelineReady(requestedSettings)) {
+        settings = requestedSettings;
+    }
+    // Every pipeline has been requested by now.
+    if (!loggedPipelineCache && veDevice.pipelineLibrary().getStats().pendingPipelines == 0) {
+        veDevice.pipelineCache().logStats();
+        sceneRenderer->logShaderPermutations();
+        loggedPipelineCache = true;
+    }
+}
+
+void FirstApp::drawFrame(VkCommandBuffer commandBuffer,
+                         float frameTime,
+                         float totalTime,
+                         bool dumpRenderGraph) {
+    int frameIndex = veRenderer.getFrameIndex();
+    if (gpuProfiler) {
+        gpuProfiler->beginFrame(commandBuffer, frameIndex);
+    }
+    if (parallelRecorder) {
+        if (recordingBenchmark) {
+            parallelRecorder->setActiveThreads(recordingBenchmark->currentThreads());
         }
+        parallelRecorder->beginFrame(frameIndex);
+    }
+    FrameInfo frameInfo{frameIndex,
+                        frameTime,
+                        commandBuffer,
+                        camera,
+                        sceneRenderer->getGlobalDescriptorSet(frameIndex),
+                        scene.getGameObjects(),
+                        settings};
+
+    sceneRenderer->update(frameInfo, totalTime, veRenderer.getSwapChainExtent());
+    addPasses(frameInfo);
+
+    renderGraph.compile();
+    if (dumpRenderGraph) {
+        renderGraph.dump(std::cout);
+    }
+    if (pipelineStatistics) {
+        pipelineStatistics->begin(commandBuffer, frameIndex);
+    }
+    renderGraph.execute(commandBuffer);
+    if (pipelineStatistics) {
+        pipelineStatistics->end(commandBuffer, frameIndex);
+    }
+    if (gpuProfiler) {
+        gpuProfiler->endFrame(commandBuffer);
+    }
+
+    // End frame.
+    veRenderer.endFrame();
+}
+
+void FirstApp::addPasses(FrameInfo &frameInfo) {
+    // Views of a recreated swap chain may reuse old handles, so don't trust the cache.
+    if (veRenderer.getSwapChainGeneration() != swapChainGeneration) {
+        swapChainGeneration = veRenderer.getSwapChainGeneration();
+        renderGraph.clearFramebuffers();
     }
 
-    //    auto cubeObj = VeGameObject::createGameObject();
-    //    cubeObj.model = cubeModel;
-    //    cubeObj.transform.scale *= 20.f;
-    //    cubeObj.transform.translation = {0.f, 10.f, 0.f};
-    //    cubeObj.texture = woodTexture;
-    //    cubeObj.material.roughness = 0.9f;
-    //    cubeObj.material.albedo = {0.9f, 0.9f, 0.9f};
-    //    cubeObj.material.metallic = 0.0f;
-    //    cubeObj.material.ao = 1.f;
-    //    gameObjects.emplace(cubeObj.getId(), std::move(cubeObj));
-    //
-    //    auto monkeyObj = VeGameObject::createGameObject();
-    //    monkeyObj.model = monkeyModel;
-    //    monkeyObj.texture = woodTexture;
-    //    monkeyObj.transform.translation = {-3.f, -3.f, 0.0f};
-    //    //    monkeyObj.transform.rotation = {M_PI, M_PI / 2.f, 0.f};
-    //    monkeyObj.transform.scale *= 3.0;
-    //    monkeyObj.material.roughness = 0.4f;
-    //    monkeyObj.material.albedo = {0.4f, 0.6f, 0.9f};
-    //    monkeyObj.material.metallic = 0.1f;
-    //    monkeyObj.material.ao = 1.f;
-    //    gameObjects.emplace(monkeyObj.getId(), std::move(monkeyObj));
-    //
-    //    auto bunnyObj = VeGameObject::createGameObject();
-    //    bunnyObj.model = bunnyModel;
-    //    bunnyObj.texture = woodTexture;
-    //    bunnyObj.transform.translation = {0.f, 0.f, 4.f};
-    //    bunnyObj.transform.rotation = {M_PI, 0.f, 0.f};
-    //    bunnyObj.material.roughness = 0.4f;
-    //    bunnyObj.material.albedo = {0.0f, 0.6f, 0.0f};
-    //    bunnyObj.material.metallic = 0.1f;
-    //    bunnyObj.material.ao = 1.f;
-    //    gameObjects.emplace(bunnyObj.getId(), std::move(bunnyObj));
-    //
-    //    auto minecraftObj = VeGameObject::createGameObject();
-    //    minecraftObj.model = minecraft;
-    //    minecraftObj.transform.rotation.x = M_PI;
-    //    minecraftObj.transform.translation.y = 50.f;
-    //    minecraftObj.texture = woodTexture;
-    //    minecraftObj.material.roughness = 0.9f;
-    //    minecraftObj.material.albedo = {0.9f, 0.9f, 0.9f};
-    //    minecraftObj.material.metallic = 0.0f;
-    //    minecraftObj.material.ao = 1.f;
-    //    gameObjects.emplace(minecraftObj.getId(), std::move(minecraftObj));
+    renderGraph.reset();
+    VkExtent2D extent = veRenderer.getSwapChainExtent();
+    auto backbuffer = renderGraph.importImage(
+        "backbuffer",
+        veRenderer.getSwapChainImage(),
+        veRenderer.getSwapChainImageView(),
+        {veRenderer.getSwapChainImageFormat(), extent, VK_IMAGE_ASPECT_COLOR_BIT},
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    auto depth = renderGraph.importImage(
+        "depth",
+        veRenderer.getSwapChainDepthImage(),
+        veRenderer.getSwapChainDepthImageView(),
+        {veRenderer.getSwapChainDepthFormat(), extent, VK_IMAGE_ASPECT_DEPTH_BIT},
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_UNDEFINED);
+    sceneRenderer->addPasses(frameInfo,
+                             {backbuffer,
+                              depth,
+                              veRenderer.getSwapChainDepthImageView(),
+                              extent,
+                              veRenderer.getClearColor()});
+}
+
+bool FirstApp::stepRecordingBenchmark() {
+    if (!recordingBenchmark) {
+        return true;
+    }
+    // The benchmark forces CPU rendering, see main.cpp.
+    const auto &submissionStats = sceneRenderer->getSimpleRenderSystem()->getSubmissionStats();
+    if (recordingBenchmark->addFrame(submissionStats.recordMilliseconds)) {
+        return true;
+    }
+    recordingBenchmark->print(std::cout);
+    return false;
 }
 
-// TODO: Sponza model does not work at all lol
-// void FirstApp::initSponzaScene() {
-//     std::shared_ptr<VeModel> sponzaModel =
-//         VeModel::createModelFromFile(veDevice, "models/sponza/sponza.obj");
-//     auto sponzaObj = VeGameObject::createGameObject();
-//     sponzaObj.model = sponzaModel;
-//     sponzaObj.material.roughness = 0.9f;
-//     sponzaObj.material.albedo = {0.9f, 0.9f, 0.9f};
-//     sponzaObj.material.metallic = 0.0f;
-//     sponzaObj.material.ao = 1.f;
-//     gameObjects.emplace(sponzaObj.getId(), std::move(sponzaObj));
-// }
-
-}  // namespace ve
\ No newline at end of file
+}  // namespace ve
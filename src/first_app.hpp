@@ -4,13 +4,21 @@
 #include <memory>
 #include <vector>
 
-#include "Core/ve_game_object.hpp"
+#include "Core/camera_controller.hpp"
+#include "Core/ve_camera.hpp"
+#include "Core/ve_frame_info.hpp"
 #include "Core/ve_input.hpp"
+#include "Core/ve_scene.hpp"
 #include "Core/ve_window.hpp"
 #include "ImGui/ve_imgui.h"
-#include "Renderer/ve_descriptors.hpp"
 #include "Renderer/ve_device.hpp"
+#include "Renderer/ve_gpu_profiler.hpp"
+#include "Renderer/ve_parallel_recorder.hpp"
+#include "Renderer/ve_pipeline_statistics.hpp"
+#include "Renderer/ve_render_graph.hpp"
 #include "Renderer/ve_renderer.hpp"
+#include "app_config.hpp"
+#include "scene_renderer.hpp"
 
 namespace ve {
 
@@ -19,8 +27,8 @@ class FirstApp {
     static constexpr int WIDTH = 1280;
     static constexpr int HEIGHT = 720;
 
-    FirstApp();
-    ~FirstApp() = default;
+    explicit FirstApp(const AppConfig &config = {});
+    ~FirstApp();
 
     // Remove copy constructors.
     FirstApp(const FirstApp &) = delete;
@@ -29,11 +37,25 @@ class FirstApp {
     void run();
 
    private:
+    class RecordingBenchmark;
+
     void initScene();
-    void loadAssets();
-    void loadGameObjects();
-    void loadTestScene();
-    void initSponzaScene();
+    // Creates the scene renderer, and the recorder and profilers the config asks for.
+    void initRenderer();
+
+    void updateCamera(float frameTime);
+    // Returns true if the render graph should be dumped this frame.
+    bool drawUi();
+    // Switches to the requested settings once their pipelines have compiled.
+    void updateSettings();
+    void drawFrame(VkCommandBuffer commandBuffer,
+                   float frameTime,
+                   float totalTime,
+                   bool dumpRenderGraph);
+    // Imports the swap chain's images and declares the frame's passes.
+    void addPasses(FrameInfo &frameInfo);
+    // Returns false once the recording benchmark has measured every thread count.
+    bool stepRecordingBenchmark();
 
    private:
     // NOTE: These classes need to be initialized in this order.
@@ -42,16 +64,30 @@ class FirstApp {
     VeDevice veDevice{veWindow};
     VeRenderer veRenderer{veWindow, veDevice};
     VeImGui veImGui{veRenderer};
+    VeRenderGraph renderGraph{veDevice};
+
+    AppConfig config;
+    VeScene scene{veDevice};
+    std::unique_ptr<SceneRenderer> sceneRenderer;
+    // The main pass is recorded into secondary command buffers on several threads.
+    std::unique_ptr<VeParallelRecorder> parallelRecorder;
+    std::unique_ptr<RecordingBenchmark> recordingBenchmark;
+    std::unique_ptr<VePipelineStatistics> pipelineStatistics;
+    std::unique_ptr<VeGpuProfiler> gpuProfiler;
 
-    std::unique_ptr<VeDescriptorPool> globalPool{};
-    VeGameObject::Map gameObjects;
-    std::shared_ptr<VeTexture> m_cubemap;
-    
-    // Assets
-    std::unordered_map<std::string, std::shared_ptr<VeTexture>> m_textures;
-    std::unordered_map<std::string, std::shared_ptr<VeModel>> m_models;
-    std::unordered_map<std::string, std::shared_ptr<Material>> m_materials;
+    // The UI edits requestedSettings, frames are drawn with settings. They only switch over once
+    // the pipelines for the requested settings have compiled in the background.
+    RenderSettings requestedSettings{};
+    RenderSettings settings{};
+    // The cache statistics and shader permutations are logged once every pipeline has compiled.
+    bool loggedPipelineCache{false};
+    int shadowCascades{0};
+    int pointShadowBudget{0};
 
+    VeCamera camera{};
+    MouseCameraController mouseCam{veInput, 25.f, 1.0f};
+    KeyboardCameraController keyCam{veInput, 25.f, 2.f};
+    uint64_t swapChainGeneration{0};
 };
 
 }  // namespace ve
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "headless.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_camera.hpp"
+#include "Core/ve_frame_info.hpp"
+#include "Renderer/ve_gpu_profiler.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+#include "scene_renderer.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ve {
+
+Headless::Headless(const AppConfig &config) : config{config} {
+    scene.load(config.scene, config.sceneSize);
+    if (config.stressLights > 0) {
+        scene.scatterLights(config.stressLights);
+    }
+}
+
+void Headless::run() {
+    veRenderer.setClearColor({0.05, 0.05, 0.05, 1.f});
+
+    // There is no swap chain render pass, pipelines are created against one compatible with the
+    // offscreen images.
+    VkRenderPass mainRenderPass = renderGraph.compatibleRenderPass({veRenderer.getColorFormat()},
+                                                                   veRenderer.getDepthFormat());
+    SceneRenderer sceneRenderer{
+        veDevice, renderGraph, scene, config, mainRenderPass, veRenderer.getDepthFormat()};
+    RenderSettings settings{config.depthPrepass, false, config.occlusionCulling};
+    // Times every render graph pass as well as the whole frame.
+    std::unique_ptr<VeGpuProfiler> gpuProfiler;
+    if (VeGpuProfiler::isSupported(veDevice)) {
+        gpuProfiler = std::make_unique<VeGpuProfiler>(veDevice);
+        renderGraph.setProfiler(gpuProfiler.get());
+        sceneRenderer.setProfiler(gpuProfiler.get());
+    }
+
+    // Frame times shouldn't include pipelines compiling in the background.
+    veDevice.pipelineLibrary().waitIdle();
+
+    VeCamera camera{};
+    VeCameraPath cameraPath = scene.cameraPath(PATH_DURATION);
+    camera.setPerspectiveProjection(
+        glm::radians(50.f), veRenderer.getAspectRatio(), .1f, 1000.f);
+
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    uint64_t frameCount = static_cast<uint64_t>(config.warmupFrames) + config.headlessFrames;
+    cpuTimes.clear();
+    gpuTimes.clear();
+    cpuTimes.reserve(config.headlessFrames);
+    gpuTimes.reserve(config.headlessFrames);
+    // GPU times are read back a few frames late, picks up the ones that came in since last time.
+    uint64_t nextGpuFrame = config.warmupFrames;
+    auto collectGpuTimes = [&]() {
+        for (size_t i = 0; gpuProfiler && i < gpuProfiler->getFrameCount(); i++) {
+            const auto &gpuFrame = gpuProfiler->getFrame(i);
+            if (gpuFrame.number >= nextGpuFrame) {
+                gpuTimes.push_back(gpuFrame.milliseconds);
+                nextGpuFrame = gpuFrame.number + 1;
+            }
+        }
+    };
+
+    auto startTime = clock::now();
+    for (uint64_t frame = 0; frame < frameCount; frame++) {
+        if (frame == config.warmupFrames) {
+            startTime = clock::now();
+        }
+        VeAllocTracker::beginFrame();
+
+        VkCommandBuffer commandBuffer = veRenderer.beginFrame();
+        auto cpuStart = clock::now();
+        int frameIndex = veRenderer.getFrameIndex();
+        if (gpuProfiler) {
+            gpuProfiler->beginFrame(commandBuffer, frameIndex);
+            collectGpuTimes();
+        }
+
+        float time = static_cast<float>(frame) * FRAME_TIME;
+        cameraPath.apply(camera, time);
+        FrameInfo frameInfo{frameIndex,
+                            FRAME_TIME,
+                            commandBuffer,
+                            camera,
+                            sceneRenderer.getGlobalDescriptorSet(frameIndex),
+                            scene.getGameObjects(),
+                            settings};
+
+        sceneRenderer.update(frameInfo, time, veRenderer.getExtent());
+
+        // Same passes as the windowed app, except the color image ends up ready to be copied
+        // instead of presented.
+        renderGraph.reset();
+        VkExtent2D extent = veRenderer.getExtent();
+        auto color = renderGraph.importImage(
+            "color",
+            veRenderer.getColorImage(),
+            veRenderer.getColorImageView(),
+            {veRenderer.getColorFormat(), extent, VK_IMAGE_ASPECT_COLOR_BIT},
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        auto depth = renderGraph.importImage(
+            "depth",
+            veRenderer.getDepthImage(),
+            veRenderer.getDepthImageView(),
+            {veRenderer.getDepthFormat(), extent, VK_IMAGE_ASPECT_DEPTH_BIT},
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_UNDEFINED);
+        sceneRenderer.addPasses(
+            frameInfo,
+            {color, depth, veRenderer.getDepthImageView(), extent, veRenderer.getClearColor()});
+
+        renderGraph.compile();
+        renderGraph.execute(commandBuffer);
+        if (gpuProfiler) {
+            gpuProfiler->endFrame(commandBuffer);
+        }
+        veRenderer.endFrame();
+        if (frame >= config.warmupFrames) {
+            cpuTimes.push_back(milliseconds(clock::now() - cpuStart).count());
+        }
+
+        VeAllocTracker::endFrame(frame);
+    }
+    vkDeviceWaitIdle(veDevice.device());
+    auto endTime = clock::now();
+    // The last frames in flight haven't been read back yet.
+    if (gpuProfiler) {
+        gpuProfiler->flush();
+        collectGpuTimes();
+        renderGraph.setProfiler(nullptr);
+    }
+
+    if (config.headlessFrames > 0) {
+        double frameTime =
+            milliseconds(endTime - startTime).count() / static_cast<double>(config.headlessFrames);
+        std::cout << "Headless: " << config.headlessFrames << " frames of scene " << config.scene
+                  << " at " << WIDTH << "x" << HEIGHT << ", average frame time " << frameTime
+                  << " ms\n";
+    }
+
+    VeAllocTracker::printReport(std::cout);
+
+    // Automated runs double as a validation check, so make errors fail them.
+    if (uint32_t errors = veDevice.getValidationErrorCount(); errors > 0) {
+        throw std::runtime_error("validation layers reported " + std::to_string(errors) +
+                                 " errors!");
+    }
+}
+
+}  // namespace ve
@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <memory>
+#include <vector>
+
+#include "Core/ve_scene.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_offscreen_renderer.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "app_config.hpp"
+
+namespace ve {
+
+// Renders the scene without a window, for automated runs on machines without a display.
+//
+// Frames go to offscreen images instead of a swap chain and are never presented, so they run as
+// fast as the GPU allows. Time advances by a fixed step every frame, so every run renders the same
+// frames however fast they are, with the camera following the scene's camera path. There is no
+// input or UI, so only the options the app starts with apply.
+class Headless {
+   public:
+    static constexpr uint32_t WIDTH = 1280;
+    static constexpr uint32_t HEIGHT = 720;
+    // Time between frames as seen by the scene.
+    static constexpr float FRAME_TIME = 1.f / 60.f;
+    // Time the camera takes to go around its path once.
+    static constexpr float PATH_DURATION = 20.f;
+
+    explicit Headless(const AppConfig &config);
+    ~Headless() = default;
+
+    // Remove copy constructors.
+    Headless(const Headless &) = delete;
+    Headless &operator=(const Headless &) = delete;
+
+    // Renders config.warmupFrames frames, then times config.headlessFrames more and prints their
+    // average frame time. Throws if the validation layers reported errors.
+    void run();
+
+    [[nodiscard]] const char *getDeviceName() const { return veDevice.properties.deviceName; }
+    // Milliseconds the CPU spent on each timed frame, without waiting for earlier frames.
+    [[nodiscard]] const std::vector<double> &getCpuTimes() const { return cpuTimes; }
+    // Milliseconds the GPU spent on each timed frame. Empty without GPU timestamps.
+    [[nodiscard]] const std::vector<double> &getGpuTimes() const { return gpuTimes; }
+
+   private:
+    // NOTE: These classes need to be initialized in this order.
+    VeDevice veDevice{};
+    VeOffscreenRenderer veRenderer{veDevice, {WIDTH, HEIGHT}};
+    VeRenderGraph renderGraph{veDevice};
+
+    AppConfig config;
+    VeScene scene{veDevice};
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+};
+
+}  // namespace ve
@@ -1,14 +1,78 @@
+#include <cctype>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 #include "first_app.hpp"
+#include "headless.hpp"
 
-int main() {
-    ve::FirstApp app{};
+int main(int argc, char **argv) {
+    // "--scene <name> [size]" loads one of the scenes of VeScene instead of the test scene.
+    // "--stress <count>" replaces the test scene with a grid of count spheres.
+    // "--lights <count>" lights the scene with count moving point lights.
+    // "--cpu" culls and draws on the CPU instead of on the GPU.
+    // "--no-instancing" gives every object its own draw on the CPU path.
+    // "--threads <count>" records the main pass on count threads, 0 for one per core.
+    // "--record-benchmark" compares recording times across thread counts and exits.
+    // "--depth-prepass" starts with the depth pre-pass enabled.
+    // "--overdraw" starts in the overdraw view.
+    // "--no-occlusion" starts with occlusion culling disabled.
+    // "--headless <frames>" renders frames offscreen without a window and exits. Only the
+    // scene and rendering options above apply.
+    // "--warmup <frames>" renders frames before the headless ones without timing them.
+    ve::AppConfig config{};
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            config.scene = argv[i + 1];
+            if (i + 2 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 2][0]))) {
+                config.sceneSize = static_cast<uint32_t>(std::strtoul(argv[i + 2], nullptr, 10));
+            }
+        } else if (std::strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            config.scene = "stress";
+            config.sceneSize = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            config.stressLights = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--cpu") == 0) {
+            config.cpuRendering = true;
+        } else if (std::strcmp(argv[i], "--no-instancing") == 0) {
+            config.instancing = false;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.parallelRecording = true;
+            config.recordingThreads =
+                static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--record-benchmark") == 0) {
+            // Instanced draws leave too little to record for threads to matter.
+            config.cpuRendering = true;
+            config.instancing = false;
+            config.parallelRecording = true;
+            config.recordingBenchmark = true;
+        } else if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+            config.depthPrepass = true;
+        } else if (std::strcmp(argv[i], "--overdraw") == 0) {
+            config.showOverdraw = true;
+        } else if (std::strcmp(argv[i], "--no-occlusion") == 0) {
+            config.occlusionCulling = false;
+        } else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            config.headless = true;
+            config.headlessFrames =
+                static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            config.warmupFrames = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        }
+    }
+    if (config.recordingBenchmark && config.scene == "test") {
+        config.scene = "stress";
+    }
 
     try {
-        app.run();
+        if (config.headless) {
+            ve::Headless app{config};
+            app.run();
+        } else {
+            ve::FirstApp app{config};
+            app.run();
+        }
     } catch (const std::exception &e) {
         std::cerr << e.what() << '\n';
         return EXIT_FAILURE;
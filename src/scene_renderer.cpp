@@ -0,0 +1,336 @@
+#include "scene_renderer.hpp"
+
+#include "Core/ve_cpu_profiler.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+namespace ve {
+
+SceneRenderer::SceneRenderer(VeDevice &device,
+                             VeRenderGraph &renderGraph,
+                             VeScene &scene,
+                             const AppConfig &config,
+                             VkRenderPass mainRenderPass,
+                             VkFormat depthFormat)
+    : veDevice{device},
+      renderGraph{renderGraph},
+      scene{scene},
+      globalSetLayout{createGlobalSetLayout(device)},
+      pointLightSystem{device, mainRenderPass, globalSetLayout->getDescriptorSetLayout()},
+      clusteredLighting{device},
+      shadowRenderSystem{device},
+      pointShadowSystem{device},
+      cubemap{VeTexture::createCubemapFromFile(device, "assets/textures/skybox")},
+      skyboxSystem{device, mainRenderPass, globalSetLayout->getDescriptorSetLayout(), cubemap} {
+    for (const auto &light : scene.getLights()) {
+        pointLightSystem.addLight(light);
+    }
+    createGlobalDescriptorSets();
+
+    // The depth pre-pass only has the depth attachment.
+    VkRenderPass depthRenderPass = renderGraph.compatibleRenderPass({}, depthFormat);
+    if (!config.cpuRendering && GpuDrivenRenderSystem::isSupported(veDevice)) {
+        gpuDrivenRenderSystem =
+            std::make_unique<GpuDrivenRenderSystem>(veDevice,
+                                                    mainRenderPass,
+                                                    depthRenderPass,
+                                                    globalSetLayout->getDescriptorSetLayout(),
+                                                    scene.getGameObjects());
+    } else {
+        simpleRenderSystem =
+            std::make_unique<SimpleRenderSystem>(veDevice,
+                                                 mainRenderPass,
+                                                 depthRenderPass,
+                                                 globalSetLayout->getDescriptorSetLayout(),
+                                                 scene.getGameObjects());
+        simpleRenderSystem->setInstancing(config.instancing);
+    }
+}
+
+std::unique_ptr<VeDescriptorSetLayout> SceneRenderer::createGlobalSetLayout(VeDevice &device) {
+    return VeDescriptorSetLayout::Builder(device)
+        .addBinding(0,
+                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(PointLightSystem::LIGHTS_BINDING,
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(VeClusteredLighting::CLUSTERS_BINDING,
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(VeClusteredLighting::LIGHT_INDICES_BINDING,
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(ShadowRenderSystem::SHADOW_MAP_BINDING,
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(PointShadowSystem::SHADOWS_BINDING,
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(PointShadowSystem::ATLAS_BINDING,
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build();
+}
+
+void SceneRenderer::createGlobalDescriptorSets() {
+    globalPool =
+        VeDescriptorPool::Builder(veDevice)
+            .setMaxSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         2 * VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+
+    uboBuffers.resize(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (auto &uboBuffer : uboBuffers) {
+        // Written every frame, so prefer device local memory when it is host visible as well.
+        uboBuffer = std::make_unique<VeBuffer>(
+            veDevice,
+            sizeof(GlobalUbo),
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            veDevice.properties.limits.minUniformBufferOffsetAlignment,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        uboBuffer->map();
+    }
+
+    globalDescriptorSets.resize(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < globalDescriptorSets.size(); i++) {
+        auto bufferInfo = uboBuffers[i]->descriptorInfo();
+        auto lightsInfo = pointLightSystem.lightsInfo(i);
+        auto clusterInfos = clusteredLighting.descriptorInfos(i);
+        auto shadowMapInfo = shadowRenderSystem.descriptorInfo(i);
+        auto pointShadowsInfo = pointShadowSystem.shadowsInfo(i);
+        auto pointShadowAtlasInfo = pointShadowSystem.atlasInfo(i);
+
+        VeDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(0, &bufferInfo)
+            .writeBuffer(PointLightSystem::LIGHTS_BINDING, &lightsInfo)
+            .writeBuffer(VeClusteredLighting::CLUSTERS_BINDING, &clusterInfos[0])
+            .writeBuffer(VeClusteredLighting::LIGHT_INDICES_BINDING, &clusterInfos[1])
+            .writeImage(ShadowRenderSystem::SHADOW_MAP_BINDING, &shadowMapInfo)
+            .writeBuffer(PointShadowSystem::SHADOWS_BINDING, &pointShadowsInfo)
+            .writeImage(PointShadowSystem::ATLAS_BINDING, &pointShadowAtlasInfo)
+            .build(globalDescriptorSets[i]);
+    }
+}
+
+bool SceneRenderer::isPipelineReady(const RenderSettings &settings) const {
+    return (!simpleRenderSystem || simpleRenderSystem->isPipelineReady(settings)) &&
+           (!gpuDrivenRenderSystem || gpuDrivenRenderSystem->isPipelineReady(settings));
+}
+
+void SceneRenderer::logShaderPermutations() {
+    if (simpleRenderSystem) {
+        simpleRenderSystem->logShaderPermutations();
+    }
+    if (gpuDrivenRenderSystem) {
+        gpuDrivenRenderSystem->logShaderPermutations();
+    }
+}
+
+void SceneRenderer::update(FrameInfo &frameInfo, float time, VkExtent2D extent) {
+    int frameIndex = frameInfo.frameIndex;
+
+    // Upload this frame's lights for the GPU to bin. The frame's descriptors are not in use
+    // anymore, so they can be pointed at a light buffer that had to grow.
+    if (scene.updateLights(time)) {
+        for (uint32_t i = 0; i < scene.getLights().size(); i++) {
+            pointLightSystem.setLight(i, scene.getLights()[i]);
+        }
+    }
+    if (pointLightSystem.update(frameInfo)) {
+        auto lightsInfo = pointLightSystem.lightsInfo(frameIndex);
+        VeDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(PointLightSystem::LIGHTS_BINDING, &lightsInfo)
+            .overwrite(globalDescriptorSets[frameIndex]);
+    }
+    clusteredLighting.update(frameIndex,
+                             pointLightSystem.lightsInfo(frameIndex),
+                             static_cast<uint32_t>(pointLightSystem.getLights().size()),
+                             frameInfo.camera,
+                             extent);
+    shadowRenderSystem.update(frameInfo, sun);
+    if (pointShadowSystem.update(frameInfo, pointLightSystem.getLights())) {
+        auto pointShadowsInfo = pointShadowSystem.shadowsInfo(frameIndex);
+        VeDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(PointShadowSystem::SHADOWS_BINDING, &pointShadowsInfo)
+            .overwrite(globalDescriptorSets[frameIndex]);
+    }
+
+    VE_PROFILE_SCOPE("update ubo");
+    GlobalUbo ubo{};
+    ubo.projection = frameInfo.camera.getProjection();
+    ubo.view = frameInfo.camera.getView();
+    ubo.viewPos = frameInfo.camera.getPosition();
+    ubo.clusters = clusteredLighting.uniforms();
+    ubo.shadows = shadowRenderSystem.uniforms(sun);
+    uboBuffers[frameIndex]->writeToBuffer(&ubo);
+    uboBuffers[frameIndex]->flush();
+}
+
+void SceneRenderer::addPasses(FrameInfo &frameInfo, const Targets &frameTargets) {
+    const RenderSettings &settings = frameInfo.settings;
+    targets = frameTargets;
+    // Overdraw is drawn additively over black, without the skybox hiding the background.
+    if (settings.showOverdraw) {
+        targets.clearColor = {{0.f, 0.f, 0.f, 1.f}};
+    }
+    shadowMap = shadowRenderSystem.addPasses(renderGraph, frameInfo.frameIndex);
+    pointShadowAtlas = pointShadowSystem.addPass(renderGraph, frameInfo.frameIndex);
+    clusteredLighting.addPass(renderGraph, frameInfo.frameIndex);
+
+    // Occlusion culling draws what was visible last frame first, builds a depth pyramid from it
+    // and then draws whatever that missed. Without a depth pre-pass the early draws get a pass of
+    // their own, since the pyramid has to be built in between.
+    occlusionCulling = gpuDrivenRenderSystem && settings.occlusionCulling;
+    mainPhases.clear();
+    if (!occlusionCulling || settings.depthPrepass) {
+        mainPhases.push_back(CullPhase::Early);
+    }
+    if (occlusionCulling) {
+        mainPhases.push_back(CullPhase::Late);
+    }
+
+    if (gpuDrivenRenderSystem) {
+        gpuDrivenRenderSystem->addCullPasses(renderGraph, frameInfo, targets.extent);
+    } else {
+        simpleRenderSystem->prepareDraws(frameInfo);
+    }
+
+    if (settings.depthPrepass) {
+        addDepthPrepass(frameInfo, "depth prepass", CullPhase::Early);
+        if (occlusionCulling) {
+            gpuDrivenRenderSystem->addOcclusionPasses(
+                renderGraph, frameInfo, targets.depth, targets.depthView);
+            addDepthPrepass(frameInfo, "depth prepass late", CullPhase::Late);
+        }
+    }
+    addMainPass(frameInfo);
+}
+
+// Lays down the final depth so the main pass only shades visible fragments. Cheap enough to
+// always record on this thread.
+void SceneRenderer::addDepthPrepass(FrameInfo &frameInfo, const char *name, CullPhase phase) {
+    renderGraph.addPass(
+        name,
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.writeDepth(targets.depth,
+                               phase == CullPhase::Early ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                                         : VK_ATTACHMENT_LOAD_OP_LOAD);
+            if (gpuDrivenRenderSystem) {
+                gpuDrivenRenderSystem->declareDrawReads(builder, phase);
+            }
+        },
+        [this, &frameInfo, phase](VkCommandBuffer cmd) {
+            FrameInfo prepassFrameInfo = frameInfo;
+            prepassFrameInfo.commandBuffer = cmd;
+            if (gpuDrivenRenderSystem) {
+                gpuDrivenRenderSystem->renderDepthPrepass(prepassFrameInfo, phase);
+            } else {
+                simpleRenderSystem->renderDepthPrepass(prepassFrameInfo);
+            }
+        });
+}
+
+void SceneRenderer::addMainPass(FrameInfo &frameInfo) {
+    bool depthPrepass = frameInfo.settings.depthPrepass;
+    bool mainClears = true;
+    if (occlusionCulling && !depthPrepass) {
+        renderGraph.addPass(
+            "main early",
+            [&](VeRenderGraph::PassBuilder &builder) {
+                builder.writeColor(targets.color, VK_ATTACHMENT_LOAD_OP_CLEAR, targets.clearColor);
+                builder.writeDepth(targets.depth);
+                builder.read(shadowMap, RGAccess::FragmentSampled);
+                builder.read(pointShadowAtlas, RGAccess::FragmentSampled);
+                clusteredLighting.declareReads(builder);
+                gpuDrivenRenderSystem->declareDrawReads(builder, CullPhase::Early);
+            },
+            [this, &frameInfo](VkCommandBuffer cmd) {
+                FrameInfo earlyFrameInfo = frameInfo;
+                earlyFrameInfo.commandBuffer = cmd;
+                gpuDrivenRenderSystem->render(earlyFrameInfo, CullPhase::Early);
+            });
+        gpuDrivenRenderSystem->addOcclusionPasses(
+            renderGraph, frameInfo, targets.depth, targets.depthView);
+        mainClears = false;
+    }
+
+    renderGraph.addPass(
+        "main",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.writeColor(
+                targets.color,
+                mainClears ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+                targets.clearColor);
+            builder.writeDepth(targets.depth,
+                               mainClears && !depthPrepass ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                                           : VK_ATTACHMENT_LOAD_OP_LOAD);
+            builder.read(shadowMap, RGAccess::FragmentSampled);
+            builder.read(pointShadowAtlas, RGAccess::FragmentSampled);
+            clusteredLighting.declareReads(builder);
+            if (gpuDrivenRenderSystem) {
+                for (CullPhase phase : mainPhases) {
+                    gpuDrivenRenderSystem->declareDrawReads(builder, phase);
+                }
+            }
+            if (parallelRecorder) {
+                builder.useSecondaryCommandBuffers();
+            }
+        },
+        [this, &frameInfo](VkCommandBuffer cmd) { renderMain(frameInfo, cmd); });
+}
+
+void SceneRenderer::renderMain(FrameInfo &frameInfo, VkCommandBuffer cmd) {
+    // Everything but the CPU culled objects, which the parallel recorder's workers record.
+    auto renderSystems = [&](FrameInfo &info) {
+        if (gpuDrivenRenderSystem) {
+            VeGpuProfiler::Scope scope{profiler, info.commandBuffer, "objects"};
+            for (CullPhase phase : mainPhases) {
+                gpuDrivenRenderSystem->render(info, phase);
+            }
+        }
+        {
+            VeGpuProfiler::Scope scope{profiler, info.commandBuffer, "point lights"};
+            pointLightSystem.render(info);
+        }
+        if (!info.settings.showOverdraw) {
+            VeGpuProfiler::Scope scope{profiler, info.commandBuffer, "skybox"};
+            skyboxSystem.renderSkybox(info);
+        }
+        if (overlay) {
+            VeGpuProfiler::Scope scope{profiler, info.commandBuffer, "overlay"};
+            overlay(info.commandBuffer);
+        }
+    };
+
+    if (parallelRecorder) {
+        const auto &target = renderGraph.getActiveRenderTarget();
+        parallelRecorder->beginRenderPass(target.renderPass, target.framebuffer, target.extent);
+        if (simpleRenderSystem) {
+            simpleRenderSystem->renderGameObjects(frameInfo, *parallelRecorder);
+        }
+        // The remaining systems are cheap, record them on this thread. Objects recorded by the
+        // workers are only timed as part of the pass.
+        parallelRecorder->recordInline([&](VkCommandBuffer secondary) {
+            FrameInfo secondaryFrameInfo = frameInfo;
+            secondaryFrameInfo.commandBuffer = secondary;
+            renderSystems(secondaryFrameInfo);
+        });
+        parallelRecorder->endRenderPass(cmd);
+        return;
+    }
+
+    FrameInfo mainFrameInfo = frameInfo;
+    mainFrameInfo.commandBuffer = cmd;
+    if (simpleRenderSystem) {
+        VeGpuProfiler::Scope scope{profiler, cmd, "objects"};
+        simpleRenderSystem->renderGameObjects(mainFrameInfo);
+    }
+    renderSystems(mainFrameInfo);
+}
+
+}  // namespace ve
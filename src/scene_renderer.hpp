@@ -0,0 +1,136 @@
+#pragma once
+
+// std
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Core/ve_frame_info.hpp"
+#include "Core/ve_scene.hpp"
+#include "Core/ve_shadow_cascades.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_clustered_lighting.hpp"
+#include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_gpu_profiler.hpp"
+#include "Renderer/ve_parallel_recorder.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "Renderer/ve_texture.hpp"
+#include "app_config.hpp"
+#include "systems/gpu_driven_render_system.hpp"
+#include "systems/point_light_system.hpp"
+#include "systems/point_shadow_system.hpp"
+#include "systems/shadow_render_system.hpp"
+#include "systems/simple_render_system.hpp"
+#include "systems/skybox_render_system.hpp"
+
+namespace ve {
+
+// Draws the scene for both the windowed and the headless app.
+//
+// Owns the global descriptor sets and the render systems. Every frame, update() fills in the
+// frame's lights, shadows and uniforms, and addPasses() declares the passes that draw the scene
+// into the frame's targets. Presenting or reading back the result is left to the app.
+class SceneRenderer {
+   public:
+    // Images a frame is drawn into, imported into the render graph by the app.
+    struct Targets {
+        RGHandle color;
+        RGHandle depth;
+        VkImageView depthView;  // The depth pyramid is built from it.
+        VkExtent2D extent;
+        VkClearColorValue clearColor;
+    };
+
+    // Pipelines are created against mainRenderPass, and against a depth only render pass with
+    // depthFormat for the pre-pass.
+    SceneRenderer(VeDevice &device,
+                  VeRenderGraph &renderGraph,
+                  VeScene &scene,
+                  const AppConfig &config,
+                  VkRenderPass mainRenderPass,
+                  VkFormat depthFormat);
+    ~SceneRenderer() = default;
+
+    // Remove copy constructors.
+    SceneRenderer(const SceneRenderer &) = delete;
+    SceneRenderer &operator=(const SceneRenderer &) = delete;
+
+    // Records the objects of the main pass on recorder's threads while non-null.
+    void setParallelRecorder(VeParallelRecorder *recorder) { parallelRecorder = recorder; }
+    // Times the systems drawn in the main pass while non-null.
+    void setProfiler(VeGpuProfiler *gpuProfiler) { profiler = gpuProfiler; }
+    // Recorded last in the main pass, for UI.
+    void setOverlay(VeRenderGraph::ExecuteFn overlayFn) { overlay = std::move(overlayFn); }
+
+    [[nodiscard]] VkDescriptorSet getGlobalDescriptorSet(int frameIndex) const {
+        return globalDescriptorSets[frameIndex];
+    }
+    [[nodiscard]] bool isPipelineReady(const RenderSettings &settings) const;
+    void logShaderPermutations();
+
+    // Moves the scene's lights to time, then updates the lights, shadows and uniforms frameInfo's
+    // frame reads. The frame's descriptors must not be in use anymore.
+    void update(FrameInfo &frameInfo, float time, VkExtent2D extent);
+    // Declares the shadow, culling, pre-pass and main passes of frameInfo's frame. frameInfo must
+    // outlive the render graph's execute().
+    void addPasses(FrameInfo &frameInfo, const Targets &targets);
+
+    [[nodiscard]] DirectionalLight &getSun() { return sun; }
+    [[nodiscard]] PointLightSystem &getPointLightSystem() { return pointLightSystem; }
+    [[nodiscard]] VeClusteredLighting &getClusteredLighting() { return clusteredLighting; }
+    [[nodiscard]] ShadowRenderSystem &getShadowRenderSystem() { return shadowRenderSystem; }
+    [[nodiscard]] PointShadowSystem &getPointShadowSystem() { return pointShadowSystem; }
+    // Null when objects are drawn by the GPU driven render system.
+    [[nodiscard]] SimpleRenderSystem *getSimpleRenderSystem() { return simpleRenderSystem.get(); }
+
+   private:
+    using CullPhase = GpuDrivenRenderSystem::CullPhase;
+
+    static std::unique_ptr<VeDescriptorSetLayout> createGlobalSetLayout(VeDevice &device);
+    void createGlobalDescriptorSets();
+
+    void addDepthPrepass(FrameInfo &frameInfo, const char *name, CullPhase phase);
+    void addMainPass(FrameInfo &frameInfo);
+    void renderMain(FrameInfo &frameInfo, VkCommandBuffer cmd);
+
+    VeDevice &veDevice;
+    VeRenderGraph &renderGraph;
+    VeScene &scene;
+
+    std::unique_ptr<VeDescriptorPool> globalPool;
+    std::vector<std::unique_ptr<VeBuffer>> uboBuffers;
+    // Highest level set common to all of our shaders.
+    std::unique_ptr<VeDescriptorSetLayout> globalSetLayout;
+    std::vector<VkDescriptorSet> globalDescriptorSets;
+
+    // Point lights are binned into clusters on the GPU every frame, so shading only loops over
+    // nearby ones.
+    // The light system owns the lights, which both its billboards and shading read.
+    PointLightSystem pointLightSystem;
+    VeClusteredLighting clusteredLighting;
+    // The sun casts shadows through a cascaded shadow map.
+    DirectionalLight sun{};
+    ShadowRenderSystem shadowRenderSystem;
+    // The point lights covering the most of the screen cast shadows through a shared atlas.
+    PointShadowSystem pointShadowSystem;
+    std::shared_ptr<VeTexture> cubemap;
+    SkyboxSystem skyboxSystem;
+    // Objects are culled and drawn on the GPU when the device allows it, and culled and instanced
+    // on the CPU otherwise.
+    std::unique_ptr<GpuDrivenRenderSystem> gpuDrivenRenderSystem;
+    std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
+
+    VeParallelRecorder *parallelRecorder{nullptr};
+    VeGpuProfiler *profiler{nullptr};
+    VeRenderGraph::ExecuteFn overlay;
+
+    // The frame being declared, read by the pass callbacks.
+    Targets targets{};
+    RGHandle shadowMap;
+    RGHandle pointShadowAtlas;
+    bool occlusionCulling{false};
+    std::vector<CullPhase> mainPhases;
+};
+
+}  // namespace ve
@@ -0,0 +1,713 @@
+#include "gpu_driven_render_system.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
+// lib
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace ve {
+
+namespace {
+
+constexpr uint32_t CULL_GROUP_SIZE = 64;  // Must match local_size_x in gpu_cull.comp.
+// Distance, in bounding sphere radii, at which objects switch to their first lower detail LOD.
+constexpr float LOD_DISTANCE = 20.f;
+
+// Laid out to match std430 in gpu_cull.comp and gpu_driven.vert.
+struct ObjectData {
+    glm::mat4 modelMatrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+    glm::vec4 boundingSphere{0.f};
+    uint32_t firstBatch{0};
+    uint32_t lodCount{1};
+    uint32_t slot{0};
+    uint32_t pad{0};
+};
+
+struct BatchData {
+    uint32_t firstCommand;
+    uint32_t indexCount;
+};
+
+// Must match the flags in gpu_cull.comp.
+constexpr uint32_t CULL_FLAG_COMPACT = 1;
+constexpr uint32_t CULL_FLAG_OCCLUSION = 2;
+constexpr uint32_t CULL_FLAG_LATE = 4;
+
+struct CullPushConstantData {
+    glm::vec4 frustumPlanes[6];
+    glm::vec4 cameraPosition;
+    uint32_t objectCount;
+    uint32_t flags;
+    glm::uvec2 depthSize;
+};
+static_assert(sizeof(CullPushConstantData) <= 128, "Push constants are only guaranteed 128 bytes");
+
+}  // namespace
+
+GpuDrivenRenderSystem::GpuDrivenRenderSystem(VeDevice &device,
+                                             VkRenderPass renderPass,
+                                             VkRenderPass depthRenderPass,
+                                             VkDescriptorSetLayout globalSetLayout,
+                                             VeGameObject::Map &gameObjects)
+    : veDevice{device}, gameObjects{gameObjects} {
+    assert(isSupported(veDevice) && "GPU driven rendering needs drawIndirectFirstInstance");
+
+    // Counting draws on the GPU needs both the extension and multi draw indirect, since a single
+    // call covers a whole batch.
+    compact = veDevice.drawIndexedIndirectCount() != nullptr &&
+              veDevice.getEnabledFeatures().multiDrawIndirect;
+    stats.indirectCount = compact;
+
+    textureSampler = VeTexture::createTextureSampler(veDevice);
+    depthPyramid = std::make_unique<VeDepthPyramid>(veDevice);
+
+    createBatches();
+    createBuffers();
+    createMaterialSets();
+    createDescriptorSets();
+    createPipelineLayouts(globalSetLayout);
+    createPipelines(renderPass, depthRenderPass);
+    markTransformsDirty();
+
+    std::cout << "GPU driven rendering: " << objectIds.size() << " objects in " << batches.size()
+              << " batches, "
+              << (compact ? "vkCmdDrawIndexedIndirectCountKHR" : "multi draw indirect") << "\n";
+}
+
+GpuDrivenRenderSystem::~GpuDrivenRenderSystem() {
+    vkDestroySampler(veDevice.device(),
+                     textureSampler,
+                     VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            cullPipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            drawPipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+bool GpuDrivenRenderSystem::isSupported(VeDevice &device) {
+    return device.getEnabledFeatures().drawIndirectFirstInstance == VK_TRUE;
+}
+
+void GpuDrivenRenderSystem::createBatches() {
+    // Group objects by model and material. Every LOD of a group gets its own batch, and the
+    // batches of a group are consecutive so an object only needs to know the first one. Groups
+    // are ordered by shader permutation first, so each permutation's pipeline is bound once.
+    std::map<std::tuple<uint32_t, VeModel *, Material *>, std::vector<VeGameObject::id_t>> groups;
+    for (const auto &[id, obj] : gameObjects) {
+        if (obj.model == nullptr || obj.material == nullptr) {
+            continue;
+        }
+        groups[{obj.material->getFeatures(), obj.model.get(), obj.material.get()}].push_back(id);
+    }
+
+    // A counted draw covers a whole batch and can't be split, so with compaction larger groups
+    // are split into batches of at most maxDrawIndirectCount.
+    uint32_t maxGroupSize = compact ? veDevice.properties.limits.maxDrawIndirectCount : UINT32_MAX;
+    for (auto &[key, ids] : groups) {
+        auto [features, model, material] = key;
+        if (std::find(usedFeatures.begin(), usedFeatures.end(), features) == usedFeatures.end()) {
+            usedFeatures.push_back(features);
+        }
+        std::vector<VeModel *> lods{model};
+        for (const auto &lod : model->getLods()) {
+            lods.push_back(lod.get());
+        }
+
+        for (size_t first = 0; first < ids.size(); first += maxGroupSize) {
+            auto firstBatch = static_cast<uint32_t>(batches.size());
+            auto groupSize =
+                static_cast<uint32_t>(std::min<size_t>(ids.size() - first, maxGroupSize));
+            for (VeModel *lod : lods) {
+                if (!lod->hasIndices()) {
+                    throw std::runtime_error("GPU driven rendering requires indexed models!");
+                }
+                batches.push_back({lod, VK_NULL_HANDLE, features, commandCount, groupSize});
+                commandCount += groupSize;
+            }
+
+            for (uint32_t slot = 0; slot < groupSize; slot++) {
+                objectIds.push_back(ids[first + slot]);
+                objectFirstBatch.push_back(firstBatch);
+                objectSlot.push_back(slot);
+            }
+        }
+    }
+
+    stats.objects = static_cast<uint32_t>(objectIds.size());
+    stats.batches = static_cast<uint32_t>(batches.size());
+}
+
+void GpuDrivenRenderSystem::createBuffers() {
+    // Buffers can't be empty, so keep at least one element around.
+    uint32_t objectCount = std::max<uint32_t>(static_cast<uint32_t>(objectIds.size()), 1);
+    uint32_t batchCount = std::max<uint32_t>(static_cast<uint32_t>(batches.size()), 1);
+    uint32_t maxCommands = std::max<uint32_t>(commandCount, 1);
+
+    // Batch layout never changes after this.
+    std::vector<BatchData> batchData(batchCount, BatchData{0, 0});
+    for (size_t i = 0; i < batches.size(); i++) {
+        batchData[i] = {batches[i].firstCommand, batches[i].model->getIndexCount()};
+    }
+    batchBuffer = std::make_unique<VeBuffer>(veDevice,
+                                             sizeof(BatchData),
+                                             batchCount,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             1,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    batchBuffer->map();
+    batchBuffer->writeToBuffer(batchData.data());
+    batchBuffer->unmap();
+
+    // Each frame in flight gets its own copies, so culling the next frame never races with the
+    // draws of the previous one.
+    for (int i = 0; i < VeSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        auto objectBuffer = std::make_unique<VeBuffer>(veDevice,
+                                                       sizeof(ObjectData),
+                                                       objectCount,
+                                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                       1,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        objectBuffer->map();
+        objectBuffers.push_back(std::move(objectBuffer));
+
+        for (auto &draws : phaseDraws[i]) {
+            draws.drawBuffer = std::make_unique<VeBuffer>(
+                veDevice,
+                sizeof(VkDrawIndexedIndirectCommand),
+                maxCommands,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            draws.countBuffer = std::make_unique<VeBuffer>(
+                veDevice,
+                sizeof(uint32_t),
+                batchCount,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+    }
+
+    // Nothing was visible before the first frame, so its late phase draws everything it keeps.
+    visibilityBuffer = std::make_unique<VeBuffer>(
+        veDevice,
+        sizeof(uint32_t),
+        objectCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkCommandBuffer commandBuffer = veDevice.beginSingleTimeCommands();
+    vkCmdFillBuffer(commandBuffer, visibilityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+    veDevice.endSingleTimeCommands(commandBuffer);
+}
+
+void GpuDrivenRenderSystem::createMaterialSets() {
+    std::vector<Material *> materials;
+    for (const auto &[id, obj] : gameObjects) {
+        if (obj.material != nullptr &&
+            std::find(materials.begin(), materials.end(), obj.material.get()) == materials.end()) {
+            materials.push_back(obj.material.get());
+        }
+    }
+    auto materialCount = static_cast<uint32_t>(std::max<size_t>(materials.size(), 1));
+    auto frameCount = static_cast<uint32_t>(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    descriptorPool =
+        VeDescriptorPool::Builder(veDevice)
+            .setMaxSets(materialCount + (CULL_PHASES + 1) * frameCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         4 * materialCount + CULL_PHASES * frameCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, materialCount)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (5 * CULL_PHASES + 1) * frameCount)
+            .build();
+
+    // Same layout as the material set of SimpleRenderSystem, so pbr.frag can be shared.
+    materialLayout = VeDescriptorSetLayout::Builder(veDevice)
+                         .addBinding(0,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Albedo
+                         .addBinding(1,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Metallic
+                         .addBinding(2,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Roughness
+                         .addBinding(3,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // AO
+                         .addBinding(4,
+                                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Uniform buffer
+                         .build();
+
+    for (Material *material : materials) {
+        auto ubo = std::make_unique<VeBuffer>(veDevice,
+                                              sizeof(DeviceMaterial),
+                                              1,
+                                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        ubo->map();
+        DeviceMaterial mat{};
+        mat.albedo = material->m_albedo;
+        mat.metallic = material->m_metallic;
+        mat.roughness = material->m_roughness;
+        mat.ao = material->m_ao;
+        ubo->writeToBuffer(&mat);
+        ubo->flush();
+        auto bufferInfo = ubo->descriptorInfo();
+        materialUBOs.push_back(std::move(ubo));
+
+        std::array<VkDescriptorImageInfo, 4> imageInfos{};
+        std::array<VeTexture *, 4> textures{material->m_albedoMap.get(),
+                                            material->m_metallicMap.get(),
+                                            material->m_roughnessMap.get(),
+                                            material->m_aoMap.get()};
+        for (size_t i = 0; i < textures.size(); i++) {
+            imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos[i].imageView = textures[i]->imageView();
+            imageInfos[i].sampler = textureSampler;
+        }
+
+        VkDescriptorSet descriptorSet{};
+        VeDescriptorWriter(*materialLayout, *descriptorPool)
+            .writeImage(0, &imageInfos[0])
+            .writeImage(1, &imageInfos[1])
+            .writeImage(2, &imageInfos[2])
+            .writeImage(3, &imageInfos[3])
+            .writeBuffer(4, &bufferInfo)
+            .build(descriptorSet);
+        materialDescriptorSets.emplace(material, descriptorSet);
+    }
+
+    // Batches were created before the sets existed, hook them up now.
+    for (size_t i = 0; i < objectIds.size(); i++) {
+        const auto &obj = gameObjects.at(objectIds[i]);
+        auto lodCount = static_cast<uint32_t>(obj.model->getLods().size()) + 1;
+        for (uint32_t lod = 0; lod < lodCount; lod++) {
+            batches[objectFirstBatch[i] + lod].materialSet =
+                materialDescriptorSets.at(obj.material.get());
+        }
+    }
+}
+
+void GpuDrivenRenderSystem::createDescriptorSets() {
+    cullLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+    objectLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    auto batchInfo = batchBuffer->descriptorInfo();
+    auto visibilityInfo = visibilityBuffer->descriptorInfo();
+    for (int i = 0; i < VeSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        auto objectInfo = objectBuffers[i]->descriptorInfo();
+
+        // The depth pyramid (binding 5) is written once the depth buffer size is known.
+        for (auto &draws : phaseDraws[i]) {
+            auto drawInfo = draws.drawBuffer->descriptorInfo();
+            auto countInfo = draws.countBuffer->descriptorInfo();
+            VeDescriptorWriter(*cullLayout, *descriptorPool)
+                .writeBuffer(0, &objectInfo)
+                .writeBuffer(1, &batchInfo)
+                .writeBuffer(2, &drawInfo)
+                .writeBuffer(3, &countInfo)
+                .writeBuffer(4, &visibilityInfo)
+                .build(draws.cullSet);
+        }
+
+        VkDescriptorSet objectSet{};
+        VeDescriptorWriter(*objectLayout, *descriptorPool)
+            .writeBuffer(0, &objectInfo)
+            .build(objectSet);
+        objectDescriptorSets.push_back(objectSet);
+    }
+}
+
+void GpuDrivenRenderSystem::createPipelineLayouts(VkDescriptorSetLayout globalSetLayout) {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstantData);
+
+    // Occlusion culling projects bounds with the camera matrices of the global set.
+    std::vector<VkDescriptorSetLayout> cullSetLayouts{cullLayout->getDescriptorSetLayout(),
+                                                      globalSetLayout};
+    VkPipelineLayoutCreateInfo cullLayoutInfo{};
+    cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    cullLayoutInfo.setLayoutCount = static_cast<uint32_t>(cullSetLayouts.size());
+    cullLayoutInfo.pSetLayouts = cullSetLayouts.data();
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &cullLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    std::vector<VkDescriptorSetLayout> drawSetLayouts{globalSetLayout,
+                                                      materialLayout->getDescriptorSetLayout(),
+                                                      objectLayout->getDescriptorSetLayout()};
+    VkPipelineLayoutCreateInfo drawLayoutInfo{};
+    drawLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    drawLayoutInfo.setLayoutCount = static_cast<uint32_t>(drawSetLayouts.size());
+    drawLayoutInfo.pSetLayouts = drawSetLayouts.data();
+    drawLayoutInfo.pushConstantRangeCount = 0;
+    drawLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &drawLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &drawPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+}
+
+void GpuDrivenRenderSystem::createPipelines(VkRenderPass renderPass,
+                                            VkRenderPass depthRenderPass) {
+    assert(cullPipelineLayout != nullptr && drawPipelineLayout != nullptr &&
+           "Cannot create pipelines before layouts");
+
+    cullPipeline = std::make_unique<VeComputePipeline>(
+        veDevice, "../assets/shaders/gpu_cull.comp.spv", cullPipelineLayout);
+
+    for (uint32_t variant = 0; variant < RenderSettings::PIPELINE_VARIANTS; variant++) {
+        RenderSettings settings = RenderSettings::fromPipelineVariant(variant);
+        PipelineConfigInfo pipelineConfig{};
+        VePipeline::defaultPipelineConfigInfo(pipelineConfig);
+        if (settings.depthPrepass) {
+            VePipeline::depthPrepassedPipelineConfigInfo(pipelineConfig);
+        }
+        if (settings.showOverdraw) {
+            VePipeline::overdrawPipelineConfigInfo(pipelineConfig);
+        }
+        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.pipelineLayout = drawPipelineLayout;
+        // As in SimpleRenderSystem, only permutations in use are compiled and the overdraw
+        // shader shares one pipeline across them.
+        for (uint32_t features : usedFeatures) {
+            if (!settings.showOverdraw) {
+                pipelineConfig.fragmentConstants = MaterialFeatures::fragmentConstants(features);
+            }
+            drawPipelines[variant][features] = veDevice.pipelineLibrary().requestPipeline(
+                "../assets/shaders/gpu_driven.vert.spv",
+                settings.showOverdraw ? "../assets/shaders/overdraw.frag.spv"
+                                      : "../assets/shaders/pbr.frag.spv",
+                pipelineConfig);
+        }
+    }
+
+    PipelineConfigInfo depthConfig{};
+    VePipeline::depthOnlyPipelineConfigInfo(depthConfig);
+    depthConfig.renderPass = depthRenderPass;
+    depthConfig.pipelineLayout = drawPipelineLayout;
+    depthPipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/gpu_driven_depth.vert.spv", "", depthConfig);
+}
+
+bool GpuDrivenRenderSystem::isPipelineReady(const RenderSettings &settings) const {
+    for (uint32_t features : usedFeatures) {
+        if (!ve::isPipelineReady(drawPipelines[settings.pipelineVariant()][features])) {
+            return false;
+        }
+    }
+    return ve::isPipelineReady(depthPipeline);
+}
+
+void GpuDrivenRenderSystem::logShaderPermutations() {
+    // The pre-pass only changes the depth test, the shaded variant without it stands for both.
+    std::cout << "pbr.frag permutations in use: " << usedFeatures.size() << "\n";
+    for (uint32_t features : usedFeatures) {
+        std::cout << "  " << MaterialFeatures::name(features) << ", "
+                  << std::bitset<MaterialFeatures::COUNT>(features).count()
+                  << " material samples\n";
+        drawPipelines[0][features].get()->logFragmentStatistics();
+    }
+}
+
+void GpuDrivenRenderSystem::uploadObjects(int frameIndex) {
+    auto *objects = static_cast<ObjectData *>(objectBuffers[frameIndex]->getMappedMemory());
+    for (size_t i = 0; i < objectIds.size(); i++) {
+        const auto &obj = gameObjects.at(objectIds[i]);
+        ObjectData data{};
+        data.modelMatrix = obj.transform.mat4();
+        data.normalMatrix = glm::mat4(obj.transform.normalMatrix());
+        const BoundingSphere &sphere = obj.model->getBoundingSphere();
+        data.boundingSphere = glm::vec4(sphere.center, sphere.radius);
+        data.firstBatch = objectFirstBatch[i];
+        data.lodCount = static_cast<uint32_t>(obj.model->getLods().size()) + 1;
+        data.slot = objectSlot[i];
+        objects[i] = data;
+    }
+    dirtyFrames[frameIndex] = false;
+}
+
+void GpuDrivenRenderSystem::addCullPasses(VeRenderGraph &renderGraph,
+                                          FrameInfo &frameInfo,
+                                          VkExtent2D depthExtent) {
+    int frameIndex = frameInfo.frameIndex;
+    if (dirtyFrames[frameIndex]) {
+        uploadObjects(frameIndex);
+    }
+    occlusionCulling = frameInfo.settings.occlusionCulling;
+    stats.drawCalls = 0;
+
+    // Both phases bind the pyramid, even when only the late one samples it.
+    depthPyramid->resize(depthExtent);
+    auto pyramidInfo = depthPyramid->descriptorInfo(frameIndex);
+    for (auto &draws : phaseDraws[frameIndex]) {
+        VeDescriptorWriter(*cullLayout, *descriptorPool)
+            .writeImage(5, &pyramidInfo)
+            .overwrite(draws.cullSet);
+    }
+
+    visibilityHandle = renderGraph.importBuffer("visibility",
+                                                visibilityBuffer->getBuffer(),
+                                                visibilityBuffer->getBufferSize());
+    addCullPhase(renderGraph, frameInfo, CullPhase::Early, RGHandle{});
+}
+
+void GpuDrivenRenderSystem::addOcclusionPasses(VeRenderGraph &renderGraph,
+                                               FrameInfo &frameInfo,
+                                               RGHandle depth,
+                                               VkImageView depthView) {
+    assert(occlusionCulling && "Occlusion culling is disabled this frame");
+    RGHandle pyramid =
+        depthPyramid->addBuildPass(renderGraph, depth, depthView, frameInfo.frameIndex);
+    addCullPhase(renderGraph, frameInfo, CullPhase::Late, pyramid);
+}
+
+void GpuDrivenRenderSystem::addCullPhase(VeRenderGraph &renderGraph,
+                                         FrameInfo &frameInfo,
+                                         CullPhase phase,
+                                         RGHandle pyramid) {
+    int frameIndex = frameInfo.frameIndex;
+    auto phaseIndex = static_cast<size_t>(phase);
+    bool late = phase == CullPhase::Late;
+    const PhaseDraws &draws = phaseDraws[frameIndex][phaseIndex];
+
+    RGHandle drawHandle = renderGraph.importBuffer(late ? "late indirect draws" : "indirect draws",
+                                                   draws.drawBuffer->getBuffer(),
+                                                   draws.drawBuffer->getBufferSize());
+    RGHandle countHandle = renderGraph.importBuffer(late ? "late draw counts" : "draw counts",
+                                                    draws.countBuffer->getBuffer(),
+                                                    draws.countBuffer->getBufferSize());
+    drawHandles[phaseIndex] = drawHandle;
+    countHandles[phaseIndex] = countHandle;
+
+    CullPushConstantData push{};
+    Frustum frustum = frameInfo.camera.getFrustum();
+    std::copy(frustum.planes.begin(), frustum.planes.end(), push.frustumPlanes);
+    push.cameraPosition = glm::vec4(frameInfo.camera.getPosition(), LOD_DISTANCE);
+    push.objectCount = static_cast<uint32_t>(objectIds.size());
+    push.flags = (compact ? CULL_FLAG_COMPACT : 0) |
+                 (occlusionCulling ? CULL_FLAG_OCCLUSION : 0) | (late ? CULL_FLAG_LATE : 0);
+    VkExtent2D depthExtent = depthPyramid->getDepthExtent();
+    push.depthSize = {depthExtent.width, depthExtent.height};
+
+    if (compact) {
+        renderGraph.addPass(
+            late ? "gpu cull reset late" : "gpu cull reset",
+            [&](VeRenderGraph::PassBuilder &builder) {
+                builder.write(countHandle, RGAccess::TransferWrite);
+            },
+            [countBuffer = draws.countBuffer->getBuffer()](VkCommandBuffer commandBuffer) {
+                vkCmdFillBuffer(commandBuffer, countBuffer, 0, VK_WHOLE_SIZE, 0);
+            });
+    }
+
+    renderGraph.addPass(
+        late ? "gpu cull late" : "gpu cull",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.write(drawHandle, RGAccess::ComputeStorageWrite);
+            if (compact) {
+                builder.write(countHandle, RGAccess::ComputeStorageWrite);
+            }
+            if (late) {
+                builder.read(pyramid, RGAccess::ComputeStorageRead);
+                builder.write(visibilityHandle, RGAccess::ComputeStorageWrite);
+            } else if (occlusionCulling) {
+                builder.read(visibilityHandle, RGAccess::ComputeStorageRead);
+            }
+        },
+        [this,
+         push,
+         cullSet = draws.cullSet,
+         globalSet = frameInfo.globalDescriptorSet,
+         waitForVisibility = occlusionCulling && !late](VkCommandBuffer commandBuffer) {
+            if (push.objectCount == 0) {
+                return;
+            }
+            // The graph only orders accesses within the frame. Visibility was written by the
+            // late phase of the previous frame.
+            if (waitForVisibility) {
+                VeComputePipeline::computeWriteBarrier(commandBuffer,
+                                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                       VK_ACCESS_SHADER_READ_BIT);
+            }
+
+            std::array<VkDescriptorSet, 2> sets{cullSet, globalSet};
+            cullPipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    cullPipelineLayout,
+                                    0,
+                                    static_cast<uint32_t>(sets.size()),
+                                    sets.data(),
+                                    0,
+                                    nullptr);
+            vkCmdPushConstants(commandBuffer,
+                               cullPipelineLayout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(CullPushConstantData),
+                               &push);
+            vkCmdDispatch(commandBuffer,
+                          VeComputePipeline::groupCount(push.objectCount, CULL_GROUP_SIZE),
+                          1,
+                          1);
+        });
+}
+
+void GpuDrivenRenderSystem::declareDrawReads(VeRenderGraph::PassBuilder &builder,
+                                             CullPhase phase) const {
+    auto phaseIndex = static_cast<size_t>(phase);
+    builder.read(drawHandles[phaseIndex], RGAccess::IndirectRead);
+    if (compact) {
+        builder.read(countHandles[phaseIndex], RGAccess::IndirectRead);
+    }
+}
+
+void GpuDrivenRenderSystem::renderDepthPrepass(FrameInfo &frameInfo, CullPhase phase) {
+    VE_PROFILE_SCOPE("GpuDrivenRenderSystem::renderDepthPrepass");
+    depthPipeline.get()->bind(frameInfo.commandBuffer);
+    drawBatches(frameInfo, phase, true);
+}
+
+void GpuDrivenRenderSystem::render(FrameInfo &frameInfo, CullPhase phase) {
+    VE_PROFILE_SCOPE("GpuDrivenRenderSystem::render");
+    // Pipelines are bound per batch, by the permutation of its material.
+    drawBatches(frameInfo, phase, false);
+}
+
+void GpuDrivenRenderSystem::drawBatches(FrameInfo &frameInfo, CullPhase phase, bool depthOnly) {
+    int frameIndex = frameInfo.frameIndex;
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    const PhaseDraws &draws = phaseDraws[frameIndex][static_cast<size_t>(phase)];
+    VkBuffer drawBuffer = draws.drawBuffer->getBuffer();
+    VkBuffer countBuffer = draws.countBuffer->getBuffer();
+    constexpr auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+    uint32_t maxDrawCount = veDevice.properties.limits.maxDrawIndirectCount;
+    bool multiDraw = veDevice.getEnabledFeatures().multiDrawIndirect;
+
+    std::array<VkDescriptorSet, 1> globalSet{frameInfo.globalDescriptorSet};
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            drawPipelineLayout,
+                            0,
+                            1,
+                            globalSet.data(),
+                            0,
+                            nullptr);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            drawPipelineLayout,
+                            2,
+                            1,
+                            &objectDescriptorSets[frameIndex],
+                            0,
+                            nullptr);
+
+    // Only draws that shade count, the depth pre-pass repeats them.
+    uint32_t drawCalls = 0;
+    const auto &variantPipelines = drawPipelines[frameInfo.settings.pipelineVariant()];
+    uint32_t boundFeatures = UINT32_MAX;
+    VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        const auto &batch = batches[i];
+        if (!depthOnly && batch.features != boundFeatures) {
+            variantPipelines[batch.features].get()->bind(commandBuffer);
+            boundFeatures = batch.features;
+        }
+        if (depthOnly) {
+            batch.model->bindPositions(commandBuffer);
+        } else {
+            batch.model->bind(commandBuffer);
+        }
+        if (!depthOnly && batch.materialSet != boundMaterial) {
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    drawPipelineLayout,
+                                    1,
+                                    1,
+                                    &batch.materialSet,
+                                    0,
+                                    nullptr);
+            boundMaterial = batch.materialSet;
+        }
+
+        VkDeviceSize offset = static_cast<VkDeviceSize>(batch.firstCommand) * stride;
+        if (compact) {
+            assert(batch.maxCommands <= maxDrawCount && "createBatches() splits larger batches");
+            veDevice.drawIndexedIndirectCount()(commandBuffer,
+                                                drawBuffer,
+                                                offset,
+                                                countBuffer,
+                                                i * sizeof(uint32_t),
+                                                batch.maxCommands,
+                                                stride);
+            drawCalls++;
+        } else if (multiDraw) {
+            for (uint32_t first = 0; first < batch.maxCommands; first += maxDrawCount) {
+                uint32_t drawCount = std::min(batch.maxCommands - first, maxDrawCount);
+                vkCmdDrawIndexedIndirect(commandBuffer,
+                                         drawBuffer,
+                                         offset + static_cast<VkDeviceSize>(first) * stride,
+                                         drawCount,
+                                         stride);
+                drawCalls++;
+            }
+        } else {
+            // Last resort: one indirect draw per slot. Still culled on the GPU, but recording
+            // cost grows with the object count again.
+            for (uint32_t slot = 0; slot < batch.maxCommands; slot++) {
+                vkCmdDrawIndexedIndirect(commandBuffer,
+                                         drawBuffer,
+                                         offset + static_cast<VkDeviceSize>(slot) * stride,
+                                         1,
+                                         stride);
+                drawCalls++;
+            }
+        }
+    }
+    if (!depthOnly) {
+        stats.drawCalls += drawCalls;
+    }
+}
+
+}  // namespace ve
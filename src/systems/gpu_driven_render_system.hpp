@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Core/ve_frame_info.hpp"
+#include "Core/ve_game_object.hpp"
+#include "Core/ve_material.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_compute_pipeline.hpp"
+#include "Renderer/ve_depth_pyramid.hpp"
+#include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Renders game objects without touching them on the CPU every frame.
+//
+// Transforms, bounds and per-batch draw arguments live in storage buffers. Each frame a compute
+// pass frustum culls every object, picks its level of detail and appends an indexed indirect draw
+// for it to the batch of its (model LOD, material) pair. The batches are then drawn with one
+// vkCmdDrawIndexedIndirectCountKHR each, so recording cost depends on the number of batches and
+// not on the number of objects. Without VK_KHR_draw_indirect_count every object keeps a fixed slot
+// and culled ones are written with zero instances, drawn with a multi-draw-indirect call instead.
+//
+// Occlusion culling splits culling in two phases. The early phase draws the objects that were
+// visible last frame. A depth pyramid is built from the depth they leave behind, and the late phase
+// tests every object against it, drawing the ones the early phase missed. Each phase has its own
+// draw buffers, and the frame's passes have to draw both.
+class GpuDrivenRenderSystem {
+   public:
+    enum class CullPhase { Early, Late };
+    static constexpr uint32_t CULL_PHASES = 2;
+
+    struct Stats {
+        uint32_t objects{0};
+        uint32_t batches{0};
+        uint32_t drawCalls{0};  // Draw calls recorded on the CPU last frame.
+        bool indirectCount{false};
+    };
+
+    // depthRenderPass is a depth-only render pass the depth pre-pass pipeline is created against.
+    GpuDrivenRenderSystem(VeDevice &device,
+                          VkRenderPass renderPass,
+                          VkRenderPass depthRenderPass,
+                          VkDescriptorSetLayout globalSetLayout,
+                          VeGameObject::Map &gameObjects);
+    ~GpuDrivenRenderSystem();
+
+    // Remove copy constructors.
+    GpuDrivenRenderSystem(const GpuDrivenRenderSystem &) = delete;
+    GpuDrivenRenderSystem &operator=(const GpuDrivenRenderSystem &) = delete;
+
+    // Objects are looked up in the vertex shader through firstInstance, which needs the
+    // drawIndirectFirstInstance feature.
+    static bool isSupported(VeDevice &device);
+
+    // Whether the pipelines drawing with these settings have finished compiling in the background.
+    [[nodiscard]] bool isPipelineReady(const RenderSettings &settings) const;
+    // Prints each shader permutation the materials use, with the driver's statistics for it.
+    // Waits for the permutations to compile.
+    void logShaderPermutations();
+
+    // Transforms are only uploaded when they change. Call after moving game objects.
+    void markTransformsDirty() { dirtyFrames.fill(true); }
+
+    // Adds the early culling passes to the graph. Without occlusion culling the early phase draws
+    // every visible object. Passes calling render() or renderDepthPrepass() must declare the draws
+    // they consume with declareDrawReads().
+    void addCullPasses(VeRenderGraph &renderGraph, FrameInfo &frameInfo, VkExtent2D depthExtent);
+    // Builds the depth pyramid from depth holding the early draws and adds the late culling
+    // passes. Only when frameInfo.settings.occlusionCulling is set.
+    void addOcclusionPasses(VeRenderGraph &renderGraph,
+                            FrameInfo &frameInfo,
+                            RGHandle depth,
+                            VkImageView depthView);
+    void declareDrawReads(VeRenderGraph::PassBuilder &builder, CullPhase phase) const;
+    // Writes depth only, reusing the draws the culling pass generated for render().
+    void renderDepthPrepass(FrameInfo &frameInfo, CullPhase phase);
+    void render(FrameInfo &frameInfo, CullPhase phase);
+
+    [[nodiscard]] const Stats &getStats() const { return stats; }
+
+   private:
+    // Draws of one model LOD with one material.
+    struct Batch {
+        VeModel *model;
+        VkDescriptorSet materialSet;
+        uint32_t features;  // MaterialFeatures of the material, selecting the permutation.
+        uint32_t firstCommand;
+        uint32_t maxCommands;
+    };
+
+    // Draws written by one culling phase of one frame in flight.
+    struct PhaseDraws {
+        std::unique_ptr<VeBuffer> drawBuffer;
+        std::unique_ptr<VeBuffer> countBuffer;
+        VkDescriptorSet cullSet{VK_NULL_HANDLE};
+    };
+
+    void createBatches();
+    void createMaterialSets();
+    void createBuffers();
+    void createDescriptorSets();
+    void createPipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+    void createPipelines(VkRenderPass renderPass, VkRenderPass depthRenderPass);
+    void uploadObjects(int frameIndex);
+    // Adds the count reset and culling dispatch of a phase. The late phase tests against pyramid.
+    void addCullPhase(VeRenderGraph &renderGraph,
+                      FrameInfo &frameInfo,
+                      CullPhase phase,
+                      RGHandle pyramid);
+    // Records the indirect draws of every batch, binding materials unless only depth is drawn.
+    void drawBatches(FrameInfo &frameInfo, CullPhase phase, bool depthOnly);
+
+    VeDevice &veDevice;
+    VeGameObject::Map &gameObjects;
+    bool compact;  // Whether draws are compacted and counted on the GPU.
+
+    // Objects in the order they are stored in the object buffer.
+    std::vector<VeGameObject::id_t> objectIds;
+    std::vector<uint32_t> objectFirstBatch;
+    std::vector<uint32_t> objectSlot;
+    std::vector<Batch> batches;
+    uint32_t commandCount{0};
+    std::array<bool, VeSwapChain::MAX_FRAMES_IN_FLIGHT> dirtyFrames{};
+
+    std::unique_ptr<VeBuffer> batchBuffer;
+    std::vector<std::unique_ptr<VeBuffer>> objectBuffers;
+    std::array<std::array<PhaseDraws, CULL_PHASES>, VeSwapChain::MAX_FRAMES_IN_FLIGHT> phaseDraws;
+    // Written by the late phase, read by the early phase of the next frame. Shared by the frames
+    // in flight, since each frame needs the results of the one before it.
+    std::unique_ptr<VeBuffer> visibilityBuffer;
+    std::vector<std::unique_ptr<VeBuffer>> materialUBOs;
+    std::unique_ptr<VeDepthPyramid> depthPyramid;
+    bool occlusionCulling{false};  // Whether this frame culls in two phases.
+
+    std::unique_ptr<VeDescriptorPool> descriptorPool{};
+    std::unique_ptr<VeDescriptorSetLayout> cullLayout{};
+    std::unique_ptr<VeDescriptorSetLayout> objectLayout{};
+    std::unique_ptr<VeDescriptorSetLayout> materialLayout{};
+    std::vector<VkDescriptorSet> objectDescriptorSets;
+    std::unordered_map<Material *, VkDescriptorSet> materialDescriptorSets;
+    VkSampler textureSampler{};
+
+    VkPipelineLayout cullPipelineLayout{};
+    VkPipelineLayout drawPipelineLayout{};
+    std::unique_ptr<VeComputePipeline> cullPipeline;
+    // Indexed by RenderSettings::pipelineVariant(), then by MaterialFeatures. Only the features
+    // in usedFeatures have a pipeline.
+    std::array<std::array<PipelineFuture, MaterialFeatures::PERMUTATIONS>,
+               RenderSettings::PIPELINE_VARIANTS>
+        drawPipelines;
+    std::vector<uint32_t> usedFeatures;
+    PipelineFuture depthPipeline;
+
+    // Graph handles of this frame's buffers.
+    std::array<RGHandle, CULL_PHASES> drawHandles{};
+    std::array<RGHandle, CULL_PHASES> countHandles{};
+    RGHandle visibilityHandle{};
+
+    Stats stats{};
+};
+
+}  // namespace ve
@@ -1,5 +1,8 @@
 #include "point_light_system.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,6 +10,7 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <iostream>
@@ -14,16 +18,140 @@
 
 namespace ve {
 
+namespace {
+
+// Enough for the test scene, larger scenes grow the buffers.
+constexpr uint32_t INITIAL_LIGHTS = 256;
+
+}  // namespace
+
 PointLightSystem::PointLightSystem(VeDevice& device,
                                    VkRenderPass renderPass,
                                    VkDescriptorSetLayout globalSetLayout)
     : veDevice{device} {
+    createFrameData();
     createPipelineLayout(globalSetLayout);
     createPipeline(renderPass);
 }
 
 PointLightSystem::~PointLightSystem() {
-    vkDestroyPipelineLayout(veDevice.device(), pipelineLayout, nullptr);
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void PointLightSystem::createFrameData() {
+    lightPool = VeDescriptorPool::Builder(veDevice)
+                    .setMaxSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                    .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                    .build();
+    visibleLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    for (auto& frame : frames) {
+        frame.lights = createBuffer(sizeof(PointLight), INITIAL_LIGHTS);
+        frame.visibleLights = createBuffer(sizeof(uint32_t), INITIAL_LIGHTS);
+        auto bufferInfo = frame.visibleLights->descriptorInfo();
+        VeDescriptorWriter(*visibleLayout, *lightPool)
+            .writeBuffer(0, &bufferInfo)
+            .build(frame.visibleSet);
+    }
+}
+
+std::unique_ptr<VeBuffer> PointLightSystem::createBuffer(VkDeviceSize elementSize,
+                                                         uint32_t count) {
+    auto buffer = std::make_unique<VeBuffer>(veDevice,
+                                             elementSize,
+                                             count,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             1,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    buffer->map();
+    return buffer;
+}
+
+uint32_t PointLightSystem::addLight(const PointLight& light) {
+    auto id = static_cast<uint32_t>(lights.size());
+    lights.push_back(light);
+    dirtyFrames.push_back(0);
+    setLight(id, light);
+    return id;
+}
+
+void PointLightSystem::setLight(uint32_t id, const PointLight& light) {
+    assert(id < lights.size() && "Light does not exist");
+    lights[id] = light;
+    for (uint32_t i = 0; i < VeSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        auto frameBit = static_cast<uint8_t>(1u << i);
+        if ((dirtyFrames[id] & frameBit) == 0) {
+            dirtyFrames[id] |= frameBit;
+            frames[i].dirty.push_back(id);
+        }
+    }
+}
+
+bool PointLightSystem::update(FrameInfo& frameInfo) {
+    VE_PROFILE_SCOPE("PointLightSystem::update");
+    FrameData& frame = frames[frameInfo.frameIndex];
+    auto frameBit = static_cast<uint8_t>(1u << frameInfo.frameIndex);
+    stats = {};
+
+    // The frame's fence has been waited on, so nothing reads its buffers anymore. Replaced
+    // buffers go through the deletion queue all the same.
+    bool reallocated = false;
+    if (lights.size() > frame.lights->getInstanceCount()) {
+        uint32_t capacity = frame.lights->getInstanceCount();
+        while (capacity < lights.size()) {
+            capacity *= 2;
+        }
+        frame.lights = createBuffer(sizeof(PointLight), capacity);
+        frame.visibleLights = createBuffer(sizeof(uint32_t), capacity);
+        auto bufferInfo = frame.visibleLights->descriptorInfo();
+        VeDescriptorWriter(*visibleLayout, *lightPool)
+            .writeBuffer(0, &bufferInfo)
+            .overwrite(frame.visibleSet);
+        reallocated = true;
+    }
+
+    // A new buffer has to be written in full, otherwise only the lights that changed.
+    auto* mapped = static_cast<PointLight*>(frame.lights->getMappedMemory());
+    if (reallocated) {
+        std::copy(lights.begin(), lights.end(), mapped);
+        stats.uploaded = static_cast<uint32_t>(lights.size());
+    } else {
+        for (uint32_t id : frame.dirty) {
+            mapped[id] = lights[id];
+        }
+        stats.uploaded = static_cast<uint32_t>(frame.dirty.size());
+    }
+    for (uint32_t id : frame.dirty) {
+        dirtyFrames[id] &= static_cast<uint8_t>(~frameBit);
+    }
+    frame.dirty.clear();
+
+    // Cull the billboards and list the survivors for the instanced draw.
+    billboardBounds.clear();
+    billboardBounds.reserve(lights.size());
+    for (const auto& light : lights) {
+        billboardBounds.add({light.position - glm::vec3{BILLBOARD_RADIUS},
+                             light.position + glm::vec3{BILLBOARD_RADIUS}});
+    }
+    visibility.resize(lights.size());
+    cullBoxes(frameInfo.camera.getFrustum(), billboardBounds, visibility.data());
+    auto* visible = static_cast<uint32_t*>(frame.visibleLights->getMappedMemory());
+    visibleCount = 0;
+    for (uint32_t id = 0; id < lights.size(); id++) {
+        if (visibility[id]) {
+            visible[visibleCount++] = id;
+        }
+    }
+    stats.drawn = visibleCount;
+    return reallocated;
 }
 
 void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -32,7 +160,8 @@ void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayou
     pushConstantRange.offset = 0;
     // pushConstantRange.size = sizeof(SimplePushConstantData);
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout, visibleLayout->getDescriptorSetLayout()};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -40,7 +169,10 @@ void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayou
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
     pipelineLayoutInfo.pushConstantRangeCount = 0;
     pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if (vkCreatePipelineLayout(veDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &pipelineLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
@@ -55,25 +187,35 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
     pipelineConfig.attributeDescriptions.clear();
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
-    vePipeline = std::make_unique<VePipeline>(
-        veDevice, "../assets/shaders/point_light.vert.spv", "../assets/shaders/point_light.frag.spv", pipelineConfig);
+    vePipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/point_light.vert.spv",
+        "../assets/shaders/point_light.frag.spv",
+        pipelineConfig);
 }
 
 void PointLightSystem::render(FrameInfo& frameInfo) {
+    VE_PROFILE_SCOPE("PointLightSystem::render");
+    if (visibleCount == 0) {
+        return;
+    }
+
     // Bind the pipeline.
-    vePipeline->bind(frameInfo.commandBuffer);
+    vePipeline.get()->bind(frameInfo.commandBuffer);
 
     // Only being bound once, not per object
+    std::array<VkDescriptorSet, 2> descriptorSets{frameInfo.globalDescriptorSet,
+                                                  frames[frameInfo.frameIndex].visibleSet};
     vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             pipelineLayout,
                             0,
-                            1,
-                            &frameInfo.globalDescriptorSet,
+                            static_cast<uint32_t>(descriptorSets.size()),
+                            descriptorSets.data(),
                             0,
                             nullptr);
 
-    vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+    // Six vertices per billboard, one instance per visible light.
+    vkCmdDraw(frameInfo.commandBuffer, 6, visibleCount, 0, 0);
 }
 
 }  // namespace ve
\ No newline at end of file
@@ -1,19 +1,37 @@
 #pragma once
 
 // std
+#include <array>
 #include <memory>
 #include <vector>
 
 #include "Core/ve_camera.hpp"
+#include "Core/ve_culling.hpp"
 #include "Core/ve_frame_info.hpp"
 #include "Core/ve_game_object.hpp"
+#include "Core/ve_light_clusters.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_descriptors.hpp"
 #include "Renderer/ve_device.hpp"
-#include "Renderer/ve_pipeline.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+#include "Renderer/ve_swap_chain.hpp"
 
 namespace ve {
 
+// Owns the scene's point lights and draws a billboard for each of them.
+//
+// Lights live in a persistently mapped storage buffer per frame in flight, which is both what the
+// billboards are drawn from and what pbr.frag shades with, through the global set. Changing a
+// light only marks it dirty, and a frame's buffer is only written for the lights that changed
+// since that buffer was last written. Billboards are frustum culled on the CPU and the survivors
+// drawn with one instanced draw.
 class PointLightSystem {
    public:
+    // Global set binding of the light buffer, the global UBO being binding 0.
+    static constexpr uint32_t LIGHTS_BINDING = 1;
+    // Must match LIGHT_RADIUS in point_light.vert.
+    static constexpr float BILLBOARD_RADIUS = 0.1f;
+
     PointLightSystem(VeDevice &device,
                      VkRenderPass renderPass,
                      VkDescriptorSetLayout globalSetLayout);
@@ -23,17 +41,56 @@ class PointLightSystem {
     PointLightSystem(const PointLightSystem &) = delete;
     PointLightSystem &operator=(const PointLightSystem &) = delete;
 
+    // Returns the id of the new light, which is its index in getLights().
+    uint32_t addLight(const PointLight &light);
+    void setLight(uint32_t id, const PointLight &light);
+    [[nodiscard]] const std::vector<PointLight> &getLights() const { return lights; }
+
+    // Writes the lights that changed into the frame's buffer and culls the billboards. Call once
+    // per frame, before render(). Returns true when the frame's light buffer had to grow, in which
+    // case the global set's LIGHTS_BINDING has to be written again before it is used.
+    bool update(FrameInfo &frameInfo);
+    [[nodiscard]] VkDescriptorBufferInfo lightsInfo(int frameIndex) const {
+        return frames[frameIndex].lights->descriptorInfo();
+    }
+
     void render(FrameInfo &frameInfo);
 
+    [[nodiscard]] const PointLightStats &getStats() const { return stats; }
+
    private:
+    struct FrameData {
+        std::unique_ptr<VeBuffer> lights;
+        std::unique_ptr<VeBuffer> visibleLights;
+        VkDescriptorSet visibleSet{};
+        // Lights changed since this frame's buffer was last written.
+        std::vector<uint32_t> dirty;
+    };
+
+    void createFrameData();
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
     void createPipeline(VkRenderPass renderPass);
+    // Host visible storage buffer holding count elements, mapped for the CPU to write.
+    std::unique_ptr<VeBuffer> createBuffer(VkDeviceSize elementSize, uint32_t count);
 
    private:
     VeDevice &veDevice;
 
-    std::unique_ptr<VePipeline> vePipeline;
+    PipelineFuture vePipeline;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::unique_ptr<VeDescriptorPool> lightPool;
+    std::unique_ptr<VeDescriptorSetLayout> visibleLayout;
+
+    std::vector<PointLight> lights;
+    // Bit i is set while the light is in frames[i].dirty.
+    std::vector<uint8_t> dirtyFrames;
+    std::array<FrameData, VeSwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+    uint32_t visibleCount{0};
+
+    // Culling scratch space, kept between frames so it doesn't allocate.
+    CullBoxes billboardBounds;
+    std::vector<uint8_t> visibility;
+    PointLightStats stats{};
 };
 
-}  // namespace ve
\ No newline at end of file
+}  // namespace ve
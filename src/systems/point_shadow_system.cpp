@@ -0,0 +1,802 @@
+#include "point_shadow_system.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+#include "Core/ve_camera.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+// Enough for the test scene, larger scenes grow the buffers.
+constexpr uint32_t INITIAL_INSTANCES = 256;
+constexpr uint32_t INITIAL_LIGHTS = 64;
+
+// Lights are measured by the height of their sphere on a screen this many pixels high.
+constexpr float REFERENCE_HEIGHT = 1024.f;
+// A light keeps its tile size while its coverage stays within these factors of it, so lights at
+// the edge of two sizes don't move between tiles every frame.
+constexpr float SHRINK_BELOW = 0.4f;
+constexpr float GROW_ABOVE = 1.2f;
+// Lights shadowed last frame count as this much larger when picking this frame's, for the same
+// reason.
+constexpr float SELECTED_BOOST = 1.25f;
+
+struct ShadowPushConstantData {
+    glm::mat4 viewProjection{1.f};
+};
+
+// Laid out to match std430 in pbr.frag.
+struct PointShadowData {
+    glm::mat4 faceMatrices[6];
+    glm::vec4 faceRects[6];
+};
+
+constexpr VkDeviceSize SLOTS_OFFSET =
+    sizeof(PointShadowData) * PointShadowSystem::MAX_SHADOWED_LIGHTS;
+
+// Cube face directions, in the order pbr.frag picks them in. Looking straight up or down needs
+// another up vector.
+const std::array<glm::vec3, 6> FACE_DIRECTIONS{glm::vec3{1.f, 0.f, 0.f},
+                                               glm::vec3{-1.f, 0.f, 0.f},
+                                               glm::vec3{0.f, 1.f, 0.f},
+                                               glm::vec3{0.f, -1.f, 0.f},
+                                               glm::vec3{0.f, 0.f, 1.f},
+                                               glm::vec3{0.f, 0.f, -1.f}};
+const std::array<glm::vec3, 6> FACE_UPS{glm::vec3{0.f, -1.f, 0.f},
+                                        glm::vec3{0.f, -1.f, 0.f},
+                                        glm::vec3{0.f, 0.f, 1.f},
+                                        glm::vec3{0.f, 0.f, 1.f},
+                                        glm::vec3{0.f, -1.f, 0.f},
+                                        glm::vec3{0.f, -1.f, 0.f}};
+
+uint32_t nextPowerOfTwo(float value) {
+    uint32_t result = 1;
+    while (static_cast<float>(result) < value && result < (1u << 30)) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AABB sphereBounds(const PointLight &light) {
+    return {light.position - glm::vec3{light.radius}, light.position + glm::vec3{light.radius}};
+}
+
+bool overlaps(const AABB &a, const AABB &b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y &&
+           b.min.y <= a.max.y && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+}  // namespace
+
+PointShadowSystem::PointShadowSystem(VeDevice &device) : veDevice{device} {
+    createRenderPass();
+    createSampler();
+    createFrameData();
+    createPipelineLayout();
+    createPipeline();
+}
+
+PointShadowSystem::~PointShadowSystem() {
+    // The device is idle when systems are torn down, so nothing can still use the atlases.
+    for (auto &frame : frames) {
+        vkDestroyFramebuffer(veDevice.device(),
+                             frame.framebuffer,
+                             VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyImageView(veDevice.device(),
+                           frame.atlasView,
+                           VeAllocTracker::callbacks(AllocScope::Device));
+        vkDestroyImage(veDevice.device(),
+                       frame.atlas,
+                       VeAllocTracker::callbacks(AllocScope::Device));
+        veDevice.freeMemory(frame.atlasMemory);
+    }
+    vkDestroySampler(veDevice.device(), sampler, VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyRenderPass(veDevice.device(),
+                        renderPass,
+                        VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void PointShadowSystem::createRenderPass() {
+    // Faces are drawn into parts of the atlas while the rest keeps its contents, so the atlas is
+    // loaded and every face cleared on its own. The graph has it in the attachment layout before
+    // the pass and keeps track of it after.
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = FORMAT;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    if (vkCreateRenderPass(veDevice.device(),
+                           &renderPassInfo,
+                           VeAllocTracker::callbacks(AllocScope::Device),
+                           &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create point shadow render pass!");
+    }
+}
+
+void PointShadowSystem::createSampler() {
+    // A single filtered comparison per lookup. Lookups are clamped inside their tile, so the
+    // address mode never matters.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(veDevice.device(),
+                        &samplerInfo,
+                        VeAllocTracker::callbacks(AllocScope::Device),
+                        &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create point shadow sampler!");
+    }
+}
+
+std::unique_ptr<VeBuffer> PointShadowSystem::createBuffer(VkDeviceSize size) {
+    auto buffer = std::make_unique<VeBuffer>(veDevice,
+                                             size,
+                                             1,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             1,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    buffer->map();
+    return buffer;
+}
+
+void PointShadowSystem::createFrameData() {
+    descriptorPool = VeDescriptorPool::Builder(veDevice)
+                         .setMaxSets(FRAMES)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FRAMES)
+                         .build();
+    instanceLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    for (auto &frame : frames) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {ATLAS_SIZE, ATLAS_SIZE, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = FORMAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        veDevice.createImageWithInfo(
+            imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.atlas, frame.atlasMemory);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frame.atlas;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &frame.atlasView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create point shadow atlas view!");
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &frame.atlasView;
+        framebufferInfo.width = ATLAS_SIZE;
+        framebufferInfo.height = ATLAS_SIZE;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(veDevice.device(),
+                                &framebufferInfo,
+                                VeAllocTracker::callbacks(AllocScope::Device),
+                                &frame.framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create point shadow framebuffer!");
+        }
+
+        frame.shadows = createBuffer(SLOTS_OFFSET + sizeof(uint32_t) * INITIAL_LIGHTS);
+        frame.instances = std::make_unique<VeBuffer>(veDevice,
+                                                     sizeof(glm::mat4),
+                                                     INITIAL_INSTANCES,
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     1,
+                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.instances->map();
+        auto bufferInfo = frame.instances->descriptorInfo();
+        VeDescriptorWriter(*instanceLayout, *descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .build(frame.instanceSet);
+    }
+}
+
+void PointShadowSystem::createPipelineLayout() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ShadowPushConstantData);
+
+    VkDescriptorSetLayout setLayout = instanceLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &pipelineLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create point shadow pipeline layout!");
+    }
+}
+
+void PointShadowSystem::createPipeline() {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before layout");
+
+    // Same as the sun's shadows, shadow.vert only transforms positions. Perspective depth is far
+    // less linear than orthographic depth, so the constant bias is smaller.
+    PipelineConfigInfo pipelineConfig{};
+    VePipeline::depthOnlyPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+    pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 1.f;
+    pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 2.f;
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/shadow.vert.spv", "", pipelineConfig);
+}
+
+VkDescriptorImageInfo PointShadowSystem::atlasInfo(int frameIndex) const {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = frames[frameIndex].atlasView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return imageInfo;
+}
+
+bool PointShadowSystem::update(FrameInfo &frameInfo, const std::vector<PointLight> &lights) {
+    VE_PROFILE_SCOPE("PointShadowSystem::update");
+    const auto frameIndex = static_cast<uint32_t>(frameInfo.frameIndex);
+    FrameData &frameData = frames[frameIndex];
+    frame++;
+    stats = {};
+
+    // Every caster's bounds, which dynamic ones moved since last frame and whether the static
+    // ones changed.
+    objects.clear();
+    objectBounds.clear();
+    movedBounds.clear();
+    size_t statics = 0;
+    for (auto &kv : frameInfo.gameObjects) {
+        auto &obj = kv.second;
+        AABB bounds = obj.transform.transformBounds(obj.model->getBoundingBox());
+        objects.push_back(&obj);
+        objectBounds.push_back(bounds);
+        if (obj.isStatic) {
+            statics++;
+            continue;
+        }
+        auto previous = dynamicBounds.find(obj.getId());
+        if (previous == dynamicBounds.end()) {
+            movedBounds.push_back(bounds);
+            dynamicBounds.emplace(obj.getId(), bounds);
+        } else if (std::memcmp(&previous->second, &bounds, sizeof(AABB)) != 0) {
+            movedBounds.push_back(previous->second);
+            movedBounds.push_back(bounds);
+            previous->second = bounds;
+        }
+    }
+    if (dynamicBounds.size() + statics > objects.size()) {
+        // Removed objects no longer cast shadows where they were.
+        for (auto it = dynamicBounds.begin(); it != dynamicBounds.end();) {
+            auto obj = frameInfo.gameObjects.find(it->first);
+            if (obj == frameInfo.gameObjects.end() || obj->second.isStatic) {
+                movedBounds.push_back(it->second);
+                it = dynamicBounds.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (statics != staticCount) {
+        staticCount = statics;
+        invalidateStaticCasters();
+    }
+
+    selectLights(frameInfo, lights);
+    invalidateMovedCasters();
+
+    // Out of date faces of this frame's atlas. Those without casters don't need drawing, they
+    // are only marked empty, and the rest wait for the budget, most visible and longest waiting
+    // first.
+    staleFaces.clear();
+    for (auto &kv : shadowedLights) {
+        ShadowedLight &shadowed = kv.second;
+        if (!shadowed.selected) {
+            continue;
+        }
+        stats.shadowedLights++;
+        bool gathered = false;
+        for (uint32_t i = 0; i < FACES; i++) {
+            Face &face = shadowed.faces[i];
+            if (face.drawnVersion[frameIndex] == face.version) {
+                stats.facesEmpty += face.drawnEmpty[frameIndex] ? 1 : 0;
+                continue;
+            }
+            if (!gathered) {
+                gatherLightCasters(shadowed);
+                gathered = true;
+            }
+            cullFace(face);
+            if (faceCasters.empty()) {
+                face.drawnVersion[frameIndex] = face.version;
+                face.drawnViewProjection[frameIndex] = face.viewProjection;
+                face.drawnEmpty[frameIndex] = true;
+                stats.facesEmpty++;
+                continue;
+            }
+            float waited = static_cast<float>(frame - face.staleSince + 1);
+            staleFaces.push_back({shadowed.coverage * waited, &shadowed, i});
+        }
+    }
+    size_t drawCount = std::min<size_t>(staleFaces.size(), faceBudget);
+    std::partial_sort(staleFaces.begin(),
+                      staleFaces.begin() + static_cast<std::ptrdiff_t>(drawCount),
+                      staleFaces.end(),
+                      [](const StaleFace &a, const StaleFace &b) {
+                          return a.priority > b.priority;
+                      });
+    stats.facesPending = static_cast<uint32_t>(staleFaces.size() - drawCount);
+
+    // List the casters of the faces drawn this frame.
+    faceDraws.clear();
+    runs.clear();
+    instanceScratch.clear();
+    const ShadowedLight *gatheredFor = nullptr;
+    for (size_t i = 0; i < drawCount; i++) {
+        ShadowedLight &shadowed = *staleFaces[i].light;
+        Face &face = shadowed.faces[staleFaces[i].face];
+        if (gatheredFor != &shadowed) {
+            gatherLightCasters(shadowed);
+            gatheredFor = &shadowed;
+        }
+        cullFace(face);
+        std::sort(faceCasters.begin(), faceCasters.end(), [&](uint32_t a, uint32_t b) {
+            return objects[a]->model.get() < objects[b]->model.get();
+        });
+
+        FaceDraw draw{face.tile, face.viewProjection, static_cast<uint32_t>(runs.size()), 0};
+        for (uint32_t object : faceCasters) {
+            VeModel *mesh = objects[object]->model.get();
+            auto instance = static_cast<uint32_t>(instanceScratch.size());
+            instanceScratch.push_back(objects[object]->transform.mat4());
+            if (draw.runCount > 0 && runs.back().mesh == mesh) {
+                runs.back().instanceCount++;
+            } else {
+                runs.push_back({mesh, instance, 1});
+                draw.runCount++;
+            }
+        }
+        faceDraws.push_back(draw);
+
+        face.drawnVersion[frameIndex] = face.version;
+        face.drawnViewProjection[frameIndex] = face.viewProjection;
+        face.drawnEmpty[frameIndex] = false;
+    }
+    stats.facesDrawn = static_cast<uint32_t>(faceDraws.size());
+    stats.casters = static_cast<uint32_t>(instanceScratch.size());
+    stats.tilesUsed = atlas.getUsedTiles();
+
+    // The frame's fence has been waited on, so nothing reads its buffers anymore. Replaced
+    // buffers go through the deletion queue all the same.
+    if (instanceScratch.size() > frameData.instances->getInstanceCount()) {
+        uint32_t capacity = frameData.instances->getInstanceCount();
+        while (capacity < instanceScratch.size()) {
+            capacity *= 2;
+        }
+        frameData.instances = std::make_unique<VeBuffer>(veDevice,
+                                                         sizeof(glm::mat4),
+                                                         capacity,
+                                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                         1,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frameData.instances->map();
+        auto bufferInfo = frameData.instances->descriptorInfo();
+        VeDescriptorWriter(*instanceLayout, *descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .overwrite(frameData.instanceSet);
+    }
+    std::copy(instanceScratch.begin(),
+              instanceScratch.end(),
+              static_cast<glm::mat4 *>(frameData.instances->getMappedMemory()));
+
+    bool reallocated = false;
+    VkDeviceSize shadowsSize = SLOTS_OFFSET + sizeof(uint32_t) * std::max<size_t>(lights.size(), 1);
+    if (shadowsSize > frameData.shadows->getBufferSize()) {
+        VkDeviceSize slots = (frameData.shadows->getBufferSize() - SLOTS_OFFSET) / sizeof(uint32_t);
+        while (SLOTS_OFFSET + sizeof(uint32_t) * slots < shadowsSize) {
+            slots *= 2;
+        }
+        frameData.shadows = createBuffer(SLOTS_OFFSET + sizeof(uint32_t) * slots);
+        reallocated = true;
+    }
+    writeShadowData(frameInfo.frameIndex, lights);
+    return reallocated;
+}
+
+void PointShadowSystem::selectLights(FrameInfo &frameInfo, const std::vector<PointLight> &lights) {
+    // Coverage is the height of the light's sphere on screen, in pixels. Only lights the camera
+    // can see reach any pixels.
+    const VeCamera &camera = frameInfo.camera;
+    Frustum frustum = camera.getFrustum();
+    float pixelScale = camera.getProjection()[1][1] * REFERENCE_HEIGHT;
+    glm::vec3 cameraPosition = camera.getPosition();
+    auto coverageOf = [&](const PointLight &light) {
+        float distance = std::max(glm::length(light.position - cameraPosition), light.radius);
+        return light.radius / distance * pixelScale;
+    };
+
+    candidates.clear();
+    for (uint32_t id = 0; id < lights.size(); id++) {
+        const PointLight &light = lights[id];
+        if (light.radius <= 0.f ||
+            !frustum.intersects(BoundingSphere{light.position, light.radius})) {
+            continue;
+        }
+        auto existing = shadowedLights.find(id);
+        float score = coverageOf(light);
+        if (existing != shadowedLights.end() && existing->second.selected) {
+            score *= SELECTED_BOOST;
+        }
+        candidates.emplace_back(score, id);
+    }
+    size_t selectedCount = std::min<size_t>(candidates.size(), MAX_SHADOWED_LIGHTS);
+    std::partial_sort(candidates.begin(),
+                      candidates.begin() + static_cast<std::ptrdiff_t>(selectedCount),
+                      candidates.end(),
+                      [](const auto &a, const auto &b) { return a.first > b.first; });
+    candidates.resize(selectedCount);
+
+    // Evicted lights give their tiles back before anyone asks for new ones.
+    for (auto &kv : shadowedLights) {
+        kv.second.selected = false;
+    }
+    for (auto &candidate : candidates) {
+        auto existing = shadowedLights.find(candidate.second);
+        if (existing != shadowedLights.end()) {
+            existing->second.selected = true;
+        }
+    }
+    for (auto it = shadowedLights.begin(); it != shadowedLights.end();) {
+        if (!it->second.selected || it->first >= lights.size()) {
+            freeFaces(it->second);
+            it = shadowedLights.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Faces only see part of the sphere, so tiles are half its coverage. Lights keep their tiles
+    // while that stays close to them. Shrinking lights move first, so growing ones find the
+    // space.
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto &candidate : candidates) {
+            uint32_t id = candidate.second;
+            const PointLight &light = lights[id];
+            float coverage = coverageOf(light);
+            float wanted = coverage * 0.5f;
+            uint32_t tileSize = std::clamp(nextPowerOfTwo(wanted), MIN_TILE_SIZE, MAX_TILE_SIZE);
+
+            ShadowedLight &shadowed = shadowedLights[id];
+            shadowed.coverage = coverage;
+            auto current = static_cast<float>(shadowed.faces[0].tile.size);
+            bool keep = current != 0.f &&
+                        (tileSize == shadowed.faces[0].tile.size ||
+                         (wanted >= SHRINK_BELOW * current && wanted <= GROW_ABOVE * current));
+            bool shrinking = current != 0.f && static_cast<float>(tileSize) < current;
+            if (keep || (pass == 0) != shrinking) {
+                continue;
+            }
+            if (current != 0.f) {
+                freeFaces(shadowed);
+            }
+            // Without room at the wanted size, a smaller tile beats no shadow.
+            bool allocated = false;
+            for (uint32_t size = tileSize; size >= MIN_TILE_SIZE && !allocated; size /= 2) {
+                allocated = allocateFaces(shadowed, size);
+            }
+            if (!allocated) {
+                shadowedLights.erase(id);
+                continue;
+            }
+            shadowed.light = light;
+            shadowed.selected = true;
+            shadowed.staticVersion = staticVersion;
+            setupFaces(shadowed);
+        }
+    }
+
+    // Lights that moved, and those whose static casters changed, are redrawn entirely.
+    for (auto &kv : shadowedLights) {
+        ShadowedLight &shadowed = kv.second;
+        const PointLight &light = lights[kv.first];
+        bool moved =
+            std::memcmp(&shadowed.light.position, &light.position, sizeof(glm::vec3)) != 0 ||
+            shadowed.light.radius != light.radius;
+        shadowed.light = light;
+        if (moved) {
+            setupFaces(shadowed);
+        } else if (shadowed.staticVersion != staticVersion) {
+            shadowed.staticVersion = staticVersion;
+            for (Face &face : shadowed.faces) {
+                markStale(face);
+            }
+        }
+    }
+}
+
+bool PointShadowSystem::allocateFaces(ShadowedLight &shadowed, uint32_t tileSize) {
+    for (uint32_t i = 0; i < FACES; i++) {
+        auto tile = atlas.allocate(tileSize);
+        if (!tile) {
+            for (uint32_t j = 0; j < i; j++) {
+                atlas.free(shadowed.faces[j].tile);
+                shadowed.faces[j].tile = {};
+            }
+            return false;
+        }
+        shadowed.faces[i].tile = *tile;
+    }
+    // A new tile holds nothing of this light in any frame's atlas.
+    for (Face &face : shadowed.faces) {
+        face.drawnVersion.fill(0);
+        face.staleSince = frame;
+    }
+    return true;
+}
+
+void PointShadowSystem::freeFaces(ShadowedLight &shadowed) {
+    for (Face &face : shadowed.faces) {
+        if (face.tile.size != 0) {
+            atlas.free(face.tile);
+            face.tile = {};
+        }
+    }
+}
+
+void PointShadowSystem::setupFaces(ShadowedLight &shadowed) {
+    // Ninety degree perspective views out of the light, reaching as far as its light does.
+    const PointLight &light = shadowed.light;
+    float near = std::max(0.05f, light.radius * 0.02f);
+    VeCamera faceCamera{};
+    faceCamera.setPerspectiveProjection(glm::radians(90.f), 1.f, near, light.radius);
+    for (uint32_t i = 0; i < FACES; i++) {
+        Face &face = shadowed.faces[i];
+        faceCamera.setViewDirection(light.position, FACE_DIRECTIONS[i], FACE_UPS[i]);
+        face.viewProjection = faceCamera.getProjection() * faceCamera.getView();
+        face.frustum = Frustum::fromMatrix(face.viewProjection);
+        markStale(face);
+    }
+}
+
+void PointShadowSystem::markStale(Face &face) const {
+    // A face some frame's atlas is still waiting for keeps its place in the queue.
+    bool waiting = std::any_of(face.drawnVersion.begin(),
+                               face.drawnVersion.end(),
+                               [&](uint64_t drawn) { return drawn != face.version; });
+    face.version++;
+    if (!waiting) {
+        face.staleSince = frame;
+    }
+}
+
+void PointShadowSystem::invalidateMovedCasters() {
+    if (movedBounds.empty()) {
+        return;
+    }
+    for (auto &kv : shadowedLights) {
+        ShadowedLight &shadowed = kv.second;
+        AABB lightBounds = sphereBounds(shadowed.light);
+        for (const AABB &moved : movedBounds) {
+            if (!overlaps(lightBounds, moved)) {
+                continue;
+            }
+            for (Face &face : shadowed.faces) {
+                if (face.frustum.intersects(moved)) {
+                    markStale(face);
+                }
+            }
+        }
+    }
+}
+
+void PointShadowSystem::gatherLightCasters(const ShadowedLight &shadowed) {
+    // Casters reaching into the light's sphere, the only ones any of its faces can see.
+    AABB lightBounds = sphereBounds(shadowed.light);
+    lightCasters.clear();
+    lightCasterBounds.clear();
+    for (uint32_t object = 0; object < objects.size(); object++) {
+        if (overlaps(lightBounds, objectBounds[object])) {
+            lightCasters.push_back(object);
+            lightCasterBounds.add(objectBounds[object]);
+        }
+    }
+    visibility.resize(lightCasterBounds.paddedSize());
+}
+
+void PointShadowSystem::cullFace(const Face &face) {
+    faceCasters.clear();
+    if (lightCasters.empty()) {
+        return;
+    }
+    cullBoxes(face.frustum, lightCasterBounds, visibility.data());
+    for (uint32_t i = 0; i < lightCasters.size(); i++) {
+        if (visibility[i]) {
+            faceCasters.push_back(lightCasters[i]);
+        }
+    }
+}
+
+void PointShadowSystem::writeShadowData(int frameIndex, const std::vector<PointLight> &lights) {
+    // Faces are looked up with the matrix they were drawn with, which lags behind a moving light
+    // until the budget gets to them.
+    auto *mapped = static_cast<uint8_t *>(frames[frameIndex].shadows->getMappedMemory());
+    auto *shadows = reinterpret_cast<PointShadowData *>(mapped);
+    auto *slots = reinterpret_cast<uint32_t *>(mapped + SLOTS_OFFSET);
+    std::fill(slots, slots + lights.size(), 0u);
+
+    uint32_t slot = 0;
+    for (auto &kv : shadowedLights) {
+        const ShadowedLight &shadowed = kv.second;
+        PointShadowData &data = shadows[slot];
+        for (uint32_t i = 0; i < FACES; i++) {
+            const Face &face = shadowed.faces[i];
+            data.faceMatrices[i] = face.drawnViewProjection[frameIndex];
+            bool lit = face.drawnVersion[frameIndex] == 0 || face.drawnEmpty[frameIndex];
+            float scale = lit ? 0.f : static_cast<float>(face.tile.size) / ATLAS_SIZE;
+            data.faceRects[i] = glm::vec4{static_cast<float>(face.tile.x) / ATLAS_SIZE,
+                                          static_cast<float>(face.tile.y) / ATLAS_SIZE,
+                                          scale,
+                                          scale};
+        }
+        slots[kv.first] = ++slot;
+    }
+}
+
+RGHandle PointShadowSystem::addPass(VeRenderGraph &renderGraph, int frameIndex) {
+    FrameData &frameData = frames[frameIndex];
+    RGImageDesc desc{FORMAT, {ATLAS_SIZE, ATLAS_SIZE}, VK_IMAGE_ASPECT_DEPTH_BIT};
+    auto atlasHandle = renderGraph.importImage(
+        "point shadow atlas",
+        frameData.atlas,
+        frameData.atlasView,
+        desc,
+        frameData.atlasWritten ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                               : VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    frameData.atlasWritten = true;
+
+    // Added even without faces to draw, it's what moves the atlas into the layout it is sampled
+    // in the first time around.
+    renderGraph.addPass(
+        "point shadows",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.write(atlasHandle, RGAccess::DepthAttachment);
+        },
+        [this, frameIndex](VkCommandBuffer cmd) { renderFaces(cmd, frameIndex); });
+    return atlasHandle;
+}
+
+void PointShadowSystem::renderFaces(VkCommandBuffer commandBuffer, int frameIndex) {
+    VE_PROFILE_SCOPE("PointShadowSystem::renderFaces");
+    if (faceDraws.empty()) {
+        return;
+    }
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = frames[frameIndex].framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {ATLAS_SIZE, ATLAS_SIZE};
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    pipeline.get()->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &frames[frameIndex].instanceSet,
+                            0,
+                            nullptr);
+    for (const FaceDraw &draw : faceDraws) {
+        VkViewport viewport{};
+        viewport.x = static_cast<float>(draw.tile.x);
+        viewport.y = static_cast<float>(draw.tile.y);
+        viewport.width = static_cast<float>(draw.tile.size);
+        viewport.height = static_cast<float>(draw.tile.size);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{static_cast<int32_t>(draw.tile.x), static_cast<int32_t>(draw.tile.y)},
+                         {draw.tile.size, draw.tile.size}};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        VkClearAttachment clear{};
+        clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clear.clearValue.depthStencil = {1.f, 0};
+        VkClearRect clearRect{scissor, 0, 1};
+        vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &clearRect);
+
+        ShadowPushConstantData push{draw.viewProjection};
+        vkCmdPushConstants(commandBuffer,
+                           pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0,
+                           sizeof(ShadowPushConstantData),
+                           &push);
+        for (uint32_t i = draw.firstRun; i < draw.firstRun + draw.runCount; i++) {
+            const DrawRun &run = runs[i];
+            run.mesh->bindPositions(commandBuffer);
+            run.mesh->draw(commandBuffer, run.instanceCount, run.firstInstance);
+        }
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+}  // namespace ve
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "Core/ve_culling.hpp"
+#include "Core/ve_frame_info.hpp"
+#include "Core/ve_game_object.hpp"
+#include "Core/ve_light_clusters.hpp"
+#include "Core/ve_shadow_atlas.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Omnidirectional shadows for point lights, drawn into a shared depth atlas.
+//
+// The lights covering the most of the screen get shadows, each a cube of six perspective faces
+// whose tile size follows the light's screen coverage. A face is only drawn again when it is out
+// of date: its light moved or changed radius, it moved to a new tile, or a dynamic object inside
+// it moved. Faces without casters are never drawn, shading treats them as lit. At most
+// faceBudget faces are drawn per frame, the most visible and longest waiting first, and faces left
+// over keep their previous contents until their turn comes.
+//
+// Every frame in flight has its own atlas, so a frame never draws into the atlas the previous one
+// may still be sampling. Each keeps track of which version of every face it holds.
+class PointShadowSystem {
+   public:
+    // Global set bindings of the shadow data and the atlas.
+    static constexpr uint32_t SHADOWS_BINDING = 5;
+    static constexpr uint32_t ATLAS_BINDING = 6;
+    static constexpr uint32_t ATLAS_SIZE = 4096;
+    static constexpr uint32_t MIN_TILE_SIZE = 64;
+    static constexpr uint32_t MAX_TILE_SIZE = 512;
+    // Must match the size of pointShadows in pbr.frag.
+    static constexpr uint32_t MAX_SHADOWED_LIGHTS = 32;
+    static constexpr VkFormat FORMAT = VK_FORMAT_D16_UNORM;
+
+    explicit PointShadowSystem(VeDevice &device);
+    ~PointShadowSystem();
+
+    // Remove copy constructors.
+    PointShadowSystem(const PointShadowSystem &) = delete;
+    PointShadowSystem &operator=(const PointShadowSystem &) = delete;
+
+    // Picks the shadowed lights, works out which faces are out of date and lists the casters of
+    // those drawn this frame. Call once per frame, before addPass(). Returns true when the frame's
+    // shadow buffer had to grow, in which case the global set's SHADOWS_BINDING has to be written
+    // again before it is used.
+    bool update(FrameInfo &frameInfo, const std::vector<PointLight> &lights);
+    // Adds the pass drawing this frame's faces and returns the frame's atlas, for the passes
+    // sampling it to declare.
+    RGHandle addPass(VeRenderGraph &renderGraph, int frameIndex);
+
+    // Redraws every face. Call after moving, adding or removing static objects, only a change in
+    // their number is noticed otherwise.
+    void invalidateStaticCasters() { staticVersion++; }
+    void setFaceBudget(uint32_t budget) { faceBudget = budget; }
+    [[nodiscard]] uint32_t getFaceBudget() const { return faceBudget; }
+
+    [[nodiscard]] VkDescriptorBufferInfo shadowsInfo(int frameIndex) const {
+        return frames[frameIndex].shadows->descriptorInfo();
+    }
+    // The frame's atlas, with a depth comparison sampler.
+    [[nodiscard]] VkDescriptorImageInfo atlasInfo(int frameIndex) const;
+    [[nodiscard]] const PointShadowStats &getStats() const { return stats; }
+
+   private:
+    static constexpr uint32_t FACES = 6;
+    static constexpr uint32_t FRAMES = VeSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+    struct Face {
+        AtlasTile tile{};
+        glm::mat4 viewProjection{1.f};
+        Frustum frustum{};
+        // Bumped whenever the face has to be drawn again. Each frame's atlas holds the version it
+        // last drew, 0 being none, and the matrix and emptiness it was drawn with.
+        uint64_t version{1};
+        uint64_t staleSince{0};  // Frame the face went out of date in.
+        std::array<uint64_t, FRAMES> drawnVersion{};
+        std::array<glm::mat4, FRAMES> drawnViewProjection{};
+        std::array<bool, FRAMES> drawnEmpty{};
+    };
+
+    struct ShadowedLight {
+        PointLight light{};  // As the faces are set up for.
+        float coverage{0.f};
+        bool selected{false};
+        uint64_t staticVersion{0};
+        std::array<Face, FACES> faces{};
+    };
+
+    // A face drawn this frame, with the runs drawing its casters.
+    struct FaceDraw {
+        AtlasTile tile;
+        glm::mat4 viewProjection;
+        uint32_t firstRun;
+        uint32_t runCount;
+    };
+
+    struct DrawRun {
+        VeModel *mesh;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    struct StaleFace {
+        float priority;
+        ShadowedLight *light;
+        uint32_t face;
+    };
+
+    struct FrameData {
+        std::unique_ptr<VeBuffer> shadows;
+        std::unique_ptr<VeBuffer> instances;
+        VkDescriptorSet instanceSet{};
+        VkImage atlas{VK_NULL_HANDLE};
+        VkDeviceMemory atlasMemory{VK_NULL_HANDLE};
+        VkImageView atlasView{VK_NULL_HANDLE};
+        VkFramebuffer framebuffer{VK_NULL_HANDLE};
+        bool atlasWritten{false};
+    };
+
+    void createRenderPass();
+    void createSampler();
+    void createFrameData();
+    void createPipelineLayout();
+    void createPipeline();
+    std::unique_ptr<VeBuffer> createBuffer(VkDeviceSize size);
+
+    // Picks the lights to shadow this frame and gives their faces tiles.
+    void selectLights(FrameInfo &frameInfo, const std::vector<PointLight> &lights);
+    bool allocateFaces(ShadowedLight &shadowed, uint32_t tileSize);
+    void freeFaces(ShadowedLight &shadowed);
+    void setupFaces(ShadowedLight &shadowed);
+    void markStale(Face &face) const;
+    // Marks the faces a moved dynamic object was or is in out of date.
+    void invalidateMovedCasters();
+    // Casters inside the light's sphere, culled against the face's frustum into faceCasters.
+    void cullFace(const Face &face);
+    void gatherLightCasters(const ShadowedLight &shadowed);
+    void writeShadowData(int frameIndex, const std::vector<PointLight> &lights);
+    void renderFaces(VkCommandBuffer commandBuffer, int frameIndex);
+
+    VeDevice &veDevice;
+    ShadowAtlas atlas{ATLAS_SIZE, MIN_TILE_SIZE};
+
+    VkRenderPass renderPass{VK_NULL_HANDLE};
+    VkSampler sampler{VK_NULL_HANDLE};
+    std::unique_ptr<VeDescriptorPool> descriptorPool{};
+    std::unique_ptr<VeDescriptorSetLayout> instanceLayout{};
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    PipelineFuture pipeline;
+    std::array<FrameData, FRAMES> frames{};
+
+    uint32_t faceBudget{24};
+    uint64_t frame{0};
+    uint64_t staticVersion{0};
+    size_t staticCount{0};
+    std::unordered_map<uint32_t, ShadowedLight> shadowedLights;
+    std::unordered_map<VeGameObject::id_t, AABB> dynamicBounds;
+
+    // This frame's draws, recorded by the pass added in addPass().
+    std::vector<FaceDraw> faceDraws;
+    std::vector<DrawRun> runs;
+
+    // Scratch space, kept between frames so it doesn't allocate.
+    std::vector<std::pair<float, uint32_t>> candidates;
+    std::vector<AABB> movedBounds;
+    std::vector<StaleFace> staleFaces;
+    std::vector<const VeGameObject *> objects;
+    std::vector<AABB> objectBounds;
+    std::vector<uint32_t> lightCasters;
+    CullBoxes lightCasterBounds;
+    std::vector<uint8_t> visibility;
+    std::vector<uint32_t> faceCasters;
+    std::vector<glm::mat4> instanceScratch;
+    PointShadowStats stats{};
+};
+
+}  // namespace ve
@@ -0,0 +1,577 @@
+#include "shadow_render_system.hpp"
+
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace ve {
+
+namespace {
+
+// Enough for the test scene, larger scenes grow the buffers.
+constexpr uint32_t INITIAL_INSTANCES = 256;
+
+struct ShadowPushConstantData {
+    glm::mat4 viewProjection{1.f};
+};
+
+}  // namespace
+
+ShadowRenderSystem::ShadowRenderSystem(VeDevice &device) : veDevice{device} {
+    createRenderPasses();
+    createImages();
+    createSampler();
+    createFrameData();
+    createPipelineLayout();
+    createPipeline();
+}
+
+ShadowRenderSystem::~ShadowRenderSystem() {
+    // The device is idle when systems are torn down, so nothing can still use the images.
+    for (auto &frame : frames) {
+        destroyLayeredImage(frame.shadowMap);
+        destroyLayeredImage(frame.cache);
+    }
+    vkDestroySampler(veDevice.device(), sampler, VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyRenderPass(veDevice.device(),
+                        clearRenderPass,
+                        VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyRenderPass(veDevice.device(),
+                        loadRenderPass,
+                        VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void ShadowRenderSystem::createRenderPasses() {
+    // The graph has the layer in the attachment layout before the pass and keeps track of it
+    // after, so the layout never changes here.
+    for (VkAttachmentLoadOp loadOp : {VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_LOAD}) {
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = FORMAT;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        VkRenderPass &renderPass =
+            loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? clearRenderPass : loadRenderPass;
+        if (vkCreateRenderPass(veDevice.device(),
+                               &renderPassInfo,
+                               VeAllocTracker::callbacks(AllocScope::Device),
+                               &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow render pass!");
+        }
+    }
+}
+
+void ShadowRenderSystem::createImages() {
+    for (auto &frame : frames) {
+        createLayeredImage(frame.shadowMap,
+                           ShadowCascades::MAX_CASCADES,
+                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        createLayeredImage(frame.cache,
+                           CACHED_CASCADES,
+                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    }
+}
+
+void ShadowRenderSystem::createLayeredImage(LayeredImage &target,
+                                            uint32_t layers,
+                                            VkImageUsageFlags usage) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {RESOLUTION, RESOLUTION, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = layers;
+    imageInfo.format = FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    veDevice.createImageWithInfo(
+        imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.image, target.memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = layers;
+    if (vkCreateImageView(veDevice.device(),
+                          &viewInfo,
+                          VeAllocTracker::callbacks(AllocScope::Device),
+                          &target.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map view!");
+    }
+
+    // Layers are drawn one at a time, each through a framebuffer of its own.
+    target.layerViews.resize(layers);
+    target.framebuffers.resize(layers);
+    for (uint32_t layer = 0; layer < layers; layer++) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange.baseArrayLayer = layer;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(veDevice.device(),
+                              &viewInfo,
+                              VeAllocTracker::callbacks(AllocScope::Device),
+                              &target.layerViews[layer]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow map layer view!");
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = clearRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &target.layerViews[layer];
+        framebufferInfo.width = RESOLUTION;
+        framebufferInfo.height = RESOLUTION;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(veDevice.device(),
+                                &framebufferInfo,
+                                VeAllocTracker::callbacks(AllocScope::Device),
+                                &target.framebuffers[layer]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow map framebuffer!");
+        }
+    }
+}
+
+void ShadowRenderSystem::destroyLayeredImage(LayeredImage &target) {
+    for (auto framebuffer : target.framebuffers) {
+        vkDestroyFramebuffer(veDevice.device(),
+                             framebuffer,
+                             VeAllocTracker::callbacks(AllocScope::Device));
+    }
+    for (auto view : target.layerViews) {
+        vkDestroyImageView(veDevice.device(), view, VeAllocTracker::callbacks(AllocScope::Device));
+    }
+    vkDestroyImageView(veDevice.device(),
+                       target.view,
+                       VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyImage(veDevice.device(), target.image, VeAllocTracker::callbacks(AllocScope::Device));
+    veDevice.freeMemory(target.memory);
+    target = {};
+}
+
+void ShadowRenderSystem::createSampler() {
+    // Comparisons are filtered, so every tap is a bilinear blend of four depth tests. Outside of
+    // the map everything is lit.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(veDevice.device(),
+                        &samplerInfo,
+                        VeAllocTracker::callbacks(AllocScope::Device),
+                        &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map sampler!");
+    }
+}
+
+void ShadowRenderSystem::createFrameData() {
+    descriptorPool = VeDescriptorPool::Builder(veDevice)
+                         .setMaxSets(VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                      VeSwapChain::MAX_FRAMES_IN_FLIGHT)
+                         .build();
+    instanceLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    for (auto &frame : frames) {
+        frame.instances = std::make_unique<VeBuffer>(veDevice,
+                                                     sizeof(glm::mat4),
+                                                     INITIAL_INSTANCES,
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     1,
+                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.instances->map();
+        auto bufferInfo = frame.instances->descriptorInfo();
+        VeDescriptorWriter(*instanceLayout, *descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .build(frame.instanceSet);
+    }
+}
+
+void ShadowRenderSystem::createPipelineLayout() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ShadowPushConstantData);
+
+    VkDescriptorSetLayout setLayout = instanceLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &pipelineLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow pipeline layout!");
+    }
+}
+
+void ShadowRenderSystem::createPipeline() {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before layout");
+
+    PipelineConfigInfo pipelineConfig{};
+    VePipeline::depthOnlyPipelineConfigInfo(pipelineConfig);
+    // Push the depth of every caster back a little, more so for surfaces at a grazing angle to
+    // the light, so lit surfaces don't shadow themselves. pbr.frag offsets its lookups along the
+    // normal as well.
+    pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+    pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 2.f;
+    pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 2.5f;
+    pipelineConfig.renderPass = clearRenderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/shadow.vert.spv", "", pipelineConfig);
+}
+
+VkDescriptorImageInfo ShadowRenderSystem::descriptorInfo(int frameIndex) const {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = frames[frameIndex].shadowMap.view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return imageInfo;
+}
+
+void ShadowRenderSystem::update(FrameInfo &frameInfo, const DirectionalLight &light) {
+    VE_PROFILE_SCOPE("ShadowRenderSystem::update");
+    FrameData &frame = frames[frameInfo.frameIndex];
+    stats = {};
+
+    // Gather every caster's bounds, and how deep they reach along the light direction.
+    glm::vec3 lightDirection = glm::normalize(light.direction);
+    glm::vec3 absDirection = glm::abs(lightDirection);
+    float casterMin = std::numeric_limits<float>::max();
+    float casterMax = std::numeric_limits<float>::lowest();
+    size_t statics = 0;
+    casterBounds.clear();
+    casterObjects.clear();
+    casterBounds.reserve(frameInfo.gameObjects.size());
+    for (auto &kv : frameInfo.gameObjects) {
+        auto &obj = kv.second;
+        AABB bounds = obj.transform.transformBounds(obj.model->getBoundingBox());
+        glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+        glm::vec3 extent = 0.5f * (bounds.max - bounds.min);
+        float depth = glm::dot(lightDirection, center);
+        float reach = glm::dot(absDirection, extent);
+        casterMin = std::min(casterMin, depth - reach);
+        casterMax = std::max(casterMax, depth + reach);
+        casterBounds.add(bounds);
+        casterObjects.push_back(&obj);
+        statics += obj.isStatic ? 1 : 0;
+    }
+    if (casterObjects.empty()) {
+        casterMin = 0.f;
+        casterMax = 0.f;
+    }
+    if (statics != staticCount) {
+        staticCount = statics;
+        invalidateStaticCasters();
+    }
+
+    const VeCamera &camera = frameInfo.camera;
+    cascades.update(camera.getView(),
+                    camera.getProjection(),
+                    camera.getNear(),
+                    camera.getFar(),
+                    lightDirection,
+                    casterMin,
+                    casterMax);
+
+    // List the casters of every layer drawn this frame. Cached cascades only draw their static
+    // casters again when the cache is out of date, and dynamic ones every frame on top of it.
+    runs.clear();
+    instanceScratch.clear();
+    visibility.resize(casterObjects.size());
+    uint32_t cascadeCount = cascades.getCascadeCount();
+    stats.cascades = cascadeCount;
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        const ShadowCascade &cascade = cascades.getCascade(i);
+        cullBoxes(cascade.frustum, casterBounds, visibility.data());
+
+        bool cached = ShadowCascades::isCached(i);
+        if (cached) {
+            uint32_t layer = i - ShadowCascades::FIRST_CACHED_CASCADE;
+            CacheState &state = frame.cacheStates[layer];
+            cacheUpdates[layer] =
+                !state.valid || state.staticVersion != staticVersion ||
+                std::memcmp(&state.viewProjection, &cascade.viewProjection, sizeof(glm::mat4)) != 0;
+            if (cacheUpdates[layer]) {
+                state = {true, cascade.viewProjection, staticVersion};
+                layerCasters.clear();
+                for (uint32_t object = 0; object < casterObjects.size(); object++) {
+                    if (visibility[object] && casterObjects[object]->isStatic) {
+                        layerCasters.push_back(object);
+                    }
+                }
+                cacheDraws[layer] = addDraws(layerCasters);
+                stats.cacheUpdates++;
+            } else {
+                stats.cachedCascades++;
+            }
+        }
+
+        layerCasters.clear();
+        for (uint32_t object = 0; object < casterObjects.size(); object++) {
+            if (visibility[object] && !(cached && casterObjects[object]->isStatic)) {
+                layerCasters.push_back(object);
+            }
+        }
+        cascadeDraws[i] = addDraws(layerCasters);
+    }
+    stats.casters = static_cast<uint32_t>(instanceScratch.size());
+    stats.drawCalls = static_cast<uint32_t>(runs.size());
+
+    // The frame's fence has been waited on, so nothing reads its buffer anymore. A replaced
+    // buffer goes through the deletion queue all the same.
+    if (instanceScratch.size() > frame.instances->getInstanceCount()) {
+        uint32_t capacity = frame.instances->getInstanceCount();
+        while (capacity < instanceScratch.size()) {
+            capacity *= 2;
+        }
+        frame.instances = std::make_unique<VeBuffer>(veDevice,
+                                                     sizeof(glm::mat4),
+                                                     capacity,
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     1,
+                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.instances->map();
+        auto bufferInfo = frame.instances->descriptorInfo();
+        VeDescriptorWriter(*instanceLayout, *descriptorPool)
+            .writeBuffer(0, &bufferInfo)
+            .overwrite(frame.instanceSet);
+    }
+    std::copy(instanceScratch.begin(),
+              instanceScratch.end(),
+              static_cast<glm::mat4 *>(frame.instances->getMappedMemory()));
+}
+
+ShadowRenderSystem::LayerDraws ShadowRenderSystem::addDraws(std::vector<uint32_t> &casters) {
+    std::sort(casters.begin(), casters.end(), [&](uint32_t a, uint32_t b) {
+        return casterObjects[a]->model.get() < casterObjects[b]->model.get();
+    });
+
+    LayerDraws draws{static_cast<uint32_t>(runs.size()), 0};
+    for (uint32_t object : casters) {
+        VeModel *mesh = casterObjects[object]->model.get();
+        auto instance = static_cast<uint32_t>(instanceScratch.size());
+        instanceScratch.push_back(casterObjects[object]->transform.mat4());
+        if (draws.runCount > 0 && runs.back().mesh == mesh) {
+            runs.back().instanceCount++;
+        } else {
+            runs.push_back({mesh, instance, 1});
+            draws.runCount++;
+        }
+    }
+    return draws;
+}
+
+RGHandle ShadowRenderSystem::addPasses(VeRenderGraph &renderGraph, int frameIndex) {
+    FrameData &frame = frames[frameIndex];
+    RGImageDesc desc{FORMAT, {RESOLUTION, RESOLUTION}, VK_IMAGE_ASPECT_DEPTH_BIT};
+    auto shadowMap = renderGraph.importImage(
+        "shadow map",
+        frame.shadowMap.image,
+        frame.shadowMap.view,
+        desc,
+        frame.shadowMapWritten ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                               : VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    frame.shadowMapWritten = true;
+
+    uint32_t cascadeCount = cascades.getCascadeCount();
+    if (cascadeCount > ShadowCascades::FIRST_CACHED_CASCADE) {
+        auto cache = renderGraph.importImage(
+            "shadow cache",
+            frame.cache.image,
+            frame.cache.view,
+            desc,
+            frame.cacheWritten ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        frame.cacheWritten = true;
+
+        uint32_t cachedCount = cascadeCount - ShadowCascades::FIRST_CACHED_CASCADE;
+        if (std::any_of(cacheUpdates.begin(), cacheUpdates.begin() + cachedCount, [](bool b) {
+                return b;
+            })) {
+            renderGraph.addPass(
+                "shadow cache",
+                [&](VeRenderGraph::PassBuilder &builder) {
+                    builder.write(cache, RGAccess::DepthAttachment);
+                },
+                [this, &frame, frameIndex, cachedCount](VkCommandBuffer cmd) {
+                    for (uint32_t layer = 0; layer < cachedCount; layer++) {
+                        if (cacheUpdates[layer]) {
+                            uint32_t cascade = layer + ShadowCascades::FIRST_CACHED_CASCADE;
+                            renderLayer(cmd,
+                                        frameIndex,
+                                        frame.cache.framebuffers[layer],
+                                        true,
+                                        cascades.getCascade(cascade),
+                                        cacheDraws[layer]);
+                        }
+                    }
+                });
+        }
+
+        // Cached cascades start out as their static casters.
+        renderGraph.addPass(
+            "shadow cache copy",
+            [&](VeRenderGraph::PassBuilder &builder) {
+                builder.read(cache, RGAccess::TransferRead);
+                builder.write(shadowMap, RGAccess::TransferWrite);
+            },
+            [&frame, cachedCount](VkCommandBuffer cmd) {
+                VkImageCopy region{};
+                region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, cachedCount};
+                region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT,
+                                         0,
+                                         ShadowCascades::FIRST_CACHED_CASCADE,
+                                         cachedCount};
+                region.extent = {RESOLUTION, RESOLUTION, 1};
+                vkCmdCopyImage(cmd,
+                               frame.cache.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               frame.shadowMap.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1,
+                               &region);
+            });
+    }
+
+    renderGraph.addPass(
+        "shadows",
+        [&](VeRenderGraph::PassBuilder &builder) {
+            builder.write(shadowMap, RGAccess::DepthAttachment);
+        },
+        [this, &frame, frameIndex, cascadeCount](VkCommandBuffer cmd) {
+            for (uint32_t i = 0; i < cascadeCount; i++) {
+                renderLayer(cmd,
+                            frameIndex,
+                            frame.shadowMap.framebuffers[i],
+                            !ShadowCascades::isCached(i),
+                            cascades.getCascade(i),
+                            cascadeDraws[i]);
+            }
+        });
+    return shadowMap;
+}
+
+void ShadowRenderSystem::renderLayer(VkCommandBuffer commandBuffer,
+                                     int frameIndex,
+                                     VkFramebuffer framebuffer,
+                                     bool clear,
+                                     const ShadowCascade &cascade,
+                                     const LayerDraws &draws) {
+    VE_PROFILE_SCOPE("ShadowRenderSystem::renderLayer");
+    VkClearValue clearValue{};
+    clearValue.depthStencil = {1.f, 0};
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = clear ? clearRenderPass : loadRenderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {RESOLUTION, RESOLUTION};
+    renderPassInfo.clearValueCount = clear ? 1 : 0;
+    renderPassInfo.pClearValues = clear ? &clearValue : nullptr;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(RESOLUTION);
+    viewport.height = static_cast<float>(RESOLUTION);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, {RESOLUTION, RESOLUTION}};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (draws.runCount > 0) {
+        pipeline.get()->bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                pipelineLayout,
+                                0,
+                                1,
+                                &frames[frameIndex].instanceSet,
+                                0,
+                                nullptr);
+        ShadowPushConstantData push{cascade.viewProjection};
+        vkCmdPushConstants(commandBuffer,
+                           pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT,
+                           0,
+                           sizeof(ShadowPushConstantData),
+                           &push);
+        for (uint32_t i = draws.firstRun; i < draws.firstRun + draws.runCount; i++) {
+            const DrawRun &run = runs[i];
+            run.mesh->bindPositions(commandBuffer);
+            run.mesh->draw(commandBuffer, run.instanceCount, run.firstInstance);
+        }
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+}  // namespace ve
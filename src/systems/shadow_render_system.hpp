@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Core/ve_culling.hpp"
+#include "Core/ve_frame_info.hpp"
+#include "Core/ve_game_object.hpp"
+#include "Core/ve_shadow_cascades.hpp"
+#include "Renderer/ve_buffer.hpp"
+#include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_device.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
+#include "Renderer/ve_render_graph.hpp"
+#include "Renderer/ve_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+// lib
+#include <vulkan/vulkan.h>
+
+namespace ve {
+
+// Draws the directional light's cascaded shadow map.
+//
+// Cascades are the layers of one depth texture array. Each is drawn in a render pass of its own
+// with a depth-only pipeline, and only with the casters its frustum culling lets through.
+//
+// The distant cascades only move in coarse steps (see ShadowCascades), so the depth of the static
+// casters in them is kept in a cache array. While such a cascade, the light and the static
+// casters stay put, the cascade starts every frame as a copy of its cache and only dynamic
+// casters are drawn over it.
+//
+// Every frame in flight has its own shadow map and cache, so a frame never draws into textures
+// the previous one may still be reading.
+class ShadowRenderSystem {
+   public:
+    // Global set binding of the shadow map.
+    static constexpr uint32_t SHADOW_MAP_BINDING = 4;
+    static constexpr uint32_t RESOLUTION = 2048;
+    // Enough precision for an orthographic depth range, at half the memory of 32 bit depth.
+    static constexpr VkFormat FORMAT = VK_FORMAT_D16_UNORM;
+
+    explicit ShadowRenderSystem(VeDevice &device);
+    ~ShadowRenderSystem();
+
+    // Remove copy constructors.
+    ShadowRenderSystem(const ShadowRenderSystem &) = delete;
+    ShadowRenderSystem &operator=(const ShadowRenderSystem &) = delete;
+
+    // Fits the cascades to the camera and the light, culls the casters of every cascade and
+    // uploads their transforms. Call once per frame, before addPasses().
+    void update(FrameInfo &frameInfo, const DirectionalLight &light);
+    // Adds the passes drawing the frame's shadow map and returns it, for the passes sampling it
+    // to declare.
+    RGHandle addPasses(VeRenderGraph &renderGraph, int frameIndex);
+
+    // Redraws every cache. Call after moving, adding or removing static objects, only a change
+    // in their number is noticed otherwise.
+    void invalidateStaticCasters() { staticVersion++; }
+    void setCascadeCount(uint32_t count) { cascades.setCascadeCount(count); }
+    [[nodiscard]] uint32_t getCascadeCount() const { return cascades.getCascadeCount(); }
+
+    [[nodiscard]] ShadowUniforms uniforms(const DirectionalLight &light) const {
+        return cascades.uniforms(light);
+    }
+    // Every cascade of the frame's shadow map, with a depth comparison sampler.
+    [[nodiscard]] VkDescriptorImageInfo descriptorInfo(int frameIndex) const;
+    [[nodiscard]] const ShadowStats &getStats() const { return stats; }
+
+   private:
+    static constexpr uint32_t CACHED_CASCADES =
+        ShadowCascades::MAX_CASCADES - ShadowCascades::FIRST_CACHED_CASCADE;
+
+    // Depth texture array and a framebuffer for each of its layers.
+    struct LayeredImage {
+        VkImage image{VK_NULL_HANDLE};
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};  // Every layer.
+        std::vector<VkImageView> layerViews;
+        std::vector<VkFramebuffer> framebuffers;
+    };
+
+    // What a cache layer was last drawn with. It is still valid while all of it matches.
+    struct CacheState {
+        bool valid{false};
+        glm::mat4 viewProjection{1.f};
+        uint64_t staticVersion{0};
+    };
+
+    struct FrameData {
+        LayeredImage shadowMap;
+        LayeredImage cache;
+        bool shadowMapWritten{false};
+        bool cacheWritten{false};
+        std::array<CacheState, CACHED_CASCADES> cacheStates{};
+        // Casters' model matrices, indexed by gl_InstanceIndex.
+        std::unique_ptr<VeBuffer> instances;
+        VkDescriptorSet instanceSet{};
+    };
+
+    // Consecutive instances of one mesh, drawn as one instanced draw.
+    struct DrawRun {
+        VeModel *mesh;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    // Runs [firstRun, firstRun + runCount) drawn into a layer.
+    struct LayerDraws {
+        uint32_t firstRun{0};
+        uint32_t runCount{0};
+    };
+
+    void createImages();
+    void createLayeredImage(LayeredImage &target, uint32_t layers, VkImageUsageFlags usage);
+    void destroyLayeredImage(LayeredImage &target);
+    void createRenderPasses();
+    void createSampler();
+    void createFrameData();
+    void createPipelineLayout();
+    void createPipeline();
+    // Sorts the listed casters by mesh, appends their transforms to instanceScratch and returns
+    // the runs drawing them.
+    LayerDraws addDraws(std::vector<uint32_t> &casters);
+    void renderLayer(VkCommandBuffer commandBuffer,
+                     int frameIndex,
+                     VkFramebuffer framebuffer,
+                     bool clear,
+                     const ShadowCascade &cascade,
+                     const LayerDraws &draws);
+
+    VeDevice &veDevice;
+    ShadowCascades cascades{RESOLUTION};
+
+    // Both render passes are compatible, they only differ in whether the layer is cleared.
+    VkRenderPass clearRenderPass{VK_NULL_HANDLE};
+    VkRenderPass loadRenderPass{VK_NULL_HANDLE};
+    VkSampler sampler{VK_NULL_HANDLE};
+    std::unique_ptr<VeDescriptorPool> descriptorPool{};
+    std::unique_ptr<VeDescriptorSetLayout> instanceLayout{};
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    PipelineFuture pipeline;
+    std::array<FrameData, VeSwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+
+    uint64_t staticVersion{0};
+    size_t staticCount{0};
+
+    // This frame's draws, recorded by the passes added in addPasses().
+    std::vector<DrawRun> runs;
+    std::array<LayerDraws, ShadowCascades::MAX_CASCADES> cascadeDraws{};
+    std::array<LayerDraws, CACHED_CASCADES> cacheDraws{};
+    std::array<bool, CACHED_CASCADES> cacheUpdates{};
+
+    // Culling scratch space, kept between frames so it doesn't allocate.
+    CullBoxes casterBounds;
+    std::vector<const VeGameObject *> casterObjects;
+    std::vector<uint8_t> visibility;
+    std::vector<uint32_t> layerCasters;
+    std::vector<glm::mat4> instanceScratch;
+    ShadowStats stats{};
+};
+
+}  // namespace ve
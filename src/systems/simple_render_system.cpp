@@ -1,5 +1,8 @@
 #include "simple_render_system.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
 // lib
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,8 +10,11 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
+#include <bitset>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
@@ -18,53 +24,93 @@ namespace ve {
 // - scalars aligned by N ( = 4 bytes given 32 bit floats)
 // - vec2 aligned by 2N ( = 8 bytes)
 // - vec3 and vec4 aligned by 4N ( = 16 bytes)
-struct SimplePushConstantData {
+// Laid out to match std430 in pbr.vert.
+struct InstanceData {
     glm::mat4 modelMatrix{1.0f};
     glm::mat4 normalMatrix{1.f};
 };
 
 SimpleRenderSystem::SimpleRenderSystem(VeDevice& device,
                                        VkRenderPass renderPass,
+                                       VkRenderPass depthRenderPass,
                                        VkDescriptorSetLayout globalSetLayout,
                                        VeGameObject::Map& gameObjects)
     : veDevice{device} {
-    
     // Create texture sampler
     textureSampler = VeTexture::createTextureSampler(veDevice);
 
+    std::cout << "Number of game objects: " << gameObjects.size() << "\n";
 
-    numGameObjects = static_cast<int>(gameObjects.size());
-    std::cout << "Number of game objects: " << numGameObjects << "\n";
+    createMaterialSets(gameObjects);
+    createInstanceBuffers(static_cast<uint32_t>(gameObjects.size()));
+    createPipelineLayout(globalSetLayout);
+    createPipelines(renderPass, depthRenderPass);
+}
 
-    // Create descriptor pool which allows for a descriptor set for each game object.
+SimpleRenderSystem::~SimpleRenderSystem() {
+    vkDestroySampler(veDevice.device(),
+                     textureSampler,
+                     VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
+}
+
+void SimpleRenderSystem::createMaterialSets(VeGameObject::Map& gameObjects) {
+    std::vector<Material*> materials;
+    for (const auto& [id, obj] : gameObjects) {
+        if (materialIds.count(obj.material.get()) == 0) {
+            materialIds.emplace(obj.material.get(), static_cast<uint32_t>(materials.size()));
+            materials.push_back(obj.material.get());
+            uint32_t features = obj.material->getFeatures();
+            materialFeatures.push_back(features);
+            if (std::find(usedFeatures.begin(), usedFeatures.end(), features) ==
+                usedFeatures.end()) {
+                usedFeatures.push_back(features);
+            }
+        }
+        if (meshIds.count(obj.model.get()) == 0) {
+            meshIds.emplace(obj.model.get(), static_cast<uint32_t>(meshes.size()));
+            meshes.push_back(obj.model.get());
+        }
+    }
+    if (materials.size() > (size_t{1} << DrawPacket::MATERIAL_BITS) ||
+        meshes.size() > (size_t{1} << DrawPacket::MESH_BITS)) {
+        throw std::runtime_error("too many materials or meshes for draw keys!");
+    }
+    auto materialCount = static_cast<uint32_t>(std::max<size_t>(materials.size(), 1));
+    auto frameCount = static_cast<uint32_t>(VeSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    // Create descriptor pool which allows for a descriptor set for each material, plus the
+    // instance buffer set of each frame.
     simplePool = VeDescriptorPool::Builder(veDevice)
-                     .setMaxSets(numGameObjects)
-                     .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000)
-                     .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, numGameObjects)
+                     .setMaxSets(materialCount + frameCount)
+                     .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * materialCount)
+                     .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, materialCount)
+                     .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount)
                      .build();
 
     // Create descriptor layout.
-    simpleLayout = VeDescriptorSetLayout::Builder(veDevice)
-                       .addBinding(0,
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                   VK_SHADER_STAGE_FRAGMENT_BIT)  // Albedo
-                       .addBinding(1,
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                   VK_SHADER_STAGE_FRAGMENT_BIT)  // Metallic
-                       .addBinding(2,
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                   VK_SHADER_STAGE_FRAGMENT_BIT)  // Rougness
-                       .addBinding(3,
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                   VK_SHADER_STAGE_FRAGMENT_BIT)  // AO
-                       .addBinding(4,
-                                   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                   VK_SHADER_STAGE_FRAGMENT_BIT)  // Uniform buffer
-                       .build();
-
-    // Create descriptor set for each game object
-    for (const auto& [id, obj] : gameObjects) {
-        VkDescriptorSet descriptorSet{};
+    materialLayout = VeDescriptorSetLayout::Builder(veDevice)
+                         .addBinding(0,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Albedo
+                         .addBinding(1,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Metallic
+                         .addBinding(2,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Rougness
+                         .addBinding(3,
+                                     VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // AO
+                         .addBinding(4,
+                                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                     VK_SHADER_STAGE_FRAGMENT_BIT)  // Uniform buffer
+                         .build();
+
+    // Create descriptor set for each material.
+    for (Material* material : materials) {
         // Allocate material UBO.
         auto ubo = std::make_unique<VeBuffer>(veDevice,
                                               sizeof(DeviceMaterial),
@@ -74,98 +120,354 @@ SimpleRenderSystem::SimpleRenderSystem(VeDevice& device,
         // Write material info to the UBO.
         ubo->map();
         DeviceMaterial mat{};
-        mat.albedo = obj.material->m_albedo;
-        mat.metallic = obj.material->m_metallic;
-        mat.roughness = obj.material->m_roughness;
-        mat.ao = obj.material->m_ao;
+        mat.albedo = material->m_albedo;
+        mat.metallic = material->m_metallic;
+        mat.roughness = material->m_roughness;
+        mat.ao = material->m_ao;
         ubo->writeToBuffer(&mat);
         ubo->flush();
         auto bufferInfo = ubo->descriptorInfo();
         materialUBOs.push_back(std::move(ubo));
 
         // Write texture infos.
-        VkDescriptorImageInfo albedoInfo{};
-        albedoInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        albedoInfo.imageView = obj.material->m_albedoMap->imageView();
-        albedoInfo.sampler = textureSampler;
-
-        VkDescriptorImageInfo metallicInfo{};
-        metallicInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        metallicInfo.imageView = obj.material->m_metallicMap->imageView();
-        metallicInfo.sampler = textureSampler;
-
-        VkDescriptorImageInfo roughnessInfo{};
-        roughnessInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        roughnessInfo.imageView = obj.material->m_roughnessMap->imageView();
-        roughnessInfo.sampler = textureSampler;
-
-        VkDescriptorImageInfo aoInfo{};
-        aoInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        aoInfo.imageView = obj.material->m_aoMap->imageView();
-        aoInfo.sampler = textureSampler;
+        std::array<VkDescriptorImageInfo, 4> imageInfos{};
+        std::array<VeTexture*, 4> textures{material->m_albedoMap.get(),
+                                           material->m_metallicMap.get(),
+                                           material->m_roughnessMap.get(),
+                                           material->m_aoMap.get()};
+        for (size_t i = 0; i < textures.size(); i++) {
+            imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos[i].imageView = textures[i]->imageView();
+            imageInfos[i].sampler = textureSampler;
+        }
 
         // Allocate and write descriptor set.
-        VeDescriptorWriter(*simpleLayout, *simplePool)
-            .writeImage(0, &albedoInfo)
-            .writeImage(1, &metallicInfo)
-            .writeImage(2, &roughnessInfo)
-            .writeImage(3, &aoInfo)
+        VkDescriptorSet descriptorSet{};
+        VeDescriptorWriter(*materialLayout, *simplePool)
+            .writeImage(0, &imageInfos[0])
+            .writeImage(1, &imageInfos[1])
+            .writeImage(2, &imageInfos[2])
+            .writeImage(3, &imageInfos[3])
             .writeBuffer(4, &bufferInfo)
             .build(descriptorSet);
 
-        // Insert into our map.
-        objectDescriptorSets.emplace(id, descriptorSet);
+        materialDescriptorSets.push_back(descriptorSet);
     }
 
-    std::cout << "# of object descriptor sets: " << objectDescriptorSets.size();
-
-    createPipelineLayout(globalSetLayout);
-    createPipeline(renderPass);
+    std::cout << "# of material descriptor sets: " << materialDescriptorSets.size() << "\n";
 }
 
-SimpleRenderSystem::~SimpleRenderSystem() {
-    vkDestroySampler(veDevice.device(), textureSampler, nullptr);
-    vkDestroyPipelineLayout(veDevice.device(), pipelineLayout, nullptr);
+void SimpleRenderSystem::createInstanceBuffers(uint32_t capacity) {
+    // Buffers can't be empty, so keep at least one instance around.
+    instanceCapacity = std::max<uint32_t>(capacity, 1);
+
+    instanceLayout =
+        VeDescriptorSetLayout::Builder(veDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+
+    // Each frame in flight writes its own buffer, so we never overwrite transforms the GPU is
+    // still reading.
+    for (int i = 0; i < VeSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        auto instanceBuffer = std::make_unique<VeBuffer>(veDevice,
+                                                         sizeof(InstanceData),
+                                                         instanceCapacity,
+                                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                         1,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        instanceBuffer->map();
+        auto bufferInfo = instanceBuffer->descriptorInfo();
+
+        VkDescriptorSet descriptorSet{};
+        VeDescriptorWriter(*instanceLayout, *simplePool)
+            .writeBuffer(0, &bufferInfo)
+            .build(descriptorSet);
+        instanceBuffers.push_back(std::move(instanceBuffer));
+        instanceDescriptorSets.push_back(descriptorSet);
+    }
 }
 
 void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
-
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout,
-                                                            simpleLayout->getDescriptorSetLayout()};
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout,
+        materialLayout->getDescriptorSetLayout(),
+        instanceLayout->getDescriptorSetLayout()};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    if (vkCreatePipelineLayout(veDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &pipelineLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+void SimpleRenderSystem::createPipelines(VkRenderPass renderPass, VkRenderPass depthRenderPass) {
     assert(pipelineLayout != nullptr && "Cannot create pipeline before layout");
 
-    PipelineConfigInfo pipelineConfig{};
-    VePipeline::defaultPipelineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
-    vePipeline = std::make_unique<VePipeline>(
-        veDevice, "../assets/shaders/pbr.vert.spv", "../assets/shaders/pbr.frag.spv", pipelineConfig);
+    for (uint32_t variant = 0; variant < RenderSettings::PIPELINE_VARIANTS; variant++) {
+        RenderSettings settings = RenderSettings::fromPipelineVariant(variant);
+        PipelineConfigInfo pipelineConfig{};
+        VePipeline::defaultPipelineConfigInfo(pipelineConfig);
+        if (settings.depthPrepass) {
+            VePipeline::depthPrepassedPipelineConfigInfo(pipelineConfig);
+        }
+        if (settings.showOverdraw) {
+            VePipeline::overdrawPipelineConfigInfo(pipelineConfig);
+        }
+        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.pipelineLayout = pipelineLayout;
+        // Only permutations some material uses are compiled. The overdraw shader ignores
+        // materials, so its permutations all share one pipeline.
+        for (uint32_t features : usedFeatures) {
+            if (!settings.showOverdraw) {
+                pipelineConfig.fragmentConstants = MaterialFeatures::fragmentConstants(features);
+            }
+            pipelines[variant][features] = veDevice.pipelineLibrary().requestPipeline(
+                "../assets/shaders/pbr.vert.spv",
+                settings.showOverdraw ? "../assets/shaders/overdraw.frag.spv"
+                                      : "../assets/shaders/pbr.frag.spv",
+                pipelineConfig);
+        }
+    }
+
+    // The material set is unused by the depth pipeline, but sharing the layout keeps the global
+    // and instance sets bound across both passes.
+    PipelineConfigInfo depthConfig{};
+    VePipeline::depthOnlyPipelineConfigInfo(depthConfig);
+    depthConfig.renderPass = depthRenderPass;
+    depthConfig.pipelineLayout = pipelineLayout;
+    depthPipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/pbr_depth.vert.spv", "", depthConfig);
+}
+
+bool SimpleRenderSystem::isPipelineReady(const RenderSettings& settings) const {
+    for (uint32_t features : usedFeatures) {
+        if (!ve::isPipelineReady(pipelines[settings.pipelineVariant()][features])) {
+            return false;
+        }
+    }
+    return ve::isPipelineReady(depthPipeline);
+}
+
+void SimpleRenderSystem::logShaderPermutations() {
+    // The pre-pass only changes the depth test, the shaded variant without it stands for both.
+    std::cout << "pbr.frag permutations in use: " << usedFeatures.size() << "\n";
+    for (uint32_t features : usedFeatures) {
+        std::cout << "  " << MaterialFeatures::name(features) << ", "
+                  << std::bitset<MaterialFeatures::COUNT>(features).count()
+                  << " material samples\n";
+        pipelines[0][features].get()->logFragmentStatistics();
+    }
+}
+
+void SimpleRenderSystem::renderDepthPrepass(FrameInfo& frameInfo) {
+    VE_PROFILE_SCOPE("SimpleRenderSystem::renderDepthPrepass");
+    VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+    depthPipeline.get()->bind(commandBuffer);
+    bindFrameSets(frameInfo, commandBuffer);
+
+    // Runs are sorted by material first, which doesn't matter without shading, so only meshes
+    // need rebinding.
+    uint32_t boundMesh = UINT32_MAX;
+    for (const DrawRun& run : runs) {
+        if (run.mesh != boundMesh) {
+            boundMesh = run.mesh;
+            meshes[run.mesh]->bindPositions(commandBuffer);
+        }
+        meshes[run.mesh]->draw(commandBuffer, run.instanceCount, run.firstInstance);
+    }
 }
 
 void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-    // Bind the pipeline.
-    vePipeline->bind(frameInfo.commandBuffer);
+    VE_PROFILE_SCOPE("SimpleRenderSystem::renderGameObjects");
+    auto start = std::chrono::high_resolution_clock::now();
+    recordDraws(frameInfo, frameInfo.commandBuffer, 0, runs.size());
+    auto end = std::chrono::high_resolution_clock::now();
+    submissionStats.recordThreads = 1;
+    submissionStats.recordMilliseconds =
+        std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, VeParallelRecorder& recorder) {
+    VE_PROFILE_SCOPE("SimpleRenderSystem::renderGameObjects");
+    auto start = std::chrono::high_resolution_clock::now();
+    recorder.record(static_cast<uint32_t>(runs.size()),
+                    [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+                        recordDraws(frameInfo, commandBuffer, begin, end);
+                    });
+    auto end = std::chrono::high_resolution_clock::now();
+    submissionStats.recordThreads =
+        std::min(recorder.getActiveThreads(), static_cast<uint32_t>(runs.size()));
+    submissionStats.recordMilliseconds =
+        std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void SimpleRenderSystem::cullOccluded(FrameInfo& frameInfo) {
+    // Pick the visible occluders likely to cover the most of the screen, by the size of their
+    // bounds over their distance to the camera.
+    glm::vec3 eye = frameInfo.camera.getPosition();
+    occluderCandidates.clear();
+    for (size_t i = 0; i < cullObjects.size(); i++) {
+        if (!visibility[i] || cullObjects[i]->model->getOccluder() == nullptr) {
+            continue;
+        }
+        glm::vec3 center{worldBounds.centerX[i], worldBounds.centerY[i], worldBounds.centerZ[i]};
+        glm::vec3 extent{worldBounds.extentX[i], worldBounds.extentY[i], worldBounds.extentZ[i]};
+        float size = glm::length(extent) / std::max(glm::length(center - eye), 1e-3f);
+        if (size >= MIN_OCCLUDER_SIZE) {
+            occluderCandidates.push_back({size, static_cast<uint32_t>(i)});
+        }
+    }
+    size_t occluderCount = std::min(occluderCandidates.size(), MAX_OCCLUDERS);
+    if (occluderCount == 0) {
+        return;
+    }
+    std::partial_sort(occluderCandidates.begin(),
+                      occluderCandidates.begin() + static_cast<std::ptrdiff_t>(occluderCount),
+                      occluderCandidates.end(),
+                      [](const OccluderCandidate& a, const OccluderCandidate& b) {
+                          return a.size > b.size;
+                      });
+
+    occlusionBuffer.clear(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+    for (size_t i = 0; i < occluderCount; i++) {
+        const auto* obj = cullObjects[occluderCandidates[i].index];
+        occlusionBuffer.renderOccluder(*obj->model->getOccluder(), obj->transform.mat4());
+    }
+    // Occluders are drawn inside their objects, so they never hide themselves.
+    size_t occluded =
+        occlusionBuffer.testBoxes(worldBounds, visibility.data(), 0, cullObjects.size());
+    cullStats.occluders = static_cast<uint32_t>(occluderCount);
+    cullStats.occluded = static_cast<uint32_t>(occluded);
+}
+
+void SimpleRenderSystem::prepareDraws(FrameInfo& frameInfo) {
+    VE_PROFILE_SCOPE("SimpleRenderSystem::prepareDraws");
+    // Gather world space bounds and cull them in one batch.
+    worldBounds.clear();
+    cullObjects.clear();
+    worldBounds.reserve(frameInfo.gameObjects.size());
+    for (auto& kv : frameInfo.gameObjects) {
+        auto& obj = kv.second;
+        worldBounds.add(obj.transform.transformBounds(obj.model->getBoundingBox()));
+        cullObjects.push_back(&obj);
+    }
+    visibility.resize(cullObjects.size());
+    size_t visibleCount =
+        cullBoxes(frameInfo.camera.getFrustum(), worldBounds, visibility.data());
+    cullStats.tested = static_cast<uint32_t>(cullObjects.size());
+    cullStats.culled = static_cast<uint32_t>(cullObjects.size() - visibleCount);
+    cullStats.occluders = 0;
+    cullStats.occluded = 0;
+    if (frameInfo.settings.occlusionCulling) {
+        cullOccluded(frameInfo);
+    }
+
+    // Emit a packet per visible object and sort them into submission order.
+    const glm::mat4& view = frameInfo.camera.getView();
+    packets.clear();
+    for (size_t i = 0; i < cullObjects.size(); i++) {
+        if (!visibility[i]) {
+            continue;
+        }
+        const auto* obj = cullObjects[i];
+        glm::vec4 center{
+            worldBounds.centerX[i], worldBounds.centerY[i], worldBounds.centerZ[i], 1.f};
+        float depth = (view * center).z;
+        uint32_t material = materialIds.at(obj->material.get());
+        uint64_t key = DrawPacket::makeKey(0,
+                                           materialFeatures[material],
+                                           material,
+                                           meshIds.at(obj->model.get()),
+                                           depth);
+        packets.push_back({key, static_cast<uint32_t>(i)});
+    }
+    submissionStats.packets = static_cast<uint32_t>(packets.size());
+    submissionStats.unsorted = countStateChanges(packets);
+    radixSortPackets(packets, sortScratch);
+    submissionStats.sorted = countStateChanges(packets);
+
+    // Write the transforms in submission order, so every run of packets sharing a mesh and
+    // material is a contiguous range of instances.
+    assert(packets.size() <= instanceCapacity && "Game objects added after creation");
+    auto* instances =
+        static_cast<InstanceData*>(instanceBuffers[frameInfo.frameIndex]->getMappedMemory());
+    for (size_t i = 0; i < packets.size(); i++) {
+        const auto& transform = cullObjects[packets[i].index]->transform;
+        instances[i].modelMatrix = transform.mat4();
+        instances[i].normalMatrix = transform.normalMatrix();
+    }
 
+    // Split the sorted packets into runs sharing all state above depth, each drawn with one
+    // instanced draw.
+    runs.clear();
+    size_t first = 0;
+    while (first < packets.size()) {
+        uint64_t state = packets[first].key >> DrawPacket::MESH_SHIFT;
+        size_t last = first + 1;
+        while (instancing && last < packets.size() &&
+               packets[last].key >> DrawPacket::MESH_SHIFT == state) {
+            last++;
+        }
+        runs.push_back({static_cast<uint32_t>(first),
+                        static_cast<uint32_t>(last - first),
+                        packets[first].pipeline(),
+                        packets[first].material(),
+                        packets[first].mesh()});
+        first = last;
+    }
+    submissionStats.drawCalls = static_cast<uint32_t>(runs.size());
+}
+
+void SimpleRenderSystem::recordDraws(FrameInfo& frameInfo,
+                                     VkCommandBuffer commandBuffer,
+                                     size_t begin,
+                                     size_t end) {
+    VE_PROFILE_SCOPE("SimpleRenderSystem::recordDraws");
+    const auto& variantPipelines = pipelines[frameInfo.settings.pipelineVariant()];
+    bindFrameSets(frameInfo, commandBuffer);
+
+    // Only bind state that changed since the previous run. Runs are sorted by permutation first.
+    uint32_t boundPipeline = UINT32_MAX;
+    uint32_t boundMaterial = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+    for (size_t i = begin; i < end; i++) {
+        const DrawRun& run = runs[i];
+        if (run.pipeline != boundPipeline) {
+            boundPipeline = run.pipeline;
+            variantPipelines[run.pipeline].get()->bind(commandBuffer);
+        }
+        if (run.material != boundMaterial) {
+            boundMaterial = run.material;
+            vkCmdBindDescriptorSets(commandBuffer,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    pipelineLayout,
+                                    1,
+                                    1,
+                                    &materialDescriptorSets[run.material],
+                                    0,
+                                    nullptr);
+        }
+        if (run.mesh != boundMesh) {
+            boundMesh = run.mesh;
+            meshes[run.mesh]->bind(commandBuffer);
+        }
+        meshes[run.mesh]->draw(commandBuffer, run.instanceCount, run.firstInstance);
+    }
+}
+
+void SimpleRenderSystem::bindFrameSets(FrameInfo& frameInfo, VkCommandBuffer commandBuffer) {
     // Only being bound once, not per object
-    vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+    vkCmdBindDescriptorSets(commandBuffer,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
                             pipelineLayout,
                             0,
@@ -173,38 +475,14 @@ void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
                             &frameInfo.globalDescriptorSet,
                             0,
                             nullptr);
-
-    // Render each game object.
-    for (auto& kv : frameInfo.gameObjects) {
-        auto id = kv.first;
-        auto& obj = kv.second;
-
-        // Push data containing model and normal matrix.
-        SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.mat4();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        // Bind the descriptor set of the object we are rendering.
-        vkCmdBindDescriptorSets(frameInfo.commandBuffer,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipelineLayout,
-                                1,
-                                1,
-                                &objectDescriptorSets[id],
-                                0,
-                                nullptr);
-
-        // Send push constants.
-        vkCmdPushConstants(frameInfo.commandBuffer,
-                           pipelineLayout,
-                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                           0,
-                           sizeof(SimplePushConstantData),
-                           &push);
-
-        obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
-    }
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout,
+                            2,
+                            1,
+                            &instanceDescriptorSets[frameInfo.frameIndex],
+                            0,
+                            nullptr);
 }
 
-}  // namespace ve
\ No newline at end of file
+}  // namespace ve
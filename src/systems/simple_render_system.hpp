@@ -1,14 +1,20 @@
 #pragma once
 
 #include "Core/ve_camera.hpp"
+#include "Core/ve_culling.hpp"
 #include "Core/ve_frame_info.hpp"
 #include "Core/ve_game_object.hpp"
+#include "Core/ve_material.hpp"
+#include "Core/ve_occlusion.hpp"
 #include "Renderer/ve_descriptors.hpp"
+#include "Renderer/ve_draw_packets.hpp"
+#include "Renderer/ve_parallel_recorder.hpp"
 #include "Renderer/ve_device.hpp"
-#include "Renderer/ve_pipeline.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
 #include "Renderer/ve_swap_chain.hpp"
 
 // std
+#include <array>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -18,10 +24,23 @@
 
 namespace ve {
 
+// Renders game objects with CPU frustum and occlusion culling and automatic instancing.
+//
+// Every visible object emits a draw packet whose key orders it by pipeline, material, mesh and then
+// front to back. After sorting, objects sharing a model and material are next to each other, their
+// transforms are written to a per-frame instance buffer in that order and each run is drawn with a
+// single instanced vkCmdDrawIndexed. The vertex shader finds its transform through
+// gl_InstanceIndex.
+//
+// With occlusion culling on, the largest visible models with an occluder mesh are rasterized into
+// a small CPU depth buffer first, and objects whose bounds are hidden behind them are dropped
+// before any packet is emitted.
 class SimpleRenderSystem {
    public:
+    // depthRenderPass is a depth-only render pass the depth pre-pass pipeline is created against.
     SimpleRenderSystem(VeDevice &device,
                        VkRenderPass renderPass,
+                       VkRenderPass depthRenderPass,
                        VkDescriptorSetLayout globalSetLayout,
                        VeGameObject::Map &gameObjects);
     ~SimpleRenderSystem();
@@ -30,26 +49,82 @@ class SimpleRenderSystem {
     SimpleRenderSystem(const SimpleRenderSystem &) = delete;
     SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
+    // Whether the pipelines drawing with these settings have finished compiling in the background.
+    [[nodiscard]] bool isPipelineReady(const RenderSettings &settings) const;
+    // Prints each shader permutation the materials use, with the driver's statistics for it.
+    // Waits for the permutations to compile.
+    void logShaderPermutations();
+
+    // Culls, sorts and uploads instances for this frame. Call once per frame, before any of the
+    // render functions below.
+    void prepareDraws(FrameInfo &frameInfo);
+
+    // Writes the depth of every visible object, without shading, for the depth pre-pass.
+    void renderDepthPrepass(FrameInfo &frameInfo);
+    // Draws every game object whose world space bounds intersect the camera frustum.
     void renderGameObjects(FrameInfo &frameInfo);
+    // Same, but the draws are split across the recorder's threads, each recording a secondary
+    // command buffer. Must be called between the recorder's beginRenderPass() and endRenderPass().
+    void renderGameObjects(FrameInfo &frameInfo, VeParallelRecorder &recorder);
+
+    // With instancing off every object gets its own draw, as if no two objects shared state.
+    void setInstancing(bool enabled) { instancing = enabled; }
+
+    [[nodiscard]] const CullStats &getCullStats() const { return cullStats; }
+    [[nodiscard]] const SubmissionStats &getSubmissionStats() const { return submissionStats; }
 
    private:
+    // Consecutive packets sharing all state, drawn as one instanced draw.
+    struct DrawRun {
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+        uint32_t pipeline;  // MaterialFeatures of the material, selecting the permutation.
+        uint32_t material;
+        uint32_t mesh;
+    };
+
+    struct OccluderCandidate {
+        float size;
+        uint32_t index;
+    };
+
+    // At most this many occluders are drawn, and only those whose bounds cover a large enough
+    // angle, as small ones rarely hide anything and still cost a full rasterization.
+    static constexpr size_t MAX_OCCLUDERS = 32;
+    static constexpr float MIN_OCCLUDER_SIZE = 0.05f;
+
+    // Clears the visibility of frustum visible objects hidden behind occluders.
+    void cullOccluded(FrameInfo &frameInfo);
+    // Records runs [begin, end). Safe to call concurrently for disjoint ranges.
+    void recordDraws(FrameInfo &frameInfo, VkCommandBuffer commandBuffer, size_t begin, size_t end);
+    void bindFrameSets(FrameInfo &frameInfo, VkCommandBuffer commandBuffer);
+    void createMaterialSets(VeGameObject::Map &gameObjects);
+    void createInstanceBuffers(uint32_t capacity);
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    void createPipeline(VkRenderPass renderPass);
+    void createPipelines(VkRenderPass renderPass, VkRenderPass depthRenderPass);
 
     VeDevice &veDevice;
 
-    // Number of game objects we are rendering.
-    int numGameObjects;
-
-    std::unique_ptr<VePipeline> vePipeline;
+    // Indexed by RenderSettings::pipelineVariant(), then by MaterialFeatures. Only the features
+    // in usedFeatures have a pipeline.
+    std::array<std::array<PipelineFuture, MaterialFeatures::PERMUTATIONS>,
+               RenderSettings::PIPELINE_VARIANTS>
+        pipelines;
+    PipelineFuture depthPipeline;
     VkPipelineLayout pipelineLayout{};
 
     std::unique_ptr<VeDescriptorPool> simplePool{};
-    std::unique_ptr<VeDescriptorSetLayout> simpleLayout{};
-
-    // Each game object has a descriptor set.
-    // Map from game object ID to descriptor set.
-    std::unordered_map<VeGameObject::id_t, VkDescriptorSet> objectDescriptorSets;
+    std::unique_ptr<VeDescriptorSetLayout> materialLayout{};
+    std::unique_ptr<VeDescriptorSetLayout> instanceLayout{};
+
+    // Objects sharing a material share its descriptor set. Materials and meshes are numbered
+    // for the draw keys, the ids index these vectors.
+    std::unordered_map<Material *, uint32_t> materialIds;
+    std::unordered_map<VeModel *, uint32_t> meshIds;
+    std::vector<VkDescriptorSet> materialDescriptorSets;
+    std::vector<uint32_t> materialFeatures;
+    std::vector<uint32_t> usedFeatures;
+    std::vector<VeModel *> meshes;
 
     // Sampler for game object's textures.
     VkSampler textureSampler{};
@@ -57,7 +132,23 @@ class SimpleRenderSystem {
     // UBO's for object materials.
     std::vector<std::unique_ptr<VeBuffer>> materialUBOs;
 
-    // Cubemap.
+    // Per frame instance transforms, indexed by gl_InstanceIndex.
+    uint32_t instanceCapacity{0};
+    std::vector<std::unique_ptr<VeBuffer>> instanceBuffers;
+    std::vector<VkDescriptorSet> instanceDescriptorSets;
+
+    // Culling and sorting scratch space, kept between frames so it doesn't allocate.
+    CullBoxes worldBounds;
+    std::vector<uint8_t> visibility;
+    std::vector<const VeGameObject *> cullObjects;
+    std::vector<OccluderCandidate> occluderCandidates;
+    OcclusionBuffer occlusionBuffer{320, 180};
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> sortScratch;
+    std::vector<DrawRun> runs;
+    bool instancing{true};
+    CullStats cullStats{};
+    SubmissionStats submissionStats{};
 };
 
-}  // namespace ve
\ No newline at end of file
+}  // namespace ve
@@ -1,5 +1,8 @@
 #include "skybox_render_system.hpp"
 
+#include "Core/ve_alloc_tracker.hpp"
+#include "Core/ve_cpu_profiler.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -52,8 +55,12 @@ SkyboxSystem::SkyboxSystem(VeDevice& device,
 }
 
 SkyboxSystem::~SkyboxSystem() {
-    vkDestroySampler(veDevice.device(), m_cubemapSampler, nullptr);
-    vkDestroyPipelineLayout(veDevice.device(), pipelineLayout, nullptr);
+    vkDestroySampler(veDevice.device(),
+                     m_cubemapSampler,
+                     VeAllocTracker::callbacks(AllocScope::Device));
+    vkDestroyPipelineLayout(veDevice.device(),
+                            pipelineLayout,
+                            VeAllocTracker::callbacks(AllocScope::Pipeline));
 }
 
 void SkyboxSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -71,7 +78,10 @@ void SkyboxSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
     pipelineLayoutInfo.pushConstantRangeCount = 0;
     pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if (vkCreatePipelineLayout(veDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+    if (vkCreatePipelineLayout(veDevice.device(),
+                               &pipelineLayoutInfo,
+                               VeAllocTracker::callbacks(AllocScope::Pipeline),
+                               &pipelineLayout) !=
         VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
@@ -94,13 +104,14 @@ void SkyboxSystem::createPipeline(VkRenderPass renderPass) {
 
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
-    vePipeline = std::make_unique<VePipeline>(
-        veDevice, "../assets/shaders/skybox.vert.spv", "../assets/shaders/skybox.frag.spv", pipelineConfig);
+    vePipeline = veDevice.pipelineLibrary().requestPipeline(
+        "../assets/shaders/skybox.vert.spv", "../assets/shaders/skybox.frag.spv", pipelineConfig);
 }
 
 void SkyboxSystem::renderSkybox(FrameInfo& frameInfo) {
+    VE_PROFILE_SCOPE("SkyboxSystem::renderSkybox");
     // Bind the pipeline.
-    vePipeline->bind(frameInfo.commandBuffer);
+    vePipeline.get()->bind(frameInfo.commandBuffer);
 
     // Bind global descriptor set as set 0.
     vkCmdBindDescriptorSets(frameInfo.commandBuffer,
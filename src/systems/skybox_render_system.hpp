@@ -10,7 +10,7 @@
 #include "Core/ve_game_object.hpp"
 #include "Renderer/ve_device.hpp"
 #include "Renderer/ve_descriptors.hpp"
-#include "Renderer/ve_pipeline.hpp"
+#include "Renderer/ve_pipeline_library.hpp"
 
 namespace ve {
 
@@ -42,7 +42,7 @@ class SkyboxSystem {
     std::shared_ptr<VeTexture> m_cubemap;
     VkSampler m_cubemapSampler;
 
-    std::unique_ptr<VePipeline> vePipeline;
+    PipelineFuture vePipeline;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 };
 